@@ -0,0 +1,459 @@
+#include "airshift_acquisition.h"
+#include "airshift_metrics.h"
+#include "airshift_power.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <esp_timer.h>
+#include <freertos/queue.h>
+
+#define TICK_PERIOD_MS          1000
+#define TICK_PERIOD_US          ( (int64_t)TICK_PERIOD_MS * 1000 )
+#define TICK_DEADLINE_MS        ( TICK_PERIOD_MS - 100 )
+
+#define SHT30_AVERAGING         1
+
+#define SAMPLE_QUEUE_LENGTH     2
+#define SENSOR_TASK_STACK_SIZE  4096
+#define SENSOR_TASK_PRIORITY    6
+#define ENGINE_TASK_STACK_SIZE  4096
+#define ENGINE_TASK_PRIORITY    7
+
+#define TRIGGER_BIT( sensor )   ( 1UL << ( sensor ) )
+#define DONE_BIT( sensor )      ( 1UL << ( ( sensor ) + 8 ) )
+#define DONE_BITS_ALL           ( AIRSHIFT_ACQUISITION_SENSOR_ALL << 8 )
+
+typedef struct
+{
+    const char                  *name;
+    airshift_metrics_stage_t    stage;
+    uint32_t                    cadence_ms;     // native cadence, must be a multiple of TICK_PERIOD_MS
+    esp_err_t                   ( *read )( void *data );
+    size_t                      offset;         // destination inside airshift_sample_set_t
+    size_t                      size;
+} sensor_t;
+
+static const char* TAG = "airshift_acquisition";
+
+// Forward declarations
+static void         engine_task( void *arguments );
+static void         sensor_task( void *arguments );
+static void         tick_timer_callback( void *arguments );
+static esp_err_t    read_pms7003( void *data );
+static esp_err_t    read_senseair( void *data );
+static esp_err_t    read_sht30( void *data );
+
+static const sensor_t sensors_[AIRSHIFT_ACQUISITION_SENSOR_COUNT] =
+{
+    [AIRSHIFT_ACQUISITION_SENSOR_PMS7003]   = { .name = "pms7003",  .stage = AIRSHIFT_METRICS_STAGE_PMS7003_READ,  .cadence_ms = 1000, .read = read_pms7003,   .offset = offsetof( airshift_sample_set_t, pms7003 ), .size = sizeof( pms7003_data_t ) },
+    [AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR]  = { .name = "senseair", .stage = AIRSHIFT_METRICS_STAGE_SENSEAIR_READ, .cadence_ms = 2000, .read = read_senseair,  .offset = offsetof( airshift_sample_set_t, senseair ),.size = sizeof( senseair_data_t ) },
+    [AIRSHIFT_ACQUISITION_SENSOR_SHT30]     = { .name = "sht30",    .stage = AIRSHIFT_METRICS_STAGE_SHT30_READ,    .cadence_ms = 2000, .read = read_sht30,     .offset = offsetof( airshift_sample_set_t, sht30 ),   .size = sizeof( sht30_data_t ) },
+};
+
+static const esp_timer_create_args_t    tick_timer_args_    = { .callback = &tick_timer_callback, .name = "acquisition-tick", .dispatch_method = ESP_TIMER_TASK };
+static esp_timer_handle_t               tick_timer_         = NULL;
+static EventGroupHandle_t               event_group_        = NULL;
+static QueueHandle_t                    sample_queue_       = NULL;
+static TaskHandle_t                     engine_task_        = NULL;
+static TaskHandle_t                     sensor_tasks_[AIRSHIFT_ACQUISITION_SENSOR_COUNT] = { 0 };
+static portMUX_TYPE                     lock_               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_sample_set_t            latest_             = { 0 };
+static airshift_acquisition_stats_t     stats_              = { 0 };
+static int64_t                          latency_total_      = 0;
+static int64_t                          origin_             = 0;
+static uint32_t                         sensor_mask_        = 0;
+
+// Public functions
+esp_err_t airshift_acquisition_init( uint32_t sensor_mask )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_acquisition_init -> sensors: 0x%lx", sensor_mask );
+
+    memset( &latest_, 0, sizeof( latest_ ) );
+    memset( &stats_, 0, sizeof( stats_ ) );
+    latency_total_  = 0;
+    sensor_mask_    = sensor_mask & AIRSHIFT_ACQUISITION_SENSOR_ALL;
+
+    // let the sht30 pick the cheapest measurement mode for our cadence, one it cannot be talked into is read no more ...
+    if( ( sensor_mask_ & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 ) ) && ( airshift_sht30_configure( sensors_[AIRSHIFT_ACQUISITION_SENSOR_SHT30].cadence_ms, SHT30_AVERAGING, SHT30_REPEATABILITY_HIGH ) != ESP_OK ) )
+    {
+        ESP_LOGE( TAG, "airshift_acquisition_init -> airshift_sht30_configure failed, sht30 dropped" );
+
+        sensor_mask_ &= ~AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 );
+    }
+
+    ESP_GOTO_ON_FALSE( ( sensor_mask_ != 0 ), ESP_ERR_NOT_FOUND, error, TAG, "no sensors" );
+
+    event_group_ = xEventGroupCreate();
+
+    ESP_GOTO_ON_FALSE( ( event_group_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xEventGroupCreate failed" );
+
+    // every sensor starts idle ...
+    xEventGroupSetBits( event_group_, DONE_BITS_ALL );
+
+    sample_queue_ = xQueueCreate( SAMPLE_QUEUE_LENGTH, sizeof( airshift_sample_set_t ) );
+
+    ESP_GOTO_ON_FALSE( ( sample_queue_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xQueueCreate failed" );
+
+    for( int i = 0; i < AIRSHIFT_ACQUISITION_SENSOR_COUNT; i++ )
+    {
+        if( ( sensor_mask_ & AIRSHIFT_ACQUISITION_SENSOR_BIT( i ) ) == 0 )
+        {
+            continue;
+        }
+
+        ESP_GOTO_ON_FALSE( ( xTaskCreate( sensor_task, sensors_[i].name, SENSOR_TASK_STACK_SIZE, (void *)(intptr_t)i, SENSOR_TASK_PRIORITY, &sensor_tasks_[i] ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> %s failed", sensors_[i].name );
+    }
+
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( engine_task, "acquisition_task", ENGINE_TASK_STACK_SIZE, NULL, ENGINE_TASK_PRIORITY, &engine_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> acquisition_task failed" );
+
+    ESP_GOTO_ON_ERROR( esp_timer_create( &tick_timer_args_, &tick_timer_ ), error, TAG, "esp_timer_create failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_acquisition_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    // clean up on failure ...
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_acquisition_release() );
+
+    return ret;
+}
+
+esp_err_t airshift_acquisition_release()
+{
+    ESP_LOGI( TAG, "airshift_acquisition_release" );
+
+    if( tick_timer_ != NULL )
+    {
+        airshift_acquisition_stop();
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_timer_delete( tick_timer_ ) );
+
+        tick_timer_ = NULL;
+    }
+
+    if( engine_task_ != NULL )
+    {
+        vTaskDelete( engine_task_ );
+
+        engine_task_ = NULL;
+    }
+
+    for( int i = 0; i < AIRSHIFT_ACQUISITION_SENSOR_COUNT; i++ )
+    {
+        if( sensor_tasks_[i] != NULL )
+        {
+            vTaskDelete( sensor_tasks_[i] );
+
+            sensor_tasks_[i] = NULL;
+        }
+    }
+
+    if( sample_queue_ != NULL )
+    {
+        vQueueDelete( sample_queue_ );
+
+        sample_queue_ = NULL;
+    }
+
+    if( event_group_ != NULL )
+    {
+        vEventGroupDelete( event_group_ );
+
+        event_group_ = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_acquisition_start()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_acquisition_start" );
+
+    ESP_GOTO_ON_FALSE( ( tick_timer_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    // every tick is scheduled from this fixed origin, so errors never accumulate ...
+    origin_ = esp_timer_get_time() + TICK_PERIOD_US;
+
+    ESP_GOTO_ON_ERROR( esp_timer_start_periodic( tick_timer_, TICK_PERIOD_US ), error, TAG, "esp_timer_start_periodic failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_acquisition_start failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_acquisition_stop()
+{
+    ESP_LOGI( TAG, "airshift_acquisition_stop" );
+
+    if( ( tick_timer_ != NULL ) && ( esp_timer_is_active( tick_timer_ ) == true ) )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_timer_stop( tick_timer_ ) );
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_acquisition_wait( airshift_sample_set_t *sample_set, TickType_t ticks_to_wait )
+{
+    if( ( sample_queue_ == NULL ) || ( sample_set == NULL ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if( xQueueReceive( sample_queue_, sample_set, ticks_to_wait ) != pdTRUE )
+    {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_acquisition_get_stats( airshift_acquisition_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+uint32_t airshift_acquisition_get_sensors()
+{
+    return sensor_mask_;
+}
+
+esp_err_t airshift_acquisition_to_sample( const airshift_sample_set_t *sample_set, airshift_sample_t *sample )
+{
+    uint32_t fresh = 0;
+
+    if( ( sample_set == NULL ) || ( sample == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset( sample, 0, sizeof( airshift_sample_t ) );
+
+    sample->timestamp = sample_set->timestamp;
+
+    // a held reading was already in the sample when it was new, the series, the log and the windows do not get it twice ...
+    fresh = sample_set->valid_mask & ~sample_set->held_mask;
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        sample->values[i] = AIRSHIFT_VALUE_INVALID;
+    }
+
+    if( fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR ) )
+    {
+        sample->values[AIRSHIFT_CHANNEL_CO2]            = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_CO2, sample_set->senseair.co2 );
+        sample->valid_mask                             |= AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_CO2 );
+    }
+
+    if( fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 ) )
+    {
+        sample->values[AIRSHIFT_CHANNEL_TEMPERATURE]    = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_TEMPERATURE, sample_set->sht30.temperature );
+        sample->values[AIRSHIFT_CHANNEL_HUMIDITY]       = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_HUMIDITY, sample_set->sht30.humidity );
+        sample->valid_mask                             |= AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_TEMPERATURE ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_HUMIDITY );
+    }
+
+    if( fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_PMS7003 ) )
+    {
+        sample->values[AIRSHIFT_CHANNEL_PM_1_0]         = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_PM_1_0, sample_set->pms7003.pm_sp_ug_1_0 );
+        sample->values[AIRSHIFT_CHANNEL_PM_2_5]         = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_PM_2_5, sample_set->pms7003.pm_sp_ug_2_5 );
+        sample->values[AIRSHIFT_CHANNEL_PM_10_0]        = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_PM_10_0, sample_set->pms7003.pm_sp_ug_10_0 );
+        sample->valid_mask                             |= AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_PM_1_0 ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_PM_2_5 ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_PM_10_0 );
+    }
+
+    return ESP_OK;
+}
+
+// Private functions
+static void tick_timer_callback( void *arguments )
+{
+    if( engine_task_ != NULL )
+    {
+        xTaskNotifyGive( engine_task_ );
+    }
+}
+
+static void engine_task( void *arguments )
+{
+    airshift_sample_set_t sample_set = { 0 };
+
+    ESP_LOGI( TAG, "engine_task" );
+
+    while( true )
+    {
+        EventBits_t triggered   = 0;
+        EventBits_t done        = 0;
+        int64_t     now         = 0;
+        uint32_t    cycle       = 0;
+        int64_t     ideal       = 0;
+        int64_t     latency     = 0;
+
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        // derive the tick from the fixed clock, late or coalesced notifications cannot shift the schedule ...
+        now     = esp_timer_get_time();
+        cycle   = (uint32_t)( ( now - origin_ + ( TICK_PERIOD_US / 2 ) ) / TICK_PERIOD_US );
+        ideal   = origin_ + ( (int64_t)cycle * TICK_PERIOD_US );
+
+        // trigger every sensor due on this tick at the same instant ...
+        for( int i = 0; i < AIRSHIFT_ACQUISITION_SENSOR_COUNT; i++ )
+        {
+            if( ( ( sensor_mask_ & AIRSHIFT_ACQUISITION_SENSOR_BIT( i ) ) == 0 ) || ( ( cycle % ( sensors_[i].cadence_ms / TICK_PERIOD_MS ) ) != 0 ) )
+            {
+                continue;
+            }
+
+            if( ( xEventGroupGetBits( event_group_ ) & DONE_BIT( i ) ) == 0 )
+            {
+                ESP_LOGW( TAG, "%s overrun on cycle %lu", sensors_[i].name, cycle );
+
+                portENTER_CRITICAL( &lock_ );
+                stats_.overruns++;
+                portEXIT_CRITICAL( &lock_ );
+
+                continue;
+            }
+
+            triggered |= TRIGGER_BIT( i );
+        }
+
+        if( triggered != 0 )
+        {
+            // modbus and i2c transactions in flight, no light sleep until the slowest one is done ...
+            airshift_power_lock( AIRSHIFT_POWER_LOCK_SENSOR );
+
+            xEventGroupClearBits( event_group_, ( triggered << 8 ) );
+            xEventGroupSetBits( event_group_, triggered );
+
+            done = xEventGroupWaitBits( event_group_, ( triggered << 8 ), pdFALSE, pdTRUE, ( TICK_DEADLINE_MS / portTICK_PERIOD_MS ) );
+
+            airshift_power_unlock( AIRSHIFT_POWER_LOCK_SENSOR );
+        }
+
+        latency = esp_timer_get_time() - now;
+
+        airshift_metrics_record( AIRSHIFT_METRICS_STAGE_ACQUISITION, latency );
+
+        portENTER_CRITICAL( &lock_ );
+
+        sample_set              = latest_;
+        sample_set.cycle        = cycle;
+        sample_set.timestamp    = ideal;
+        sample_set.jitter       = now - ideal;
+        sample_set.latency      = latency;
+        sample_set.updated_mask = ( ( done >> 8 ) & triggered );
+
+        if( sample_set.updated_mask != triggered )
+        {
+            stats_.deadline_misses++;
+        }
+
+        stats_.cycles++;
+        stats_.latency_last = latency;
+        stats_.latency_max  = ( latency > stats_.latency_max ) ? latency : stats_.latency_max;
+        latency_total_      += latency;
+        stats_.latency_avg  = ( latency_total_ / stats_.cycles );
+        stats_.jitter_last  = sample_set.jitter;
+        stats_.jitter_max   = ( llabs( sample_set.jitter ) > stats_.jitter_max ) ? llabs( sample_set.jitter ) : stats_.jitter_max;
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( xQueueSend( sample_queue_, &sample_set, 0 ) != pdTRUE )
+        {
+            portENTER_CRITICAL( &lock_ );
+            stats_.dropped++;
+            portEXIT_CRITICAL( &lock_ );
+        }
+    }
+
+    vTaskDelete( NULL );
+}
+
+static void sensor_task( void *arguments )
+{
+    const int       sensor          = (int)(intptr_t)arguments;
+    const sensor_t  *descriptor     = &sensors_[sensor];
+    uint8_t         data[sizeof( pms7003_data_t )] = { 0 };
+
+    _Static_assert( sizeof( pms7003_data_t ) >= sizeof( sht30_data_t ), "sensor scratch buffer too small" );
+    _Static_assert( sizeof( pms7003_data_t ) >= sizeof( senseair_data_t ), "sensor scratch buffer too small" );
+
+    ESP_LOGI( TAG, "sensor_task -> %s", descriptor->name );
+
+    while( true )
+    {
+        esp_err_t   ret     = ESP_FAIL;
+        int64_t     start   = 0;
+        int64_t     elapsed = 0;
+
+        xEventGroupWaitBits( event_group_, TRIGGER_BIT( sensor ), pdTRUE, pdTRUE, portMAX_DELAY );
+
+        start   = esp_timer_get_time();
+        ret     = descriptor->read( data );
+        elapsed = esp_timer_get_time() - start;
+
+        airshift_metrics_record( descriptor->stage, elapsed );
+
+        portENTER_CRITICAL( &lock_ );
+
+        // keep the last good reading, consumers check valid_mask, and held_mask for one the sensor is only repeating ...
+        if( ( ret == ESP_OK ) || ( ret == ESP_ERR_NOT_FINISHED ) )
+        {
+            memcpy( ( (uint8_t *)&latest_ ) + descriptor->offset, data, descriptor->size );
+
+            latest_.valid_mask |= AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor );
+            latest_.held_mask   = ( ret == ESP_ERR_NOT_FINISHED ) ? ( latest_.held_mask | AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor ) ) : ( latest_.held_mask & ~AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor ) );
+        }
+        else
+        {
+            latest_.valid_mask &= ~AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor );
+            latest_.held_mask  &= ~AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor );
+
+            stats_.sensor_errors[sensor]++;
+        }
+
+        stats_.sensor_latency_last[sensor]  = elapsed;
+        stats_.sensor_latency_max[sensor]   = ( elapsed > stats_.sensor_latency_max[sensor] ) ? elapsed : stats_.sensor_latency_max[sensor];
+
+        portEXIT_CRITICAL( &lock_ );
+
+        xEventGroupSetBits( event_group_, DONE_BIT( sensor ) );
+    }
+
+    vTaskDelete( NULL );
+}
+
+static esp_err_t read_pms7003( void *data )
+{
+    return airshift_pms7003_get( (pms7003_data_t *)data );
+}
+
+static esp_err_t read_senseair( void *data )
+{
+    return airshift_senseair_get( (senseair_data_t *)data );
+}
+
+static esp_err_t read_sht30( void *data )
+{
+    return airshift_sht30_get( (sht30_data_t *)data );
+}
@@ -0,0 +1,83 @@
+#ifndef AIRSHIFT_ACQUISITION_H
+#define AIRSHIFT_ACQUISITION_H
+
+#include "airshift_header_common.h"
+#include "airshift_common.h"
+
+#include "airshift_pms7003.h"
+#include "airshift_senseair.h"
+#include "airshift_sht30.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    AIRSHIFT_ACQUISITION_SENSOR_PMS7003,
+    AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR,
+    AIRSHIFT_ACQUISITION_SENSOR_SHT30,
+    AIRSHIFT_ACQUISITION_SENSOR_COUNT
+} airshift_acquisition_sensor_t;
+
+#define AIRSHIFT_ACQUISITION_SENSOR_BIT( sensor )   ( 1UL << ( sensor ) )
+#define AIRSHIFT_ACQUISITION_SENSOR_ALL             ( ( 1UL << AIRSHIFT_ACQUISITION_SENSOR_COUNT ) - 1 )
+
+// One coherent snapshot of all sensors, emitted once per scheduler tick ...
+typedef struct
+{
+    uint32_t        cycle;          // scheduler tick number since airshift_acquisition_start
+    int64_t         timestamp;      // ideal trigger time of this tick ( esp_timer_get_time base, us )
+    int64_t         jitter;         // actual trigger time minus ideal trigger time ( us )
+    int64_t         latency;        // trigger until the slowest triggered sensor completed ( us )
+
+    uint32_t        updated_mask;   // sensors that were read during this tick
+    uint32_t        valid_mask;     // sensors whose most recent read succeeded
+    uint32_t        held_mask;      // valid sensors still reporting an earlier measurement, not a new reading
+
+    pms7003_data_t  pms7003;
+    senseair_data_t senseair;
+    sht30_data_t    sht30;
+} airshift_sample_set_t;
+
+typedef struct
+{
+    uint32_t    cycles;
+    uint32_t    overruns;           // sensor still busy when its next trigger was due
+    uint32_t    deadline_misses;    // tick closed before every triggered sensor completed
+    uint32_t    dropped;            // sample sets not consumed by airshift_acquisition_wait in time
+
+    int64_t     latency_last;
+    int64_t     latency_max;
+    int64_t     latency_avg;
+
+    int64_t     jitter_last;
+    int64_t     jitter_max;
+
+    int64_t     sensor_latency_last[AIRSHIFT_ACQUISITION_SENSOR_COUNT];
+    int64_t     sensor_latency_max[AIRSHIFT_ACQUISITION_SENSOR_COUNT];
+    uint32_t    sensor_errors[AIRSHIFT_ACQUISITION_SENSOR_COUNT];
+} airshift_acquisition_stats_t;
+
+// Sensors outside sensor_mask ( AIRSHIFT_ACQUISITION_SENSOR_BIT ) are never read and stay clear in valid_mask, a sensor that
+// failed to come up does not take the others down with it ...
+esp_err_t   airshift_acquisition_init( uint32_t sensor_mask );
+esp_err_t   airshift_acquisition_release();
+
+esp_err_t   airshift_acquisition_start();
+esp_err_t   airshift_acquisition_stop();
+
+esp_err_t   airshift_acquisition_wait( airshift_sample_set_t *sample_set, TickType_t ticks_to_wait );
+esp_err_t   airshift_acquisition_get_stats( airshift_acquisition_stats_t *stats );
+
+// the sensors actually being read, a cycle that updated all of them is a coherent sample set ...
+uint32_t    airshift_acquisition_get_sensors();
+
+// fixed point view of a sample set, channels of sensors whose last read failed or that only hold an earlier reading are marked invalid ...
+esp_err_t   airshift_acquisition_to_sample( const airshift_sample_set_t *sample_set, airshift_sample_t *sample );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_ACQUISITION_H
@@ -0,0 +1,256 @@
+#include "airshift_air_quality.h"
+
+#define WINDOW_MAX              300     // samples, 5 minutes at one acquisition cycle per second
+
+#define HUMIDITY_COMFORT_LOW    30.0f   // %RH, inside the band humidity is good
+#define HUMIDITY_COMFORT_HIGH   60.0f
+
+typedef struct
+{
+    int16_t                 samples[WINDOW_MAX];    // fixed point, see airshift_channel_t
+    int32_t                 sum;                    // of the samples held, exact, nothing to drift
+    uint16_t                head;
+    uint16_t                count;
+    airshift_air_quality_t  level;
+} window_t;
+
+static const char* TAG = "airshift_air_quality";
+
+// Forward declarations
+static void                     push( window_t *window, uint16_t size, int16_t value );
+static airshift_air_quality_t   classify( const airshift_air_quality_config_t *config, float value );
+static airshift_air_quality_t   step( const airshift_air_quality_config_t *config, airshift_air_quality_t level, float value );
+
+static const airshift_channel_t channels_[AIRSHIFT_AIR_QUALITY_INPUT_COUNT] =
+{
+    [AIRSHIFT_AIR_QUALITY_INPUT_CO2]        = AIRSHIFT_CHANNEL_CO2,
+    [AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5]     = AIRSHIFT_CHANNEL_PM_2_5,
+    [AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0]    = AIRSHIFT_CHANNEL_PM_10_0,
+    [AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY]   = AIRSHIFT_CHANNEL_HUMIDITY,
+};
+
+// co2 keeps the ladder the leds always used, particulate matter follows the epa aqi bands, humidity is the distance outside the comfort band ...
+static const airshift_air_quality_config_t default_configs_[AIRSHIFT_AIR_QUALITY_INPUT_COUNT] =
+{
+    [AIRSHIFT_AIR_QUALITY_INPUT_CO2]        = { .breakpoints = { 800.0f, 1000.0f, 1500.0f, 2000.0f, 2500.0f },  .hysteresis = 50.0f,    .window = 30 },
+    [AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5]     = { .breakpoints = { 12.0f, 35.0f, 55.0f, 150.0f, 250.0f },         .hysteresis = 2.0f,     .window = 60 },
+    [AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0]    = { .breakpoints = { 54.0f, 154.0f, 254.0f, 354.0f, 424.0f },       .hysteresis = 5.0f,     .window = 60 },
+    [AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY]   = { .breakpoints = { 1.0f, 10.0f, 20.0f, 30.0f, 60.0f },            .hysteresis = 2.0f,     .window = 60 },
+};
+
+static const char *names_[AIRSHIFT_AIR_QUALITY_COUNT] = { "unknown", "good", "fair", "moderate", "poor", "very poor", "extremely poor" };
+
+static portMUX_TYPE                     lock_                                       = portMUX_INITIALIZER_UNLOCKED;
+static airshift_air_quality_config_t    configs_[AIRSHIFT_AIR_QUALITY_INPUT_COUNT]  = { 0 };
+static window_t                         windows_[AIRSHIFT_AIR_QUALITY_INPUT_COUNT]  = { 0 };
+static airshift_air_quality_result_t    result_                                     = { 0 };
+static airshift_air_quality_stats_t     stats_                                      = { 0 };
+
+// Public functions
+esp_err_t airshift_air_quality_init()
+{
+    ESP_LOGI( TAG, "airshift_air_quality_init" );
+
+    // reset variables ...
+    memcpy( configs_, default_configs_, sizeof( configs_ ) );
+    memset( windows_, 0, sizeof( windows_ ) );
+    memset( &result_, 0, sizeof( result_ ) );
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_air_quality_release()
+{
+    ESP_LOGI( TAG, "airshift_air_quality_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_air_quality_update( const airshift_sample_t *sample, airshift_air_quality_result_t *result )
+{
+    airshift_air_quality_result_t   next        = { 0 };
+    airshift_air_quality_t          previous    = AIRSHIFT_AIR_QUALITY_UNKNOWN;
+    window_t                        *window     = NULL;
+    float                           value       = 0.0f;
+
+    ESP_RETURN_ON_FALSE( ( sample != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    for( int i = 0; i < AIRSHIFT_AIR_QUALITY_INPUT_COUNT; i++ )
+    {
+        window = &windows_[i];
+
+        // a missing reading leaves the window as it is, the level holds on what it already has ...
+        if( sample->valid_mask & AIRSHIFT_CHANNEL_BIT( channels_[i] ) )
+        {
+            push( window, configs_[i].window, sample->values[channels_[i]] );
+        }
+
+        if( window->count == 0 )
+        {
+            continue;
+        }
+
+        next.means[i] = airshift_channel_from_fixed( channels_[i], (int16_t)( window->sum / window->count ) );
+
+        value = next.means[i];
+
+        if( i == AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY )
+        {
+            value = ( value < HUMIDITY_COMFORT_LOW ) ? ( HUMIDITY_COMFORT_LOW - value ) : ( value > HUMIDITY_COMFORT_HIGH ) ? ( value - HUMIDITY_COMFORT_HIGH ) : 0.0f;
+        }
+
+        window->level   = step( &configs_[i], window->level, value );
+        next.levels[i]  = window->level;
+
+        // ... and the worst input decides ...
+        if( next.levels[i] > next.quality )
+        {
+            next.quality    = next.levels[i];
+            next.dominant   = i;
+        }
+    }
+
+    previous = result_.quality;
+    result_  = next;
+
+    stats_.updates++;
+    stats_.transitions += ( next.quality != previous ) ? 1 : 0;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( next.quality != previous )
+    {
+        ESP_LOGI( TAG, "air quality: %s -> %s ( %s )", names_[previous], names_[next.quality], airshift_channel_name( channels_[next.dominant] ) );
+    }
+
+    if( result != NULL )
+    {
+        *result = next;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_air_quality_get( airshift_air_quality_result_t *result )
+{
+    ESP_RETURN_ON_FALSE( ( result != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *result = result_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_air_quality_set_config( airshift_air_quality_input_t input, const airshift_air_quality_config_t *config )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( ( input < AIRSHIFT_AIR_QUALITY_INPUT_COUNT ) && ( config != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+    ESP_GOTO_ON_FALSE( ( ( config->window > 0 ) && ( config->window <= WINDOW_MAX ) && ( config->hysteresis >= 0.0f ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid config" );
+
+    for( int i = 1; i < AIRSHIFT_AIR_QUALITY_BREAKPOINTS; i++ )
+    {
+        ESP_GOTO_ON_FALSE( ( config->breakpoints[i] >= config->breakpoints[i - 1] ), ESP_ERR_INVALID_ARG, error, TAG, "breakpoints not ascending" );
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    // the running sum only holds for the window it was built over ...
+    if( config->window != configs_[input].window )
+    {
+        memset( &windows_[input], 0, sizeof( window_t ) );
+    }
+
+    configs_[input] = *config;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_air_quality_set_config failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_air_quality_get_config( airshift_air_quality_input_t input, airshift_air_quality_config_t *config )
+{
+    ESP_RETURN_ON_FALSE( ( ( input < AIRSHIFT_AIR_QUALITY_INPUT_COUNT ) && ( config != NULL ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *config = configs_[input];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+const char* airshift_air_quality_name( airshift_air_quality_t quality )
+{
+    return ( quality < AIRSHIFT_AIR_QUALITY_COUNT ) ? names_[quality] : "invalid";
+}
+
+esp_err_t airshift_air_quality_get_stats( airshift_air_quality_stats_t *stats )
+{
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static void push( window_t *window, uint16_t size, int16_t value )
+{
+    // the oldest sample leaves the sum as the newest enters, once the window is full ...
+    if( window->count == size )
+    {
+        window->sum -= window->samples[window->head];
+    }
+    else
+    {
+        window->count++;
+    }
+
+    window->samples[window->head]   = value;
+    window->sum                    += value;
+    window->head                    = ( window->head + 1 ) % size;
+}
+
+static airshift_air_quality_t classify( const airshift_air_quality_config_t *config, float value )
+{
+    airshift_air_quality_t quality = AIRSHIFT_AIR_QUALITY_GOOD;
+
+    while( ( ( quality - AIRSHIFT_AIR_QUALITY_GOOD ) < AIRSHIFT_AIR_QUALITY_BREAKPOINTS ) && ( value >= config->breakpoints[quality - AIRSHIFT_AIR_QUALITY_GOOD] ) )
+    {
+        quality++;
+    }
+
+    return quality;
+}
+
+static airshift_air_quality_t step( const airshift_air_quality_config_t *config, airshift_air_quality_t level, float value )
+{
+    airshift_air_quality_t rising   = classify( config, value );
+    airshift_air_quality_t falling  = classify( config, value + config->hysteresis );
+
+    // getting worse shows at once, getting better only once the mean is clear of the breakpoint ...
+    if( ( level == AIRSHIFT_AIR_QUALITY_UNKNOWN ) || ( rising > level ) )
+    {
+        return rising;
+    }
+
+    return ( falling < level ) ? falling : level;
+}
@@ -0,0 +1,78 @@
+#ifndef AIRSHIFT_AIR_QUALITY_H
+#define AIRSHIFT_AIR_QUALITY_H
+
+#include "airshift_header_common.h"
+#include "airshift_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same values as the matter AirQualityEnum, worse is larger ...
+typedef enum
+{
+    AIRSHIFT_AIR_QUALITY_UNKNOWN,
+    AIRSHIFT_AIR_QUALITY_GOOD,
+    AIRSHIFT_AIR_QUALITY_FAIR,
+    AIRSHIFT_AIR_QUALITY_MODERATE,
+    AIRSHIFT_AIR_QUALITY_POOR,
+    AIRSHIFT_AIR_QUALITY_VERY_POOR,
+    AIRSHIFT_AIR_QUALITY_EXTREMELY_POOR,
+    AIRSHIFT_AIR_QUALITY_COUNT
+} airshift_air_quality_t;
+
+// breakpoints between good and extremely poor ...
+#define AIRSHIFT_AIR_QUALITY_BREAKPOINTS    ( AIRSHIFT_AIR_QUALITY_EXTREMELY_POOR - AIRSHIFT_AIR_QUALITY_GOOD )
+
+typedef enum
+{
+    AIRSHIFT_AIR_QUALITY_INPUT_CO2,
+    AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5,
+    AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0,
+    AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY,     // classified by how far it is outside the comfort band
+    AIRSHIFT_AIR_QUALITY_INPUT_COUNT
+} airshift_air_quality_input_t;
+
+typedef struct
+{
+    float       breakpoints[AIRSHIFT_AIR_QUALITY_BREAKPOINTS];  // ascending, the upper bound of good, fair .. very poor, in the channel's unit
+    float       hysteresis;                                     // a falling mean has to clear a breakpoint by this much to improve the level
+    uint16_t    window;                                         // samples in the rolling mean, one per acquisition cycle
+} airshift_air_quality_config_t;
+
+typedef struct
+{
+    airshift_air_quality_t          quality;                                // the worst of the inputs, unknown until any input has a reading
+    airshift_air_quality_input_t    dominant;                               // the input that set it
+    airshift_air_quality_t          levels[AIRSHIFT_AIR_QUALITY_INPUT_COUNT];
+    float                           means[AIRSHIFT_AIR_QUALITY_INPUT_COUNT];
+} airshift_air_quality_result_t;
+
+typedef struct
+{
+    uint32_t    updates;
+    uint32_t    transitions;    // changes of the overall quality
+} airshift_air_quality_stats_t;
+
+esp_err_t   airshift_air_quality_init();
+esp_err_t   airshift_air_quality_release();
+
+// The sampling task, pushes every valid channel into its window and reclassifies, in constant time per input ...
+esp_err_t   airshift_air_quality_update( const airshift_sample_t *sample, airshift_air_quality_result_t *result );
+
+// Any task, the result of the last update ...
+esp_err_t   airshift_air_quality_get( airshift_air_quality_result_t *result );
+
+// Changing the window restarts that input's mean ...
+esp_err_t   airshift_air_quality_set_config( airshift_air_quality_input_t input, const airshift_air_quality_config_t *config );
+esp_err_t   airshift_air_quality_get_config( airshift_air_quality_input_t input, airshift_air_quality_config_t *config );
+
+const char* airshift_air_quality_name( airshift_air_quality_t quality );
+
+esp_err_t   airshift_air_quality_get_stats( airshift_air_quality_stats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_AIR_QUALITY_H
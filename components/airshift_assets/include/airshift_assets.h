@@ -0,0 +1,18 @@
+#ifndef AIRSHIFT_ASSETS_H
+#define AIRSHIFT_ASSETS_H
+
+#include <lvgl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Generated at build time, see CMakeLists.txt for the glyphs each font carries ...
+LV_FONT_DECLARE( airshift_font_value_28 )   // co2 reading
+LV_FONT_DECLARE( airshift_font_text_14 )    // every other label
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_ASSETS_H
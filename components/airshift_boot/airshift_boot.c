@@ -0,0 +1,454 @@
+#include "airshift_boot.h"
+
+#include <freertos/queue.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+
+#define BOOT_WORKERS                3       // the longest chains are display -> ui and i2c -> sht30 -> acquisition, more would mostly wait
+#define BOOT_WORKER_STACK_SIZE      8192    // inits ran on the main task before, matter's is the hungriest
+#define BOOT_WORKER_PRIORITY        5
+#define BOOT_WORKER_STOP            SIZE_MAX
+
+typedef struct
+{
+    size_t      stage;      // BOOT_WORKER_STOP once a worker is done
+    esp_err_t   result;
+    int64_t     started;
+    int64_t     duration;
+} completion_t;
+
+static const char* TAG = "airshift_boot";
+
+// Forward declarations
+static size_t       dispatch();
+static void         complete( const completion_t *completion );
+static bool         first_light_due();
+static void         stop_workers( size_t workers );
+static void         worker_task( void *arguments );
+static const char*  state_name( airshift_boot_state_t state );
+static int          boot_command( int argc, char **argv );
+
+static const esp_console_cmd_t  command_    = { .command = "boot", .help = "Timeline of the last boot, when each component started and how long its init took", .hint = NULL, .func = &boot_command };
+
+static const airshift_boot_stage_t  *stages_                            = NULL;
+static size_t                       count_                              = 0;
+static airshift_boot_record_t       records_[AIRSHIFT_BOOT_STAGE_MAX]   = { 0 };
+static uint8_t                      order_[AIRSHIFT_BOOT_STAGE_MAX]     = { 0 };    // stages in the order they came up
+static uint32_t                     ready_mask_                         = 0;
+static uint32_t                     down_mask_                          = 0;        // failed or skipped
+static QueueHandle_t                work_queue_                         = NULL;
+static QueueHandle_t                done_queue_                         = NULL;
+static portMUX_TYPE                 lock_                               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_boot_stats_t        stats_                              = { 0 };
+
+// Public functions
+esp_err_t airshift_boot_run( const airshift_boot_stage_t *stages, size_t count )
+{
+    esp_err_t       ret         = ESP_FAIL;
+    size_t          workers     = 0;
+    size_t          settled     = 0;
+    uint32_t        deferred    = 0;
+    completion_t    completion  = { 0 };
+
+    ESP_LOGI( TAG, "airshift_boot_run -> %u stages", count );
+
+    ESP_GOTO_ON_FALSE( ( stages != NULL ) && ( count > 0 ) && ( count <= AIRSHIFT_BOOT_STAGE_MAX ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        // a dependency on a later stage, or on itself, is a cycle waiting to happen, one on a deferred stage would hold off first light forever ...
+        ESP_GOTO_ON_FALSE( ( stages[i].init != NULL ) && ( ( ( stages[i].depends | stages[i].after ) >> i ) == 0 ), ESP_ERR_INVALID_ARG, error, TAG, "invalid stage: %s", stages[i].name );
+        ESP_GOTO_ON_FALSE( ( stages[i].deferred || !( ( stages[i].depends | stages[i].after ) & deferred ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid stage: %s", stages[i].name );
+
+        deferred |= stages[i].deferred ? AIRSHIFT_BOOT_DEPENDS( i ) : 0;
+    }
+
+    // reset variables ...
+    portENTER_CRITICAL( &lock_ );
+
+    stages_     = stages;
+    count_      = count;
+    ready_mask_ = 0;
+    down_mask_  = 0;
+
+    memset( records_, 0, sizeof( records_ ) );
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    stats_.started = esp_timer_get_time();
+
+    portEXIT_CRITICAL( &lock_ );
+
+    work_queue_ = xQueueCreate( count, sizeof( size_t ) );
+    done_queue_ = xQueueCreate( count + BOOT_WORKERS, sizeof( completion_t ) );
+
+    ESP_GOTO_ON_FALSE( ( work_queue_ != NULL ) && ( done_queue_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xQueueCreate failed" );
+
+    // fewer workers only make the boot slower ...
+    for( workers = 0; workers < BOOT_WORKERS; workers++ )
+    {
+        if( xTaskCreate( worker_task, "boot_worker", BOOT_WORKER_STACK_SIZE, NULL, BOOT_WORKER_PRIORITY, NULL ) != pdPASS )
+        {
+            break;
+        }
+    }
+
+    ESP_GOTO_ON_FALSE( ( workers > 0 ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate failed" );
+
+    while( true )
+    {
+        settled += dispatch();
+
+        // ... deferred stages become ready to run the moment the rest has settled, one more pass picks them up ...
+        if( first_light_due() )
+        {
+            continue;
+        }
+
+        if( settled == count_ )
+        {
+            break;
+        }
+
+        xQueueReceive( done_queue_, &completion, portMAX_DELAY );
+
+        complete( &completion );
+
+        settled++;
+    }
+
+    stop_workers( workers );
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.finished = esp_timer_get_time();
+
+    portEXIT_CRITICAL( &lock_ );
+
+    ESP_LOGI( TAG, "airshift_boot_run -> %lu ready, %lu failed, %lu skipped, first light: %lld ms, finished: %lld ms", stats_.ready, stats_.failed, stats_.skipped, stats_.first_light / 1000, stats_.finished / 1000 );
+
+    return ( down_mask_ == 0 ) ? ESP_OK : ESP_FAIL;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_boot_run failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    stop_workers( workers );
+
+    return ret;
+}
+
+esp_err_t airshift_boot_release()
+{
+    ESP_LOGI( TAG, "airshift_boot_release" );
+
+    // dependents came up after what they depend on, going backwards releases them first ...
+    for( size_t i = stats_.ready; i > 0; i-- )
+    {
+        size_t stage = order_[i - 1];
+
+        portENTER_CRITICAL( &lock_ );
+
+        records_[stage].state   = AIRSHIFT_BOOT_STATE_PENDING;
+        ready_mask_             &= ~AIRSHIFT_BOOT_DEPENDS( stage );
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( stages_[stage].release != NULL )
+        {
+            ESP_ERROR_CHECK_WITHOUT_ABORT( stages_[stage].release() );
+        }
+    }
+
+    stats_.ready = 0;
+
+    return ESP_OK;
+}
+
+bool airshift_boot_is_ready( size_t stage )
+{
+    bool ready = false;
+
+    portENTER_CRITICAL( &lock_ );
+
+    ready = ( stage < count_ ) && ( ready_mask_ & AIRSHIFT_BOOT_DEPENDS( stage ) );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ready;
+}
+
+void airshift_boot_mark_first_reading()
+{
+    int64_t now     = esp_timer_get_time();
+    bool    first   = false;
+
+    portENTER_CRITICAL( &lock_ );
+
+    first = ( stats_.first_reading == 0 );
+
+    if( first == true )
+    {
+        stats_.first_reading = now;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( first == true )
+    {
+        ESP_LOGI( TAG, "airshift_boot_mark_first_reading -> %lld ms after power on", now / 1000 );
+    }
+}
+
+esp_err_t airshift_boot_get_record( size_t stage, airshift_boot_record_t *record )
+{
+    ESP_RETURN_ON_FALSE( ( record != NULL ) && ( stage < count_ ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *record = records_[stage];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_boot_get_stats( airshift_boot_stats_t *stats )
+{
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_boot_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_boot_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_boot_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+
+// Hands every stage whose dependencies are ready to the workers, returns how many were skipped instead ...
+static size_t dispatch()
+{
+    size_t skipped = 0;
+
+    // dependencies are earlier in the table, one forward pass carries a failure all the way down ...
+    for( size_t i = 0; i < count_; i++ )
+    {
+        const airshift_boot_stage_t *stage = &stages_[i];
+
+        if( ( records_[i].state != AIRSHIFT_BOOT_STATE_PENDING ) || ( stage->deferred && ( stats_.first_light == 0 ) ) )
+        {
+            continue;
+        }
+
+        if( stage->depends & down_mask_ )
+        {
+            ESP_LOGW( TAG, "dispatch -> %s skipped, a dependency is down", stage->name );
+
+            portENTER_CRITICAL( &lock_ );
+
+            records_[i].state   = AIRSHIFT_BOOT_STATE_SKIPPED;
+            down_mask_          |= AIRSHIFT_BOOT_DEPENDS( i );
+
+            stats_.skipped++;
+
+            portEXIT_CRITICAL( &lock_ );
+
+            skipped++;
+
+            continue;
+        }
+
+        if( ( ( stage->depends & ready_mask_ ) != stage->depends ) || ( ( stage->after & ( ready_mask_ | down_mask_ ) ) != stage->after ) )
+        {
+            continue;
+        }
+
+        portENTER_CRITICAL( &lock_ );
+
+        records_[i].state = AIRSHIFT_BOOT_STATE_RUNNING;
+
+        portEXIT_CRITICAL( &lock_ );
+
+        // never blocks, the queue holds every stage ...
+        xQueueSend( work_queue_, &i, 0 );
+    }
+
+    return skipped;
+}
+
+static void complete( const completion_t *completion )
+{
+    size_t  stage   = completion->stage;
+    bool    ready   = ( completion->result == ESP_OK );
+
+    portENTER_CRITICAL( &lock_ );
+
+    records_[stage].state       = ready ? AIRSHIFT_BOOT_STATE_READY : AIRSHIFT_BOOT_STATE_FAILED;
+    records_[stage].result      = completion->result;
+    records_[stage].started     = completion->started;
+    records_[stage].duration    = completion->duration;
+
+    if( ready == true )
+    {
+        ready_mask_ |= AIRSHIFT_BOOT_DEPENDS( stage );
+
+        order_[stats_.ready++] = stage;
+    }
+    else
+    {
+        down_mask_ |= AIRSHIFT_BOOT_DEPENDS( stage );
+
+        stats_.failed++;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( ready == true )
+    {
+        ESP_LOGI( TAG, "complete -> %s ready, started: %lld ms, took: %lld ms", stages_[stage].name, completion->started / 1000, completion->duration / 1000 );
+    }
+    else
+    {
+        // ... what does not depend on it keeps coming up ...
+        ESP_LOGE( TAG, "complete -> %s failed: %s ( 0x%x ), took: %lld ms", stages_[stage].name, esp_err_to_name( completion->result ), completion->result, completion->duration / 1000 );
+    }
+}
+
+// True once, when the last stage that is not deferred has settled ...
+static bool first_light_due()
+{
+    if( stats_.first_light != 0 )
+    {
+        return false;
+    }
+
+    for( size_t i = 0; i < count_; i++ )
+    {
+        if( !stages_[i].deferred && ( ( records_[i].state == AIRSHIFT_BOOT_STATE_PENDING ) || ( records_[i].state == AIRSHIFT_BOOT_STATE_RUNNING ) ) )
+        {
+            return false;
+        }
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.first_light = esp_timer_get_time();
+
+    portEXIT_CRITICAL( &lock_ );
+
+    ESP_LOGI( TAG, "first_light_due -> %lld ms after power on, deferred stages next", stats_.first_light / 1000 );
+
+    return true;
+}
+
+static void stop_workers( size_t workers )
+{
+    size_t          stop        = BOOT_WORKER_STOP;
+    completion_t    completion  = { 0 };
+
+    for( size_t i = 0; i < workers; i++ )
+    {
+        xQueueSend( work_queue_, &stop, portMAX_DELAY );
+    }
+
+    // ... every worker acknowledges before the queues go away under it ...
+    for( size_t i = 0; i < workers; i++ )
+    {
+        do
+        {
+            xQueueReceive( done_queue_, &completion, portMAX_DELAY );
+        }
+        while( completion.stage != BOOT_WORKER_STOP );
+    }
+
+    if( work_queue_ != NULL )
+    {
+        vQueueDelete( work_queue_ );
+
+        work_queue_ = NULL;
+    }
+
+    if( done_queue_ != NULL )
+    {
+        vQueueDelete( done_queue_ );
+
+        done_queue_ = NULL;
+    }
+}
+
+static void worker_task( void *arguments )
+{
+    completion_t completion = { 0 };
+
+    while( xQueueReceive( work_queue_, &completion.stage, portMAX_DELAY ) == pdTRUE )
+    {
+        if( completion.stage == BOOT_WORKER_STOP )
+        {
+            break;
+        }
+
+        completion.started  = esp_timer_get_time();
+        completion.result   = stages_[completion.stage].init();
+        completion.duration = esp_timer_get_time() - completion.started;
+
+        xQueueSend( done_queue_, &completion, portMAX_DELAY );
+    }
+
+    xQueueSend( done_queue_, &completion, portMAX_DELAY );
+
+    vTaskDelete( NULL );
+}
+
+static const char* state_name( airshift_boot_state_t state )
+{
+    switch( state )
+    {
+        case AIRSHIFT_BOOT_STATE_PENDING:   return "pending";
+        case AIRSHIFT_BOOT_STATE_RUNNING:   return "running";
+        case AIRSHIFT_BOOT_STATE_READY:     return "ready";
+        case AIRSHIFT_BOOT_STATE_FAILED:    return "failed";
+        case AIRSHIFT_BOOT_STATE_SKIPPED:   return "skipped";
+        default:                            return "unknown";
+    }
+}
+
+static int boot_command( int argc, char **argv )
+{
+    airshift_boot_stats_t   stats   = { 0 };
+    airshift_boot_record_t  record  = { 0 };
+
+    airshift_boot_get_stats( &stats );
+
+    printf( "%-14s %-8s %10s %10s\n", "stage", "state", "start ms", "init ms" );
+
+    for( size_t i = 0; i < count_; i++ )
+    {
+        airshift_boot_get_record( i, &record );
+
+        printf( "%-14s %-8s %10lld %10lld %s\n", stages_[i].name, state_name( record.state ), record.started / 1000, record.duration / 1000, ( record.state == AIRSHIFT_BOOT_STATE_FAILED ) ? esp_err_to_name( record.result ) : ( stages_[i].deferred ? "deferred" : "" ) );
+    }
+
+    printf( "ready: %lu, failed: %lu, skipped: %lu\n", stats.ready, stats.failed, stats.skipped );
+    printf( "first light: %lld ms, finished: %lld ms, first reading: %lld ms\n", stats.first_light / 1000, stats.finished / 1000, stats.first_reading / 1000 );
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#ifndef AIRSHIFT_BOOT_H
+#define AIRSHIFT_BOOT_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AIRSHIFT_BOOT_STAGE_MAX         32
+#define AIRSHIFT_BOOT_DEPENDS( stage )  ( (uint32_t)1 << ( stage ) )
+
+typedef esp_err_t ( *airshift_boot_function_t )( void );
+
+// One component brought up at boot. Stages only depend on stages earlier in the table, so the table order is a valid
+// sequential boot and the graph cannot have cycles. A stage that works with or without another one lists it in after and
+// checks airshift_boot_is_ready itself ...
+typedef struct
+{
+    const char                  *name;
+    airshift_boot_function_t    init;
+    airshift_boot_function_t    release;    // optional
+    uint32_t                    depends;    // AIRSHIFT_BOOT_DEPENDS( stage ) | ..., skipped unless all of them are ready
+    uint32_t                    after;      // soft dependencies, settled first whether they came up or not
+    bool                        deferred;   // held back until first light, every stage that is not deferred has settled
+} airshift_boot_stage_t;
+
+typedef enum
+{
+    AIRSHIFT_BOOT_STATE_PENDING,
+    AIRSHIFT_BOOT_STATE_RUNNING,
+    AIRSHIFT_BOOT_STATE_READY,
+    AIRSHIFT_BOOT_STATE_FAILED,
+    AIRSHIFT_BOOT_STATE_SKIPPED,    // a dependency failed or was skipped, init never ran
+} airshift_boot_state_t;
+
+typedef struct
+{
+    airshift_boot_state_t   state;
+    esp_err_t               result;
+    int64_t                 started;    // us since power on ( esp_timer_get_time )
+    int64_t                 duration;   // us in init
+} airshift_boot_record_t;
+
+typedef struct
+{
+    uint32_t    ready;
+    uint32_t    failed;
+    uint32_t    skipped;
+    int64_t     started;        // us since power on, the first stage dispatched
+    int64_t     first_light;    // every stage that is not deferred settled, 0 until then
+    int64_t     finished;       // every stage settled, 0 until then
+    int64_t     first_reading;  // airshift_boot_mark_first_reading, 0 until then
+} airshift_boot_stats_t;
+
+// Runs the stages on a small pool of worker tasks, each as soon as its dependencies are ready, and returns once every stage
+// settled. A failed stage only takes down the stages depending on it, ESP_FAIL tells some did not come up ...
+esp_err_t   airshift_boot_run( const airshift_boot_stage_t *stages, size_t count );
+
+// Releases the stages that came up, in the reverse of the order they did ...
+esp_err_t   airshift_boot_release();
+
+// Any task, false until the stage's init returned ESP_OK ...
+bool        airshift_boot_is_ready( size_t stage );
+
+// Any task, once, the end of the timeline that matters to the user ...
+void        airshift_boot_mark_first_reading();
+
+esp_err_t   airshift_boot_get_record( size_t stage, airshift_boot_record_t *record );
+esp_err_t   airshift_boot_get_stats( airshift_boot_stats_t *stats );
+
+// adds the "boot" command to an initialized esp_console, the timeline of the last boot ...
+esp_err_t   airshift_boot_register_console();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_BOOT_H
@@ -1,14 +1,33 @@
 #include "airshift_common.h"
+#include "airshift_trace.h"
+
 #include <esp_mac.h>
+#include <math.h>
+
+typedef struct
+{
+    const char  *name;
+    float       scale;      // fixed point units per engineering unit
+} channel_t;
 
 static const char* TAG = "airshift_common";
 
 // Forward declarations
 
+static const channel_t channels_[AIRSHIFT_CHANNEL_COUNT] =
+{
+    [AIRSHIFT_CHANNEL_CO2]          = { .name = "co2",  .scale = 1.0f },
+    [AIRSHIFT_CHANNEL_TEMPERATURE]  = { .name = "temp", .scale = 100.0f },
+    [AIRSHIFT_CHANNEL_HUMIDITY]     = { .name = "rh",   .scale = 100.0f },
+    [AIRSHIFT_CHANNEL_PM_1_0]       = { .name = "pm1",  .scale = 1.0f },
+    [AIRSHIFT_CHANNEL_PM_2_5]       = { .name = "pm25", .scale = 1.0f },
+    [AIRSHIFT_CHANNEL_PM_10_0]      = { .name = "pm10", .scale = 1.0f },
+};
+
 // Public functions
 uint64_t seconds_to_microseconds( uint32_t seconds )
 {
-    ESP_LOGI( TAG, "seconds_to_microseconds -> %lu", seconds );
+    AIRSHIFT_TRACED( TAG, "seconds_to_microseconds -> %lu", seconds );
 
     return ( (uint64_t)seconds * (uint64_t)1000 * (uint64_t)1000 );
 }
@@ -47,4 +66,25 @@ error:
     return ret;
 }
 
+const char* airshift_channel_name( airshift_channel_t channel )
+{
+    return ( channel < AIRSHIFT_CHANNEL_COUNT ) ? channels_[channel].name : "unknown";
+}
+
+int16_t airshift_channel_to_fixed( airshift_channel_t channel, float value )
+{
+    float scaled = roundf( value * channels_[channel].scale );
+
+    // saturate, never collide with the invalid marker ...
+    if( scaled > INT16_MAX ){ return INT16_MAX; }
+    if( scaled < ( INT16_MIN + 1 ) ){ return INT16_MIN + 1; }
+
+    return (int16_t)scaled;
+}
+
+float airshift_channel_from_fixed( airshift_channel_t channel, int16_t value )
+{
+    return (float)value / channels_[channel].scale;
+}
+
 // Private functions
@@ -7,10 +7,40 @@
 extern "C" {
 #endif
 
+// Measured quantities, shared by everything that stores or ships readings ...
+typedef enum
+{
+    AIRSHIFT_CHANNEL_CO2,           // ppm
+    AIRSHIFT_CHANNEL_TEMPERATURE,   // 0.01 C
+    AIRSHIFT_CHANNEL_HUMIDITY,      // 0.01 %RH
+    AIRSHIFT_CHANNEL_PM_1_0,        // ug/m3
+    AIRSHIFT_CHANNEL_PM_2_5,        // ug/m3
+    AIRSHIFT_CHANNEL_PM_10_0,       // ug/m3
+    AIRSHIFT_CHANNEL_COUNT
+} airshift_channel_t;
+
+#define AIRSHIFT_CHANNEL_BIT( channel ) ( 1UL << ( channel ) )
+#define AIRSHIFT_CHANNEL_ALL            ( ( 1UL << AIRSHIFT_CHANNEL_COUNT ) - 1 )
+
+// fixed point value marking a missing reading ...
+#define AIRSHIFT_VALUE_INVALID          INT16_MIN
+
+// One reading of every channel in fixed point, see airshift_channel_t for units ...
+typedef struct
+{
+    int64_t     timestamp;      // esp_timer_get_time base, us
+    uint32_t    valid_mask;     // AIRSHIFT_CHANNEL_BIT of every channel holding a reading
+    int16_t     values[AIRSHIFT_CHANNEL_COUNT];
+} airshift_sample_t;
+
 uint64_t    seconds_to_microseconds( uint32_t seconds );
 uint16_t    airshift_make_word( uint8_t h, uint8_t l );
 esp_err_t   airshift_get_mac_address( char* mac_address, const char* delimiter );
 
+const char* airshift_channel_name( airshift_channel_t channel );
+int16_t     airshift_channel_to_fixed( airshift_channel_t channel, float value );
+float       airshift_channel_from_fixed( airshift_channel_t channel, int16_t value );
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,326 @@
+#include "airshift_config.h"
+#include "airshift_nvs.h"
+
+#include <esp_console.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#define CONFIG_NVS_NAMESPACE    "config"
+#define CONFIG_NVS_KEY          "blob"
+#define CONFIG_BLOB_MAX         256     // bytes, room for layouts newer than this firmware, one read takes any of them
+
+typedef struct
+{
+    uint16_t    version;    // AIRSHIFT_CONFIG_VERSION of the firmware that wrote it
+    uint16_t    size;       // bytes of airshift_config_t that follow, up to the end of its last field
+} header_t;
+
+typedef struct
+{
+    header_t            header;
+    airshift_config_t   config;
+} blob_t;
+
+_Static_assert( sizeof( blob_t ) <= CONFIG_BLOB_MAX, "airshift_config_t outgrew CONFIG_BLOB_MAX" );
+_Static_assert( offsetof( blob_t, config ) == sizeof( header_t ), "the configuration must follow the header directly" );
+
+typedef struct
+{
+    const char  *name;
+    size_t      offset;
+    size_t      size;
+    bool        is_signed;
+} field_t;
+
+static const char* TAG = "airshift_config";
+
+// Forward declarations
+static esp_err_t    load();
+static bool         migrate( const uint8_t *data, size_t length, airshift_config_t *config );
+static esp_err_t    store();
+static int64_t      get_field( const field_t *field );
+static int          config_command( int argc, char **argv );
+
+static const field_t fields_[] =
+{
+#define X( type, field, value ) { .name = #field, .offset = offsetof( airshift_config_t, field ), .size = sizeof( type ), .is_signed = ( (int64_t)(type)-1 < 0 ) },
+    AIRSHIFT_CONFIG_FIELDS( X )
+#undef X
+};
+
+// tail padding is not stored, a field appended later may land in it and must not be mistaken for a stored value ...
+#define CONFIG_SIZE     ( fields_[( sizeof( fields_ ) / sizeof( fields_[0] ) ) - 1].offset + fields_[( sizeof( fields_ ) / sizeof( fields_[0] ) ) - 1].size )
+
+static const airshift_config_t defaults_ =
+{
+#define X( type, field, value ) .field = value,
+    AIRSHIFT_CONFIG_FIELDS( X )
+#undef X
+};
+
+static const esp_console_cmd_t  command_    = { .command = "config", .help = "List the configuration, 'config <name> <value>' sets a field, 'config reset' restores the defaults", .hint = "[<name> <value> | reset]", .func = &config_command };
+
+// fields are word sized or smaller, a reader sees either the old or the new value of each ...
+static airshift_config_t    config_     = { 0 };
+static portMUX_TYPE         lock_       = portMUX_INITIALIZER_UNLOCKED;
+
+// Public functions
+esp_err_t airshift_config_init()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_config_init" );
+
+    // reset variables ...
+    config_ = defaults_;
+
+    ESP_GOTO_ON_ERROR( load(), error, TAG, "load failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_config_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_config_release()
+{
+    ESP_LOGI( TAG, "airshift_config_release" );
+
+    return ESP_OK;
+}
+
+const airshift_config_t* airshift_config()
+{
+    return &config_;
+}
+
+esp_err_t airshift_config_set( const airshift_config_t *config )
+{
+    ESP_RETURN_ON_FALSE( ( config != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    config_ = *config;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return store();
+}
+
+esp_err_t airshift_config_set_field( const char *name, int64_t value )
+{
+    const field_t   *field      = NULL;
+    int64_t         minimum     = 0;
+    int64_t         maximum     = 0;
+    uint8_t         *target     = NULL;
+
+    ESP_RETURN_ON_FALSE( ( name != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    for( size_t i = 0; ( i < ( sizeof( fields_ ) / sizeof( fields_[0] ) ) ) && ( field == NULL ); i++ )
+    {
+        field = ( strcmp( fields_[i].name, name ) == 0 ) ? &fields_[i] : NULL;
+    }
+
+    ESP_RETURN_ON_FALSE( ( field != NULL ), ESP_ERR_NOT_FOUND, TAG, "no such field: %s", name );
+
+    // the range the field's type holds ...
+    maximum = field->is_signed ? ( ( (int64_t)1 << ( ( field->size * 8 ) - 1 ) ) - 1 ) : ( ( (int64_t)1 << ( field->size * 8 ) ) - 1 );
+    minimum = field->is_signed ? ( -maximum - 1 ) : 0;
+
+    ESP_RETURN_ON_FALSE( ( ( value >= minimum ) && ( value <= maximum ) ), ESP_ERR_INVALID_ARG, TAG, "%s out of range: %lld", name, value );
+
+    target = (uint8_t *)&config_ + field->offset;
+
+    portENTER_CRITICAL( &lock_ );
+
+    // little endian, the low bytes of the value are the field ...
+    memcpy( target, &value, field->size );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return store();
+}
+
+esp_err_t airshift_config_reset()
+{
+    ESP_LOGI( TAG, "airshift_config_reset" );
+
+    return airshift_config_set( &defaults_ );
+}
+
+esp_err_t airshift_config_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_config_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_config_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static esp_err_t load()
+{
+    esp_err_t           ret         = ESP_FAIL;
+    uint8_t             *data       = NULL;
+    size_t              length      = CONFIG_BLOB_MAX;
+    airshift_config_t   config      = defaults_;
+    bool                rewrite     = false;
+
+    data = malloc( CONFIG_BLOB_MAX );
+
+    ESP_GOTO_ON_FALSE( ( data != NULL ), ESP_ERR_NO_MEM, error, TAG, "malloc failed" );
+
+    // one read for the whole configuration, nothing stored yet is not an error, the defaults stand ...
+    ret = airshift_nvs_get_blob( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY, data, &length );
+
+    if( ret == ESP_ERR_NVS_NOT_FOUND )
+    {
+        ESP_LOGI( TAG, "load -> nothing stored, defaults" );
+
+        free( data );
+
+        return ESP_OK;
+    }
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "airshift_nvs_get_blob failed" );
+
+    rewrite = migrate( data, length, &config );
+
+    free( data );
+    data = NULL;
+
+    portENTER_CRITICAL( &lock_ );
+
+    config_ = config;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    // ... a migrated blob is stored in the current layout, the next boot reads it as is ...
+    if( rewrite == true )
+    {
+        ESP_GOTO_ON_ERROR( store(), error, TAG, "store failed" );
+    }
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "load failed: %s ( 0x%x ), defaults", esp_err_to_name( ret ), ret );
+
+    free( data );
+
+    return ret;
+}
+
+// Returns true when the blob was not in the current layout and should be stored again ...
+static bool migrate( const uint8_t *data, size_t length, airshift_config_t *config )
+{
+    header_t header = { 0 };
+
+    if( length < sizeof( header_t ) )
+    {
+        ESP_LOGW( TAG, "migrate -> truncated blob, defaults" );
+
+        return true;
+    }
+
+    memcpy( &header, data, sizeof( header ) );
+
+    if( header.size != ( length - sizeof( header_t ) ) )
+    {
+        ESP_LOGW( TAG, "migrate -> size mismatch ( %u of %u bytes ), defaults", length - sizeof( header_t ), header.size );
+
+        return true;
+    }
+
+    // every layout is a prefix of the next, fields that end within the stored size are taken as stored, fields added since keep
+    // their defaults, a newer firmware's extra fields are dropped ...
+    for( size_t i = 0; i < ( sizeof( fields_ ) / sizeof( fields_[0] ) ); i++ )
+    {
+        if( ( fields_[i].offset + fields_[i].size ) <= header.size )
+        {
+            memcpy( (uint8_t *)config + fields_[i].offset, data + sizeof( header_t ) + fields_[i].offset, fields_[i].size );
+        }
+    }
+
+    // ... fields whose meaning changed get converted here, one case per version, falling through to the current one ...
+    switch( header.version )
+    {
+        case AIRSHIFT_CONFIG_VERSION:
+        default:
+        {
+            break;
+        }
+    }
+
+    if( ( header.version != AIRSHIFT_CONFIG_VERSION ) || ( header.size != CONFIG_SIZE ) )
+    {
+        ESP_LOGI( TAG, "migrate -> version %u ( %u bytes ) to %u ( %u bytes )", header.version, header.size, AIRSHIFT_CONFIG_VERSION, CONFIG_SIZE );
+
+        return true;
+    }
+
+    return false;
+}
+
+static esp_err_t store()
+{
+    blob_t blob = { .header = { .version = AIRSHIFT_CONFIG_VERSION, .size = CONFIG_SIZE } };
+
+    portENTER_CRITICAL( &lock_ );
+
+    blob.config = config_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return airshift_nvs_write_blob( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY, &blob, sizeof( header_t ) + CONFIG_SIZE );
+}
+
+static int64_t get_field( const field_t *field )
+{
+    const uint8_t   *source = (const uint8_t *)&config_ + field->offset;
+    int64_t         value   = 0;
+
+    memcpy( &value, source, field->size );
+
+    // sign extend ...
+    if( field->is_signed && ( field->size < sizeof( value ) ) && ( value & ( (int64_t)1 << ( ( field->size * 8 ) - 1 ) ) ) )
+    {
+        value -= (int64_t)1 << ( field->size * 8 );
+    }
+
+    return value;
+}
+
+static int config_command( int argc, char **argv )
+{
+    if( ( argc == 2 ) && ( strcmp( argv[1], "reset" ) == 0 ) )
+    {
+        return ( airshift_config_reset() == ESP_OK ) ? 0 : 1;
+    }
+
+    if( argc == 3 )
+    {
+        return ( airshift_config_set_field( argv[1], strtoll( argv[2], NULL, 0 ) ) == ESP_OK ) ? 0 : 1;
+    }
+
+    printf( "version: %d, %u bytes\n", AIRSHIFT_CONFIG_VERSION, CONFIG_SIZE );
+
+    for( size_t i = 0; i < ( sizeof( fields_ ) / sizeof( fields_[0] ) ); i++ )
+    {
+        printf( "%-20s %lld\n", fields_[i].name, get_field( &fields_[i] ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#ifndef AIRSHIFT_CONFIG_H
+#define AIRSHIFT_CONFIG_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bumped with every change to the schema, airshift_config.c migrates blobs written by older versions ...
+#define AIRSHIFT_CONFIG_VERSION     1
+
+// The schema, X( type, name, default ), integer fields of up to 32 bits only. New fields are appended, never inserted, removed or resized,
+// so every older layout is a prefix of the current one ...
+#define AIRSHIFT_CONFIG_FIELDS( X )                                                                                     \
+    X( uint32_t,    publish_period_s,   10  )   /* sample sets published over mqtt, at most one per period */          \
+    X( uint32_t,    history_period_s,   5   )   /* records appended to the history log, published sets always are */   \
+    X( uint32_t,    diag_period_s,      60  )   /* stage latencies and error counters published for fleet diagnostics */ \
+    X( uint8_t,     telemetry_mode,     3   )   /* airshift_telemetry_mode_t, both, applied at boot */                  \
+    X( uint8_t,     telemetry_format,   1   )   /* airshift_telemetry_format_t, cbor, applied at boot */
+
+typedef struct
+{
+#define X( type, field, value ) type field;
+    AIRSHIFT_CONFIG_FIELDS( X )
+#undef X
+} airshift_config_t;
+
+// Loads the whole configuration with a single read, defaults for anything never stored ...
+esp_err_t                   airshift_config_init();
+esp_err_t                   airshift_config_release();
+
+// Any task, plain field access, airshift_config()->publish_period_s ...
+const airshift_config_t*    airshift_config();
+
+// Stores the whole configuration as one blob, the write goes out with the next nvs batch ...
+esp_err_t                   airshift_config_set( const airshift_config_t *config );
+esp_err_t                   airshift_config_set_field( const char *name, int64_t value );
+esp_err_t                   airshift_config_reset();
+
+esp_err_t                   airshift_config_register_console();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_CONFIG_H
@@ -1,27 +1,51 @@
 #include "airshift_display.h"
+#include "airshift_gc9a01.h"
+#include "airshift_metrics.h"
 
 #include <esp_timer.h>
+#include <esp_heap_caps.h>
 
-#define HORIZONTAL_RESOLUTION   240
-#define VERTICAL_RESOLUTION     240
+#define HORIZONTAL_RESOLUTION   GC9A01_HORIZONTAL_RESOLUTION
+#define VERTICAL_RESOLUTION     GC9A01_VERTICAL_RESOLUTION
 
-#define TICK_TIMER_MS           5000
+// Two draw buffers, lvgl renders into one while the other is on the spi bus. A full frame ( BUFFER_LINES = VERTICAL_RESOLUTION )
+// redraws the whole screen each frame, the driver splits it into 32 KB transfers, but both buffers then take 230 KB of internal
+// ram. Spiram buffers are no way around that, the spi driver copies each transfer into internal dma memory of the same size ...
+#define BUFFER_LINES            40
+#define BUFFER_CAPS             ( MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL )
+#define BUFFER_PIXELS           ( HORIZONTAL_RESOLUTION * BUFFER_LINES )
+#define BUFFER_FULL_FRAME       ( BUFFER_LINES == VERTICAL_RESOLUTION )
 
 static const char* TAG = "airshift_display";
 
 // Forward declarations
 static esp_err_t    display_driver_init();
-static esp_err_t    tick_timer_init();
-static void         tick_timer_callback( void *data );
+static void         flush_callback( lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p );
+static void         flush_done_callback( void *context );
+
+static lv_disp_drv_t            lv_disp_drv_        = { 0 };
+static lv_color_t               *buffers_[2]        = { NULL };
+static portMUX_TYPE             lock_               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_display_stats_t stats_              = { 0 };
+static int64_t                  flush_time_total_   = 0;
+static int64_t                  since_              = 0;
+
+// the flush in flight, set on the lvgl task and read back from the spi isr ...
+static volatile size_t          flush_size_         = 0;
+static volatile bool            flush_last_         = false;
+static volatile int64_t         flush_started_      = 0;
+static volatile int64_t         flush_time_         = 0;
 
 // Public functions
 esp_err_t airshift_display_init()
 {
     ESP_LOGI( TAG, "airshift_display_init" );
 
-    lv_init();
+    memset( &stats_, 0, sizeof( stats_ ) );
+    flush_time_total_   = 0;
+    since_              = esp_timer_get_time();
 
-    lvgl_driver_init();
+    lv_init();
 
     ESP_RETURN_ON_ERROR( display_driver_init(), TAG, "display_driver_init failed" );
 
@@ -32,6 +56,36 @@ esp_err_t airshift_display_release()
 {
     ESP_LOGI( TAG, "airshift_display_release" );
 
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_gc9a01_release() );
+
+    for( int i = 0; i < 2; i++ )
+    {
+        heap_caps_free( buffers_[i] );
+
+        buffers_[i] = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_display_get_stats( airshift_display_stats_t *stats )
+{
+    int64_t flush_time_total = 0;
+
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats              = stats_;
+    flush_time_total    = flush_time_total_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    stats->window           = esp_timer_get_time() - since_;
+    stats->flush_time_avg   = ( stats->flushes > 0 ) ? ( flush_time_total / stats->flushes ) : 0;
+    stats->bytes_per_frame  = ( stats->frames > 0 ) ? (uint32_t)( stats->bytes / stats->frames ) : 0;
+    stats->fps              = ( stats->window > 0 ) ? ( (float)stats->frames * 1e6f / (float)stats->window ) : 0.0f;
+
     return ESP_OK;
 }
 
@@ -40,39 +94,36 @@ static esp_err_t display_driver_init()
 {
     esp_err_t                   ret                 = ESP_FAIL;
     static lv_disp_draw_buf_t   lv_disp_draw_buf    = { 0 };
-    static lv_disp_drv_t        lv_disp_drv         = { 0 };
-    lv_color_t                  *lv_color_buf_1     = NULL;
-    lv_color_t                  *lv_color_buf_2     = NULL;
     lv_disp_t                   *lv_disp            = NULL;
 
-    ESP_LOGI( TAG, "display_driver_init" );
+    ESP_LOGI( TAG, "display_driver_init -> lines: %d, caps: 0x%x", BUFFER_LINES, BUFFER_CAPS );
 
-    lv_color_buf_1 = heap_caps_malloc( DISP_BUF_SIZE * sizeof( lv_color_t ), MALLOC_CAP_DMA );
+    for( int i = 0; i < 2; i++ )
+    {
+        buffers_[i] = heap_caps_malloc( BUFFER_PIXELS * sizeof( lv_color_t ), BUFFER_CAPS );
 
-    ESP_GOTO_ON_FALSE( ( lv_color_buf_1 != NULL ), ret, error, TAG, "heap_caps_malloc -> lv_color_buf_1 failed" );
+        ESP_GOTO_ON_FALSE( ( buffers_[i] != NULL ), ESP_ERR_NO_MEM, error, TAG, "heap_caps_malloc -> buffer %d failed", i );
+    }
 
-    lv_color_buf_2 = heap_caps_malloc( DISP_BUF_SIZE * sizeof( lv_color_t ), MALLOC_CAP_DMA );
+    ESP_GOTO_ON_ERROR( airshift_gc9a01_init( BUFFER_PIXELS * sizeof( lv_color_t ), flush_done_callback, &lv_disp_drv_ ), error, TAG, "airshift_gc9a01_init failed" );
 
-    ESP_GOTO_ON_FALSE( ( lv_color_buf_2 != NULL ), ret, error, TAG, "heap_caps_malloc -> lv_color_buf_2 failed" );
+    lv_disp_draw_buf_init( &lv_disp_draw_buf, buffers_[0], buffers_[1], BUFFER_PIXELS );
     
-    lv_disp_draw_buf_init( &lv_disp_draw_buf, lv_color_buf_1, lv_color_buf_2, DISP_BUF_SIZE );
+    lv_disp_drv_init( &lv_disp_drv_ );
     
-    lv_disp_drv_init( &lv_disp_drv );
+    lv_disp_drv_.flush_cb           = flush_callback;
+    lv_disp_drv_.hor_res            = HORIZONTAL_RESOLUTION;
+    lv_disp_drv_.ver_res            = VERTICAL_RESOLUTION;
+    lv_disp_drv_.physical_hor_res   = -1;
+    lv_disp_drv_.physical_ver_res   = -1;
+    lv_disp_drv_.antialiasing       = true;
+    lv_disp_drv_.screen_transp      = false;
+    lv_disp_drv_.full_refresh       = BUFFER_FULL_FRAME;
+    lv_disp_drv_.draw_buf           = &lv_disp_draw_buf;
     
-    lv_disp_drv.flush_cb           = disp_driver_flush;
-    lv_disp_drv.hor_res            = HORIZONTAL_RESOLUTION;
-    lv_disp_drv.ver_res            = VERTICAL_RESOLUTION;
-    lv_disp_drv.physical_hor_res   = -1;
-    lv_disp_drv.physical_ver_res   = -1;
-    lv_disp_drv.antialiasing       = true;
-    lv_disp_drv.screen_transp      = false;
-    lv_disp_drv.draw_buf           = &lv_disp_draw_buf;
-    
-    lv_disp = lv_disp_drv_register( &lv_disp_drv );
-
-    ESP_GOTO_ON_FALSE( ( lv_disp != NULL ), ret, error, TAG, "lv_disp_drv_register failed" );
+    lv_disp = lv_disp_drv_register( &lv_disp_drv_ );
 
-    ESP_GOTO_ON_ERROR( tick_timer_init(), error, TAG, "tick_timer_init failed" );
+    ESP_GOTO_ON_FALSE( ( lv_disp != NULL ), ESP_FAIL, error, TAG, "lv_disp_drv_register failed" );
 
     return ESP_OK;
 
@@ -83,28 +134,43 @@ error:
 	return ret;
 }
 
-static esp_err_t tick_timer_init()
+static void flush_callback( lv_disp_drv_t *disp_drv, const lv_area_t *area, lv_color_t *color_p )
 {
-    esp_err_t                       ret                     = ESP_FAIL;
-    esp_timer_handle_t              esp_timer_handle        = NULL;
-    const esp_timer_create_args_t   esp_timer_create_args   = { .callback = tick_timer_callback, .name = "tick_timer_init", .arg = NULL, .dispatch_method = ESP_TIMER_TASK, .skip_unhandled_events = true };
-
-    ESP_LOGI( TAG, "tick_timer_init" );
-
-    ESP_GOTO_ON_ERROR( esp_timer_create( &esp_timer_create_args, &esp_timer_handle ), error, TAG, "esp_timer_create failed" );
+    // lvgl only flushes once the previous flush was done, so its time is final, metrics are not isr safe so it is recorded from here ...
+    if( flush_time_ > 0 )
+    {
+        airshift_metrics_record( AIRSHIFT_METRICS_STAGE_DISPLAY_FLUSH, flush_time_ );
+
+        flush_time_ = 0;
+    }
+
+    flush_size_     = (size_t)lv_area_get_size( area ) * sizeof( lv_color_t );
+    flush_last_     = lv_disp_flush_is_last( disp_drv );
+    flush_started_  = esp_timer_get_time();
+
+    // returns as soon as the transfer is queued, lvgl goes on rendering into the other buffer ...
+    if( airshift_gc9a01_draw( area->x1, area->y1, area->x2, area->y2, color_p, flush_size_ ) != ESP_OK )
+    {
+        // nothing is in flight, lvgl must not wait for it ...
+        lv_disp_flush_ready( disp_drv );
+    }
+}
 
-    ESP_GOTO_ON_ERROR( esp_timer_start_periodic( esp_timer_handle, TICK_TIMER_MS ), error, TAG, "esp_timer_start_once failed" );
+static void IRAM_ATTR flush_done_callback( void *context )
+{
+    int64_t elapsed = esp_timer_get_time() - flush_started_;
 
-    return ESP_OK;
+    portENTER_CRITICAL_ISR( &lock_ );
 
-error:
+    stats_.flushes++;
+    stats_.frames          += ( flush_last_ == true ) ? 1 : 0;
+    stats_.bytes           += flush_size_;
+    stats_.flush_time_max   = ( elapsed > stats_.flush_time_max ) ? elapsed : stats_.flush_time_max;
+    flush_time_total_      += elapsed;
 
-    ESP_LOGE( TAG, "tick_timer_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    portEXIT_CRITICAL_ISR( &lock_ );
 
-	return ret;
-}
+    flush_time_ = elapsed;
 
-static void tick_timer_callback( void *data )
-{
-    lv_tick_inc( ( TICK_TIMER_MS / 1000 ) );
+    lv_disp_flush_ready( (lv_disp_drv_t *)context );
 }
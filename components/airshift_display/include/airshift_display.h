@@ -4,15 +4,28 @@
 #include "airshift_header_common.h"
 
 #include <lvgl.h>
-#include <lvgl_helpers.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct
+{
+    uint32_t    frames;             // refreshes whose last area went out
+    uint32_t    flushes;            // areas, a partial buffer splits a frame into several
+    uint64_t    bytes;              // pixels sent over spi
+    uint32_t    bytes_per_frame;
+    int64_t     flush_time_avg;     // us, transfer queued until the last pixel is out
+    int64_t     flush_time_max;
+    float       fps;                // frames sent per second over the window
+    int64_t     window;             // us since init
+} airshift_display_stats_t;
+
 esp_err_t   airshift_display_init();
 esp_err_t   airshift_display_release();
 
+esp_err_t   airshift_display_get_stats( airshift_display_stats_t *stats );
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,6 +4,7 @@ static const char* TAG = "airshift_event";
 
 ESP_EVENT_DEFINE_BASE( AIRSHIFT_EVENT_MATTER );
 ESP_EVENT_DEFINE_BASE( AIRSHIFT_EVENT_GENERAL );
+ESP_EVENT_DEFINE_BASE( AIRSHIFT_EVENT_MQTT );
 
 // Forward declarations
 
@@ -11,6 +11,7 @@ extern "C" {
 
 ESP_EVENT_DECLARE_BASE( AIRSHIFT_EVENT_MATTER );
 ESP_EVENT_DECLARE_BASE( AIRSHIFT_EVENT_GENERAL );
+ESP_EVENT_DECLARE_BASE( AIRSHIFT_EVENT_MQTT );
 
 // Added numbers for easier readability ...
 typedef enum {
@@ -19,6 +20,13 @@ typedef enum {
     AIRSHIFT_EVENT_MATTER_IP_EVENT_STA_GOT_IP           = 3
 } airshift_event_matter_t;
 
+// AIRSHIFT_EVENT_MQTT_PUBLISHED carries the int msg_id of the acknowledged message ...
+typedef enum {
+    AIRSHIFT_EVENT_MQTT_CONNECTED                       = 1,
+    AIRSHIFT_EVENT_MQTT_DISCONNECTED                    = 2,
+    AIRSHIFT_EVENT_MQTT_PUBLISHED                       = 3
+} airshift_event_mqtt_t;
+
 typedef enum {
     AIRSHIFT_EVENT_GENERAL_REBOOT_NEEDED                = 999
 } airshift_event_general_t;
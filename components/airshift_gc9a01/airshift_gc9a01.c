@@ -0,0 +1,291 @@
+#include "airshift_gc9a01.h"
+
+#include <driver/spi_master.h>
+#include <driver/gpio.h>
+
+#define SPI_HOST_ID             SPI2_HOST
+#define MOSI_PIN                GPIO_NUM_35
+#define CLK_PIN                 GPIO_NUM_36
+#define CS_PIN                  GPIO_NUM_10
+#define DC_PIN                  GPIO_NUM_4
+#define RESET_PIN               GPIO_NUM_5
+#define BACKLIGHT_PIN           GPIO_NUM_15
+#define SPI_CLOCK_HZ            ( 40 * 1000 * 1000 )
+
+#define COMMAND_SLEEP_OUT       0x11
+#define COMMAND_DISPLAY_ON      0x29
+#define COMMAND_COLUMN_ADDRESS  0x2a
+#define COMMAND_ROW_ADDRESS     0x2b
+#define COMMAND_MEMORY_WRITE    0x2c
+
+#define INIT_DELAY              0x80    // length flag, wait 120 ms after the command
+#define INIT_DELAY_MS           120
+#define RESET_DELAY_MS          10
+
+// the spi peripheral moves at most 2^18 bits per transaction, larger draws go out in chunks, whole pixels each ...
+#define PIXEL_CHUNK_SIZE        ( 32 * 1024 )
+#define PIXEL_TRANSACTIONS_MAX  ( ( ( GC9A01_HORIZONTAL_RESOLUTION * GC9A01_VERTICAL_RESOLUTION * 2 ) + PIXEL_CHUNK_SIZE - 1 ) / PIXEL_CHUNK_SIZE )
+
+// a draw is column, row and memory write, each a command and its data, then the pixel chunks ...
+#define WINDOW_TRANSACTIONS     5
+#define DRAW_TRANSACTIONS       ( WINDOW_TRANSACTIONS + PIXEL_TRANSACTIONS_MAX )
+#define QUEUE_SIZE              DRAW_TRANSACTIONS
+
+// transaction user field, what the pre and post callbacks need to know ...
+#define TRANSACTION_DATA        0x1     // dc high
+#define TRANSACTION_LAST        0x2     // the pixels, the draw is done once it completes
+
+typedef struct
+{
+    uint8_t command;
+    uint8_t data[12];
+    uint8_t length;
+} init_command_t;
+
+static const char* TAG = "airshift_gc9a01";
+
+// Forward declarations
+static esp_err_t    send_command( uint8_t command, const uint8_t *data, size_t length );
+static esp_err_t    reclaim();
+static void         pre_transfer_callback( spi_transaction_t *transaction );
+static void         post_transfer_callback( spi_transaction_t *transaction );
+
+// vendor initialization sequence, 16 bit colour, portrait, bgr ...
+static const init_command_t init_commands_[] =
+{
+    { 0xef, { 0 }, 0 },
+    { 0xeb, { 0x14 }, 1 },
+    { 0xfe, { 0 }, 0 },
+    { 0xef, { 0 }, 0 },
+    { 0xeb, { 0x14 }, 1 },
+    { 0x84, { 0x40 }, 1 },
+    { 0x85, { 0xff }, 1 },
+    { 0x86, { 0xff }, 1 },
+    { 0x87, { 0xff }, 1 },
+    { 0x88, { 0x0a }, 1 },
+    { 0x89, { 0x21 }, 1 },
+    { 0x8a, { 0x00 }, 1 },
+    { 0x8b, { 0x80 }, 1 },
+    { 0x8c, { 0x01 }, 1 },
+    { 0x8d, { 0x01 }, 1 },
+    { 0x8e, { 0xff }, 1 },
+    { 0x8f, { 0xff }, 1 },
+    { 0xb6, { 0x00, 0x20 }, 2 },
+    { 0x36, { 0x08 }, 1 },
+    { 0x3a, { 0x05 }, 1 },
+    { 0x90, { 0x08, 0x08, 0x08, 0x08 }, 4 },
+    { 0xbd, { 0x06 }, 1 },
+    { 0xbc, { 0x00 }, 1 },
+    { 0xff, { 0x60, 0x01, 0x04 }, 3 },
+    { 0xc3, { 0x13 }, 1 },
+    { 0xc4, { 0x13 }, 1 },
+    { 0xc9, { 0x22 }, 1 },
+    { 0xbe, { 0x11 }, 1 },
+    { 0xe1, { 0x10, 0x0e }, 2 },
+    { 0xdf, { 0x21, 0x0c, 0x02 }, 3 },
+    { 0xf0, { 0x45, 0x09, 0x08, 0x08, 0x26, 0x2a }, 6 },
+    { 0xf1, { 0x43, 0x70, 0x72, 0x36, 0x37, 0x6f }, 6 },
+    { 0xf2, { 0x45, 0x09, 0x08, 0x08, 0x26, 0x2a }, 6 },
+    { 0xf3, { 0x43, 0x70, 0x72, 0x36, 0x37, 0x6f }, 6 },
+    { 0xed, { 0x1b, 0x0b }, 2 },
+    { 0xae, { 0x77 }, 1 },
+    { 0xcd, { 0x63 }, 1 },
+    { 0x70, { 0x07, 0x07, 0x04, 0x0e, 0x0f, 0x09, 0x07, 0x08, 0x03 }, 9 },
+    { 0xe8, { 0x34 }, 1 },
+    { 0x62, { 0x18, 0x0d, 0x71, 0xed, 0x70, 0x70, 0x18, 0x0f, 0x71, 0xef, 0x70, 0x70 }, 12 },
+    { 0x63, { 0x18, 0x11, 0x71, 0xf1, 0x70, 0x70, 0x18, 0x13, 0x71, 0xf3, 0x70, 0x70 }, 12 },
+    { 0x64, { 0x28, 0x29, 0xf1, 0x01, 0xf1, 0x00, 0x07 }, 7 },
+    { 0x66, { 0x3c, 0x00, 0xcd, 0x67, 0x45, 0x45, 0x10, 0x00, 0x00, 0x00 }, 10 },
+    { 0x67, { 0x00, 0x3c, 0x00, 0x00, 0x00, 0x01, 0x54, 0x10, 0x32, 0x98 }, 10 },
+    { 0x74, { 0x10, 0x85, 0x80, 0x00, 0x00, 0x4e, 0x00 }, 7 },
+    { 0x98, { 0x3e, 0x07 }, 2 },
+    { 0x35, { 0 }, 0 },
+    { 0x21, { 0 }, 0 },
+    { COMMAND_SLEEP_OUT, { 0 }, INIT_DELAY },
+    { COMMAND_DISPLAY_ON, { 0 }, INIT_DELAY },
+};
+
+static spi_device_handle_t      spi_device_                             = NULL;
+static bool                     spi_bus_                                = false;
+static spi_transaction_t        transactions_[DRAW_TRANSACTIONS]        = { 0 };
+static size_t                   pending_                                = 0;
+static airshift_gc9a01_done_t   done_                                   = NULL;
+static void                     *context_                               = NULL;
+
+// Public functions
+esp_err_t airshift_gc9a01_init( size_t max_transfer_size, airshift_gc9a01_done_t done, void *context )
+{
+    esp_err_t                           ret                 = ESP_FAIL;
+    const gpio_config_t                 gpio_config_output  = { .pin_bit_mask = BIT64( DC_PIN ) | BIT64( RESET_PIN ) | BIT64( BACKLIGHT_PIN ), .mode = GPIO_MODE_OUTPUT };
+    const spi_bus_config_t              spi_bus_config      = { .mosi_io_num = MOSI_PIN, .miso_io_num = -1, .sclk_io_num = CLK_PIN, .quadwp_io_num = -1, .quadhd_io_num = -1, .max_transfer_sz = (int)( ( max_transfer_size < PIXEL_CHUNK_SIZE ) ? max_transfer_size : PIXEL_CHUNK_SIZE ) };
+    const spi_device_interface_config_t spi_device_config   = { .clock_speed_hz = SPI_CLOCK_HZ, .mode = 0, .spics_io_num = CS_PIN, .queue_size = QUEUE_SIZE, .pre_cb = pre_transfer_callback, .post_cb = post_transfer_callback };
+
+    ESP_LOGI( TAG, "airshift_gc9a01_init -> max_transfer_size: %u", max_transfer_size );
+
+    done_       = done;
+    context_    = context;
+    pending_    = 0;
+
+    ESP_GOTO_ON_ERROR( gpio_config( &gpio_config_output ), error, TAG, "gpio_config failed" );
+
+    ESP_GOTO_ON_ERROR( spi_bus_initialize( SPI_HOST_ID, &spi_bus_config, SPI_DMA_CH_AUTO ), error, TAG, "spi_bus_initialize failed" );
+
+    spi_bus_ = true;
+
+    ESP_GOTO_ON_ERROR( spi_bus_add_device( SPI_HOST_ID, &spi_device_config, &spi_device_ ), error, TAG, "spi_bus_add_device failed" );
+
+    // hardware reset ...
+    gpio_set_level( RESET_PIN, 0 );
+    vTaskDelay( pdMS_TO_TICKS( RESET_DELAY_MS ) );
+    gpio_set_level( RESET_PIN, 1 );
+    vTaskDelay( pdMS_TO_TICKS( INIT_DELAY_MS ) );
+
+    for( size_t i = 0; i < ( sizeof( init_commands_ ) / sizeof( init_commands_[0] ) ); i++ )
+    {
+        ESP_GOTO_ON_ERROR( send_command( init_commands_[i].command, init_commands_[i].data, init_commands_[i].length & ~INIT_DELAY ), error, TAG, "send_command -> 0x%02x failed", init_commands_[i].command );
+
+        if( init_commands_[i].length & INIT_DELAY )
+        {
+            vTaskDelay( pdMS_TO_TICKS( INIT_DELAY_MS ) );
+        }
+    }
+
+    gpio_set_level( BACKLIGHT_PIN, 1 );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_gc9a01_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    // Cleanup on any error ...
+    airshift_gc9a01_release();
+
+    return ret;
+}
+
+esp_err_t airshift_gc9a01_release()
+{
+    ESP_LOGI( TAG, "airshift_gc9a01_release" );
+
+    gpio_set_level( BACKLIGHT_PIN, 0 );
+
+    if( spi_device_ != NULL )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( reclaim() );
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( spi_bus_remove_device( spi_device_ ) );
+
+        spi_device_ = NULL;
+    }
+
+    if( spi_bus_ == true )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( spi_bus_free( SPI_HOST_ID ) );
+
+        spi_bus_ = false;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_gc9a01_draw( uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const void *pixels, size_t size )
+{
+    esp_err_t   ret     = ESP_FAIL;
+    size_t      count   = WINDOW_TRANSACTIONS;
+    size_t      chunk   = 0;
+
+    ESP_GOTO_ON_FALSE( ( spi_device_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+    ESP_GOTO_ON_FALSE( ( ( size > 0 ) && ( size <= ( PIXEL_TRANSACTIONS_MAX * PIXEL_CHUNK_SIZE ) ) ), ESP_ERR_INVALID_SIZE, error, TAG, "size: %u", size );
+
+    // the previous draw has completed by now, its results only free the queue slots ...
+    ESP_GOTO_ON_ERROR( reclaim(), error, TAG, "reclaim failed" );
+
+    memset( transactions_, 0, sizeof( transactions_ ) );
+
+    transactions_[0] = (spi_transaction_t){ .flags = SPI_TRANS_USE_TXDATA, .length = 8, .tx_data = { COMMAND_COLUMN_ADDRESS }, .user = (void *)0 };
+    transactions_[1] = (spi_transaction_t){ .flags = SPI_TRANS_USE_TXDATA, .length = 32, .tx_data = { x1 >> 8, x1 & 0xff, x2 >> 8, x2 & 0xff }, .user = (void *)TRANSACTION_DATA };
+    transactions_[2] = (spi_transaction_t){ .flags = SPI_TRANS_USE_TXDATA, .length = 8, .tx_data = { COMMAND_ROW_ADDRESS }, .user = (void *)0 };
+    transactions_[3] = (spi_transaction_t){ .flags = SPI_TRANS_USE_TXDATA, .length = 32, .tx_data = { y1 >> 8, y1 & 0xff, y2 >> 8, y2 & 0xff }, .user = (void *)TRANSACTION_DATA };
+    transactions_[4] = (spi_transaction_t){ .flags = SPI_TRANS_USE_TXDATA, .length = 8, .tx_data = { COMMAND_MEMORY_WRITE }, .user = (void *)0 };
+
+    // only the final chunk completes the draw ...
+    for( size_t offset = 0; offset < size; offset += chunk )
+    {
+        chunk                   = ( ( size - offset ) < PIXEL_CHUNK_SIZE ) ? ( size - offset ) : PIXEL_CHUNK_SIZE;
+        transactions_[count++]  = (spi_transaction_t){ .length = chunk * 8, .tx_buffer = (const uint8_t *)pixels + offset, .user = (void *)(uintptr_t)( TRANSACTION_DATA | ( ( ( offset + chunk ) == size ) ? TRANSACTION_LAST : 0 ) ) };
+    }
+
+    // queued, not polled, the pixels go out over dma while the caller renders into its other buffer ...
+    for( size_t i = 0; i < count; i++ )
+    {
+        ESP_GOTO_ON_ERROR( spi_device_queue_trans( spi_device_, &transactions_[i], portMAX_DELAY ), error, TAG, "spi_device_queue_trans failed" );
+
+        pending_++;
+    }
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_gc9a01_draw failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static esp_err_t send_command( uint8_t command, const uint8_t *data, size_t length )
+{
+    esp_err_t           ret                     = ESP_FAIL;
+    spi_transaction_t   command_transaction     = { .length = 8, .tx_buffer = &command, .user = (void *)0 };
+    spi_transaction_t   data_transaction        = { .length = length * 8, .tx_buffer = data, .user = (void *)TRANSACTION_DATA };
+
+    ESP_GOTO_ON_ERROR( spi_device_polling_transmit( spi_device_, &command_transaction ), error, TAG, "spi_device_polling_transmit -> command failed" );
+
+    if( length > 0 )
+    {
+        ESP_GOTO_ON_ERROR( spi_device_polling_transmit( spi_device_, &data_transaction ), error, TAG, "spi_device_polling_transmit -> data failed" );
+    }
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "send_command failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+static esp_err_t reclaim()
+{
+    esp_err_t           ret         = ESP_FAIL;
+    spi_transaction_t   *completed  = NULL;
+
+    while( pending_ > 0 )
+    {
+        ESP_GOTO_ON_ERROR( spi_device_get_trans_result( spi_device_, &completed, portMAX_DELAY ), error, TAG, "spi_device_get_trans_result failed" );
+
+        pending_--;
+    }
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "reclaim failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+static void IRAM_ATTR pre_transfer_callback( spi_transaction_t *transaction )
+{
+    gpio_set_level( DC_PIN, (uintptr_t)transaction->user & TRANSACTION_DATA );
+}
+
+static void IRAM_ATTR post_transfer_callback( spi_transaction_t *transaction )
+{
+    if( ( (uintptr_t)transaction->user & TRANSACTION_LAST ) && ( done_ != NULL ) )
+    {
+        done_( context_ );
+    }
+}
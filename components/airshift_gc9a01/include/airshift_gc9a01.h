@@ -0,0 +1,27 @@
+#ifndef AIRSHIFT_GC9A01_H
+#define AIRSHIFT_GC9A01_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GC9A01_HORIZONTAL_RESOLUTION    240
+#define GC9A01_VERTICAL_RESOLUTION      240
+
+// called from the spi isr once the pixels of a draw are on the panel ...
+typedef void ( *airshift_gc9a01_done_t )( void *context );
+
+// max_transfer_size is the largest draw in bytes, the spi bus sizes its dma descriptors for it, or for one 32 KB chunk when it is larger ...
+esp_err_t   airshift_gc9a01_init( size_t max_transfer_size, airshift_gc9a01_done_t done, void *context );
+esp_err_t   airshift_gc9a01_release();
+
+// queues the window and pixel transfers and returns, pixels must stay untouched until done is called. At most one draw is in flight ...
+esp_err_t   airshift_gc9a01_draw( uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, const void *pixels, size_t size );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_GC9A01_H
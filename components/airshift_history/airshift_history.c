@@ -0,0 +1,594 @@
+#include "airshift_history.h"
+
+#include <time.h>
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_SECTOR_SIZE     4096
+#define HISTORY_MAGIC           0x54534841  // "AHST"
+#define HISTORY_VERSION         1
+
+// records kept in ram and written with a single flash write, lost on power failure ...
+#define HISTORY_BATCH_RECORDS   8
+
+// anything before 2023-01-01 means sntp has not set the clock yet ...
+#define HISTORY_UTC_VALID       1672531200
+
+#define HISTORY_ERASED          0xFFFFFFFF
+
+typedef struct __attribute__(( packed ))
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    record_size;
+    uint32_t    sector_sequence;    // incremented every time a sector is recycled
+    uint32_t    first_sequence;     // record sequence held in slot 0
+    uint8_t     reserved[14];
+    uint16_t    crc;
+} sector_header_t;
+
+typedef struct __attribute__(( packed ))
+{
+    uint32_t    sequence;
+    uint32_t    timestamp;
+    uint16_t    flags;
+    int16_t     values[AIRSHIFT_CHANNEL_COUNT];
+    uint16_t    crc;
+} record_t;
+
+_Static_assert( sizeof( sector_header_t ) == 32, "sector header must stay 32 bytes" );
+_Static_assert( sizeof( record_t ) == 24, "record must stay 24 bytes" );
+
+#define RECORDS_PER_SECTOR      ( ( HISTORY_SECTOR_SIZE - sizeof( sector_header_t ) ) / sizeof( record_t ) )
+
+static const char* TAG = "airshift_history";
+
+// Forward declarations
+static void         build_record( const airshift_sample_t *sample, uint32_t sequence, record_t *record );
+static esp_err_t    build_index();
+static esp_err_t    format();
+static esp_err_t    find_head_slot();
+static esp_err_t    read_header( uint32_t sector, sector_header_t *header );
+static esp_err_t    write_header( uint32_t sector, uint32_t sector_sequence, uint32_t first_sequence );
+static esp_err_t    rotate();
+static esp_err_t    flush_batch();
+static size_t       slot_offset( uint32_t sector, uint32_t slot );
+
+static const esp_partition_t    *partition_         = NULL;
+static SemaphoreHandle_t        mutex_              = NULL;
+static uint32_t                 sector_count_       = 0;
+
+// sector being appended to ...
+static uint32_t                 head_sector_        = 0;
+static uint32_t                 head_sequence_      = 0;
+static uint32_t                 head_first_         = 0;
+static uint32_t                 head_slot_          = 0;
+
+// oldest sector still holding records, sectors in between are contiguous ...
+static uint32_t                 oldest_sector_      = 0;
+static uint32_t                 oldest_first_       = 0;
+
+static record_t                 batch_[HISTORY_BATCH_RECORDS]   = { 0 };
+static uint32_t                 batch_count_        = 0;
+static airshift_history_stats_t stats_              = { 0 };
+
+// Public functions
+esp_err_t airshift_history_init()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    int64_t     start   = esp_timer_get_time();
+
+    ESP_LOGI( TAG, "airshift_history_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+    batch_count_    = 0;
+    head_first_     = 0;
+    head_slot_      = 0;
+    oldest_first_   = 0;
+
+    mutex_ = xSemaphoreCreateMutex();
+
+    ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xSemaphoreCreateMutex failed" );
+
+    partition_ = esp_partition_find_first( ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION_LABEL );
+
+    // ota never rewrites the partition table, units updated over the air run without a log until reflashed over serial ...
+    if( partition_ == NULL )
+    {
+        ESP_LOGW( TAG, "airshift_history_init -> no \"%s\" partition, history disabled, appends are not stored", HISTORY_PARTITION_LABEL );
+
+        return ESP_OK;
+    }
+
+    sector_count_ = partition_->size / HISTORY_SECTOR_SIZE;
+
+    // one sector is always being recycled, so we need at least two ...
+    ESP_GOTO_ON_FALSE( ( sector_count_ >= 2 ), ESP_ERR_INVALID_SIZE, error, TAG, "history partition too small" );
+
+    ESP_GOTO_ON_ERROR( build_index(), error, TAG, "build_index failed" );
+
+    stats_.capacity     = ( sector_count_ - 1 ) * RECORDS_PER_SECTOR;
+    stats_.index_time   = esp_timer_get_time() - start;
+
+    ESP_LOGI( TAG, "airshift_history_init -> sectors: %lu, records: [ %lu, %lu ), capacity: %lu, index: %lld us", sector_count_, oldest_first_, head_first_ + head_slot_, stats_.capacity, stats_.index_time );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_history_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_history_release() );
+
+    return ret;
+}
+
+esp_err_t airshift_history_release()
+{
+    ESP_LOGI( TAG, "airshift_history_release" );
+
+    if( mutex_ != NULL )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_history_flush() );
+
+        vSemaphoreDelete( mutex_ );
+
+        mutex_ = NULL;
+    }
+
+    partition_ = NULL;
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_history_append( const airshift_sample_t *sample, airshift_history_record_t *appended )
+{
+    esp_err_t   ret     = ESP_FAIL;
+    record_t    *record = NULL;
+
+    ESP_GOTO_ON_FALSE( ( ( mutex_ != NULL ) && ( sample != NULL ) ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    // a previous flush failed and the batch is still full, try again before queuing more ...
+    if( ( batch_count_ >= HISTORY_BATCH_RECORDS ) && ( ( ret = flush_batch() ) != ESP_OK ) )
+    {
+        xSemaphoreGive( mutex_ );
+
+        goto error;
+    }
+
+    record = &batch_[batch_count_];
+
+    build_record( sample, head_first_ + head_slot_ + batch_count_, record );
+
+    if( appended != NULL )
+    {
+        appended->sequence  = record->sequence;
+        appended->timestamp = record->timestamp;
+        appended->flags     = record->flags;
+
+        memcpy( appended->values, record->values, sizeof( appended->values ) );
+    }
+
+    // ... without a partition the record only goes to the caller, sequences still advance ...
+    if( partition_ == NULL )
+    {
+        head_slot_++;
+
+        xSemaphoreGive( mutex_ );
+
+        return ESP_OK;
+    }
+
+    batch_count_++;
+
+    ret = ( batch_count_ < HISTORY_BATCH_RECORDS ) ? ESP_OK : flush_batch();
+
+    xSemaphoreGive( mutex_ );
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "flush_batch failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_history_append failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_history_flush()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    ret = flush_batch();
+
+    xSemaphoreGive( mutex_ );
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "flush_batch failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_history_flush failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_history_to_record( const airshift_sample_t *sample, airshift_history_record_t *record )
+{
+    record_t stored = { 0 };
+
+    ESP_RETURN_ON_FALSE( ( ( sample != NULL ) && ( record != NULL ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    build_record( sample, 0, &stored );
+
+    record->sequence    = stored.sequence;
+    record->timestamp   = stored.timestamp;
+    record->flags       = stored.flags;
+
+    memcpy( record->values, stored.values, sizeof( record->values ) );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_history_read( uint32_t sequence, airshift_history_record_t *record )
+{
+    esp_err_t   ret         = ESP_FAIL;
+    record_t    stored      = { 0 };
+    uint32_t    written     = 0;
+    uint32_t    offset      = 0;
+
+    ESP_GOTO_ON_FALSE( ( ( mutex_ != NULL ) && ( record != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    written = head_first_ + head_slot_;
+
+    if( ( partition_ == NULL ) || ( sequence < oldest_first_ ) || ( sequence >= ( written + batch_count_ ) ) )
+    {
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    else if( sequence >= written )
+    {
+        // still waiting in the ram batch ...
+        stored  = batch_[sequence - written];
+        ret     = ESP_OK;
+    }
+    else
+    {
+        // sequences map straight onto sector and slot, no search needed ...
+        offset  = sequence - oldest_first_;
+        ret     = esp_partition_read( partition_, slot_offset( ( oldest_sector_ + ( offset / RECORDS_PER_SECTOR ) ) % sector_count_, offset % RECORDS_PER_SECTOR ), &stored, sizeof( stored ) );
+
+        if( ( ret == ESP_OK ) && ( ( stored.sequence != sequence ) || ( stored.crc != esp_rom_crc16_le( 0, (const uint8_t *)&stored, offsetof( record_t, crc ) ) ) ) )
+        {
+            stats_.crc_errors++;
+
+            ret = ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    if( ret != ESP_OK )
+    {
+        return ret;
+    }
+
+    record->sequence    = stored.sequence;
+    record->timestamp   = stored.timestamp;
+    record->flags       = stored.flags;
+
+    memcpy( record->values, stored.values, sizeof( record->values ) );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+esp_err_t airshift_history_get_range( uint32_t *oldest, uint32_t *next )
+{
+    if( ( mutex_ == NULL ) || ( oldest == NULL ) || ( next == NULL ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    *oldest = oldest_first_;
+    *next   = head_first_ + head_slot_ + batch_count_;
+
+    xSemaphoreGive( mutex_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_history_get_stats( airshift_history_stats_t *stats )
+{
+    if( ( mutex_ == NULL ) || ( stats == NULL ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    *stats = stats_;
+
+    xSemaphoreGive( mutex_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static void build_record( const airshift_sample_t *sample, uint32_t sequence, record_t *record )
+{
+    time_t now = time( NULL );
+
+    record->sequence    = sequence;
+    record->flags       = (uint16_t)( sample->valid_mask & 0xFF );
+
+    if( now >= HISTORY_UTC_VALID )
+    {
+        record->timestamp   = (uint32_t)now;
+        record->flags      |= AIRSHIFT_HISTORY_FLAG_UTC;
+    }
+    else
+    {
+        record->timestamp   = (uint32_t)( sample->timestamp / ( 1000 * 1000 ) );
+    }
+
+    memcpy( record->values, sample->values, sizeof( record->values ) );
+
+    record->crc = esp_rom_crc16_le( 0, (const uint8_t *)record, offsetof( record_t, crc ) );
+}
+
+static esp_err_t build_index()
+{
+    esp_err_t       ret         = ESP_FAIL;
+    sector_header_t header      = { 0 };
+    sector_header_t previous    = { 0 };
+    bool            found       = false;
+
+    // only sector headers are read, never the records themselves ...
+    for( uint32_t i = 0; i < sector_count_; i++ )
+    {
+        if( ( read_header( i, &header ) == ESP_OK ) && ( !found || ( header.sector_sequence > head_sequence_ ) ) )
+        {
+            found           = true;
+            head_sector_    = i;
+            head_sequence_  = header.sector_sequence;
+            head_first_     = header.first_sequence;
+        }
+    }
+
+    if( !found )
+    {
+        ESP_LOGW( TAG, "build_index -> no valid sector, formatting" );
+
+        return format();
+    }
+
+    // walk back while the preceding sectors continue the same run ...
+    oldest_sector_  = head_sector_;
+    oldest_first_   = head_first_;
+
+    for( uint32_t i = 1; i < sector_count_; i++ )
+    {
+        uint32_t sector = ( head_sector_ + sector_count_ - i ) % sector_count_;
+
+        if( ( read_header( sector, &previous ) != ESP_OK ) || ( previous.sector_sequence != ( head_sequence_ - i ) ) || ( previous.first_sequence != ( oldest_first_ - RECORDS_PER_SECTOR ) ) )
+        {
+            break;
+        }
+
+        oldest_sector_  = sector;
+        oldest_first_   = previous.first_sequence;
+    }
+
+    ESP_GOTO_ON_ERROR( find_head_slot(), error, TAG, "find_head_slot failed" );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t format()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_ERROR( esp_partition_erase_range( partition_, 0, HISTORY_SECTOR_SIZE ), error, TAG, "esp_partition_erase_range failed" );
+
+    ESP_GOTO_ON_ERROR( write_header( 0, 1, 0 ), error, TAG, "write_header failed" );
+
+    head_sector_    = 0;
+    head_sequence_  = 1;
+    head_first_     = 0;
+    head_slot_      = 0;
+    oldest_sector_  = 0;
+    oldest_first_   = 0;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t find_head_slot()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    uint32_t    low     = 0;
+    uint32_t    high    = RECORDS_PER_SECTOR;
+    uint32_t    middle  = 0;
+    uint32_t    word    = 0;
+    record_t    record  = { 0 };
+    bool        erased  = false;
+
+    // slots fill in order, so the first erased sequence word marks the end of the sector's records ...
+    while( low < high )
+    {
+        middle = low + ( ( high - low ) / 2 );
+
+        ESP_GOTO_ON_ERROR( esp_partition_read( partition_, slot_offset( head_sector_, middle ), &word, sizeof( word ) ), error, TAG, "esp_partition_read failed" );
+
+        if( word == HISTORY_ERASED )
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    // a write torn by power loss can leave a partly programmed slot, step over it ...
+    for( ; low < RECORDS_PER_SECTOR; low++ )
+    {
+        ESP_GOTO_ON_ERROR( esp_partition_read( partition_, slot_offset( head_sector_, low ), &record, sizeof( record ) ), error, TAG, "esp_partition_read failed" );
+
+        erased = true;
+
+        for( size_t i = 0; i < sizeof( record ); i++ )
+        {
+            erased &= ( ( (const uint8_t *)&record )[i] == 0xFF );
+        }
+
+        if( erased )
+        {
+            break;
+        }
+    }
+
+    head_slot_ = low;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t read_header( uint32_t sector, sector_header_t *header )
+{
+    esp_err_t ret = esp_partition_read( partition_, (size_t)sector * HISTORY_SECTOR_SIZE, header, sizeof( sector_header_t ) );
+
+    if( ret != ESP_OK )
+    {
+        return ret;
+    }
+
+    if( ( header->magic != HISTORY_MAGIC ) || ( header->version != HISTORY_VERSION ) || ( header->record_size != sizeof( record_t ) ) || ( header->crc != esp_rom_crc16_le( 0, (const uint8_t *)header, offsetof( sector_header_t, crc ) ) ) )
+    {
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t write_header( uint32_t sector, uint32_t sector_sequence, uint32_t first_sequence )
+{
+    sector_header_t header = { 0 };
+
+    memset( &header, 0xFF, sizeof( header ) );
+
+    header.magic            = HISTORY_MAGIC;
+    header.version          = HISTORY_VERSION;
+    header.record_size      = sizeof( record_t );
+    header.sector_sequence  = sector_sequence;
+    header.first_sequence   = first_sequence;
+    header.crc              = esp_rom_crc16_le( 0, (const uint8_t *)&header, offsetof( sector_header_t, crc ) );
+
+    return esp_partition_write( partition_, (size_t)sector * HISTORY_SECTOR_SIZE, &header, sizeof( header ) );
+}
+
+static esp_err_t rotate()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    uint32_t    sector  = ( head_sector_ + 1 ) % sector_count_;
+
+    // ring is full, the oldest sector is the one being recycled ...
+    if( sector == oldest_sector_ )
+    {
+        oldest_sector_  = ( oldest_sector_ + 1 ) % sector_count_;
+        oldest_first_  += RECORDS_PER_SECTOR;
+    }
+
+    ESP_GOTO_ON_ERROR( esp_partition_erase_range( partition_, (size_t)sector * HISTORY_SECTOR_SIZE, HISTORY_SECTOR_SIZE ), error, TAG, "esp_partition_erase_range failed" );
+
+    ESP_GOTO_ON_ERROR( write_header( sector, head_sequence_ + 1, head_first_ + RECORDS_PER_SECTOR ), error, TAG, "write_header failed" );
+
+    stats_.sectors_erased++;
+
+    head_sector_    = sector;
+    head_sequence_ += 1;
+    head_first_    += RECORDS_PER_SECTOR;
+    head_slot_      = 0;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t flush_batch()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    uint32_t    index   = 0;
+    uint32_t    count   = 0;
+
+    while( index < batch_count_ )
+    {
+        if( head_slot_ >= RECORDS_PER_SECTOR )
+        {
+            ESP_GOTO_ON_ERROR( rotate(), error, TAG, "rotate failed" );
+        }
+
+        // as many records as still fit in this sector, in one write ...
+        count = batch_count_ - index;
+        count = ( count < ( RECORDS_PER_SECTOR - head_slot_ ) ) ? count : ( RECORDS_PER_SECTOR - head_slot_ );
+
+        ESP_GOTO_ON_ERROR( esp_partition_write( partition_, slot_offset( head_sector_, head_slot_ ), &batch_[index], count * sizeof( record_t ) ), error, TAG, "esp_partition_write failed" );
+
+        head_slot_              += count;
+        index                   += count;
+        stats_.records_written  += count;
+    }
+
+    if( batch_count_ > 0 )
+    {
+        stats_.batches_written++;
+    }
+
+    batch_count_ = 0;
+
+    return ESP_OK;
+
+error:
+
+    // keep whatever was not written, sequences must stay contiguous ...
+    memmove( batch_, &batch_[index], ( batch_count_ - index ) * sizeof( record_t ) );
+
+    batch_count_ -= index;
+
+    return ret;
+}
+
+static size_t slot_offset( uint32_t sector, uint32_t slot )
+{
+    return ( (size_t)sector * HISTORY_SECTOR_SIZE ) + sizeof( sector_header_t ) + ( (size_t)slot * sizeof( record_t ) );
+}
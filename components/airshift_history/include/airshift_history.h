@@ -0,0 +1,53 @@
+#ifndef AIRSHIFT_HISTORY_H
+#define AIRSHIFT_HISTORY_H
+
+#include "airshift_header_common.h"
+#include "airshift_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// timestamp is utc seconds, otherwise seconds since boot ...
+#define AIRSHIFT_HISTORY_FLAG_UTC   0x0100
+
+typedef struct
+{
+    uint32_t    sequence;       // monotonic, never reused
+    uint32_t    timestamp;
+    uint16_t    flags;          // AIRSHIFT_HISTORY_FLAG_* in the high byte, channel valid mask in the low byte
+    int16_t     values[AIRSHIFT_CHANNEL_COUNT];
+} airshift_history_record_t;
+
+typedef struct
+{
+    uint32_t    records_written;
+    uint32_t    batches_written;
+    uint32_t    sectors_erased;
+    uint32_t    crc_errors;
+    uint32_t    capacity;       // records retained before the oldest sector is recycled
+    int64_t     index_time;     // time spent rebuilding the index at boot ( us )
+} airshift_history_stats_t;
+
+esp_err_t   airshift_history_init();
+esp_err_t   airshift_history_release();
+
+// appended, when given, receives the record exactly as it will be stored ...
+esp_err_t   airshift_history_append( const airshift_sample_t *sample, airshift_history_record_t *appended );
+esp_err_t   airshift_history_flush();
+
+// the record append would store, sequence 0, for publishing live when the log itself is not running ...
+esp_err_t   airshift_history_to_record( const airshift_sample_t *sample, airshift_history_record_t *record );
+
+// ESP_ERR_NOT_FOUND once a sequence has been recycled or before it was written ...
+esp_err_t   airshift_history_read( uint32_t sequence, airshift_history_record_t *record );
+
+// records held are [ oldest, next ) ...
+esp_err_t   airshift_history_get_range( uint32_t *oldest, uint32_t *next );
+esp_err_t   airshift_history_get_stats( airshift_history_stats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_HISTORY_H
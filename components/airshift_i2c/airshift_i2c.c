@@ -1,4 +1,6 @@
 #include "airshift_i2c.h"
+#include "airshift_metrics.h"
+#include "airshift_trace.h"
 #include <driver/i2c.h>
 
 #define I2C_MASTER_FREQ_HZ      400000
@@ -7,6 +9,7 @@
 static const char* TAG = "airshift_i2c";
 
 // Forward declarations
+static esp_err_t    count_errors( esp_err_t ret );
 
 // Public functions
 esp_err_t airshift_i2c_init()
@@ -42,17 +45,30 @@ esp_err_t airshift_i2c_release()
 
 esp_err_t airshift_i2c_read( uint8_t device_address, uint8_t *read_buffer, size_t buffer_size )
 {
-    ESP_LOGI( TAG, "airshift_i2c_read" );
+    AIRSHIFT_TRACED( TAG, "airshift_i2c_read -> address: 0x%02x, size: %u", device_address, buffer_size );
 
-    return i2c_master_read_from_device( I2C_NUM_0, device_address, read_buffer, buffer_size, ( I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS ) );
+    return count_errors( i2c_master_read_from_device( I2C_NUM_0, device_address, read_buffer, buffer_size, ( I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS ) ) );
 }
 
 esp_err_t airshift_i2c_write( uint8_t device_address, uint8_t *write_buffer, size_t buffer_size )
 {
-    ESP_LOGI( TAG, "airshift_i2c_read" );
+    AIRSHIFT_TRACED( TAG, "airshift_i2c_write -> address: 0x%02x, size: %u", device_address, buffer_size );
 
-    return i2c_master_write_to_device( I2C_NUM_0, device_address, write_buffer, buffer_size, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS );
+    return count_errors( i2c_master_write_to_device( I2C_NUM_0, device_address, write_buffer, buffer_size, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS ) );
 }
 
 // Private functions
+static esp_err_t count_errors( esp_err_t ret )
+{
+    // the driver reports a missing ack as ESP_FAIL ...
+    if( ret == ESP_FAIL )
+    {
+        airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_I2C_NACKS );
+    }
+    else if( ret == ESP_ERR_TIMEOUT )
+    {
+        airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_I2C_TIMEOUTS );
+    }
 
+    return ret;
+}
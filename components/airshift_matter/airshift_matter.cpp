@@ -5,8 +5,16 @@
 #include <esp_matter_console.h>
 #include <esp_matter_ota.h>
 
+#include <app/InteractionModelEngine.h>
+#include <app/ReadHandler.h>
 #include <app/server/CommissioningWindowManager.h>
+#include <app/server/OnboardingCodesUtil.h>
 #include <app/server/Server.h>
+#include <platform/PlatformManager.h>
+
+#include <esp_timer.h>
+#include <esp_console.h>
+#include <math.h>
 
 static const char* TAG = "airshift_matter";
 
@@ -15,15 +23,81 @@ using namespace esp_matter::attribute;
 using namespace esp_matter::endpoint;
 using namespace chip::app::Clusters;
 
+typedef enum
+{
+    ENCODING_CONCENTRATION,     // nullable float, as measured
+    ENCODING_TEMPERATURE,       // nullable int16, 0.01 degrees celsius
+    ENCODING_HUMIDITY           // nullable uint16, 0.01 %
+} encoding_t;
+
+typedef struct
+{
+    const char                  *name;
+    uint32_t                    cluster_id;
+    uint32_t                    attribute_id;
+    encoding_t                  encoding;
+    airshift_matter_reporting_t reporting;      // default
+} measurement_attribute_t;
+
+typedef struct
+{
+    bool                    written;    // anything written since init
+    bool                    valid;      // what was written was not null
+    float                   value;
+    int64_t                 time;
+    esp_matter_attr_val_t   val;
+} reported_t;
+
+// Counts subscriptions and what each one costs in heap, every callback runs on the chip thread ...
+class subscription_callback_t : public chip::app::ReadHandler::ApplicationCallback
+{
+    CHIP_ERROR  OnSubscriptionRequested( chip::app::ReadHandler &handler, chip::Transport::SecureSession &session ) override;
+    void        OnSubscriptionEstablished( chip::app::ReadHandler &handler ) override;
+    void        OnSubscriptionTerminated( chip::app::ReadHandler &handler ) override;
+
+    uint32_t    requested_heap_ = 0;
+};
+
 // Forward declarations
+static esp_err_t    create_measurement_clusters( endpoint_t *endpoint );
+static void         update_work( intptr_t arg );
+static bool         due( const reported_t *reported, const airshift_matter_reporting_t *reporting, float value, bool valid, int64_t now, bool *held );
+static void         encode( airshift_matter_measurement_t measurement, float value, bool valid, esp_matter_attr_val_t *val );
+static void         register_subscription_callback( intptr_t arg );
+static int          reporting_command( int argc, char **argv );
 static esp_err_t    attribute_callback( attribute::callback_type_t type, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id, esp_matter_attr_val_t *val, void *priv_data );
 static esp_err_t    identification_callback( identification::callback_type_t type, uint16_t endpoint_id, uint8_t effect_id, uint8_t effect_variant, void *priv_data );
 static void         event_callback( const ChipDeviceEvent *event, intptr_t arg );
 
+// in airshift_matter_measurement_t order, reporting defaults sit just above the sensors' own noise ...
+static const measurement_attribute_t measurement_attributes_[AIRSHIFT_MATTER_MEASUREMENT_COUNT] =
+{
+    { "co2",            CarbonDioxideConcentrationMeasurement::Id,  CarbonDioxideConcentrationMeasurement::Attributes::MeasuredValue::Id,   ENCODING_CONCENTRATION, { 20.0f,    10000,  300000 } },
+    { "pm1.0",          Pm1ConcentrationMeasurement::Id,            Pm1ConcentrationMeasurement::Attributes::MeasuredValue::Id,             ENCODING_CONCENTRATION, { 2.0f,     10000,  300000 } },
+    { "pm2.5",          Pm25ConcentrationMeasurement::Id,           Pm25ConcentrationMeasurement::Attributes::MeasuredValue::Id,            ENCODING_CONCENTRATION, { 2.0f,     10000,  300000 } },
+    { "pm10",           Pm10ConcentrationMeasurement::Id,           Pm10ConcentrationMeasurement::Attributes::MeasuredValue::Id,            ENCODING_CONCENTRATION, { 2.0f,     10000,  300000 } },
+    { "temperature",    TemperatureMeasurement::Id,                 TemperatureMeasurement::Attributes::MeasuredValue::Id,                  ENCODING_TEMPERATURE,   { 0.2f,     30000,  600000 } },
+    { "humidity",       RelativeHumidityMeasurement::Id,            RelativeHumidityMeasurement::Attributes::MeasuredValue::Id,             ENCODING_HUMIDITY,      { 1.0f,     30000,  600000 } },
+};
+
+static const esp_console_cmd_t  command_    = { .command = "reporting", .help = "Matter attribute writes, reports and what each subscription costs", .hint = NULL, .func = &reporting_command };
+
 static node_t       *node_                          = NULL;
 static endpoint_t   *endpoint_                      = NULL;
 static bool         commissioning_session_started_  = false;
 
+// handed from the sampling task to the chip thread, under lock_ ...
+static portMUX_TYPE                     lock_               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_matter_measurements_t   pending_            = {};
+static bool                             scheduled_          = false;
+static airshift_matter_stats_t          stats_              = {};
+static airshift_matter_reporting_t      reporting_[AIRSHIFT_MATTER_MEASUREMENT_COUNT]  = {};
+
+// chip thread only, what the attributes hold ...
+static reported_t                       reported_[AIRSHIFT_MATTER_MEASUREMENT_COUNT]   = {};
+static uint8_t                          air_quality_                                    = 0;    // the cluster starts out unknown
+static subscription_callback_t          subscription_callback_;
+
 // Public functions
 esp_err_t airshift_matter_init()
 {
@@ -37,6 +111,17 @@ esp_err_t airshift_matter_init()
     node_                           = NULL;
     endpoint_                       = NULL;
     commissioning_session_started_  = false;
+    scheduled_                      = false;
+    stats_                          = {};
+
+    memset( reported_, 0, sizeof( reported_ ) );
+
+    air_quality_ = 0;
+
+    for( int i = 0; i < AIRSHIFT_MATTER_MEASUREMENT_COUNT; i++ )
+    {
+        reporting_[i] = measurement_attributes_[i].reporting;
+    }
     
     node_ = node::create( &node_config, attribute_callback, identification_callback );
 
@@ -46,8 +131,13 @@ esp_err_t airshift_matter_init()
 
     ESP_GOTO_ON_FALSE( ( endpoint_ != NULL ), ret, error, TAG, "air_quality_sensor::create failed" );
 
+    ESP_GOTO_ON_ERROR( create_measurement_clusters( endpoint_ ), error, TAG, "create_measurement_clusters failed" );
+
     ESP_GOTO_ON_ERROR( esp_matter::start( event_callback ), error, TAG, "esp_matter::start failed" );
 
+    // the interaction model engine belongs to the chip thread ...
+    ESP_GOTO_ON_FALSE( ( chip::DeviceLayer::PlatformMgr().ScheduleWork( register_subscription_callback, 0 ) == CHIP_NO_ERROR ), ESP_FAIL, error, TAG, "ScheduleWork failed" );
+
     return ESP_OK;
 
 error:
@@ -66,6 +156,12 @@ esp_err_t airshift_matter_release()
 
     if( ( node_ != NULL ) && ( endpoint_ != NULL ) )
     {
+        chip::DeviceLayer::PlatformMgr().LockChipStack();
+
+        chip::app::InteractionModelEngine::GetInstance()->UnregisterReadHandlerAppCallback();
+
+        chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+
         ESP_ERROR_CHECK_WITHOUT_ABORT( destroy( node_, endpoint_ ) );
     }
 
@@ -77,7 +173,396 @@ esp_err_t airshift_matter_release()
     return ESP_OK;
 }
 
+esp_err_t airshift_matter_get_qrcode_payload( char *payload, size_t size )
+{
+    esp_err_t               ret         = ESP_FAIL;
+    CHIP_ERROR              chip_error  = CHIP_NO_ERROR;
+    chip::MutableCharSpan   span( payload, ( size > 0 ) ? ( size - 1 ) : 0 );   // room for the terminator
+
+    ESP_GOTO_ON_FALSE( ( ( payload != NULL ) && ( size > 0 ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    // the providers behind the payload belong to the chip stack ...
+    chip::DeviceLayer::PlatformMgr().LockChipStack();
+
+    chip_error = GetQRCode( span, chip::RendezvousInformationFlags( chip::RendezvousInformationFlag::kBLE ) );
+
+    chip::DeviceLayer::PlatformMgr().UnlockChipStack();
+
+    ESP_GOTO_ON_FALSE( ( chip_error == CHIP_NO_ERROR ), ESP_FAIL, error, TAG, "GetQRCode failed: %" CHIP_ERROR_FORMAT, chip_error.Format() );
+
+    payload[span.size()] = '\0';
+
+    ESP_LOGI( TAG, "airshift_matter_get_qrcode_payload -> %s", payload );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_matter_get_qrcode_payload failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_matter_update( const airshift_matter_measurements_t *measurements )
+{
+    esp_err_t   ret         = ESP_FAIL;
+    bool        schedule    = false;
+    CHIP_ERROR  chip_error  = CHIP_NO_ERROR;
+
+    ESP_GOTO_ON_FALSE( ( measurements != NULL ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+    ESP_GOTO_ON_FALSE( ( endpoint_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    // the newest set wins, work already scheduled picks it up ...
+    pending_    = *measurements;
+    schedule    = !scheduled_;
+    scheduled_  = true;
+
+    stats_.updates++;
+    stats_.coalesced += ( schedule == true ) ? 0 : 1;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( schedule == false )
+    {
+        return ESP_OK;
+    }
+
+    chip_error = chip::DeviceLayer::PlatformMgr().ScheduleWork( update_work, 0 );
+
+    if( chip_error != CHIP_NO_ERROR )
+    {
+        portENTER_CRITICAL( &lock_ );
+        scheduled_ = false;
+        portEXIT_CRITICAL( &lock_ );
+    }
+
+    ESP_GOTO_ON_FALSE( ( chip_error == CHIP_NO_ERROR ), ESP_FAIL, error, TAG, "ScheduleWork failed: %" CHIP_ERROR_FORMAT, chip_error.Format() );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_matter_update failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_matter_get_stats( airshift_matter_stats_t *stats )
+{
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_set_reporting( airshift_matter_measurement_t measurement, const airshift_matter_reporting_t *reporting )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( ( measurement < AIRSHIFT_MATTER_MEASUREMENT_COUNT ) && ( reporting != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+    ESP_GOTO_ON_FALSE( ( ( reporting->reportable_change >= 0.0f ) && ( reporting->max_interval_ms >= reporting->min_interval_ms ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid reporting" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    reporting_[measurement] = *reporting;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_matter_set_reporting failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_matter_get_reporting( airshift_matter_measurement_t measurement, airshift_matter_reporting_t *reporting )
+{
+    ESP_RETURN_ON_FALSE( ( ( measurement < AIRSHIFT_MATTER_MEASUREMENT_COUNT ) && ( reporting != NULL ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *reporting = reporting_[measurement];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_matter_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_matter_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
 // Private functions
+static esp_err_t create_measurement_clusters( endpoint_t *endpoint )
+{
+    esp_err_t                                               ret                 = ESP_FAIL;
+    cluster::concentration_measurement::config_t            concentration_config;
+    cluster::temperature_measurement::config_t              temperature_config;
+    cluster::relative_humidity_measurement::config_t        humidity_config;
+
+    // numeric measurements in the air, every value starts out null until the first sample set ...
+    concentration_config.measurement_medium = chip::to_underlying( ConcentrationMeasurement::MeasurementMediumEnum::kAir );
+    concentration_config.feature_flags      = cluster::concentration_measurement::feature::numeric_measurement::get_id();
+
+    concentration_config.numeric_measurement.measurement_unit = chip::to_underlying( ConcentrationMeasurement::MeasurementUnitEnum::kPpm );
+
+    ESP_GOTO_ON_FALSE( ( cluster::carbon_dioxide_concentration_measurement::create( endpoint, &concentration_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "carbon_dioxide_concentration_measurement::create failed" );
+
+    concentration_config.numeric_measurement.measurement_unit = chip::to_underlying( ConcentrationMeasurement::MeasurementUnitEnum::kUgm3 );
+
+    ESP_GOTO_ON_FALSE( ( cluster::pm1_concentration_measurement::create( endpoint, &concentration_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "pm1_concentration_measurement::create failed" );
+    ESP_GOTO_ON_FALSE( ( cluster::pm25_concentration_measurement::create( endpoint, &concentration_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "pm25_concentration_measurement::create failed" );
+    ESP_GOTO_ON_FALSE( ( cluster::pm10_concentration_measurement::create( endpoint, &concentration_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "pm10_concentration_measurement::create failed" );
+
+    ESP_GOTO_ON_FALSE( ( cluster::temperature_measurement::create( endpoint, &temperature_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "temperature_measurement::create failed" );
+    ESP_GOTO_ON_FALSE( ( cluster::relative_humidity_measurement::create( endpoint, &humidity_config, CLUSTER_FLAG_SERVER ) != NULL ), ESP_FAIL, error, TAG, "relative_humidity_measurement::create failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "create_measurement_clusters failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+static void update_work( intptr_t arg )
+{
+    airshift_matter_measurements_t  measurements    = {};
+    airshift_matter_reporting_t     reporting[AIRSHIFT_MATTER_MEASUREMENT_COUNT];
+    esp_matter_attr_val_t           val             = {};
+    int64_t                         now             = esp_timer_get_time();
+    uint16_t                        endpoint_id     = 0;
+    uint32_t                        written         = 0;
+    uint32_t                        unchanged       = 0;
+    uint32_t                        held            = 0;
+    uint32_t                        suppressed      = 0;
+    bool                            valid           = false;
+    bool                            waiting         = false;
+
+    // chip thread, the stack lock is already held, every attribute below goes out in this one pass ...
+    portENTER_CRITICAL( &lock_ );
+
+    measurements    = pending_;
+    scheduled_      = false;
+
+    memcpy( reporting, reporting_, sizeof( reporting ) );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( endpoint_ == NULL )
+    {
+        return;
+    }
+
+    endpoint_id = endpoint::get_id( endpoint_ );
+
+    for( int i = 0; i < AIRSHIFT_MATTER_MEASUREMENT_COUNT; i++ )
+    {
+        valid = ( measurements.valid_mask & AIRSHIFT_MATTER_MEASUREMENT_BIT( i ) ) != 0;
+
+        encode( (airshift_matter_measurement_t)i, measurements.values[i], valid, &val );
+
+        // an unchanged value would only mark the attribute dirty for every subscriber ...
+        if( reported_[i].written && ( memcmp( &reported_[i].val.val, &val.val, sizeof( val.val ) ) == 0 ) )
+        {
+            unchanged++;
+
+            continue;
+        }
+
+        // ... and every write reaches every subscription, gate it before it gets into the store ...
+        if( due( &reported_[i], &reporting[i], measurements.values[i], valid, now, &waiting ) != true )
+        {
+            held        += ( waiting == true ) ? 1 : 0;
+            suppressed  += ( waiting == true ) ? 0 : 1;
+
+            continue;
+        }
+
+        if( attribute::update( endpoint_id, measurement_attributes_[i].cluster_id, measurement_attributes_[i].attribute_id, &val ) == ESP_OK )
+        {
+            reported_[i].written    = true;
+            reported_[i].valid      = valid;
+            reported_[i].value      = measurements.values[i];
+            reported_[i].time       = now;
+            reported_[i].val        = val;
+
+            written++;
+        }
+    }
+
+    // the fused air quality has hysteresis of its own, it goes out whenever it changes ...
+    if( measurements.air_quality != air_quality_ )
+    {
+        val = esp_matter_enum8( measurements.air_quality );
+
+        if( attribute::update( endpoint_id, AirQuality::Id, AirQuality::Attributes::AirQuality::Id, &val ) == ESP_OK )
+        {
+            air_quality_ = measurements.air_quality;
+
+            written++;
+        }
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.batches++;
+    stats_.attributes_written      += written;
+    stats_.attributes_unchanged    += unchanged;
+    stats_.attributes_held         += held;
+    stats_.attributes_suppressed   += suppressed;
+    stats_.reports                 += written * stats_.subscriptions;
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+static bool due( const reported_t *reported, const airshift_matter_reporting_t *reporting, float value, bool valid, int64_t now, bool *held )
+{
+    int64_t elapsed = now - reported->time;
+
+    *held = false;
+
+    // the very first value always goes out ...
+    if( reported->written != true )
+    {
+        return true;
+    }
+
+    if( elapsed < ( (int64_t)reporting->min_interval_ms * 1000 ) )
+    {
+        *held = true;
+
+        return false;
+    }
+
+    // ... a sensor dropping out or coming back is always worth a report, small moves only once the maximum interval is up ...
+    return ( valid != reported->valid ) || ( fabsf( value - reported->value ) >= reporting->reportable_change ) || ( elapsed >= ( (int64_t)reporting->max_interval_ms * 1000 ) );
+}
+
+static void encode( airshift_matter_measurement_t measurement, float value, bool valid, esp_matter_attr_val_t *val )
+{
+    switch( measurement_attributes_[measurement].encoding )
+    {
+        case ENCODING_CONCENTRATION:
+        {
+            *val = esp_matter_nullable_float( valid ? nullable<float>( value ) : nullable<float>() );
+            break;
+        }
+        case ENCODING_TEMPERATURE:
+        {
+            *val = esp_matter_nullable_int16( valid ? nullable<int16_t>( (int16_t)lroundf( value * 100.0f ) ) : nullable<int16_t>() );
+            break;
+        }
+        case ENCODING_HUMIDITY:
+        {
+            *val = esp_matter_nullable_uint16( valid ? nullable<uint16_t>( (uint16_t)lroundf( value * 100.0f ) ) : nullable<uint16_t>() );
+            break;
+        }
+    }
+}
+
+static void register_subscription_callback( intptr_t arg )
+{
+    chip::app::InteractionModelEngine::GetInstance()->RegisterReadHandlerAppCallback( &subscription_callback_ );
+}
+
+static int reporting_command( int argc, char **argv )
+{
+    airshift_matter_stats_t     stats           = {};
+    airshift_matter_reporting_t reporting       = {};
+    uint32_t                    free_heap       = esp_get_free_heap_size();
+    uint32_t                    heap_capacity   = 0;
+
+    airshift_matter_get_stats( &stats );
+
+    printf( "%-12s %10s %10s %10s\n", "measurement", "change", "min ms", "max ms" );
+
+    for( int i = 0; i < AIRSHIFT_MATTER_MEASUREMENT_COUNT; i++ )
+    {
+        airshift_matter_get_reporting( (airshift_matter_measurement_t)i, &reporting );
+
+        printf( "%-12s %10.2f %10lu %10lu\n", measurement_attributes_[i].name, reporting.reportable_change, reporting.min_interval_ms, reporting.max_interval_ms );
+    }
+
+    printf( "updates: %lu, coalesced: %lu, batches: %lu\n", stats.updates, stats.coalesced, stats.batches );
+    printf( "attributes: written: %lu, unchanged: %lu, held: %lu, suppressed: %lu\n", stats.attributes_written, stats.attributes_unchanged, stats.attributes_held, stats.attributes_suppressed );
+    printf( "reports: %lu, subscriptions: %lu ( max %lu, established %lu )\n", stats.reports, stats.subscriptions, stats.subscriptions_max, stats.subscriptions_established );
+
+    // what the remaining heap would still carry, the read handler pool is the other limit ...
+    heap_capacity = ( stats.subscription_heap_max > 0 ) ? ( free_heap / stats.subscription_heap_max ) : 0;
+
+    printf( "heap per subscription: last %lu, max %lu bytes, free heap: %lu bytes, room for ~%lu more, pool: %d subscriptions\n",
+        stats.subscription_heap_last, stats.subscription_heap_max, free_heap, heap_capacity, CHIP_IM_MAX_NUM_SUBSCRIPTIONS );
+
+    return 0;
+}
+
+CHIP_ERROR subscription_callback_t::OnSubscriptionRequested( chip::app::ReadHandler &handler, chip::Transport::SecureSession &session )
+{
+    // requests and their establishment do not overlap on a small device, the difference is what the subscription keeps ...
+    requested_heap_ = esp_get_free_heap_size();
+
+    return CHIP_NO_ERROR;
+}
+
+void subscription_callback_t::OnSubscriptionEstablished( chip::app::ReadHandler &handler )
+{
+    uint32_t free_heap  = esp_get_free_heap_size();
+    uint32_t cost       = ( requested_heap_ > free_heap ) ? ( requested_heap_ - free_heap ) : 0;
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.subscriptions++;
+    stats_.subscriptions_established++;
+    stats_.subscriptions_max        = ( stats_.subscriptions > stats_.subscriptions_max ) ? stats_.subscriptions : stats_.subscriptions_max;
+    stats_.subscription_heap_last   = cost;
+    stats_.subscription_heap_max    = ( cost > stats_.subscription_heap_max ) ? cost : stats_.subscription_heap_max;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    ESP_LOGI( TAG, "subscription established: %lu active, %lu bytes", stats_.subscriptions, cost );
+}
+
+void subscription_callback_t::OnSubscriptionTerminated( chip::app::ReadHandler &handler )
+{
+    // also called for subscribe requests that never got established ...
+    if( handler.IsActiveSubscription() != true )
+    {
+        return;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.subscriptions -= ( stats_.subscriptions > 0 ) ? 1 : 0;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    ESP_LOGI( TAG, "subscription terminated: %lu active", stats_.subscriptions );
+}
+
 static esp_err_t attribute_callback( attribute::callback_type_t type, uint16_t endpoint_id, uint32_t cluster_id, uint32_t attribute_id, esp_matter_attr_val_t *val, void *priv_data )
 {
     ESP_LOGE( TAG, "attribute_update_callback: attribute_id: %lu", attribute_id );
@@ -7,9 +7,70 @@
 extern "C" {
 #endif
 
+#define AIRSHIFT_MATTER_QRCODE_PAYLOAD_SIZE     64  // "MT:" and the base38 payload, with room for optional vendor data
+
+// One measurement cluster each on the air quality sensor endpoint ...
+typedef enum
+{
+    AIRSHIFT_MATTER_MEASUREMENT_CO2,            // ppm
+    AIRSHIFT_MATTER_MEASUREMENT_PM_1_0,         // ug/m3
+    AIRSHIFT_MATTER_MEASUREMENT_PM_2_5,
+    AIRSHIFT_MATTER_MEASUREMENT_PM_10_0,
+    AIRSHIFT_MATTER_MEASUREMENT_TEMPERATURE,    // degrees celsius
+    AIRSHIFT_MATTER_MEASUREMENT_HUMIDITY,       // % relative
+    AIRSHIFT_MATTER_MEASUREMENT_COUNT
+} airshift_matter_measurement_t;
+
+#define AIRSHIFT_MATTER_MEASUREMENT_BIT( measurement )  ( 1UL << ( measurement ) )
+
+typedef struct
+{
+    float       values[AIRSHIFT_MATTER_MEASUREMENT_COUNT];
+    uint32_t    valid_mask;     // AIRSHIFT_MATTER_MEASUREMENT_BIT, anything else is reported as null
+    uint8_t     air_quality;    // AirQualityEnum, airshift_air_quality_t carries the same values
+} airshift_matter_measurements_t;
+
+// When a new value is allowed into the attribute store, and from there into a report to every subscriber ...
+typedef struct
+{
+    float       reportable_change;  // in the measurement's unit, smaller moves are held back ...
+    uint32_t    min_interval_ms;    // ... no two writes closer together than this ...
+    uint32_t    max_interval_ms;    // ... unless this long has passed, then any change is written
+} airshift_matter_reporting_t;
+
+typedef struct
+{
+    uint32_t    updates;                    // airshift_matter_update calls
+    uint32_t    coalesced;                  // calls folded into work already scheduled on the chip thread
+    uint32_t    batches;                    // units of work run on the chip thread
+    uint32_t    attributes_written;
+    uint32_t    attributes_unchanged;
+    uint32_t    attributes_held;            // changed, but inside the minimum interval
+    uint32_t    attributes_suppressed;      // changed by less than the reportable change
+    uint32_t    reports;                    // attributes written times the subscriptions active at the time
+    uint32_t    subscriptions;              // active right now
+    uint32_t    subscriptions_max;
+    uint32_t    subscriptions_established;
+    uint32_t    subscription_heap_last;     // bytes gone from the heap between a subscribe request and the subscription being established
+    uint32_t    subscription_heap_max;
+} airshift_matter_stats_t;
+
 esp_err_t   airshift_matter_init();
 esp_err_t   airshift_matter_release();
 
+// The onboarding payload for the commissioning qrcode, passcode and discriminator come from the fctry partition, not a test payload ...
+esp_err_t   airshift_matter_get_qrcode_payload( char *payload, size_t size );
+
+// Any task, copies the measurements and schedules a single unit of work on the chip thread that writes every changed attribute,
+// a newer set replaces one that has not been written yet ...
+esp_err_t   airshift_matter_update( const airshift_matter_measurements_t *measurements );
+esp_err_t   airshift_matter_get_stats( airshift_matter_stats_t *stats );
+
+esp_err_t   airshift_matter_set_reporting( airshift_matter_measurement_t measurement, const airshift_matter_reporting_t *reporting );
+esp_err_t   airshift_matter_get_reporting( airshift_matter_measurement_t measurement, airshift_matter_reporting_t *reporting );
+
+esp_err_t   airshift_matter_register_console();
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,319 @@
+#include "airshift_metrics.h"
+
+#include <esp_timer.h>
+#include <esp_console.h>
+
+// log2 buckets split into 4 linear sub-buckets, exact below 4 us, anything past 33 s lands in the last one ...
+#define SUB_BUCKET_BITS     2
+#define SUB_BUCKETS         ( 1 << SUB_BUCKET_BITS )
+#define OCTAVES             23
+#define BUCKET_COUNT        ( SUB_BUCKETS * ( OCTAVES + 1 ) )
+
+typedef struct
+{
+    uint32_t    buckets[BUCKET_COUNT];
+    uint32_t    count;
+    int64_t     total;
+    int64_t     max;
+} histogram_t;
+
+static const char* TAG = "airshift_metrics";
+
+// Forward declarations
+static size_t       bucket_index( int64_t duration );
+static int64_t      bucket_upper( size_t index );
+static int64_t      percentile( const histogram_t *histogram, uint32_t per_mille );
+static int          metrics_command( int argc, char **argv );
+
+static const char *stage_names_[AIRSHIFT_METRICS_STAGE_COUNT] =
+{
+    [AIRSHIFT_METRICS_STAGE_PMS7003_READ]   = "pms7003",
+    [AIRSHIFT_METRICS_STAGE_SENSEAIR_READ]  = "senseair",
+    [AIRSHIFT_METRICS_STAGE_SHT30_READ]     = "sht30",
+    [AIRSHIFT_METRICS_STAGE_ACQUISITION]    = "acquisition",
+    [AIRSHIFT_METRICS_STAGE_HISTORY_APPEND] = "history",
+    [AIRSHIFT_METRICS_STAGE_UI_UPDATE]      = "ui",
+    [AIRSHIFT_METRICS_STAGE_UI_RENDER]      = "ui_render",
+    [AIRSHIFT_METRICS_STAGE_DISPLAY_FLUSH]  = "display_flush",
+    [AIRSHIFT_METRICS_STAGE_LED_UPDATE]     = "led",
+    [AIRSHIFT_METRICS_STAGE_MQTT_PUBLISH]   = "mqtt_publish",
+};
+
+static const char *counter_names_[AIRSHIFT_METRICS_COUNTER_COUNT] =
+{
+    [AIRSHIFT_METRICS_COUNTER_UART_TIMEOUTS]    = "uart_timeouts",
+    [AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS]  = "uart_crc_errors",
+    [AIRSHIFT_METRICS_COUNTER_UART_OVERFLOWS]   = "uart_overflows",
+    [AIRSHIFT_METRICS_COUNTER_I2C_NACKS]        = "i2c_nacks",
+    [AIRSHIFT_METRICS_COUNTER_I2C_TIMEOUTS]     = "i2c_timeouts",
+    [AIRSHIFT_METRICS_COUNTER_I2C_CRC_ERRORS]   = "i2c_crc_errors",
+    [AIRSHIFT_METRICS_COUNTER_MQTT_FAILURES]    = "mqtt_failures",
+};
+
+static const esp_console_cmd_t  command_        = { .command = "metrics", .help = "Stage latency percentiles and error counters, 'metrics reset' clears them", .hint = "[reset]", .func = &metrics_command };
+
+static portMUX_TYPE             lock_           = portMUX_INITIALIZER_UNLOCKED;
+static histogram_t              histograms_[AIRSHIFT_METRICS_STAGE_COUNT]   = { 0 };
+static uint32_t                 counters_[AIRSHIFT_METRICS_COUNTER_COUNT]   = { 0 };
+static int64_t                  since_          = 0;
+
+// Public functions
+esp_err_t airshift_metrics_init()
+{
+    ESP_LOGI( TAG, "airshift_metrics_init" );
+
+    airshift_metrics_reset();
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_metrics_release()
+{
+    ESP_LOGI( TAG, "airshift_metrics_release" );
+
+    return ESP_OK;
+}
+
+void airshift_metrics_record( airshift_metrics_stage_t stage, int64_t duration )
+{
+    size_t index = 0;
+
+    if( stage >= AIRSHIFT_METRICS_STAGE_COUNT )
+    {
+        return;
+    }
+
+    duration    = ( duration > 0 ) ? duration : 0;
+    index       = bucket_index( duration );
+
+    portENTER_CRITICAL( &lock_ );
+
+    histograms_[stage].buckets[index]++;
+    histograms_[stage].count++;
+    histograms_[stage].total   += duration;
+    histograms_[stage].max      = ( duration > histograms_[stage].max ) ? duration : histograms_[stage].max;
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+void airshift_metrics_count( airshift_metrics_counter_t counter )
+{
+    if( counter >= AIRSHIFT_METRICS_COUNTER_COUNT )
+    {
+        return;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    counters_[counter]++;
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+esp_err_t airshift_metrics_get_summary( airshift_metrics_stage_t stage, airshift_metrics_summary_t *summary )
+{
+    histogram_t histogram = { 0 };
+
+    if( ( stage >= AIRSHIFT_METRICS_STAGE_COUNT ) || ( summary == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // copy out, percentiles are worked out without holding the lock ...
+    portENTER_CRITICAL( &lock_ );
+
+    histogram = histograms_[stage];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    memset( summary, 0, sizeof( airshift_metrics_summary_t ) );
+
+    summary->count = histogram.count;
+
+    if( histogram.count == 0 )
+    {
+        return ESP_OK;
+    }
+
+    summary->p50    = percentile( &histogram, 500 );
+    summary->p99    = percentile( &histogram, 990 );
+    summary->max    = histogram.max;
+    summary->avg    = histogram.total / histogram.count;
+
+    return ESP_OK;
+}
+
+uint32_t airshift_metrics_get_counter( airshift_metrics_counter_t counter )
+{
+    uint32_t value = 0;
+
+    if( counter >= AIRSHIFT_METRICS_COUNTER_COUNT )
+    {
+        return 0;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    value = counters_[counter];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return value;
+}
+
+void airshift_metrics_reset()
+{
+    portENTER_CRITICAL( &lock_ );
+
+    memset( histograms_, 0, sizeof( histograms_ ) );
+    memset( counters_, 0, sizeof( counters_ ) );
+
+    since_ = esp_timer_get_time();
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+esp_err_t airshift_metrics_to_json( char *buffer, size_t buffer_size, size_t *length )
+{
+    esp_err_t                   ret     = ESP_FAIL;
+    airshift_metrics_summary_t  summary = { 0 };
+    size_t                      used    = 0;
+    int                         written = 0;
+
+    ESP_GOTO_ON_FALSE( ( ( buffer != NULL ) && ( length != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    written = snprintf( buffer, buffer_size, "{\"window\":%lld,\"stages\":{", ( esp_timer_get_time() - since_ ) / 1000 );
+
+    for( int i = 0; ( i < AIRSHIFT_METRICS_STAGE_COUNT ) && ( written >= 0 ) && ( ( used + written ) < buffer_size ); i++ )
+    {
+        used += written;
+
+        airshift_metrics_get_summary( i, &summary );
+
+        written = snprintf( &buffer[used], buffer_size - used, "%s\"%s\":{\"n\":%lu,\"p50\":%lld,\"p99\":%lld,\"max\":%lld}",
+            ( i > 0 ) ? "," : "", stage_names_[i], summary.count, summary.p50, summary.p99, summary.max );
+    }
+
+    for( int i = 0; ( i < AIRSHIFT_METRICS_COUNTER_COUNT ) && ( written >= 0 ) && ( ( used + written ) < buffer_size ); i++ )
+    {
+        used += written;
+
+        written = snprintf( &buffer[used], buffer_size - used, "%s\"%s\":%lu", ( i > 0 ) ? "," : "},\"counters\":{", counter_names_[i], airshift_metrics_get_counter( i ) );
+    }
+
+    if( ( written >= 0 ) && ( ( used + written ) < buffer_size ) )
+    {
+        used    += written;
+        written  = snprintf( &buffer[used], buffer_size - used, "}}" );
+    }
+
+    ESP_GOTO_ON_FALSE( ( ( written >= 0 ) && ( ( used + written ) < buffer_size ) ), ESP_ERR_INVALID_SIZE, error, TAG, "buffer too small" );
+
+    *length = used + written;
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_metrics_to_json failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_metrics_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_metrics_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_metrics_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static size_t bucket_index( int64_t duration )
+{
+    uint64_t    value   = (uint64_t)duration;
+    int         msb     = 0;
+    size_t      index   = 0;
+
+    if( value < SUB_BUCKETS )
+    {
+        return (size_t)value;
+    }
+
+    // octave from the top bit, sub-bucket from the two bits below it ...
+    msb     = 63 - __builtin_clzll( value );
+    index   = ( (size_t)( msb - SUB_BUCKET_BITS + 1 ) << SUB_BUCKET_BITS ) + (size_t)( ( value >> ( msb - SUB_BUCKET_BITS ) ) & ( SUB_BUCKETS - 1 ) );
+
+    return ( index < BUCKET_COUNT ) ? index : ( BUCKET_COUNT - 1 );
+}
+
+static int64_t bucket_upper( size_t index )
+{
+    int shift = 0;
+
+    if( index < SUB_BUCKETS )
+    {
+        return (int64_t)index;
+    }
+
+    shift = (int)( index >> SUB_BUCKET_BITS ) - 1;
+
+    return ( (int64_t)( SUB_BUCKETS + ( index & ( SUB_BUCKETS - 1 ) ) + 1 ) << shift ) - 1;
+}
+
+static int64_t percentile( const histogram_t *histogram, uint32_t per_mille )
+{
+    uint32_t rank       = (uint32_t)( ( ( (uint64_t)histogram->count * per_mille ) + 999 ) / 1000 );
+    uint32_t cumulative = 0;
+
+    for( size_t i = 0; i < BUCKET_COUNT; i++ )
+    {
+        cumulative += histogram->buckets[i];
+
+        if( cumulative >= rank )
+        {
+            // the bucket edge can overshoot what was actually seen ...
+            return ( bucket_upper( i ) < histogram->max ) ? bucket_upper( i ) : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+static int metrics_command( int argc, char **argv )
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    if( ( argc > 1 ) && ( strcmp( argv[1], "reset" ) == 0 ) )
+    {
+        airshift_metrics_reset();
+
+        return 0;
+    }
+
+    printf( "window: %lld s\n", ( esp_timer_get_time() - since_ ) / ( 1000 * 1000 ) );
+    printf( "%-14s %8s %10s %10s %10s %10s\n", "stage", "count", "p50 us", "p99 us", "max us", "avg us" );
+
+    for( int i = 0; i < AIRSHIFT_METRICS_STAGE_COUNT; i++ )
+    {
+        airshift_metrics_get_summary( i, &summary );
+
+        printf( "%-14s %8lu %10lld %10lld %10lld %10lld\n", stage_names_[i], summary.count, summary.p50, summary.p99, summary.max, summary.avg );
+    }
+
+    for( int i = 0; i < AIRSHIFT_METRICS_COUNTER_COUNT; i++ )
+    {
+        printf( "%-16s %8lu\n", counter_names_[i], airshift_metrics_get_counter( i ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef AIRSHIFT_METRICS_H
+#define AIRSHIFT_METRICS_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Timed stages of the sensing and publishing path ...
+typedef enum
+{
+    AIRSHIFT_METRICS_STAGE_PMS7003_READ,
+    AIRSHIFT_METRICS_STAGE_SENSEAIR_READ,
+    AIRSHIFT_METRICS_STAGE_SHT30_READ,
+    AIRSHIFT_METRICS_STAGE_ACQUISITION,     // trigger until the slowest sensor of the cycle completed
+    AIRSHIFT_METRICS_STAGE_HISTORY_APPEND,
+    AIRSHIFT_METRICS_STAGE_UI_UPDATE,       // publishing the values, the widgets are only touched on the lvgl task
+    AIRSHIFT_METRICS_STAGE_UI_RENDER,       // lvgl drawing and flushing a frame that had something invalidated
+    AIRSHIFT_METRICS_STAGE_DISPLAY_FLUSH,    // one area queued to the panel until its last pixel is out
+    AIRSHIFT_METRICS_STAGE_LED_UPDATE,
+    AIRSHIFT_METRICS_STAGE_MQTT_PUBLISH,    // one message handed to the mqtt client
+    AIRSHIFT_METRICS_STAGE_COUNT
+} airshift_metrics_stage_t;
+
+typedef enum
+{
+    AIRSHIFT_METRICS_COUNTER_UART_TIMEOUTS,
+    AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS,   // modbus crc and pms7003 checksum failures
+    AIRSHIFT_METRICS_COUNTER_UART_OVERFLOWS,
+    AIRSHIFT_METRICS_COUNTER_I2C_NACKS,
+    AIRSHIFT_METRICS_COUNTER_I2C_TIMEOUTS,
+    AIRSHIFT_METRICS_COUNTER_I2C_CRC_ERRORS,
+    AIRSHIFT_METRICS_COUNTER_MQTT_FAILURES,
+    AIRSHIFT_METRICS_COUNTER_COUNT
+} airshift_metrics_counter_t;
+
+// Percentiles are the upper edge of their histogram bucket, within 25% of the true value ...
+typedef struct
+{
+    uint32_t    count;
+    int64_t     p50;            // us
+    int64_t     p99;
+    int64_t     max;
+    int64_t     avg;
+} airshift_metrics_summary_t;
+
+esp_err_t   airshift_metrics_init();
+esp_err_t   airshift_metrics_release();
+
+// cheap enough for every hot path, durations come from esp_timer_get_time ...
+void        airshift_metrics_record( airshift_metrics_stage_t stage, int64_t duration );
+void        airshift_metrics_count( airshift_metrics_counter_t counter );
+
+esp_err_t   airshift_metrics_get_summary( airshift_metrics_stage_t stage, airshift_metrics_summary_t *summary );
+uint32_t    airshift_metrics_get_counter( airshift_metrics_counter_t counter );
+void        airshift_metrics_reset();
+
+// json for the diagnostics topic, every stage summary and counter ...
+esp_err_t   airshift_metrics_to_json( char *buffer, size_t buffer_size, size_t *length );
+
+// adds the "metrics" command to an initialized esp_console ...
+esp_err_t   airshift_metrics_register_console();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_METRICS_H
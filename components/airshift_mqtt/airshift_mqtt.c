@@ -1,20 +1,90 @@
 #include "airshift_mqtt.h"
 #include "airshift_common.h"
+#include "airshift_event.h"
+#include "airshift_metrics.h"
+#include "airshift_power.h"
 
 #include <esp_netif.h>
+#include <esp_timer.h>
 #include <mqtt_client.h>
+#include <stdlib.h>
+#include <freertos/semphr.h>
 
-#define MQTT_URI    "mqtt://mqtt.airshift.app"
-// #define MQTT_URI    "mqtt://192.168.1.250"
-#define MQTT_PORT   1883
+#define MQTT_URI                "mqtt://mqtt.airshift.app"
+// #define MQTT_URI                "mqtt://192.168.1.250"
+#define MQTT_PORT               1883
+
+// messages waiting to be handed to the client, hard limits ...
+#define MQTT_QUEUE_MAX_MESSAGES 32
+#define MQTT_QUEUE_MAX_BYTES    ( 16 * 1024 )
+
+// qos 1 messages handed to the client but not yet acknowledged, bounds the esp-mqtt outbox ...
+#define MQTT_INFLIGHT_WINDOW    4
+#define MQTT_ACK_TIMEOUT_US     ( 30 * 1000 * 1000 )
+
+typedef struct
+{
+    const char                  *prefix;
+    const char                  *suffix;
+    int                         qos;
+    airshift_mqtt_policy_t      policy;
+} topic_policy_t;
+
+typedef struct
+{
+    char        *topic;         // topic and message share one allocation
+    char        *message;
+    size_t      message_len;
+    size_t      bytes;
+    int         qos;
+    int         ticket;
+} entry_t;
+
+typedef struct
+{
+    int         msg_id;
+    int         ticket;
+    int64_t     sent_at;
+} inflight_t;
 
 static const char* TAG = "airshift_mqtt";
 
 // Forward declarations
-static void mqtt_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data );
+static void                 mqtt_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data );
+static const topic_policy_t *find_policy( const char *topic );
+static bool                 enqueue( const char *topic, const char *message, size_t message_len, const topic_policy_t *policy, int ticket );
+static void                 drop_head();
+static void                 dispatch();
+static void                 acknowledge( int msg_id );
+static int                  complete( inflight_t *slot );
+static void                 post_published( int ticket );
+static size_t               publish_packet_size( size_t topic_len, size_t message_len, int qos );
+
+// first match wins, the last entry catches everything else ...
+static const topic_policy_t policies_[] =
+{
+    { .prefix = "telemetry/",   .suffix = "/backfill",  .qos = 1,   .policy = AIRSHIFT_MQTT_POLICY_DROP_NEWEST },    // outbox retries whatever is rejected
+    { .prefix = "telemetry/",   .suffix = NULL,         .qos = 1,   .policy = AIRSHIFT_MQTT_POLICY_DROP_OLDEST },
+    { .prefix = "co2/",         .suffix = NULL,         .qos = 0,   .policy = AIRSHIFT_MQTT_POLICY_COALESCE },
+    { .prefix = "temp/",        .suffix = NULL,         .qos = 0,   .policy = AIRSHIFT_MQTT_POLICY_COALESCE },
+    { .prefix = "rh/",          .suffix = NULL,         .qos = 0,   .policy = AIRSHIFT_MQTT_POLICY_COALESCE },
+    { .prefix = "pm2.5/",       .suffix = NULL,         .qos = 0,   .policy = AIRSHIFT_MQTT_POLICY_COALESCE },
+    { .prefix = "diag/",        .suffix = NULL,         .qos = 0,   .policy = AIRSHIFT_MQTT_POLICY_COALESCE },     // only the latest snapshot matters
+    { .prefix = "",             .suffix = NULL,         .qos = 1,   .policy = AIRSHIFT_MQTT_POLICY_DROP_OLDEST },
+};
 
 static char                     client_id_[32]          = { 0 };
 static esp_mqtt_client_handle_t esp_mqtt_client_handle_ = NULL;
+static volatile bool            connected_              = false;
+static SemaphoreHandle_t        mutex_                  = NULL;
+static entry_t                  queue_[MQTT_QUEUE_MAX_MESSAGES] = { 0 };
+static uint32_t                 queue_head_             = 0;
+static inflight_t               inflight_[MQTT_INFLIGHT_WINDOW] = { 0 };
+static int                      early_acks_[MQTT_INFLIGHT_WINDOW] = { 0 };   // PUBACKs handled before the client returned their msg_id
+static uint32_t                 early_ack_next_         = 0;
+static int                      next_ticket_            = 1;
+static int64_t                  ack_latency_total_      = 0;
+static airshift_mqtt_stats_t    stats_                  = { 0 };
 
 // Public functions
 esp_err_t airshift_mqtt_init()
@@ -28,6 +98,20 @@ esp_err_t airshift_mqtt_init()
 
     ESP_GOTO_ON_ERROR( airshift_get_mac_address( client_id_, NULL ), error, TAG, "get_mac_address failed" );
 
+    memset( &stats_, 0, sizeof( stats_ ) );
+    memset( queue_, 0, sizeof( queue_ ) );
+    memset( inflight_, 0, sizeof( inflight_ ) );
+    memset( early_acks_, 0, sizeof( early_acks_ ) );
+
+    stats_.since        = esp_timer_get_time();
+    queue_head_         = 0;
+    early_ack_next_     = 0;
+    ack_latency_total_  = 0;
+
+    mutex_ = xSemaphoreCreateMutex();
+
+    ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xSemaphoreCreateMutex failed" );
+
     esp_mqtt_client_config.broker.address.uri       = MQTT_URI;
     esp_mqtt_client_config.broker.address.port      = MQTT_PORT;
     esp_mqtt_client_config.credentials.client_id    = client_id_;
@@ -63,6 +147,18 @@ esp_err_t airshift_mqtt_release()
         esp_mqtt_client_handle_ = NULL;
     }
 
+    if( mutex_ != NULL )
+    {
+        while( stats_.queue_depth > 0 )
+        {
+            drop_head();
+        }
+
+        vSemaphoreDelete( mutex_ );
+
+        mutex_ = NULL;
+    }
+
     return ESP_OK;
 }
 
@@ -80,14 +176,39 @@ esp_err_t airshift_mqtt_start()
 
 esp_err_t airshift_mqtt_publish( const char *topic, const char *message, size_t message_len )
 {
-    ESP_LOGI( TAG, "airshift_mqtt_publish -> topic: %s, message: %s", topic, message );
+    return airshift_mqtt_publish_tracked( topic, message, message_len, NULL );
+}
 
-    if( esp_mqtt_client_handle_ != NULL )
+esp_err_t airshift_mqtt_publish_tracked( const char *topic, const char *message, size_t message_len, int *msg_id )
+{
+    const topic_policy_t    *policy = find_policy( topic );
+    bool                    queued  = false;
+    int                     ticket  = 0;
+
+    // payload may be binary, never print it ...
+    ESP_LOGI( TAG, "airshift_mqtt_publish -> topic: %s, length: %u, qos: %d", topic, message_len, policy->qos );
+
+    if( ( esp_mqtt_client_handle_ == NULL ) || ( mutex_ == NULL ) )
     {
-        return esp_mqtt_client_publish( esp_mqtt_client_handle_, topic, message, message_len, 1, 0 );
+        return ESP_FAIL;
     }
 
-    return ESP_FAIL;
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    ticket          = next_ticket_;
+    next_ticket_    = ( next_ticket_ == INT32_MAX ) ? 1 : ( next_ticket_ + 1 );
+    queued          = enqueue( topic, message, message_len, policy, ticket );
+
+    xSemaphoreGive( mutex_ );
+
+    if( msg_id != NULL )
+    {
+        *msg_id = ticket;
+    }
+
+    dispatch();
+
+    return queued ? ESP_OK : ESP_ERR_NO_MEM;
 }
 
 const char *airshift_mqtt_get_client_id()
@@ -95,9 +216,32 @@ const char *airshift_mqtt_get_client_id()
     return client_id_;
 }
 
+bool airshift_mqtt_is_connected()
+{
+    return connected_;
+}
+
+esp_err_t airshift_mqtt_get_stats( airshift_mqtt_stats_t *stats )
+{
+    if( ( stats == NULL ) || ( mutex_ == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    *stats = stats_;
+
+    xSemaphoreGive( mutex_ );
+
+    return ESP_OK;
+}
+
 // Private functions
 static void mqtt_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data )
 {
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
     switch( event_id )
     {
         case MQTT_EVENT_BEFORE_CONNECT:
@@ -108,16 +252,32 @@ static void mqtt_event_handler( void *handler_args, esp_event_base_t base, int32
         case MQTT_EVENT_CONNECTED:
         {
             ESP_LOGI( TAG, "MQTT_EVENT_CONNECTED" );
+
+            connected_ = true;
+
+            ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_post( AIRSHIFT_EVENT_MQTT, AIRSHIFT_EVENT_MQTT_CONNECTED, NULL, 0, portMAX_DELAY ) );
+
+            // whatever queued up while we were away ...
+            dispatch();
             break;
         }
         case MQTT_EVENT_DISCONNECTED:
         {
             ESP_LOGI( TAG, "MQTT_EVENT_DISCONNECTED" );
+
+            connected_ = false;
+
+            ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_post( AIRSHIFT_EVENT_MQTT, AIRSHIFT_EVENT_MQTT_DISCONNECTED, NULL, 0, portMAX_DELAY ) );
             break;
         }
         case MQTT_EVENT_PUBLISHED:
         {
-            ESP_LOGI( TAG, "MQTT_EVENT_PUBLISHED" );
+            ESP_LOGI( TAG, "MQTT_EVENT_PUBLISHED -> msg_id: %d", event->msg_id );
+
+            acknowledge( event->msg_id );
+
+            // a window slot just opened up ...
+            dispatch();
             break;
         }
         default:
@@ -127,3 +287,350 @@ static void mqtt_event_handler( void *handler_args, esp_event_base_t base, int32
         }
     }
 }
+
+static const topic_policy_t *find_policy( const char *topic )
+{
+    size_t topic_len = strlen( topic );
+
+    for( size_t i = 0; i < ( sizeof( policies_ ) / sizeof( policies_[0] ) ) - 1; i++ )
+    {
+        size_t prefix_len = strlen( policies_[i].prefix );
+        size_t suffix_len = ( policies_[i].suffix != NULL ) ? strlen( policies_[i].suffix ) : 0;
+
+        if( strncmp( topic, policies_[i].prefix, prefix_len ) != 0 )
+        {
+            continue;
+        }
+
+        if( ( suffix_len > 0 ) && ( ( topic_len < ( prefix_len + suffix_len ) ) || ( strcmp( &topic[topic_len - suffix_len], policies_[i].suffix ) != 0 ) ) )
+        {
+            continue;
+        }
+
+        return &policies_[i];
+    }
+
+    return &policies_[( sizeof( policies_ ) / sizeof( policies_[0] ) ) - 1];
+}
+
+static bool enqueue( const char *topic, const char *message, size_t message_len, const topic_policy_t *policy, int ticket )
+{
+    size_t      topic_len   = strlen( topic );
+    size_t      bytes       = topic_len + 1 + message_len;
+    entry_t     *entry      = NULL;
+    char        *buffer     = NULL;
+
+    if( bytes > MQTT_QUEUE_MAX_BYTES )
+    {
+        stats_.dropped_newest++;
+
+        return false;
+    }
+
+    // coalesce, a queued message for the same metric is simply replaced by the newer one ...
+    if( policy->policy == AIRSHIFT_MQTT_POLICY_COALESCE )
+    {
+        for( uint32_t i = 0; i < stats_.queue_depth; i++ )
+        {
+            entry_t *queued = &queue_[( queue_head_ + i ) % MQTT_QUEUE_MAX_MESSAGES];
+
+            if( ( queued->topic != NULL ) && ( strcmp( queued->topic, topic ) == 0 ) )
+            {
+                stats_.queue_bytes -= queued->bytes;
+                stats_.coalesced++;
+
+                free( queued->topic );
+
+                entry = queued;
+
+                break;
+            }
+        }
+    }
+
+    while( ( entry == NULL ) && ( ( stats_.queue_depth >= MQTT_QUEUE_MAX_MESSAGES ) || ( ( stats_.queue_bytes + bytes ) > MQTT_QUEUE_MAX_BYTES ) ) )
+    {
+        if( policy->policy == AIRSHIFT_MQTT_POLICY_DROP_NEWEST )
+        {
+            stats_.dropped_newest++;
+
+            return false;
+        }
+
+        drop_head();
+
+        stats_.dropped_oldest++;
+    }
+
+    buffer = malloc( bytes );
+
+    if( buffer == NULL )
+    {
+        // a coalesced slot was already freed, give it up entirely ...
+        if( entry != NULL )
+        {
+            entry->topic    = NULL;
+            entry->bytes    = 0;
+        }
+
+        stats_.dropped_newest++;
+
+        return false;
+    }
+
+    if( entry == NULL )
+    {
+        entry = &queue_[( queue_head_ + stats_.queue_depth ) % MQTT_QUEUE_MAX_MESSAGES];
+
+        stats_.queue_depth++;
+    }
+
+    memcpy( buffer, topic, topic_len + 1 );
+    memcpy( &buffer[topic_len + 1], message, message_len );
+
+    entry->topic        = buffer;
+    entry->message      = &buffer[topic_len + 1];
+    entry->message_len  = message_len;
+    entry->bytes        = bytes;
+    entry->qos          = policy->qos;
+    entry->ticket       = ticket;
+
+    stats_.queue_bytes     += bytes;
+    stats_.queue_bytes_max  = ( stats_.queue_bytes > stats_.queue_bytes_max ) ? stats_.queue_bytes : stats_.queue_bytes_max;
+    stats_.queue_depth_max  = ( stats_.queue_depth > stats_.queue_depth_max ) ? stats_.queue_depth : stats_.queue_depth_max;
+
+    return true;
+}
+
+static void drop_head()
+{
+    entry_t *entry = &queue_[queue_head_];
+
+    stats_.queue_bytes -= entry->bytes;
+    stats_.queue_depth--;
+
+    free( entry->topic );
+
+    memset( entry, 0, sizeof( entry_t ) );
+
+    queue_head_ = ( queue_head_ + 1 ) % MQTT_QUEUE_MAX_MESSAGES;
+}
+
+static void dispatch()
+{
+    entry_t     entry   = { 0 };
+    inflight_t  *slot   = NULL;
+    int64_t     now     = 0;
+    int64_t     started = 0;
+    int         msg_id  = -1;
+    int         ticket  = 0;
+
+    if( ( esp_mqtt_client_handle_ == NULL ) || ( mutex_ == NULL ) )
+    {
+        return;
+    }
+
+    // everything queued goes out back to back, one radio wakeup for the burst instead of one per message ...
+    airshift_power_lock( AIRSHIFT_POWER_LOCK_NETWORK );
+
+    while( connected_ )
+    {
+        slot    = NULL;
+        ticket  = 0;
+        now     = esp_timer_get_time();
+
+        xSemaphoreTake( mutex_, portMAX_DELAY );
+
+        // a message the client gave up on must not hold its window slot forever ...
+        for( int i = 0; i < MQTT_INFLIGHT_WINDOW; i++ )
+        {
+            if( ( inflight_[i].ticket != 0 ) && ( ( now - inflight_[i].sent_at ) > MQTT_ACK_TIMEOUT_US ) )
+            {
+                memset( &inflight_[i], 0, sizeof( inflight_t ) );
+
+                stats_.inflight--;
+                stats_.ack_timeouts++;
+            }
+        }
+
+        // skip holes left by a coalesced entry that could not be reallocated ...
+        while( ( stats_.queue_depth > 0 ) && ( queue_[queue_head_].topic == NULL ) )
+        {
+            drop_head();
+        }
+
+        if( stats_.queue_depth == 0 )
+        {
+            xSemaphoreGive( mutex_ );
+
+            break;
+        }
+
+        if( queue_[queue_head_].qos > 0 )
+        {
+            for( int i = 0; ( i < MQTT_INFLIGHT_WINDOW ) && ( slot == NULL ); i++ )
+            {
+                slot = ( inflight_[i].ticket == 0 ) ? &inflight_[i] : NULL;
+            }
+
+            if( slot == NULL )
+            {
+                xSemaphoreGive( mutex_ );
+
+                break;
+            }
+
+            // reserve the slot, so a concurrent dispatch cannot overfill the window ...
+            slot->ticket    = queue_[queue_head_].ticket;
+            slot->msg_id    = -1;
+            slot->sent_at   = now;
+            stats_.inflight++;
+        }
+
+        // take the message out, the client is never called with our mutex held ...
+        entry                           = queue_[queue_head_];
+        queue_[queue_head_].topic       = NULL;
+        stats_.queue_bytes             -= entry.bytes;
+        stats_.queue_depth--;
+        queue_head_                     = ( queue_head_ + 1 ) % MQTT_QUEUE_MAX_MESSAGES;
+
+        xSemaphoreGive( mutex_ );
+
+        started = esp_timer_get_time();
+        msg_id  = esp_mqtt_client_publish( esp_mqtt_client_handle_, entry.topic, entry.message, entry.message_len, entry.qos, 0 );
+
+        airshift_metrics_record( AIRSHIFT_METRICS_STAGE_MQTT_PUBLISH, esp_timer_get_time() - started );
+
+        xSemaphoreTake( mutex_, portMAX_DELAY );
+
+        if( msg_id < 0 )
+        {
+            stats_.publish_failures++;
+
+            airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_MQTT_FAILURES );
+
+            if( slot != NULL )
+            {
+                memset( slot, 0, sizeof( inflight_t ) );
+
+                stats_.inflight--;
+            }
+        }
+        else
+        {
+            stats_.publishes++;
+            stats_.payload_bytes   += entry.message_len;
+            stats_.wire_bytes      += publish_packet_size( strlen( entry.topic ), entry.message_len, entry.qos );
+
+            if( slot != NULL )
+            {
+                slot->msg_id = msg_id;
+
+                // the mqtt task may have handled the PUBACK while the client still had the message ...
+                for( int i = 0; i < MQTT_INFLIGHT_WINDOW; i++ )
+                {
+                    if( early_acks_[i] == msg_id )
+                    {
+                        early_acks_[i]  = 0;
+                        ticket          = complete( slot );
+
+                        break;
+                    }
+                }
+            }
+
+            // qos 0 is done once it is on the wire ...
+            ticket = ( entry.qos == 0 ) ? entry.ticket : ticket;
+        }
+
+        xSemaphoreGive( mutex_ );
+
+        free( entry.topic );
+
+        if( ticket != 0 )
+        {
+            post_published( ticket );
+        }
+
+        if( msg_id < 0 )
+        {
+            break;
+        }
+    }
+
+    airshift_power_unlock( AIRSHIFT_POWER_LOCK_NETWORK );
+}
+
+static void acknowledge( int msg_id )
+{
+    bool    waiting = false;
+    int     ticket  = 0;
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    for( int i = 0; ( i < MQTT_INFLIGHT_WINDOW ) && ( ticket == 0 ); i++ )
+    {
+        if( ( inflight_[i].ticket != 0 ) && ( inflight_[i].msg_id == msg_id ) )
+        {
+            ticket = complete( &inflight_[i] );
+        }
+
+        waiting |= ( ( inflight_[i].ticket != 0 ) && ( inflight_[i].msg_id < 0 ) );
+    }
+
+    // no slot has it yet, a dispatch still waiting on esp_mqtt_client_publish claims it once it has the msg_id ...
+    if( ( ticket == 0 ) && waiting )
+    {
+        early_acks_[early_ack_next_]    = msg_id;
+        early_ack_next_                 = ( early_ack_next_ + 1 ) % MQTT_INFLIGHT_WINDOW;
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    if( ticket != 0 )
+    {
+        post_published( ticket );
+    }
+}
+
+// Mutex held, frees the window slot and returns the ticket it carried ...
+static int complete( inflight_t *slot )
+{
+    int64_t latency = esp_timer_get_time() - slot->sent_at;
+    int     ticket  = slot->ticket;
+
+    ack_latency_total_ += latency;
+
+    stats_.acks++;
+
+    stats_.ack_latency_last = latency;
+    stats_.ack_latency_max  = ( latency > stats_.ack_latency_max ) ? latency : stats_.ack_latency_max;
+    stats_.ack_latency_avg  = ack_latency_total_ / stats_.acks;
+    stats_.inflight--;
+
+    memset( slot, 0, sizeof( inflight_t ) );
+
+    return ticket;
+}
+
+static void post_published( int ticket )
+{
+    ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_post( AIRSHIFT_EVENT_MQTT, AIRSHIFT_EVENT_MQTT_PUBLISHED, &ticket, sizeof( ticket ), portMAX_DELAY ) );
+}
+
+static size_t publish_packet_size( size_t topic_len, size_t message_len, int qos )
+{
+    // topic length prefix, topic, packet identifier ( qos > 0 ) and payload ...
+    size_t length       = 2 + topic_len + ( ( qos > 0 ) ? 2 : 0 ) + message_len;
+    size_t remaining    = length;
+    size_t header       = 1;
+
+    // ... plus the fixed header byte and a 7 bit per byte remaining length ...
+    do
+    {
+        header++;
+        remaining >>= 7;
+    } while( remaining > 0 );
+
+    return header + length;
+}
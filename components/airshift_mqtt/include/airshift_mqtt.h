@@ -7,12 +7,49 @@
 extern "C" {
 #endif
 
+// what happens when a message does not fit the queue, chosen per topic ...
+typedef enum
+{
+    AIRSHIFT_MQTT_POLICY_DROP_OLDEST,   // evict queued messages, oldest first, until it fits
+    AIRSHIFT_MQTT_POLICY_DROP_NEWEST,   // reject the message being published
+    AIRSHIFT_MQTT_POLICY_COALESCE,      // replace a queued message on the same topic, otherwise drop oldest
+} airshift_mqtt_policy_t;
+
+typedef struct
+{
+    uint32_t    publishes;          // messages handed to the client
+    uint32_t    publish_failures;
+    uint32_t    acks;               // PUBACKs received
+    uint64_t    payload_bytes;
+    uint64_t    wire_bytes;         // PUBLISH packets as sent, including fixed and variable headers
+    int64_t     since;              // counting started ( esp_timer_get_time base, us )
+
+    uint32_t    queue_depth;        // messages waiting for a window slot or a connection
+    uint32_t    queue_depth_max;
+    uint32_t    queue_bytes;
+    uint32_t    queue_bytes_max;
+    uint32_t    inflight;           // qos 1 messages awaiting PUBACK
+    uint32_t    dropped_oldest;
+    uint32_t    dropped_newest;
+    uint32_t    coalesced;
+    uint32_t    ack_timeouts;       // in flight messages given up on
+
+    int64_t     ack_latency_last;   // client publish until PUBACK ( us )
+    int64_t     ack_latency_max;
+    int64_t     ack_latency_avg;
+} airshift_mqtt_stats_t;
+
 esp_err_t   airshift_mqtt_init();
 esp_err_t   airshift_mqtt_release();
 
 esp_err_t   airshift_mqtt_start();
+// queued, qos and overflow policy come from the topic, ESP_ERR_NO_MEM when the policy rejected it ...
 esp_err_t   airshift_mqtt_publish( const char *topic, const char *message, size_t message_len );
+// msg_id receives the id reported by AIRSHIFT_EVENT_MQTT_PUBLISHED once the broker acknowledges ( qos 1 ) or the message is sent ( qos 0 ) ...
+esp_err_t   airshift_mqtt_publish_tracked( const char *topic, const char *message, size_t message_len, int *msg_id );
+bool        airshift_mqtt_is_connected();
 const char  *airshift_mqtt_get_client_id();
+esp_err_t   airshift_mqtt_get_stats( airshift_mqtt_stats_t *stats );
 
 #ifdef __cplusplus
 }
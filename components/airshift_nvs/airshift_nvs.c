@@ -1,9 +1,70 @@
 #include "airshift_nvs.h"
+#include "airshift_trace.h"
+
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <stdlib.h>
+
+#define NAMESPACES_MAX          8       // handles kept open, one per namespace
+#define PENDING_MAX             16      // distinct keys waiting for the flash, a full table is written out at once
+
+#define COMMIT_DELAY_US         ( 2 * 1000 * 1000 )     // writes wait at least this long, so repeated writes to a key reach the flash once ...
+#define COMMIT_DEADLINE_US      ( 10 * 1000 * 1000 )    // ... and at most this long, when nobody offers a quiet slot
+
+#define COMMIT_TASK_STACK_SIZE  3072
+#define COMMIT_TASK_PRIORITY    1                       // below everything else, it only runs when nobody offered a quiet slot
+
+typedef enum
+{
+    OPERATION_NONE,
+    OPERATION_SET_INT16,
+    OPERATION_SET_INT32,
+    OPERATION_SET_STRING,
+    OPERATION_SET_BLOB,
+    OPERATION_ERASE
+} operation_t;
+
+typedef struct
+{
+    char            name[NVS_KEY_NAME_MAX_SIZE];
+    nvs_handle_t    handle;         // 0 until first used
+    nvs_open_mode_t mode;           // read only until something is written to it
+} namespace_t;
+
+typedef struct
+{
+    operation_t     operation;
+    uint8_t         space;          // index into namespaces_
+    char            key[NVS_KEY_NAME_MAX_SIZE];
+    int32_t         integer;
+    void            *data;          // heap copy of a string, terminator included, or a blob
+    size_t          length;
+} pending_t;
 
 static const char* TAG = "airshift_nvs";
 
 // Forward declarations
-esp_err_t commit_and_close( nvs_handle_t nvs_handle );
+static void         commit_timer_callback( void* arguments );
+static void         commit_task( void* arguments );
+static esp_err_t    find_namespace( const char* namespace, bool create, uint8_t *space );
+static esp_err_t    open_namespace( uint8_t space, nvs_open_mode_t mode );
+static pending_t*   find_pending( uint8_t space, const char* key );
+static esp_err_t    write_pending( const char* namespace, const char* key, operation_t operation, int32_t integer, const void* data, size_t length );
+static esp_err_t    read_pending( const char* namespace, const char* key, operation_t operation, int32_t* integer, void* data, size_t* length, uint8_t *space );
+static esp_err_t    flush();
+static void         close_all();
+
+static const esp_timer_create_args_t    commit_timer_args_  = { .callback = &commit_timer_callback, .name = "nvs-commit" };
+
+static SemaphoreHandle_t    mutex_                          = NULL;
+static esp_timer_handle_t   commit_timer_                   = NULL;
+static TaskHandle_t         commit_task_                    = NULL;
+static namespace_t          namespaces_[NAMESPACES_MAX]     = { 0 };
+static pending_t            pending_[PENDING_MAX]           = { 0 };
+static size_t               pending_count_                  = 0;
+static int64_t              pending_since_                  = 0;    // first write of the current batch
+static portMUX_TYPE         lock_                           = portMUX_INITIALIZER_UNLOCKED;
+static airshift_nvs_stats_t stats_                          = { 0 };
 
 // Public functions
 esp_err_t airshift_nvs_init()
@@ -11,7 +72,7 @@ esp_err_t airshift_nvs_init()
     esp_err_t ret = ESP_FAIL;
 
     ESP_LOGI( TAG, "airshift_nvs_init" );
-    
+
     ret = nvs_flash_init();
     
     if( ( ret == ESP_ERR_NVS_NO_FREE_PAGES ) || ( ret == ESP_ERR_NVS_NEW_VERSION_FOUND ) )
@@ -23,6 +84,23 @@ esp_err_t airshift_nvs_init()
 
     ESP_GOTO_ON_ERROR( ret, error, TAG, "nvs_flash_init failed" );
 
+    if( mutex_ == NULL )
+    {
+        mutex_ = xSemaphoreCreateMutex();
+
+        ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xSemaphoreCreateMutex failed" );
+    }
+
+    if( commit_task_ == NULL )
+    {
+        ESP_GOTO_ON_FALSE( ( xTaskCreate( commit_task, "nvs_commit_task", COMMIT_TASK_STACK_SIZE, NULL, COMMIT_TASK_PRIORITY, &commit_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate failed" );
+    }
+
+    if( commit_timer_ == NULL )
+    {
+        ESP_GOTO_ON_ERROR( esp_timer_create( &commit_timer_args_, &commit_timer_ ), error, TAG, "esp_timer_create failed" );
+    }
+
     return ESP_OK;
 
 error:
@@ -58,6 +136,34 @@ esp_err_t airshift_nvs_release()
     esp_err_t ret = ESP_FAIL;
 
     ESP_LOGI( TAG, "airshift_nvs_release" );
+
+    // nothing written may be lost, whatever is still pending goes out now ...
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_nvs_flush() );
+
+    if( commit_timer_ != NULL )
+    {
+        esp_timer_stop( commit_timer_ );
+        esp_timer_delete( commit_timer_ );
+
+        commit_timer_ = NULL;
+    }
+
+    if( mutex_ != NULL )
+    {
+        xSemaphoreTake( mutex_, portMAX_DELAY );
+
+        // with the mutex held the commit task is not in the middle of a flush ...
+        if( commit_task_ != NULL )
+        {
+            vTaskDelete( commit_task_ );
+
+            commit_task_ = NULL;
+        }
+
+        close_all();
+
+        xSemaphoreGive( mutex_ );
+    }
     
     ESP_GOTO_ON_ERROR( nvs_flash_deinit(), error, TAG, "nvs_flash_deinit failed" );
 
@@ -76,6 +182,20 @@ esp_err_t airshift_nvs_format()
 
     ESP_LOGI( TAG, "airshift_nvs_format" );
 
+    // pending writes and open handles belong to the partition about to be erased ...
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    for( size_t i = 0; i < pending_count_; i++ )
+    {
+        free( pending_[i].data );
+    }
+
+    pending_count_ = 0;
+
+    close_all();
+
+    xSemaphoreGive( mutex_ );
+
     ESP_GOTO_ON_ERROR( nvs_flash_erase(), error, TAG, "nvs_flash_erase failed" );
 
     return airshift_nvs_init();
@@ -89,360 +209,643 @@ error:
 
 esp_err_t airshift_nvs_write_string( const char* namespace, const char* key, const char* value )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
-
     ESP_LOGI( TAG, "airshift_nvs_write_string" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    return write_pending( namespace, key, OPERATION_SET_STRING, 0, value, strlen( value ) + 1 );
+}
 
-    ESP_GOTO_ON_ERROR( nvs_set_str( nvs_handle, key, value ), error, TAG, "nvs_set_str failed" );
+esp_err_t airshift_nvs_write_int16( const char* namespace, const char* key, int16_t value )
+{
+    ESP_LOGI( TAG, "airshift_nvs_write_int16" );
 
-    return commit_and_close( nvs_handle );
+    return write_pending( namespace, key, OPERATION_SET_INT16, value, NULL, 0 );
+}
 
-error:
+esp_err_t airshift_nvs_write_int32( const char* namespace, const char* key, int32_t value )
+{
+    ESP_LOGI( TAG, "airshift_nvs_write_int32" );
 
-    ESP_LOGE( TAG, "airshift_nvs_write_string failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    return write_pending( namespace, key, OPERATION_SET_INT32, value, NULL, 0 );
+}
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
-    {
-        nvs_close( nvs_handle );
-    }
+esp_err_t airshift_nvs_write_blob( const char* namespace, const char* key, const void* value, size_t length )
+{
+    ESP_LOGI( TAG, "airshift_nvs_write_blob" );
 
-    return ret;
+    return write_pending( namespace, key, OPERATION_SET_BLOB, 0, value, length );
 }
 
-esp_err_t airshift_nvs_write_int16( const char* namespace, const char* key, int16_t value )
+esp_err_t airshift_nvs_get_string( const char* namespace, const char* key, char* out_value, size_t* length )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    esp_err_t   ret     = ESP_FAIL;
+    uint8_t     space   = 0;
 
-    ESP_LOGI( TAG, "airshift_nvs_write_int16" );
+    ESP_LOGI( TAG, "airshift_nvs_get_string" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    ESP_GOTO_ON_ERROR( nvs_set_i16( nvs_handle, key, value ), error, TAG, "nvs_set_i16 failed" );
+    // a value still waiting for the flash is the current one ...
+    ret = read_pending( namespace, key, OPERATION_SET_STRING, NULL, out_value, length, &space );
 
-    return commit_and_close( nvs_handle );
+    if( ret == ESP_ERR_NOT_FINISHED )
+    {
+        ret = nvs_get_str( namespaces_[space].handle, key, out_value, length );
+    }
 
-error:
+    xSemaphoreGive( mutex_ );
 
-    ESP_LOGE( TAG, "airshift_nvs_write_int16 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "nvs_get_str failed" );
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
-    {
-        nvs_close( nvs_handle );
-    }
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_nvs_get_string failed: %s ( 0x%x ) -> %s", esp_err_to_name( ret ), ret, key );
 
     return ret;
 }
 
-esp_err_t airshift_nvs_write_int32( const char* namespace, const char* key, int32_t value )
+esp_err_t airshift_nvs_get_int16( const char* namespace, const char* key, int16_t* out_value )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    esp_err_t   ret     = ESP_FAIL;
+    int32_t     value   = 0;
+    uint8_t     space   = 0;
 
-    ESP_LOGI( TAG, "airshift_nvs_write_int32" );
+    ESP_LOGI( TAG, "airshift_nvs_get_int16" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    ESP_GOTO_ON_ERROR( nvs_set_i32( nvs_handle, key, value ), error, TAG, "nvs_set_i32 failed" );
+    ret = read_pending( namespace, key, OPERATION_SET_INT16, &value, NULL, NULL, &space );
 
-    return commit_and_close( nvs_handle );
+    if( ret == ESP_OK )
+    {
+        *out_value = (int16_t)value;
+    }
+    else if( ret == ESP_ERR_NOT_FINISHED )
+    {
+        ret = nvs_get_i16( namespaces_[space].handle, key, out_value );
+    }
 
-error:
+    xSemaphoreGive( mutex_ );
 
-    ESP_LOGE( TAG, "airshift_nvs_write_int32 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "nvs_get_i16 failed" );
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
-    {
-        nvs_close( nvs_handle );
-    }
+    ESP_LOGI( TAG, "airshift_nvs_get_int16 -> %d", *out_value );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_nvs_get_int16 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
 
     return ret;
 }
 
-esp_err_t airshift_nvs_write_blob( const char* namespace, const char* key, const void* value, size_t length )
+esp_err_t airshift_nvs_get_int32( const char* namespace, const char* key, int32_t* out_value )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    esp_err_t   ret     = ESP_FAIL;
+    uint8_t     space   = 0;
 
-    ESP_LOGI( TAG, "airshift_nvs_write_blob" );
+    ESP_LOGI( TAG, "airshift_nvs_get_int32" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    ESP_GOTO_ON_ERROR( nvs_set_blob( nvs_handle, key, value, length ), error, TAG, "nvs_set_blob failed" );
+    ret = read_pending( namespace, key, OPERATION_SET_INT32, out_value, NULL, NULL, &space );
 
-    return commit_and_close( nvs_handle );
+    if( ret == ESP_ERR_NOT_FINISHED )
+    {
+        ret = nvs_get_i32( namespaces_[space].handle, key, out_value );
+    }
 
-error:
+    xSemaphoreGive( mutex_ );
 
-    ESP_LOGE( TAG, "airshift_nvs_write_blob failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "nvs_get_i32 failed" );
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
-    {
-        nvs_close( nvs_handle );
-    }
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_nvs_get_int32 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
 
     return ret;
 }
 
-esp_err_t airshift_nvs_get_string( const char* namespace, const char* key, char* out_value, size_t* length )
+esp_err_t airshift_nvs_get_blob( const char* namespace, const char* key, void* out_value, size_t* length )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    esp_err_t   ret     = ESP_FAIL;
+    uint8_t     space   = 0;
 
-    ESP_LOGI( TAG, "airshift_nvs_get_string" );
+    ESP_LOGI( TAG, "airshift_nvs_get_blob" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READONLY, &nvs_handle ), error, TAG, "nvs_open failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    ESP_GOTO_ON_ERROR( nvs_get_str( nvs_handle, key, out_value, length ), error, TAG, "nvs_get_str failed" );
+    ret = read_pending( namespace, key, OPERATION_SET_BLOB, NULL, out_value, length, &space );
 
-    nvs_close( nvs_handle );
+    if( ret == ESP_ERR_NOT_FINISHED )
+    {
+        ret = nvs_get_blob( namespaces_[space].handle, key, out_value, length );
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "nvs_get_blob failed" );
 
     return ESP_OK;
 
 error:
 
-    ESP_LOGE( TAG, "airshift_nvs_get_string failed: %s ( 0x%x ) -> %s", esp_err_to_name( ret ), ret, key );
-
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
-    {
-        nvs_close( nvs_handle );
-    }
+    ESP_LOGE( TAG, "airshift_nvs_get_blob failed: %s ( 0x%x ) -> %s", esp_err_to_name( ret ), ret, key );
 
     return ret;
 }
 
-esp_err_t airshift_nvs_get_int16( const char* namespace, const char* key, int16_t* out_value )
+esp_err_t airshift_nvs_erase_value( const char* namespace, const char* key )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    ESP_LOGI( TAG, "airshift_nvs_erase_value" );
 
-    ESP_LOGI( TAG, "airshift_nvs_get_int16" );
+    return write_pending( namespace, key, OPERATION_ERASE, 0, NULL, 0 );
+}
+
+esp_err_t airshift_nvs_erase_all( const char* namespace )
+{
+    esp_err_t   ret     = ESP_FAIL;
+    uint8_t     space   = 0;
+    size_t      kept    = 0;
+
+    ESP_LOGI( TAG, "airshift_nvs_erase_all" );
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READONLY, &nvs_handle ), error, TAG, "nvs_open failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    ESP_GOTO_ON_ERROR( nvs_get_i16( nvs_handle, key, out_value ), error, TAG, "nvs_get_i16 failed" );
+    ESP_GOTO_ON_ERROR( find_namespace( namespace, true, &space ), error, TAG, "find_namespace failed" );
 
-    ESP_LOGI( TAG, "airshift_nvs_get_int16 -> %d", *out_value );
+    // pending writes to the namespace would only be erased again ...
+    for( size_t i = 0; i < pending_count_; i++ )
+    {
+        if( pending_[i].space == space )
+        {
+            free( pending_[i].data );
+
+            continue;
+        }
+
+        pending_[kept++] = pending_[i];
+    }
 
-    nvs_close( nvs_handle );
+    pending_count_ = kept;
+
+    ESP_GOTO_ON_ERROR( open_namespace( space, NVS_READWRITE ), error, TAG, "open_namespace failed" );
+
+    ESP_GOTO_ON_ERROR( nvs_erase_all( namespaces_[space].handle ), error, TAG, "nvs_erase_all failed" );
+
+    ESP_GOTO_ON_ERROR( nvs_commit( namespaces_[space].handle ), error, TAG, "nvs_commit failed" );
+
+    xSemaphoreGive( mutex_ );
 
     return ESP_OK;
 
 error:
 
-    ESP_LOGE( TAG, "airshift_nvs_get_int16 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    xSemaphoreGive( mutex_ );
+
+    ESP_LOGE( TAG, "airshift_nvs_erase_all failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
+bool airshift_nvs_key_exists( const char* namespace, const char* key )
+{
+    bool            exists      = false;
+    uint8_t         space       = 0;
+    pending_t       *pending    = NULL;
+    nvs_type_t      type        = NVS_TYPE_ANY;
+
+    ESP_LOGI( TAG, "airshift_nvs_key_exists -> %s -> %s", namespace, key );
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    pending = ( find_namespace( namespace, false, &space ) == ESP_OK ) ? find_pending( space, key ) : NULL;
+
+    // a key waiting to be written exists, one waiting to be erased does not, anything else is a hashed lookup on the cached handle ...
+    if( pending != NULL )
     {
-        nvs_close( nvs_handle );
+        exists = ( pending->operation != OPERATION_ERASE );
+    }
+    else if( ( find_namespace( namespace, true, &space ) == ESP_OK ) && ( open_namespace( space, NVS_READONLY ) == ESP_OK ) )
+    {
+        exists = ( nvs_find_key( namespaces_[space].handle, key, &type ) == ESP_OK );
     }
 
-    return ret;
+    xSemaphoreGive( mutex_ );
+
+    return exists;
 }
 
-esp_err_t airshift_nvs_get_int32( const char* namespace, const char* key, int32_t* out_value )
+esp_err_t airshift_nvs_get_or_create_int16( const char* namespace, const char* key, int16_t* out_value )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    if( airshift_nvs_key_exists( namespace, key ) == true )
+    {
+        return airshift_nvs_get_int16( namespace, key, out_value );
+    }
+    else
+    {
+        return airshift_nvs_write_int16( namespace, key, (int32_t)*out_value );
+    }
+}
 
-    ESP_LOGI( TAG, "airshift_nvs_get_int32" );
+esp_err_t airshift_nvs_get_or_create_int32( const char* namespace, const char* key, int32_t* out_value )
+{
+    if( airshift_nvs_key_exists( namespace, key ) == true )
+    {
+        return airshift_nvs_get_int32( namespace, key, out_value );
+    }
+    else
+    {
+        return airshift_nvs_write_int32( namespace, key, (int32_t)*out_value );
+    }
+}
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READONLY, &nvs_handle ), error, TAG, "nvs_open failed" );
+esp_err_t airshift_nvs_commit_if_due()
+{
+    bool due = false;
 
-    ESP_GOTO_ON_ERROR( nvs_get_i32( nvs_handle, key, out_value ), error, TAG, "nvs_get_i32 failed" );
+    xSemaphoreTake( mutex_, portMAX_DELAY );
 
-    nvs_close( nvs_handle );
+    due = ( pending_count_ > 0 ) && ( ( esp_timer_get_time() - pending_since_ ) >= COMMIT_DELAY_US );
 
-    return ESP_OK;
+    xSemaphoreGive( mutex_ );
 
-error:
+    return ( due == true ) ? airshift_nvs_flush() : ESP_OK;
+}
 
-    ESP_LOGE( TAG, "airshift_nvs_get_int32 failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+esp_err_t airshift_nvs_flush()
+{
+    esp_err_t ret = ESP_FAIL;
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
+    if( mutex_ == NULL )
     {
-        nvs_close( nvs_handle );
+        return ESP_OK;
     }
 
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    ret = flush();
+
+    xSemaphoreGive( mutex_ );
+
     return ret;
 }
 
-esp_err_t airshift_nvs_get_blob( const char* namespace, const char* key, void* out_value, size_t* length )
+esp_err_t airshift_nvs_get_stats( airshift_nvs_stats_t *stats )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
 
-    ESP_LOGI( TAG, "airshift_nvs_get_blob" );
-
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READONLY, &nvs_handle ), error, TAG, "nvs_open failed" );
+    portENTER_CRITICAL( &lock_ );
 
-    ESP_GOTO_ON_ERROR( nvs_get_blob( nvs_handle, key, out_value, length ), error, TAG, "nvs_get_blob failed" );
+    *stats = stats_;
 
-    nvs_close( nvs_handle );
+    portEXIT_CRITICAL( &lock_ );
 
     return ESP_OK;
+}
 
-error:
-
-    ESP_LOGE( TAG, "airshift_nvs_get_blob failed: %s ( 0x%x ) -> %s", esp_err_to_name( ret ), ret, key );
+// Private functions
+static void commit_timer_callback( void* arguments )
+{
+    AIRSHIFT_TRACED( TAG, "commit_timer_callback" );
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
+    // nobody offered a quiet slot in time, the flash write blocks, it must not hold up the other timers ...
+    if( commit_task_ != NULL )
     {
-        nvs_close( nvs_handle );
+        xTaskNotifyGive( commit_task_ );
     }
-
-    return ret;
 }
 
-esp_err_t airshift_nvs_erase_value( const char* namespace, const char* key )
+static void commit_task( void* arguments )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    ESP_LOGI( TAG, "commit_task" );
 
-    ESP_LOGI( TAG, "airshift_nvs_erase_value" );
+    while( true )
+    {
+        ulTaskNotifyTake( pdTRUE, portMAX_DELAY );
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_nvs_flush() );
+    }
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    vTaskDelete( NULL );
+}
 
-    ESP_GOTO_ON_ERROR( nvs_erase_key( nvs_handle, key ), error, TAG, "nvs_erase_key failed" );
+static esp_err_t find_namespace( const char* namespace, bool create, uint8_t *space )
+{
+    int free_slot = -1;
 
-    return commit_and_close( nvs_handle );
+    for( int i = 0; i < NAMESPACES_MAX; i++ )
+    {
+        if( namespaces_[i].name[0] == '\0' )
+        {
+            free_slot = ( free_slot < 0 ) ? i : free_slot;
 
-error:
+            continue;
+        }
 
-    ESP_LOGE( TAG, "airshift_nvs_erase_value failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+        if( strncmp( namespaces_[i].name, namespace, sizeof( namespaces_[i].name ) ) == 0 )
+        {
+            *space = i;
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
+            return ESP_OK;
+        }
+    }
+
+    // not a failure, nothing was ever read from or written to it ...
+    if( create != true )
     {
-        nvs_close( nvs_handle );
+        return ESP_ERR_NOT_FOUND;
     }
 
-    return ret;
+    ESP_RETURN_ON_FALSE( ( free_slot >= 0 ), ESP_ERR_NO_MEM, TAG, "too many namespaces" );
+    ESP_RETURN_ON_FALSE( ( strlen( namespace ) < sizeof( namespaces_[free_slot].name ) ), ESP_ERR_INVALID_ARG, TAG, "namespace too long" );
+
+    strcpy( namespaces_[free_slot].name, namespace );
+
+    namespaces_[free_slot].handle   = 0;
+    namespaces_[free_slot].mode     = NVS_READONLY;
+
+    *space = free_slot;
+
+    return ESP_OK;
 }
 
-esp_err_t airshift_nvs_erase_all( const char* namespace )
+static esp_err_t open_namespace( uint8_t space, nvs_open_mode_t mode )
 {
-    esp_err_t       ret         = ESP_FAIL;
-    nvs_handle_t    nvs_handle  = 0;
+    namespace_t *entry = &namespaces_[space];
 
-    ESP_LOGI( TAG, "airshift_nvs_erase_all" );
+    // a handle opened for reading is reopened once something has to be written, read only never creates the namespace ...
+    if( ( entry->handle != 0 ) && ( ( entry->mode == NVS_READWRITE ) || ( mode == NVS_READONLY ) ) )
+    {
+        return ESP_OK;
+    }
 
-    ESP_GOTO_ON_ERROR( nvs_open( namespace, NVS_READWRITE, &nvs_handle ), error, TAG, "nvs_open failed" );
+    if( entry->handle != 0 )
+    {
+        nvs_close( entry->handle );
 
-    ESP_GOTO_ON_ERROR( nvs_erase_all( nvs_handle ), error, TAG, "nvs_erase_all failed" );
+        entry->handle = 0;
+    }
 
-    return commit_and_close( nvs_handle );
+    ESP_RETURN_ON_ERROR( nvs_open( entry->name, mode, &entry->handle ), TAG, "nvs_open failed -> %s", entry->name );
 
-error:
+    entry->mode = mode;
 
-    ESP_LOGE( TAG, "airshift_nvs_erase_all failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    portENTER_CRITICAL( &lock_ );
+    stats_.opens++;
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
 
-    // Cleanup in case of error after open ...
-    if( nvs_handle != 0 )
+static pending_t* find_pending( uint8_t space, const char* key )
+{
+    for( size_t i = 0; i < pending_count_; i++ )
     {
-        nvs_close( nvs_handle );
+        if( ( pending_[i].space == space ) && ( strncmp( pending_[i].key, key, sizeof( pending_[i].key ) ) == 0 ) )
+        {
+            return &pending_[i];
+        }
     }
 
-    return ret;
+    return NULL;
 }
 
-bool airshift_nvs_key_exists( const char* namespace, const char* key )
+static esp_err_t write_pending( const char* namespace, const char* key, operation_t operation, int32_t integer, const void* data, size_t length )
 {
-    bool            exists          = false;
-    esp_err_t       ret             = ESP_FAIL;
-    nvs_iterator_t  nvs_iterator    = NULL;
+    esp_err_t   ret         = ESP_FAIL;
+    uint8_t     space       = 0;
+    pending_t   *pending    = NULL;
+    void        *copy       = NULL;
 
-    ESP_LOGI( TAG, "airshift_nvs_key_exists -> %s -> %s", namespace, key );
+    ESP_RETURN_ON_FALSE( ( ( namespace != NULL ) && ( key != NULL ) && ( strlen( key ) < NVS_KEY_NAME_MAX_SIZE ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
 
-    ESP_GOTO_ON_ERROR( nvs_entry_find( NVS_DEFAULT_PART_NAME, namespace, NVS_TYPE_ANY, &nvs_iterator ), error, TAG, "nvs_entry_find failed" );
-    
-    while( nvs_iterator != NULL )
+    if( length > 0 )
     {
-        nvs_entry_info_t entry_info;
-        
-        nvs_entry_info( nvs_iterator, &entry_info );
+        copy = malloc( length );
 
-        if( strcmp( entry_info.key, key ) == 0 )
-        {
-            exists = true;
+        ESP_RETURN_ON_FALSE( ( copy != NULL ), ESP_ERR_NO_MEM, TAG, "malloc failed" );
+
+        memcpy( copy, data, length );
+    }
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    ESP_GOTO_ON_ERROR( find_namespace( namespace, true, &space ), error, TAG, "find_namespace failed" );
+
+    pending = find_pending( space, key );
 
-            break;
+    // the newest write to a key replaces the one still waiting, only the last one ever reaches the flash ...
+    if( pending != NULL )
+    {
+        free( pending->data );
+
+        portENTER_CRITICAL( &lock_ );
+        stats_.coalesced++;
+        portEXIT_CRITICAL( &lock_ );
+    }
+    else
+    {
+        // ... a full table goes out now, rather than refusing the write ...
+        if( pending_count_ == PENDING_MAX )
+        {
+            ESP_GOTO_ON_ERROR( flush(), error, TAG, "flush failed" );
         }
 
-        ESP_GOTO_ON_ERROR( nvs_entry_next( &nvs_iterator ), error, TAG, "nvs_entry_next failed" );
-    };
+        pending = &pending_[pending_count_++];
 
-    goto cleanup;
+        strcpy( pending->key, key );
 
-error:
+        pending->space = space;
+    }
 
-    ESP_LOGE( TAG, "airshift_nvs_key_exists failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    pending->operation  = operation;
+    pending->integer    = integer;
+    pending->data       = copy;
+    pending->length     = length;
 
-cleanup:
+    portENTER_CRITICAL( &lock_ );
+    stats_.writes++;
+    portEXIT_CRITICAL( &lock_ );
 
-    // Cleanup ...
-    if( nvs_iterator != NULL )
+    // ... and the first write of a batch arms the deadline ...
+    if( pending_count_ == 1 )
     {
-        nvs_release_iterator( nvs_iterator );
+        pending_since_ = esp_timer_get_time();
+
+        esp_timer_stop( commit_timer_ );
+        esp_timer_start_once( commit_timer_, COMMIT_DEADLINE_US );
     }
 
-    return exists;
+    xSemaphoreGive( mutex_ );
+
+    return ESP_OK;
+
+error:
+
+    xSemaphoreGive( mutex_ );
+
+    free( copy );
+
+    ESP_LOGE( TAG, "write_pending failed: %s ( 0x%x ) -> %s", esp_err_to_name( ret ), ret, key );
+
+    return ret;
 }
 
-esp_err_t airshift_nvs_get_or_create_int16( const char* namespace, const char* key, int16_t* out_value )
+// Mutex held. ESP_OK with the value when it is pending, ESP_ERR_NVS_NOT_FOUND when it is pending erase, ESP_ERR_NOT_FINISHED when the flash has to be read, space then has an open handle ...
+static esp_err_t read_pending( const char* namespace, const char* key, operation_t operation, int32_t* integer, void* data, size_t* length, uint8_t *space )
 {
-    if( airshift_nvs_key_exists( namespace, key ) == true )
+    pending_t *pending = NULL;
+
+    ESP_RETURN_ON_FALSE( ( ( namespace != NULL ) && ( key != NULL ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    if( find_namespace( namespace, false, space ) == ESP_OK )
     {
-        return airshift_nvs_get_int16( namespace, key, out_value );
+        pending = find_pending( *space, key );
     }
-    else
+
+    if( pending != NULL )
     {
-        return airshift_nvs_write_int16( namespace, key, (int32_t)*out_value );
+        if( pending->operation == OPERATION_ERASE )
+        {
+            return ESP_ERR_NVS_NOT_FOUND;
+        }
+
+        // a pending value of another type is left to the flash to report, once it is there ...
+        if( pending->operation != operation )
+        {
+            ESP_RETURN_ON_ERROR( flush(), TAG, "flush failed" );
+        }
+        else if( integer != NULL )
+        {
+            *integer = pending->integer;
+
+            return ESP_OK;
+        }
+        else
+        {
+            // same contract as nvs_get_str and nvs_get_blob, no buffer asks for the length ...
+            if( data != NULL )
+            {
+                ESP_RETURN_ON_FALSE( ( *length >= pending->length ), ESP_ERR_NVS_INVALID_LENGTH, TAG, "buffer too small" );
+
+                memcpy( data, pending->data, pending->length );
+            }
+
+            *length = pending->length;
+
+            return ESP_OK;
+        }
     }
+
+    ESP_RETURN_ON_ERROR( find_namespace( namespace, true, space ), TAG, "find_namespace failed" );
+    ESP_RETURN_ON_ERROR( open_namespace( *space, NVS_READONLY ), TAG, "open_namespace failed" );
+
+    return ESP_ERR_NOT_FINISHED;
 }
 
-esp_err_t airshift_nvs_get_or_create_int32( const char* namespace, const char* key, int32_t* out_value )
+// Mutex held, every pending operation, then one commit per namespace that took any ...
+static esp_err_t flush()
 {
-    if( airshift_nvs_key_exists( namespace, key ) == true )
+    esp_err_t       ret                     = ESP_OK;
+    esp_err_t       result                  = ESP_OK;
+    bool            dirty[NAMESPACES_MAX]   = { 0 };
+    nvs_handle_t    handle                  = 0;
+    uint32_t        operations              = 0;
+    uint32_t        commits                 = 0;
+
+    if( pending_count_ == 0 )
     {
-        return airshift_nvs_get_int32( namespace, key, out_value );
+        return ESP_OK;
     }
-    else
+
+    AIRSHIFT_TRACED( TAG, "flush: %u pending", pending_count_ );
+
+    esp_timer_stop( commit_timer_ );
+
+    for( size_t i = 0; i < pending_count_; i++ )
     {
-        return airshift_nvs_write_int32( namespace, key, (int32_t)*out_value );
+        pending_t *pending = &pending_[i];
+
+        result = open_namespace( pending->space, NVS_READWRITE );
+
+        if( result == ESP_OK )
+        {
+            handle = namespaces_[pending->space].handle;
+
+            switch( pending->operation )
+            {
+                case OPERATION_SET_INT16:   result = nvs_set_i16( handle, pending->key, (int16_t)pending->integer );       break;
+                case OPERATION_SET_INT32:   result = nvs_set_i32( handle, pending->key, pending->integer );                break;
+                case OPERATION_SET_STRING:  result = nvs_set_str( handle, pending->key, pending->data );                   break;
+                case OPERATION_SET_BLOB:    result = nvs_set_blob( handle, pending->key, pending->data, pending->length ); break;
+                case OPERATION_ERASE:       result = nvs_erase_key( handle, pending->key );                                 break;
+                default:                    result = ESP_ERR_INVALID_STATE;                                                 break;
+            }
+
+            // erasing what was never written is not a failure ...
+            result = ( ( pending->operation == OPERATION_ERASE ) && ( result == ESP_ERR_NVS_NOT_FOUND ) ) ? ESP_OK : result;
+        }
+
+        if( result != ESP_OK )
+        {
+            ESP_LOGE( TAG, "flush -> %s -> %s failed: %s ( 0x%x )", namespaces_[pending->space].name, pending->key, esp_err_to_name( result ), result );
+
+            ret = result;
+        }
+
+        dirty[pending->space] |= ( result == ESP_OK );
+        operations++;
+
+        free( pending->data );
     }
-}
 
-// Private functions
-esp_err_t commit_and_close( nvs_handle_t nvs_handle )
-{
-    esp_err_t ret = ESP_FAIL;
+    pending_count_ = 0;
 
-    ESP_LOGI( TAG, "commit_and_close" );
+    for( int i = 0; i < NAMESPACES_MAX; i++ )
+    {
+        if( dirty[i] != true )
+        {
+            continue;
+        }
 
-    ESP_GOTO_ON_ERROR( nvs_commit( nvs_handle ), error, TAG, "nvs_commit failed" );
+        result = nvs_commit( namespaces_[i].handle );
 
-    nvs_close( nvs_handle );
+        if( result != ESP_OK )
+        {
+            ESP_LOGE( TAG, "flush -> nvs_commit -> %s failed: %s ( 0x%x )", namespaces_[i].name, esp_err_to_name( result ), result );
 
-    return ESP_OK;
+            ret = result;
+        }
 
-error:
+        commits++;
+    }
 
-    ESP_LOGE( TAG, "commit_and_close failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    portENTER_CRITICAL( &lock_ );
 
-    // Cleanup in case of error with commit ...
-    nvs_close( nvs_handle );
+    stats_.flushes++;
+    stats_.operations  += operations;
+    stats_.commits     += commits;
+    stats_.errors      += ( ret == ESP_OK ) ? 0 : 1;
+
+    portEXIT_CRITICAL( &lock_ );
 
     return ret;
-}
\ No newline at end of file
+}
+
+static void close_all()
+{
+    for( int i = 0; i < NAMESPACES_MAX; i++ )
+    {
+        if( namespaces_[i].handle != 0 )
+        {
+            nvs_close( namespaces_[i].handle );
+        }
+    }
+
+    memset( namespaces_, 0, sizeof( namespaces_ ) );
+}
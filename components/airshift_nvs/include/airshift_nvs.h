@@ -9,11 +9,24 @@
 extern "C" {
 #endif
 
+typedef struct
+{
+    uint32_t    writes;         // writes and erases of single keys, all of them deferred
+    uint32_t    coalesced;      // writes that replaced one to the same key still waiting for the flash
+    uint32_t    flushes;        // batches written out
+    uint32_t    operations;     // sets and erases that reached the flash
+    uint32_t    commits;        // one per namespace per batch
+    uint32_t    opens;          // handles are kept open, this only grows with new namespaces
+    uint32_t    errors;         // batches with at least one failed operation
+} airshift_nvs_stats_t;
+
 esp_err_t   airshift_nvs_init();
 size_t      airshift_nvs_available( size_t *total_entries, size_t *used_entries );
 esp_err_t   airshift_nvs_release();
 esp_err_t   airshift_nvs_format();
 
+// Writes and single key erases are held in ram, reads see them at once. They reach the flash together, with one commit per namespace,
+// from airshift_nvs_commit_if_due once they have waited a moment, or from airshift_nvs_flush, or at the latest from a deadline task ...
 esp_err_t   airshift_nvs_write_string( const char* namespace, const char* key, const char* value );
 esp_err_t   airshift_nvs_write_int16( const char* namespace, const char* key, int16_t value );
 esp_err_t   airshift_nvs_write_int32( const char* namespace, const char* key, int32_t value );
@@ -25,6 +38,8 @@ esp_err_t   airshift_nvs_get_int32( const char* namespace, const char* key, int3
 esp_err_t   airshift_nvs_get_blob( const char* namespace, const char* key, void* out_value, size_t* length );
 
 esp_err_t   airshift_nvs_erase_value( const char* namespace, const char* key );
+
+// Immediate, drops whatever is pending for the namespace ...
 esp_err_t   airshift_nvs_erase_all( const char* namespace );
 
 bool        airshift_nvs_key_exists( const char* namespace, const char* key );
@@ -32,6 +47,12 @@ bool        airshift_nvs_key_exists( const char* namespace, const char* key );
 esp_err_t   airshift_nvs_get_or_create_int16( const char* namespace, const char* key, int16_t* out_value );
 esp_err_t   airshift_nvs_get_or_create_int32( const char* namespace, const char* key, int32_t* out_value );
 
+// Call from a quiet slot, when no sensor is being read for a while, the flash cache is off while nvs writes ...
+esp_err_t   airshift_nvs_commit_if_due();
+esp_err_t   airshift_nvs_flush();
+
+esp_err_t   airshift_nvs_get_stats( airshift_nvs_stats_t *stats );
+
 #ifdef __cplusplus
 }
 #endif
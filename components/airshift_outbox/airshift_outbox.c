@@ -0,0 +1,394 @@
+#include "airshift_outbox.h"
+#include "airshift_event.h"
+#include "airshift_nvs.h"
+#include "airshift_mqtt.h"
+#include "airshift_telemetry.h"
+
+#define OUTBOX_NVS_NAMESPACE        "outbox"
+#define OUTBOX_NVS_CURSOR           "cursor"
+
+#define OUTBOX_TOPIC                "telemetry/%s/backfill"
+#define OUTBOX_CACHE_RECORDS        32          // most recent undelivered records kept in ram, older ones are read back from flash
+#define OUTBOX_BATCH_RECORDS        10
+#define OUTBOX_BATCH_INTERVAL_MS    2000        // rate limit, leaves the link to live samples
+#define OUTBOX_ACK_TIMEOUT_MS       10000
+#define OUTBOX_RETRY_MS             60000
+#define OUTBOX_MESSAGE_SIZE         1024
+#define OUTBOX_ACKED_HISTORY        8
+
+#define OUTBOX_TASK_STACK_SIZE      4096
+#define OUTBOX_TASK_PRIORITY        2           // below acquisition, sensors and ui
+
+#define NOTIFY_CONNECTED            0x01
+#define NOTIFY_DISCONNECTED         0x02
+#define NOTIFY_ACK                  0x04
+
+static const char* TAG = "airshift_outbox";
+
+// Forward declarations
+static void         outbox_task( void *arguments );
+static void         mqtt_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data );
+static esp_err_t    drain_batch();
+static esp_err_t    wait_for_ack( int msg_id );
+static void         advance( uint32_t sequence );
+static void         persist_cursor();
+
+static TaskHandle_t                     outbox_task_        = NULL;
+static esp_event_handler_instance_t     event_instance_     = NULL;
+static portMUX_TYPE                     lock_               = portMUX_INITIALIZER_UNLOCKED;
+static char                             topic_[80]          = { 0 };
+static uint8_t                          message_[OUTBOX_MESSAGE_SIZE]   = { 0 };
+
+// pending records are [ cursor_, end_ ) of the history log ...
+static bool                             backlog_            = false;
+static uint32_t                         cursor_             = 0;
+static uint32_t                         end_                = 0;
+static airshift_history_record_t        cache_[OUTBOX_CACHE_RECORDS]    = { 0 };
+static int                              acked_[OUTBOX_ACKED_HISTORY]    = { 0 };
+static uint32_t                         acked_index_        = 0;
+static airshift_outbox_stats_t          stats_              = { 0 };
+
+// Public functions
+esp_err_t airshift_outbox_init()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    int32_t     cursor  = 0;
+    uint32_t    oldest  = 0;
+
+    ESP_LOGI( TAG, "airshift_outbox_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+    memset( cache_, 0xFF, sizeof( cache_ ) );
+    memset( acked_, 0xFF, sizeof( acked_ ) );
+
+    snprintf( topic_, sizeof( topic_ ), OUTBOX_TOPIC, airshift_mqtt_get_client_id() );
+
+    // a backlog left over from before the reboot covers everything logged since ...
+    backlog_ = false;
+
+    if( airshift_nvs_key_exists( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR ) && ( airshift_nvs_get_int32( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR, &cursor ) == ESP_OK ) )
+    {
+        ESP_GOTO_ON_ERROR( airshift_history_get_range( &oldest, &end_ ), error, TAG, "airshift_history_get_range failed" );
+
+        cursor_     = (uint32_t)cursor;
+        backlog_    = ( cursor_ < end_ );
+
+        ESP_LOGI( TAG, "airshift_outbox_init -> backlog: [ %lu, %lu )", cursor_, end_ );
+    }
+
+    ESP_GOTO_ON_ERROR( esp_event_handler_instance_register( AIRSHIFT_EVENT_MQTT, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL, &event_instance_ ), error, TAG, "esp_event_handler_instance_register failed" );
+
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( outbox_task, "outbox_task", OUTBOX_TASK_STACK_SIZE, NULL, OUTBOX_TASK_PRIORITY, &outbox_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_outbox_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    // clean up on failure ...
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_outbox_release() );
+
+    return ret;
+}
+
+esp_err_t airshift_outbox_release()
+{
+    ESP_LOGI( TAG, "airshift_outbox_release" );
+
+    if( event_instance_ != NULL )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_handler_instance_unregister( AIRSHIFT_EVENT_MQTT, ESP_EVENT_ANY_ID, event_instance_ ) );
+
+        event_instance_ = NULL;
+    }
+
+    if( outbox_task_ != NULL )
+    {
+        vTaskDelete( outbox_task_ );
+
+        outbox_task_ = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_outbox_push( const airshift_history_record_t *record )
+{
+    bool started = false;
+
+    if( record == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    if( !backlog_ )
+    {
+        backlog_    = true;
+        cursor_     = record->sequence;
+        started     = true;
+    }
+
+    end_                                            = record->sequence + 1;
+    cache_[record->sequence % OUTBOX_CACHE_RECORDS] = *record;
+
+    stats_.queued++;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    // only the start of an outage touches nvs, the end is always the newest pushed record ...
+    if( started )
+    {
+        ESP_LOGW( TAG, "airshift_outbox_push -> backlog started at %lu", record->sequence );
+
+        persist_cursor();
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_outbox_get_stats( airshift_outbox_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats          = stats_;
+    stats->pending  = backlog_ ? ( end_ - cursor_ ) : 0;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static void outbox_task( void *arguments )
+{
+    uint32_t notified = 0;
+
+    ESP_LOGI( TAG, "outbox_task" );
+
+    // a backlog restored from nvs is drained on the first connect, same as any other ...
+    while( true )
+    {
+        notified = 0;
+
+        // ... and a periodic retry picks up batches that timed out while the link stayed up ...
+        if( ( xTaskNotifyWait( 0, NOTIFY_CONNECTED | NOTIFY_DISCONNECTED, &notified, OUTBOX_RETRY_MS / portTICK_PERIOD_MS ) == pdTRUE ) && !( notified & NOTIFY_CONNECTED ) )
+        {
+            continue;
+        }
+
+        while( airshift_mqtt_is_connected() && ( drain_batch() == ESP_OK ) )
+        {
+            vTaskDelay( OUTBOX_BATCH_INTERVAL_MS / portTICK_PERIOD_MS );
+        }
+    }
+
+    vTaskDelete( NULL );
+}
+
+static void mqtt_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data )
+{
+    switch( event_id )
+    {
+        case AIRSHIFT_EVENT_MQTT_CONNECTED:
+        {
+            xTaskNotify( outbox_task_, NOTIFY_CONNECTED, eSetBits );
+            break;
+        }
+        case AIRSHIFT_EVENT_MQTT_DISCONNECTED:
+        {
+            xTaskNotify( outbox_task_, NOTIFY_DISCONNECTED, eSetBits );
+            break;
+        }
+        case AIRSHIFT_EVENT_MQTT_PUBLISHED:
+        {
+            // keep a few, the ack can race the publisher storing its msg_id ...
+            portENTER_CRITICAL( &lock_ );
+
+            acked_[acked_index_++ % OUTBOX_ACKED_HISTORY] = *(int *)event_data;
+
+            portEXIT_CRITICAL( &lock_ );
+
+            xTaskNotify( outbox_task_, NOTIFY_ACK, eSetBits );
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
+}
+
+static esp_err_t drain_batch()
+{
+    esp_err_t                   ret                             = ESP_FAIL;
+    airshift_history_record_t   records[OUTBOX_BATCH_RECORDS]   = { 0 };
+    size_t                      count                           = 0;
+    size_t                      length                          = 0;
+    uint32_t                    first                           = 0;
+    uint32_t                    last                            = 0;
+    uint32_t                    oldest                          = 0;
+    uint32_t                    next                            = 0;
+    int                         msg_id                          = -1;
+
+    portENTER_CRITICAL( &lock_ );
+
+    first   = cursor_;
+    last    = ( ( end_ - cursor_ ) > OUTBOX_BATCH_RECORDS ) ? ( cursor_ + OUTBOX_BATCH_RECORDS ) : end_;
+    ret     = backlog_ ? ESP_OK : ESP_ERR_NOT_FOUND;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( ret != ESP_OK )
+    {
+        return ret;
+    }
+
+    ESP_GOTO_ON_ERROR( airshift_history_get_range( &oldest, &next ), error, TAG, "airshift_history_get_range failed" );
+
+    // the log wrapped during a very long outage, what was recycled is gone ...
+    if( first < oldest )
+    {
+        ESP_LOGW( TAG, "drain_batch -> %lu records recycled before delivery", oldest - first );
+
+        stats_.lost    += oldest - first;
+        first           = oldest;
+        last            = ( last > first ) ? last : first;
+    }
+
+    for( uint32_t sequence = first; sequence < last; sequence++ )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        if( cache_[sequence % OUTBOX_CACHE_RECORDS].sequence == sequence )
+        {
+            records[count++] = cache_[sequence % OUTBOX_CACHE_RECORDS];
+            stats_.cache_hits++;
+            ret = ESP_OK;
+        }
+        else
+        {
+            ret = ESP_ERR_NOT_FOUND;
+        }
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( ret == ESP_OK )
+        {
+            continue;
+        }
+
+        if( airshift_history_read( sequence, &records[count] ) == ESP_OK )
+        {
+            count++;
+            stats_.flash_reads++;
+        }
+        else
+        {
+            stats_.lost++;
+        }
+    }
+
+    if( count > 0 )
+    {
+        ESP_GOTO_ON_ERROR( airshift_telemetry_encode( records, count, message_, sizeof( message_ ), &length ), error, TAG, "airshift_telemetry_encode failed" );
+
+        ESP_GOTO_ON_ERROR( airshift_mqtt_publish_tracked( topic_, (const char *)message_, length, &msg_id ), error, TAG, "airshift_mqtt_publish_tracked failed" );
+
+        ESP_GOTO_ON_ERROR( wait_for_ack( msg_id ), error, TAG, "wait_for_ack failed" );
+
+        stats_.batches++;
+    }
+
+    ESP_LOGI( TAG, "drain_batch -> [ %lu, %lu ), %u records", first, last, count );
+
+    advance( last );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t wait_for_ack( int msg_id )
+{
+    TickType_t  start       = xTaskGetTickCount();
+    TickType_t  timeout     = pdMS_TO_TICKS( OUTBOX_ACK_TIMEOUT_MS );
+    TickType_t  elapsed     = 0;
+    bool        acked       = false;
+
+    while( true )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        for( int i = 0; i < OUTBOX_ACKED_HISTORY; i++ )
+        {
+            acked |= ( acked_[i] == msg_id );
+        }
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( acked )
+        {
+            return ESP_OK;
+        }
+
+        elapsed = xTaskGetTickCount() - start;
+
+        if( !airshift_mqtt_is_connected() || ( elapsed >= timeout ) )
+        {
+            break;
+        }
+
+        xTaskNotifyWait( 0, NOTIFY_ACK | NOTIFY_DISCONNECTED, NULL, timeout - elapsed );
+    }
+
+    // cursor stays put, the same batch is sent again on the next connect ...
+    stats_.timeouts++;
+
+    return ESP_ERR_TIMEOUT;
+}
+
+static void advance( uint32_t sequence )
+{
+    portENTER_CRITICAL( &lock_ );
+
+    cursor_     = sequence;
+    backlog_    = ( cursor_ < end_ );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    persist_cursor();
+}
+
+static void persist_cursor()
+{
+    bool        backlog = false;
+    uint32_t    cursor  = 0;
+
+    portENTER_CRITICAL( &lock_ );
+
+    backlog = backlog_;
+    cursor  = cursor_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( backlog )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_nvs_write_int32( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR, (int32_t)cursor ) );
+    }
+    else if( airshift_nvs_key_exists( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR ) )
+    {
+        ESP_LOGI( TAG, "persist_cursor -> backlog drained" );
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_nvs_erase_value( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR ) );
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef AIRSHIFT_OUTBOX_H
+#define AIRSHIFT_OUTBOX_H
+
+#include "airshift_header_common.h"
+#include "airshift_history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint32_t    pending;            // records waiting to be backfilled
+    uint32_t    queued;             // records handed to airshift_outbox_push
+    uint32_t    cache_hits;         // backfilled records served from ram
+    uint32_t    flash_reads;        // backfilled records read back from the history log
+    uint32_t    lost;               // records recycled by the history log before they could be sent
+    uint32_t    batches;            // backfill batches acknowledged by the broker
+    uint32_t    timeouts;           // backfill batches never acknowledged, retried on the next connect
+} airshift_outbox_stats_t;
+
+esp_err_t   airshift_outbox_init();
+esp_err_t   airshift_outbox_release();
+
+// record could not be delivered live, it is sent to telemetry/<id>/backfill once the broker is reachable again ...
+esp_err_t   airshift_outbox_push( const airshift_history_record_t *record );
+esp_err_t   airshift_outbox_get_stats( airshift_outbox_stats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_OUTBOX_H
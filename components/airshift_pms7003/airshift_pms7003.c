@@ -1,19 +1,99 @@
 #include "airshift_pms7003.h"
 #include "airshift_common.h"
+#include "airshift_metrics.h"
+#include "airshift_power.h"
+#include "airshift_trace.h"
 
+#include <stdlib.h>
+#include <esp_timer.h>
 #include <driver/uart.h>
 #include <driver/gpio.h>
 
-#define UART_PORT           UART_NUM_2
-#define TX_PIN              GPIO_NUM_18
-#define RX_PIN              GPIO_NUM_8
-#define RECEIVE_BUFFER_SIZE 128
-#define START_CHARACTER_1   0x42
-#define START_CHARACTER_2   0x4d
+#define UART_PORT               UART_NUM_2
+#define TX_PIN                  GPIO_NUM_18
+#define RX_PIN                  GPIO_NUM_8
+#define RECEIVE_BUFFER_SIZE     128
+#define UART_RING_BUFFER_SIZE   ( RECEIVE_BUFFER_SIZE * 8 )
+#define UART_QUEUE_SIZE         16
+#define START_CHARACTER_1       0x42
+#define START_CHARACTER_2       0x4d
+
+#define FRAME_HEADER_SIZE       4
+#define FRAME_DATA_LENGTH       28      // 13 data words + checksum
+#define FRAME_COMMAND_LENGTH    4       // command acknowledge, 1 data word + checksum
+#define FRAME_MAX_SIZE          ( FRAME_HEADER_SIZE + FRAME_DATA_LENGTH )
+
+#define COMMAND_CHANGE_MODE     0xe1
+#define COMMAND_SLEEP           0xe4
+#define MODE_ACTIVE             0x0001
+#define SLEEP_SLEEP             0x0000
+#define SLEEP_WAKEUP            0x0001
+
+#define STALE_TIMEOUT_US        ( 5 * 1000 * 1000 )
+
+// the datasheet wants 30 s of fan after a wakeup before readings are stable ...
+#define DUTY_CYCLE_PERIOD_MIN_MS    ( 2 * 60 * 1000 )
+#define DUTY_CYCLE_PERIOD_MAX_MS    ( 10 * 60 * 1000 )
+#define DUTY_CYCLE_SETTLE_MS        ( 30 * 1000 )
+#define DUTY_CYCLE_MEASURE_MS       ( 10 * 1000 )
+#define DUTY_CYCLE_CHANGE_THRESHOLD 5
+
+#define READER_TASK_STACK_SIZE  3072
+#define READER_TASK_PRIORITY    9
+
+typedef enum
+{
+    PARSER_STATE_START_1,
+    PARSER_STATE_START_2,
+    PARSER_STATE_LENGTH_H,
+    PARSER_STATE_LENGTH_L,
+    PARSER_STATE_PAYLOAD
+} parser_state_t;
+
+typedef enum
+{
+    DUTY_STATE_CONTINUOUS,
+    DUTY_STATE_SETTLING,
+    DUTY_STATE_MEASURING,
+    DUTY_STATE_SLEEPING
+} duty_state_t;
+
+typedef struct
+{
+    parser_state_t  state;
+    uint8_t         frame[FRAME_MAX_SIZE];
+    size_t          index;
+    size_t          frame_size;
+} parser_t;
 
 static const char* TAG = "airshift_pms7003";
 
 // Forward declarations
+static esp_err_t    send_command( uint8_t command, uint16_t data );
+static void         reader_task( void *arguments );
+static void         parser_reset( parser_t *parser );
+static void         parser_feed( parser_t *parser, uint8_t byte );
+static void         parser_frame_complete( parser_t *parser );
+static void         duty_timer_callback( void *arguments );
+static uint32_t     next_period( uint32_t frames, uint32_t sum );
+
+static QueueHandle_t    uart_queue_         = NULL;
+static TaskHandle_t     reader_task_        = NULL;
+static portMUX_TYPE     lock_               = portMUX_INITIALIZER_UNLOCKED;
+static pms7003_data_t   latest_             = { 0 };
+static int64_t          latest_timestamp_   = 0;
+static bool             awake_              = false;    // streaming, holds the sensor power lock
+static int64_t          awake_since_        = 0;
+static pms7003_stats_t  stats_              = { 0 };
+
+static const pms7003_duty_cycle_t       default_duty_cycle_ = { .period_min_ms = DUTY_CYCLE_PERIOD_MIN_MS, .period_max_ms = DUTY_CYCLE_PERIOD_MAX_MS, .settle_ms = DUTY_CYCLE_SETTLE_MS, .measure_ms = DUTY_CYCLE_MEASURE_MS, .change_threshold = DUTY_CYCLE_CHANGE_THRESHOLD };
+static const esp_timer_create_args_t    duty_timer_args_    = { .callback = &duty_timer_callback, .name = "pms7003-duty", .dispatch_method = ESP_TIMER_TASK };
+static esp_timer_handle_t               duty_timer_         = NULL;
+static pms7003_duty_cycle_t             duty_cycle_         = { 0 };
+static duty_state_t                     duty_state_         = DUTY_STATE_CONTINUOUS;    // under lock_
+static uint32_t                         window_frames_      = 0;                        // under lock_
+static uint32_t                         window_sum_         = 0;                        // under lock_, pm2.5
+static int32_t                          previous_average_   = -1;                       // pm2.5 of the last window with frames
 
 // Public functions
 esp_err_t airshift_pms7003_init()
@@ -23,8 +103,14 @@ esp_err_t airshift_pms7003_init()
 
     ESP_LOGI( TAG, "airshift_pms7003_init" );
 
-    // uart_driver_install
-    ESP_GOTO_ON_ERROR( uart_driver_install( UART_PORT, ( RECEIVE_BUFFER_SIZE * 2 ), 0, 0, NULL, 0 ), error, TAG, "uart_driver_install failed" );
+    // reset variables ...
+    memset( &latest_, 0, sizeof( latest_ ) );
+    memset( &stats_, 0, sizeof( stats_ ) );
+    latest_timestamp_   = 0;
+    duty_state_         = DUTY_STATE_CONTINUOUS;
+
+    // uart_driver_install, with an event queue so frames are decoded as they stream in, the isr keeps draining the fifo while the flash cache is off ...
+    ESP_GOTO_ON_ERROR( uart_driver_install( UART_PORT, UART_RING_BUFFER_SIZE, 0, UART_QUEUE_SIZE, &uart_queue_, ESP_INTR_FLAG_IRAM ), error, TAG, "uart_driver_install failed" );
 
     // uart_param_config
     ESP_GOTO_ON_ERROR( uart_param_config( UART_PORT, &uart_config ), error, TAG, "uart_param_config failed" );
@@ -32,9 +118,18 @@ esp_err_t airshift_pms7003_init()
     // uart_set_pin
     ESP_GOTO_ON_ERROR( uart_set_pin( UART_PORT, TX_PIN, RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE ), error, TAG, "uart_set_pin failed" );
 
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( reader_task, "pms7003_reader", READER_TASK_STACK_SIZE, NULL, READER_TASK_PRIORITY, &reader_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> pms7003_reader failed" );
+
     // default to waking up the device, can be put to sleep later ...
     ESP_GOTO_ON_ERROR( airshift_pms7003_wakeup(), error, TAG, "airshift_pms7003_wakeup failed" );
 
+    // active mode, the sensor streams a frame on every internal measurement ...
+    ESP_GOTO_ON_ERROR( send_command( COMMAND_CHANGE_MODE, MODE_ACTIVE ), error, TAG, "send_command -> COMMAND_CHANGE_MODE failed" );
+
+    ESP_GOTO_ON_ERROR( esp_timer_create( &duty_timer_args_, &duty_timer_ ), error, TAG, "esp_timer_create failed" );
+
+    ESP_GOTO_ON_ERROR( airshift_pms7003_set_duty_cycle( &default_duty_cycle_ ), error, TAG, "airshift_pms7003_set_duty_cycle failed" );
+
     return ESP_OK;
 
 error:
@@ -51,121 +146,540 @@ esp_err_t airshift_pms7003_release()
 {
     ESP_LOGI( TAG, "airshift_pms7003_release" );
 
+    if( duty_timer_ != NULL )
+    {
+        esp_timer_stop( duty_timer_ );
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_timer_delete( duty_timer_ ) );
+
+        duty_timer_ = NULL;
+    }
+
+    if( reader_task_ != NULL )
+    {
+        vTaskDelete( reader_task_ );
+
+        reader_task_ = NULL;
+    }
+
     ESP_ERROR_CHECK_WITHOUT_ABORT( uart_driver_delete( UART_PORT ) );
 
+    uart_queue_ = NULL;
+
+    if( awake_ == true )
+    {
+        airshift_power_unlock( AIRSHIFT_POWER_LOCK_SENSOR );
+
+        awake_ = false;
+    }
+
     return ESP_OK;
 }
 
 esp_err_t airshift_pms7003_sleep()
 {
-    uint8_t command[] = { 0x42, 0x4D, 0xE4, 0x00, 0x00, 0x01, 0x73 };
-
     ESP_LOGI( TAG, "airshift_pms7003_sleep" );
 
-    uart_write_bytes( UART_PORT, command, sizeof( command ) );
+    // no more frames, the uart may lose its clock again ...
+    if( awake_ == true )
+    {
+        airshift_power_unlock( AIRSHIFT_POWER_LOCK_SENSOR );
 
-    return ESP_OK;
+        awake_ = false;
+
+        portENTER_CRITICAL( &lock_ );
+        stats_.awake_time += esp_timer_get_time() - awake_since_;
+        portEXIT_CRITICAL( &lock_ );
+    }
+
+    return send_command( COMMAND_SLEEP, SLEEP_SLEEP );
 }
 
 esp_err_t airshift_pms7003_wakeup()
 {
-    uint8_t command[] = { 0x42, 0x4D, 0xE4, 0x00, 0x01, 0x01, 0x74 };
-
     ESP_LOGI( TAG, "airshift_pms7003_wakeup" );
 
-    uart_write_bytes( UART_PORT, command, sizeof( command ) );
+    // an active mode sensor streams whenever it likes, light sleep would drop bytes mid frame ...
+    if( awake_ == false )
+    {
+        airshift_power_lock( AIRSHIFT_POWER_LOCK_SENSOR );
+
+        awake_          = true;
+        awake_since_    = esp_timer_get_time();
+
+        portENTER_CRITICAL( &lock_ );
+        stats_.wakeups++;
+        portEXIT_CRITICAL( &lock_ );
+    }
+
+    return send_command( COMMAND_SLEEP, SLEEP_WAKEUP );
+}
+
+esp_err_t airshift_pms7003_set_duty_cycle( const pms7003_duty_cycle_t *duty_cycle )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( duty_cycle != NULL ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+    ESP_GOTO_ON_FALSE( ( ( duty_cycle->period_min_ms == 0 ) || ( ( duty_cycle->period_min_ms <= duty_cycle->period_max_ms ) && ( duty_cycle->measure_ms > 0 ) ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid duty cycle" );
+    ESP_GOTO_ON_FALSE( ( duty_timer_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    ESP_LOGI( TAG, "airshift_pms7003_set_duty_cycle -> period: %lu .. %lu ms, settle: %lu ms, measure: %lu ms", duty_cycle->period_min_ms, duty_cycle->period_max_ms, duty_cycle->settle_ms, duty_cycle->measure_ms );
+
+    esp_timer_stop( duty_timer_ );
+
+    duty_cycle_         = *duty_cycle;
+    previous_average_   = -1;
+
+    // whatever state the sensor was in, it starts over from a wakeup ...
+    ESP_GOTO_ON_ERROR( airshift_pms7003_wakeup(), error, TAG, "airshift_pms7003_wakeup failed" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    duty_state_         = ( duty_cycle_.period_min_ms == 0 ) ? DUTY_STATE_CONTINUOUS : DUTY_STATE_SETTLING;
+    stats_.period_ms    = duty_cycle_.period_min_ms;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( duty_cycle_.period_min_ms != 0 )
+    {
+        ESP_GOTO_ON_ERROR( esp_timer_start_once( duty_timer_, (uint64_t)duty_cycle_.settle_ms * 1000 ), error, TAG, "esp_timer_start_once failed" );
+    }
 
     return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_pms7003_set_duty_cycle failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
 }
 
 esp_err_t airshift_pms7003_get( pms7003_data_t *pms7003_data )
 {
-    esp_err_t   ret                                 = ESP_FAIL;
-    uint8_t     read_buffer[RECEIVE_BUFFER_SIZE]    = { 0 };
-    int         bytes_read                          = 0;
-    uint8_t     passive_mode[]                      = { 0x42, 0x4D, 0xE2, 0x00, 0x00, 0x01, 0x71 };
-
-    ESP_LOGI( TAG, "airshift_pms7003_get" );
+    esp_err_t   ret         = ESP_OK;
+    int64_t     timestamp   = 0;
+    int64_t     stale       = STALE_TIMEOUT_US;
+    bool        held        = false;
 
     // reset output ...
     memset( pms7003_data, 0, sizeof( pms7003_data_t ) );
 
-    // set passive mode ...
-    uart_write_bytes( UART_PORT, passive_mode, sizeof( passive_mode ) );
+    // the reader task keeps the latest validated frame, no uart traffic here ...
+    portENTER_CRITICAL( &lock_ );
 
-    // uart_read_bytes ...
-    bytes_read = uart_read_bytes( UART_PORT, read_buffer, sizeof( read_buffer ), ( 1000 / portTICK_PERIOD_MS ) );
+    *pms7003_data   = latest_;
+    timestamp       = latest_timestamp_;
 
-    ESP_GOTO_ON_FALSE( ( bytes_read > 0 ), ret, error, TAG, "uart_read_bytes no bytes read" );
+    // between measurement windows the last window's frame is held, for up to a whole period, it is not a new reading ...
+    if( ( duty_state_ == DUTY_STATE_SETTLING ) || ( duty_state_ == DUTY_STATE_SLEEPING ) )
+    {
+        stale   += (int64_t)stats_.period_ms * 1000;
+        held    = true;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( timestamp == 0 )
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    else if( ( esp_timer_get_time() - timestamp ) > stale )
+    {
+        ret = ESP_ERR_TIMEOUT;
+
+        airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_UART_TIMEOUTS );
+    }
+    else if( held == true )
+    {
+        ret = ESP_ERR_NOT_FINISHED;
+    }
+
+    return ret;
+}
+
+esp_err_t airshift_pms7003_get_stats( pms7003_stats_t *pms7003_stats )
+{
+    if( pms7003_stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *pms7003_stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    // running right now counts up to now ...
+    if( awake_ == true )
+    {
+        pms7003_stats->awake_time += esp_timer_get_time() - awake_since_;
+    }
+
+    return ESP_OK;
+}
+
+// Private functions
+static esp_err_t send_command( uint8_t command, uint16_t data )
+{
+    uint8_t     buffer[7]   = { START_CHARACTER_1, START_CHARACTER_2, command, (uint8_t)( data >> 8 ), (uint8_t)data, 0, 0 };
+    uint16_t    checksum    = 0;
 
-    for( size_t i = 0; i < bytes_read; i++ )
+    for( size_t i = 0; i < 5; i++ )
     {
-        // must make sure enough sapce for data left ...
-        if( ( bytes_read - i ) < sizeof( pms7003_data_t ) )
+        checksum += buffer[i];
+    }
+
+    buffer[5] = (uint8_t)( checksum >> 8 );
+    buffer[6] = (uint8_t)checksum;
+
+    return ( uart_write_bytes( UART_PORT, buffer, sizeof( buffer ) ) == sizeof( buffer ) ) ? ESP_OK : ESP_FAIL;
+}
+
+static void reader_task( void *arguments )
+{
+    parser_t        parser                              = { 0 };
+    uart_event_t    event                               = { 0 };
+    uint8_t         read_buffer[RECEIVE_BUFFER_SIZE]    = { 0 };
+
+    ESP_LOGI( TAG, "reader_task" );
+
+    parser_reset( &parser );
+
+    while( true )
+    {
+        if( xQueueReceive( uart_queue_, &event, portMAX_DELAY ) != pdTRUE )
         {
-            ESP_LOGE( TAG, "pms7003 data not found: %d, %d", bytes_read, i );
+            continue;
+        }
+
+        switch( event.type )
+        {
+            case UART_DATA:
+            {
+                size_t remaining = event.size;
 
-            goto error;
+                while( remaining > 0 )
+                {
+                    int bytes_read = uart_read_bytes( UART_PORT, read_buffer, ( remaining < sizeof( read_buffer ) ) ? remaining : sizeof( read_buffer ), 0 );
+
+                    if( bytes_read <= 0 )
+                    {
+                        break;
+                    }
+
+                    for( int i = 0; i < bytes_read; i++ )
+                    {
+                        parser_feed( &parser, read_buffer[i] );
+                    }
+
+                    remaining -= bytes_read;
+                }
+
+                break;
+            }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+            {
+                // bytes were lost, drop everything buffered and start hunting for a frame again ...
+                ESP_LOGW( TAG, "uart overflow: %d", event.type );
+
+                uart_flush_input( UART_PORT );
+                xQueueReset( uart_queue_ );
+
+                parser_reset( &parser );
+
+                portENTER_CRITICAL( &lock_ );
+                stats_.overflows++;
+                portEXIT_CRITICAL( &lock_ );
+
+                airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_UART_OVERFLOWS );
+
+                break;
+            }
+            default:
+            {
+                break;
+            }
         }
+    }
+
+    vTaskDelete( NULL );
+}
+
+static void parser_reset( parser_t *parser )
+{
+    parser->state       = PARSER_STATE_START_1;
+    parser->index       = 0;
+    parser->frame_size  = 0;
+}
 
-        // look for start ...
-        if( ( read_buffer[i] == START_CHARACTER_1 ) && ( read_buffer[i + 1] == START_CHARACTER_2 ) )
+static void parser_feed( parser_t *parser, uint8_t byte )
+{
+    switch( parser->state )
+    {
+        case PARSER_STATE_START_1:
         {
-            uint16_t calculated_checksum = 0;
+            if( byte == START_CHARACTER_1 )
+            {
+                parser->frame[0]    = byte;
+                parser->state       = PARSER_STATE_START_2;
+            }
+            else
+            {
+                portENTER_CRITICAL( &lock_ );
+                stats_.bytes_discarded++;
+                portEXIT_CRITICAL( &lock_ );
+            }
 
-            pms7003_data->frame_length  = airshift_make_word( read_buffer[i + 2], read_buffer[i + 3] );
+            break;
+        }
+        case PARSER_STATE_START_2:
+        {
+            if( byte == START_CHARACTER_2 )
+            {
+                parser->frame[1]    = byte;
+                parser->state       = PARSER_STATE_LENGTH_H;
+            }
+            else
+            {
+                portENTER_CRITICAL( &lock_ );
+                stats_.bytes_discarded++;
+                stats_.resyncs++;
+                portEXIT_CRITICAL( &lock_ );
 
-            pms7003_data->pm_sp_ug_1_0  = airshift_make_word( read_buffer[i + 4], read_buffer[i + 5] );
-            pms7003_data->pm_sp_ug_2_5  = airshift_make_word( read_buffer[i + 6], read_buffer[i + 7] );
-            pms7003_data->pm_sp_ug_10_0 = airshift_make_word( read_buffer[i + 8], read_buffer[i + 9] );
+                // a repeated start character may itself begin the next frame ...
+                parser->state = ( byte == START_CHARACTER_1 ) ? PARSER_STATE_START_2 : PARSER_STATE_START_1;
+            }
 
-            pms7003_data->pm_ae_ug_1_0  = airshift_make_word( read_buffer[i + 10], read_buffer[i + 11] );
-            pms7003_data->pm_ae_ug_2_5  = airshift_make_word( read_buffer[i + 12], read_buffer[i + 13] );
-            pms7003_data->pm_ae_ug_10_0 = airshift_make_word( read_buffer[i + 14], read_buffer[i + 15] );
+            break;
+        }
+        case PARSER_STATE_LENGTH_H:
+        {
+            parser->frame[2]    = byte;
+            parser->state       = PARSER_STATE_LENGTH_L;
 
-            pms7003_data->pm_raw_0_3    = airshift_make_word( read_buffer[i + 16], read_buffer[i + 17] );
-            pms7003_data->pm_raw_0_5    = airshift_make_word( read_buffer[i + 18], read_buffer[i + 19] );
-            pms7003_data->pm_raw_1_0    = airshift_make_word( read_buffer[i + 20], read_buffer[i + 21] );
-            pms7003_data->pm_raw_2_5    = airshift_make_word( read_buffer[i + 22], read_buffer[i + 23] );
-            pms7003_data->pm_raw_5_0    = airshift_make_word( read_buffer[i + 24], read_buffer[i + 25] );
-            pms7003_data->pm_raw_10_0   = airshift_make_word( read_buffer[i + 26], read_buffer[i + 27] );
+            break;
+        }
+        case PARSER_STATE_LENGTH_L:
+        {
+            uint16_t frame_length = airshift_make_word( parser->frame[2], byte );
 
-            pms7003_data->checksum      = airshift_make_word( read_buffer[i + 30], read_buffer[i + 31] );
+            parser->frame[3] = byte;
 
-            // calculate checksum ...
-            for( size_t x = i; x < ( i + 30 ); x++ )
+            if( ( frame_length != FRAME_DATA_LENGTH ) && ( frame_length != FRAME_COMMAND_LENGTH ) )
             {
-                calculated_checksum += read_buffer[x];
+                portENTER_CRITICAL( &lock_ );
+                stats_.length_errors++;
+                stats_.resyncs++;
+                portEXIT_CRITICAL( &lock_ );
+
+                parser_reset( parser );
+
+                break;
             }
 
-            ESP_LOGI( TAG, "pms7003_data: frame_length: %hu, checksum: %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, %hu, calculated_checksum: %hu",
-                pms7003_data->frame_length,
-                pms7003_data->checksum,
-                pms7003_data->pm_sp_ug_1_0,
-                pms7003_data->pm_sp_ug_2_5,
-                pms7003_data->pm_sp_ug_10_0,
-                pms7003_data->pm_ae_ug_1_0,
-                pms7003_data->pm_ae_ug_2_5,
-                pms7003_data->pm_ae_ug_10_0,
-                pms7003_data->pm_raw_0_3, 
-                pms7003_data->pm_raw_0_5, 
-                pms7003_data->pm_raw_1_0, 
-                pms7003_data->pm_raw_2_5, 
-                pms7003_data->pm_raw_5_0, 
-                pms7003_data->pm_raw_10_0, 
-                calculated_checksum );
+            parser->frame_size  = FRAME_HEADER_SIZE + frame_length;
+            parser->index       = FRAME_HEADER_SIZE;
+            parser->state       = PARSER_STATE_PAYLOAD;
+
+            break;
+        }
+        case PARSER_STATE_PAYLOAD:
+        {
+            parser->frame[parser->index++] = byte;
+
+            if( parser->index == parser->frame_size )
+            {
+                parser_frame_complete( parser );
+
+                parser_reset( parser );
+            }
 
             break;
         }
     }
+}
 
-    return ESP_OK;
+static void parser_frame_complete( parser_t *parser )
+{
+    const uint8_t   *frame              = parser->frame;
+    uint16_t        calculated_checksum = 0;
+    uint16_t        checksum            = airshift_make_word( frame[parser->frame_size - 2], frame[parser->frame_size - 1] );
+    pms7003_data_t  data                = { 0 };
 
-error:
+    // checksum is the sum of every byte before it, start characters included ...
+    for( size_t i = 0; i < ( parser->frame_size - 2 ); i++ )
+    {
+        calculated_checksum += frame[i];
+    }
 
-    ESP_LOGE( TAG, "airshift_pms7003_get failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    if( calculated_checksum != checksum )
+    {
+        portENTER_CRITICAL( &lock_ );
+        stats_.checksum_errors++;
+        stats_.resyncs++;
+        portEXIT_CRITICAL( &lock_ );
 
-    return ret;
+        airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS );
+
+        return;
+    }
+
+    // command acknowledge frames carry no measurement ...
+    if( parser->frame_size != FRAME_MAX_SIZE )
+    {
+        return;
+    }
+
+    data.frame_length   = airshift_make_word( frame[2], frame[3] );
+
+    data.pm_sp_ug_1_0   = airshift_make_word( frame[4], frame[5] );
+    data.pm_sp_ug_2_5   = airshift_make_word( frame[6], frame[7] );
+    data.pm_sp_ug_10_0  = airshift_make_word( frame[8], frame[9] );
+
+    data.pm_ae_ug_1_0   = airshift_make_word( frame[10], frame[11] );
+    data.pm_ae_ug_2_5   = airshift_make_word( frame[12], frame[13] );
+    data.pm_ae_ug_10_0  = airshift_make_word( frame[14], frame[15] );
+
+    data.pm_raw_0_3     = airshift_make_word( frame[16], frame[17] );
+    data.pm_raw_0_5     = airshift_make_word( frame[18], frame[19] );
+    data.pm_raw_1_0     = airshift_make_word( frame[20], frame[21] );
+    data.pm_raw_2_5     = airshift_make_word( frame[22], frame[23] );
+    data.pm_raw_5_0     = airshift_make_word( frame[24], frame[25] );
+    data.pm_raw_10_0    = airshift_make_word( frame[26], frame[27] );
+
+    data.reserved       = airshift_make_word( frame[28], frame[29] );
+    data.checksum       = checksum;
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.frames++;
+
+    // the fan is still spinning up, or a frame raced the sleep command ...
+    if( ( duty_state_ == DUTY_STATE_SETTLING ) || ( duty_state_ == DUTY_STATE_SLEEPING ) )
+    {
+        stats_.settling_frames++;
+
+        portEXIT_CRITICAL( &lock_ );
+
+        return;
+    }
+
+    latest_             = data;
+    latest_timestamp_   = esp_timer_get_time();
+    window_frames_++;
+    window_sum_        += data.pm_sp_ug_2_5;
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+static void duty_timer_callback( void *arguments )
+{
+    duty_state_t    state   = DUTY_STATE_CONTINUOUS;
+    uint32_t        frames  = 0;
+    uint32_t        sum     = 0;
+    uint32_t        period  = 0;
+    uint32_t        awake   = duty_cycle_.settle_ms + duty_cycle_.measure_ms;
+
+    portENTER_CRITICAL( &lock_ );
+
+    state           = duty_state_;
+    frames          = window_frames_;
+    sum             = window_sum_;
+    window_frames_  = 0;
+    window_sum_     = 0;
+
+    // settled, every frame from here on counts ...
+    if( state == DUTY_STATE_SETTLING )
+    {
+        duty_state_ = DUTY_STATE_MEASURING;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    switch( state )
+    {
+        case DUTY_STATE_SETTLING:
+        {
+            esp_timer_start_once( duty_timer_, (uint64_t)duty_cycle_.measure_ms * 1000 );
+
+            break;
+        }
+        case DUTY_STATE_MEASURING:
+        {
+            period = next_period( frames, sum );
+
+            portENTER_CRITICAL( &lock_ );
+
+            stats_.period_ms = period;
+
+            // a period too short to sleep in keeps measuring ...
+            if( period > awake )
+            {
+                duty_state_ = DUTY_STATE_SLEEPING;
+            }
+
+            portEXIT_CRITICAL( &lock_ );
+
+            if( period > awake )
+            {
+                ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_pms7003_sleep() );
+            }
+
+            esp_timer_start_once( duty_timer_, (uint64_t)( ( period > awake ) ? ( period - awake ) : duty_cycle_.measure_ms ) * 1000 );
+
+            break;
+        }
+        case DUTY_STATE_SLEEPING:
+        {
+            ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_pms7003_wakeup() );
+
+            portENTER_CRITICAL( &lock_ );
+            duty_state_ = DUTY_STATE_SETTLING;
+            portEXIT_CRITICAL( &lock_ );
+
+            esp_timer_start_once( duty_timer_, (uint64_t)duty_cycle_.settle_ms * 1000 );
+
+            break;
+        }
+        default:
+        {
+            break;
+        }
+    }
 }
 
-// Private functions
\ No newline at end of file
+static uint32_t next_period( uint32_t frames, uint32_t sum )
+{
+    int32_t     average = 0;
+    uint32_t    period  = 0;
+
+    portENTER_CRITICAL( &lock_ );
+    period = stats_.period_ms;
+    portEXIT_CRITICAL( &lock_ );
+
+    // a silent window says nothing about the air, look again soon ...
+    if( frames == 0 )
+    {
+        return duty_cycle_.period_min_ms;
+    }
+
+    average = (int32_t)( sum / frames );
+
+    // pm is moving, sample at the fastest rate, otherwise back off ...
+    if( ( previous_average_ < 0 ) || ( abs( average - previous_average_ ) >= duty_cycle_.change_threshold ) )
+    {
+        period = duty_cycle_.period_min_ms;
+    }
+    else
+    {
+        period = ( period > ( duty_cycle_.period_max_ms / 2 ) ) ? duty_cycle_.period_max_ms : ( period * 2 );
+    }
+
+    AIRSHIFT_TRACED( TAG, "next_period -> frames: %lu, pm2.5: %ld ( was %ld ), period: %lu ms", frames, average, previous_average_, period );
+
+    previous_average_ = average;
+
+    return period;
+}
@@ -30,13 +30,43 @@ typedef struct
     uint16_t checksum;
 } pms7003_data_t;
 
+typedef struct
+{
+    uint32_t frames;            // frames that passed length and checksum validation
+    uint32_t checksum_errors;
+    uint32_t length_errors;
+    uint32_t resyncs;           // times the decoder lost frame alignment and had to hunt for a start sequence
+    uint32_t bytes_discarded;   // bytes skipped while hunting for a start sequence
+    uint32_t overflows;         // uart fifo or ring buffer overflows
+    uint32_t settling_frames;   // valid frames discarded while the fan spun up
+    uint32_t wakeups;
+    uint32_t period_ms;         // current wake to wake period, 0 runs continuously
+    int64_t  awake_time;        // us, fan and laser running
+} pms7003_stats_t;
+
+// Duty cycle of the fan and laser, the sensor sleeps between measurement windows. The period shrinks to period_min_ms as soon
+// as pm2.5 moves by change_threshold between windows and doubles up to period_max_ms while it holds steady ...
+typedef struct
+{
+    uint32_t period_min_ms;     // wake to wake, 0 keeps the sensor running
+    uint32_t period_max_ms;
+    uint32_t settle_ms;         // fan spin up after a wakeup, frames are discarded
+    uint32_t measure_ms;        // frames are kept, then the sensor goes back to sleep
+    uint16_t change_threshold;  // ug/m3 pm2.5, window to window
+} pms7003_duty_cycle_t;
+
 esp_err_t   airshift_pms7003_init();
 esp_err_t   airshift_pms7003_release();
 
 esp_err_t   airshift_pms7003_sleep();
 esp_err_t   airshift_pms7003_wakeup();
 
+// init starts the default duty cycle, a new one starts over with a wakeup ...
+esp_err_t   airshift_pms7003_set_duty_cycle( const pms7003_duty_cycle_t *duty_cycle );
+
+// ESP_ERR_NOT_FINISHED while the sensor sleeps between windows, pms7003_data then holds the last window's frame again ...
 esp_err_t   airshift_pms7003_get( pms7003_data_t *pms7003_data );
+esp_err_t   airshift_pms7003_get_stats( pms7003_stats_t *pms7003_stats );
 
 #ifdef __cplusplus
 }
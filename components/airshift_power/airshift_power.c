@@ -0,0 +1,225 @@
+#include "airshift_power.h"
+#include "airshift_event.h"
+
+#include <esp_pm.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+
+#define CPU_FREQUENCY_MAX_MHZ   CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#define CPU_FREQUENCY_MIN_MHZ   40      // xtal, apb follows it down when nothing holds a lock
+#define LIGHT_SLEEP_ENABLE      true    // needs CONFIG_FREERTOS_USE_TICKLESS_IDLE
+
+typedef struct
+{
+    const char          *name;
+    esp_pm_lock_type_t  type;
+} lock_descriptor_t;
+
+static const char* TAG = "airshift_power";
+
+// Forward declarations
+static void         ip_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data );
+static int          power_command( int argc, char **argv );
+
+static const lock_descriptor_t locks_[AIRSHIFT_POWER_LOCK_COUNT] =
+{
+    [AIRSHIFT_POWER_LOCK_SENSOR]    = { .name = "sensor",   .type = ESP_PM_NO_LIGHT_SLEEP },
+    [AIRSHIFT_POWER_LOCK_DISPLAY]   = { .name = "display",  .type = ESP_PM_CPU_FREQ_MAX },
+    [AIRSHIFT_POWER_LOCK_NETWORK]   = { .name = "network",  .type = ESP_PM_CPU_FREQ_MAX },
+};
+
+static const esp_console_cmd_t  command_        = { .command = "power", .help = "Power lock hold times and the time spent in each power mode", .hint = NULL, .func = &power_command };
+
+static esp_event_handler_instance_t     ip_event_handler_instance_  = NULL;
+static esp_pm_lock_handle_t             handles_[AIRSHIFT_POWER_LOCK_COUNT]     = { 0 };
+static uint32_t                         holders_[AIRSHIFT_POWER_LOCK_COUNT]     = { 0 };
+static int64_t                          acquired_at_[AIRSHIFT_POWER_LOCK_COUNT] = { 0 };
+static portMUX_TYPE                     lock_                       = portMUX_INITIALIZER_UNLOCKED;
+static airshift_power_stats_t           stats_                      = { 0 };
+
+// Public functions
+esp_err_t airshift_power_init()
+{
+    esp_err_t       ret     = ESP_FAIL;
+    esp_pm_config_t config  = { .max_freq_mhz = CPU_FREQUENCY_MAX_MHZ, .min_freq_mhz = CPU_FREQUENCY_MIN_MHZ, .light_sleep_enable = LIGHT_SLEEP_ENABLE };
+
+    ESP_LOGI( TAG, "airshift_power_init" );
+
+    // reset variables ...
+    memset( &stats_, 0, sizeof( stats_ ) );
+    memset( holders_, 0, sizeof( holders_ ) );
+
+    stats_.since = esp_timer_get_time();
+
+    ESP_GOTO_ON_ERROR( esp_pm_configure( &config ), error, TAG, "esp_pm_configure failed" );
+
+    for( int i = 0; i < AIRSHIFT_POWER_LOCK_COUNT; i++ )
+    {
+        ESP_GOTO_ON_ERROR( esp_pm_lock_create( locks_[i].type, 0, locks_[i].name, &handles_[i] ), error, TAG, "esp_pm_lock_create -> %s failed", locks_[i].name );
+    }
+
+    // the station sleeps between dtim beacons, esp_wifi only accepts it once it is started ...
+    ESP_GOTO_ON_ERROR( esp_event_handler_instance_register( AIRSHIFT_EVENT_MATTER, AIRSHIFT_EVENT_MATTER_IP_EVENT_STA_GOT_IP, ip_event_handler, NULL, &ip_event_handler_instance_ ), error, TAG, "esp_event_handler_instance_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_power_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    // clean up on failure ...
+    ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_power_release() );
+
+    return ret;
+}
+
+esp_err_t airshift_power_release()
+{
+    ESP_LOGI( TAG, "airshift_power_release" );
+
+    if( ip_event_handler_instance_ != NULL )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_handler_instance_unregister( AIRSHIFT_EVENT_MATTER, AIRSHIFT_EVENT_MATTER_IP_EVENT_STA_GOT_IP, ip_event_handler_instance_ ) );
+
+        ip_event_handler_instance_ = NULL;
+    }
+
+    for( int i = 0; i < AIRSHIFT_POWER_LOCK_COUNT; i++ )
+    {
+        if( handles_[i] == NULL )
+        {
+            continue;
+        }
+
+        // a lock still held cannot be deleted ...
+        while( holders_[i] > 0 )
+        {
+            airshift_power_unlock( i );
+        }
+
+        ESP_ERROR_CHECK_WITHOUT_ABORT( esp_pm_lock_delete( handles_[i] ) );
+
+        handles_[i] = NULL;
+    }
+
+    return ESP_OK;
+}
+
+void airshift_power_lock( airshift_power_lock_t lock )
+{
+    if( ( lock >= AIRSHIFT_POWER_LOCK_COUNT ) || ( handles_[lock] == NULL ) )
+    {
+        return;
+    }
+
+    esp_pm_lock_acquire( handles_[lock] );
+
+    portENTER_CRITICAL( &lock_ );
+
+    if( holders_[lock]++ == 0 )
+    {
+        acquired_at_[lock] = esp_timer_get_time();
+
+        stats_.acquisitions[lock]++;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+void airshift_power_unlock( airshift_power_lock_t lock )
+{
+    bool held = false;
+
+    if( ( lock >= AIRSHIFT_POWER_LOCK_COUNT ) || ( handles_[lock] == NULL ) )
+    {
+        return;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    // an unbalanced unlock must not release someone else's hold ...
+    held = ( holders_[lock] > 0 );
+
+    if( held && ( --holders_[lock] == 0 ) )
+    {
+        stats_.held_time[lock] += esp_timer_get_time() - acquired_at_[lock];
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( held )
+    {
+        esp_pm_lock_release( handles_[lock] );
+    }
+}
+
+esp_err_t airshift_power_get_stats( airshift_power_stats_t *stats )
+{
+    int64_t now = esp_timer_get_time();
+
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    // a lock held right now counts up to now ...
+    for( int i = 0; i < AIRSHIFT_POWER_LOCK_COUNT; i++ )
+    {
+        stats->held_time[i] += ( holders_[i] > 0 ) ? ( now - acquired_at_[i] ) : 0;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_power_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_power_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_power_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static void ip_event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data )
+{
+    ESP_LOGI( TAG, "ip_event_handler -> modem sleep" );
+
+    // the radio wakes for every dtim beacon, anything buffered at the access point arrives then, transmissions wake it on demand ...
+    ESP_ERROR_CHECK_WITHOUT_ABORT( esp_wifi_set_ps( WIFI_PS_MIN_MODEM ) );
+}
+
+static int power_command( int argc, char **argv )
+{
+    airshift_power_stats_t  stats   = { 0 };
+    int64_t                 window  = 0;
+
+    airshift_power_get_stats( &stats );
+
+    window = esp_timer_get_time() - stats.since;
+
+    printf( "window: %lld s\n", window / ( 1000 * 1000 ) );
+    printf( "%-10s %12s %12s %8s\n", "lock", "acquired", "held ms", "held %" );
+
+    for( int i = 0; i < AIRSHIFT_POWER_LOCK_COUNT; i++ )
+    {
+        printf( "%-10s %12lu %12lld %8.2f\n", locks_[i].name, stats.acquisitions[i], stats.held_time[i] / 1000, ( window > 0 ) ? ( 100.0 * (double)stats.held_time[i] / (double)window ) : 0.0 );
+    }
+
+    // every lock in the system, ours and the drivers', and with CONFIG_PM_PROFILING the time in each mode, light sleep included ...
+    esp_pm_dump_locks( stdout );
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef AIRSHIFT_POWER_H
+#define AIRSHIFT_POWER_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Activities that keep the chip out of automatic light sleep, the rest of the time it runs at the lowest frequency or sleeps
+// until the next timer, interrupt or dtim beacon ...
+typedef enum
+{
+    AIRSHIFT_POWER_LOCK_SENSOR,     // uart and i2c traffic, no light sleep, the peripherals lose their clock
+    AIRSHIFT_POWER_LOCK_DISPLAY,    // lvgl rendering, full cpu frequency so the frame is done and the chip back asleep sooner
+    AIRSHIFT_POWER_LOCK_NETWORK,    // a burst of mqtt messages, full cpu frequency for the same reason
+    AIRSHIFT_POWER_LOCK_COUNT
+} airshift_power_lock_t;
+
+typedef struct
+{
+    uint32_t    acquisitions[AIRSHIFT_POWER_LOCK_COUNT];
+    int64_t     held_time[AIRSHIFT_POWER_LOCK_COUNT];   // us, the lock held by at least one holder
+    int64_t     since;                                  // counting started ( esp_timer_get_time base, us )
+} airshift_power_stats_t;
+
+// Configures dfs and automatic light sleep, modem sleep follows once the station has an address ...
+esp_err_t   airshift_power_init();
+esp_err_t   airshift_power_release();
+
+// Any task, nests, every lock needs its unlock ...
+void        airshift_power_lock( airshift_power_lock_t lock );
+void        airshift_power_unlock( airshift_power_lock_t lock );
+
+esp_err_t   airshift_power_get_stats( airshift_power_stats_t *stats );
+
+// adds the "power" command to an initialized esp_console, lock hold times and the time in each power mode ...
+esp_err_t   airshift_power_register_console();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_POWER_H
@@ -1,16 +1,63 @@
 #include "airshift_senseair.h"
+#include "airshift_common.h"
+#include "airshift_metrics.h"
 
+#include <esp_timer.h>
 #include <driver/uart.h>
 #include <driver/gpio.h>
+#include <freertos/semphr.h>
 
-#define UART_PORT           UART_NUM_1
-#define TX_PIN              GPIO_NUM_7
-#define RX_PIN              GPIO_NUM_6
-#define RECEIVE_BUFFER_SIZE 128
+#define UART_PORT                   UART_NUM_1
+#define TX_PIN                      GPIO_NUM_7
+#define RX_PIN                      GPIO_NUM_6
+#define RECEIVE_BUFFER_SIZE         128
+#define UART_RING_BUFFER_SIZE       ( RECEIVE_BUFFER_SIZE * 2 )
+#define UART_QUEUE_SIZE             8
+
+#define MODBUS_ADDRESS_ANY          0xfe
+#define MODBUS_READ_HOLDING         0x03
+#define MODBUS_READ_INPUT           0x04
+#define MODBUS_EXCEPTION            0x80
+#define MODBUS_REQUEST_SIZE         8
+#define MODBUS_EXCEPTION_SIZE       5
+#define MODBUS_RESPONSE_SIZE( n )   ( 5 + ( 2 * ( n ) ) )
+#define MODBUS_RESPONSE_TIMEOUT_MS  250
+
+#define INPUT_METER_STATUS          0x0000  // IR1 .. IR4 are read in a single transaction
+#define INPUT_REGISTER_COUNT        4
+#define HOLDING_ABC_PERIOD          0x001f  // HR32
+
+#define READER_TASK_STACK_SIZE      3072
+#define READER_TASK_PRIORITY        9
+
+typedef struct
+{
+    bool        active;
+    uint8_t     function;   // the reply has to echo it, anything else answers an abandoned request
+    uint8_t     response[MODBUS_RESPONSE_SIZE( INPUT_REGISTER_COUNT )];
+    size_t      expected;
+    size_t      received;
+    esp_err_t   result;
+    int64_t     started;
+} transaction_t;
 
 static const char* TAG = "airshift_senseair";
 
 // Forward declarations
+static esp_err_t    modbus_request( uint8_t function, uint16_t address, uint16_t count );
+static esp_err_t    modbus_wait( uint16_t *registers, uint16_t count, TickType_t ticks_to_wait );
+static esp_err_t    modbus_read( uint8_t function, uint16_t address, uint16_t *registers, uint16_t count );
+static uint16_t     modbus_crc16( const uint8_t *data, size_t length );
+static void         reader_task( void *arguments );
+static void         receive( const uint8_t *data, size_t length );
+
+static QueueHandle_t        uart_queue_     = NULL;
+static TaskHandle_t         reader_task_    = NULL;
+static SemaphoreHandle_t    done_           = NULL;
+static portMUX_TYPE         lock_           = portMUX_INITIALIZER_UNLOCKED;
+static transaction_t        transaction_    = { 0 };
+static senseair_stats_t     stats_          = { 0 };
+static uint16_t             abc_period_     = 0;
 
 // Public functions
 esp_err_t airshift_senseair_init()
@@ -20,8 +67,17 @@ esp_err_t airshift_senseair_init()
 
     ESP_LOGI( TAG, "airshift_senseair_init" );
 
-    // uart_driver_install
-    ESP_GOTO_ON_ERROR( uart_driver_install( UART_PORT, ( RECEIVE_BUFFER_SIZE * 2 ), 0, 0, NULL, 0 ), error, TAG, "uart_driver_install failed" );
+    // reset variables ...
+    memset( &transaction_, 0, sizeof( transaction_ ) );
+    memset( &stats_, 0, sizeof( stats_ ) );
+    abc_period_ = 0;
+
+    done_ = xSemaphoreCreateBinary();
+
+    ESP_GOTO_ON_FALSE( ( done_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xSemaphoreCreateBinary failed" );
+
+    // uart_driver_install, with an event queue so replies complete as soon as they arrive, the isr keeps draining the fifo while the flash cache is off ...
+    ESP_GOTO_ON_ERROR( uart_driver_install( UART_PORT, UART_RING_BUFFER_SIZE, 0, UART_QUEUE_SIZE, &uart_queue_, ESP_INTR_FLAG_IRAM ), error, TAG, "uart_driver_install failed" );
 
     // uart_param_config
     ESP_GOTO_ON_ERROR( uart_param_config( UART_PORT, &uart_config ), error, TAG, "uart_param_config failed" );
@@ -29,6 +85,14 @@ esp_err_t airshift_senseair_init()
     // uart_set_pin
     ESP_GOTO_ON_ERROR( uart_set_pin( UART_PORT, TX_PIN, RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE ), error, TAG, "uart_set_pin failed" );
 
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( reader_task, "senseair_reader", READER_TASK_STACK_SIZE, NULL, READER_TASK_PRIORITY, &reader_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> senseair_reader failed" );
+
+    // abc period is configuration, it is read once here and cached, the sensor may still be booting so don't fail on it ...
+    if( modbus_read( MODBUS_READ_HOLDING, HOLDING_ABC_PERIOD, &abc_period_, 1 ) != ESP_OK )
+    {
+        ESP_LOGW( TAG, "abc period not available" );
+    }
+
     return ESP_OK;
 
 error:
@@ -45,37 +109,64 @@ esp_err_t airshift_senseair_release()
 {
     ESP_LOGI( TAG, "airshift_senseair_release" );
 
+    if( reader_task_ != NULL )
+    {
+        vTaskDelete( reader_task_ );
+
+        reader_task_ = NULL;
+    }
+
     ESP_ERROR_CHECK_WITHOUT_ABORT( uart_driver_delete( UART_PORT ) );
 
+    uart_queue_ = NULL;
+
+    if( done_ != NULL )
+    {
+        vSemaphoreDelete( done_ );
+
+        done_ = NULL;
+    }
+
     return ESP_OK;
 }
 
-esp_err_t airshift_senseair_get( uint32_t *value )
+esp_err_t airshift_senseair_request()
 {
-    esp_err_t   ret                                 = ESP_FAIL;
-    uint8_t     read_buffer[RECEIVE_BUFFER_SIZE]    = { 0 };
-    int         bytes_read                          = 0;
-    uint8_t     read_command[]                      = { 0xfe, 0x04, 0x00, 0x03, 0x00, 0x01, 0xd5, 0xc5 };
+    return modbus_request( MODBUS_READ_INPUT, INPUT_METER_STATUS, INPUT_REGISTER_COUNT );
+}
 
-    ESP_LOGI( TAG, "airshift_senseair_get" );
+esp_err_t airshift_senseair_wait( senseair_data_t *senseair_data, TickType_t ticks_to_wait )
+{
+    esp_err_t   ret                                 = ESP_FAIL;
+    uint16_t    registers[INPUT_REGISTER_COUNT]     = { 0 };
 
     // reset output ...
-    *value = 0;
+    memset( senseair_data, 0, sizeof( senseair_data_t ) );
+
+    ESP_GOTO_ON_ERROR( modbus_wait( registers, INPUT_REGISTER_COUNT, ticks_to_wait ), error, TAG, "modbus_wait failed" );
+
+    // format output ...
+    senseair_data->meter_status     = registers[0];
+    senseair_data->alarm_status     = registers[1];
+    senseair_data->output_status    = registers[2];
+    senseair_data->co2              = registers[3];
+    senseair_data->abc_period       = abc_period_;
 
-    // send read request ...
-    uart_write_bytes( UART_PORT, read_command, sizeof( read_command ) );
+    return ESP_OK;
 
-    // uart_read_bytes ...
-    bytes_read = uart_read_bytes( UART_PORT, read_buffer, sizeof( read_buffer ), ( 1000 / portTICK_PERIOD_MS ) );
+error:
 
-    // response must be 7 bytes ...
-    ESP_GOTO_ON_FALSE( ( bytes_read == 7 ), ret, error, TAG, "invalid response received" );
+    return ret;
+}
 
-    // format output ...
-    *value = ( 256 * read_buffer[3] ) + read_buffer[4];
+esp_err_t airshift_senseair_get( senseair_data_t *senseair_data )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_ERROR( airshift_senseair_request(), error, TAG, "airshift_senseair_request failed" );
+
+    ESP_GOTO_ON_ERROR( airshift_senseair_wait( senseair_data, ( MODBUS_RESPONSE_TIMEOUT_MS / portTICK_PERIOD_MS ) ), error, TAG, "airshift_senseair_wait failed" );
 
-    ESP_LOGI( TAG, "airshift_senseair_get: %lu", *value  );
-    
     return ESP_OK;
 
 error:
@@ -85,4 +176,273 @@ error:
     return ret;
 }
 
+esp_err_t airshift_senseair_get_stats( senseair_stats_t *senseair_stats )
+{
+    if( senseair_stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *senseair_stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
 // Private functions
+static esp_err_t modbus_request( uint8_t function, uint16_t address, uint16_t count )
+{
+    uint8_t     request[MODBUS_REQUEST_SIZE]    = { MODBUS_ADDRESS_ANY, function, (uint8_t)( address >> 8 ), (uint8_t)address, (uint8_t)( count >> 8 ), (uint8_t)count, 0, 0 };
+    uint16_t    crc                             = modbus_crc16( request, MODBUS_REQUEST_SIZE - 2 );
+
+    if( ( done_ == NULL ) || ( MODBUS_RESPONSE_SIZE( count ) > sizeof( transaction_.response ) ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // crc is transmitted low byte first ...
+    request[6] = (uint8_t)crc;
+    request[7] = (uint8_t)( crc >> 8 );
+
+    portENTER_CRITICAL( &lock_ );
+
+    if( transaction_.active == true )
+    {
+        portEXIT_CRITICAL( &lock_ );
+
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    transaction_.active     = true;
+    transaction_.function   = function;
+    transaction_.expected   = MODBUS_RESPONSE_SIZE( count );
+    transaction_.received   = 0;
+    transaction_.result     = ESP_ERR_TIMEOUT;
+    transaction_.started    = esp_timer_get_time();
+
+    portEXIT_CRITICAL( &lock_ );
+
+    // drop any completion left over from an abandoned transaction ...
+    xSemaphoreTake( done_, 0 );
+
+    if( uart_write_bytes( UART_PORT, request, sizeof( request ) ) != sizeof( request ) )
+    {
+        portENTER_CRITICAL( &lock_ );
+        transaction_.active = false;
+        portEXIT_CRITICAL( &lock_ );
+
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t modbus_wait( uint16_t *registers, uint16_t count, TickType_t ticks_to_wait )
+{
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+
+    if( xSemaphoreTake( done_, ticks_to_wait ) != pdTRUE )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        // the reply may have completed right after the timeout ...
+        if( transaction_.active == true )
+        {
+            transaction_.active = false;
+
+            stats_.timeouts++;
+        }
+        else
+        {
+            ret = transaction_.result;
+        }
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( ret == ESP_ERR_TIMEOUT )
+        {
+            airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_UART_TIMEOUTS );
+        }
+
+        if( ret != ESP_OK )
+        {
+            return ret;
+        }
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    ret = transaction_.result;
+
+    if( ret == ESP_OK )
+    {
+        for( uint16_t i = 0; i < count; i++ )
+        {
+            registers[i] = airshift_make_word( transaction_.response[3 + ( 2 * i )], transaction_.response[4 + ( 2 * i )] );
+        }
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ret;
+}
+
+static esp_err_t modbus_read( uint8_t function, uint16_t address, uint16_t *registers, uint16_t count )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_ERROR( modbus_request( function, address, count ), error, TAG, "modbus_request failed" );
+
+    ESP_GOTO_ON_ERROR( modbus_wait( registers, count, ( MODBUS_RESPONSE_TIMEOUT_MS / portTICK_PERIOD_MS ) ), error, TAG, "modbus_wait failed" );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static uint16_t modbus_crc16( const uint8_t *data, size_t length )
+{
+    uint16_t crc = 0xffff;
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x0001 ) ? ( ( crc >> 1 ) ^ 0xa001 ) : ( crc >> 1 );
+        }
+    }
+
+    return crc;
+}
+
+static void reader_task( void *arguments )
+{
+    uart_event_t    event                               = { 0 };
+    uint8_t         read_buffer[RECEIVE_BUFFER_SIZE]    = { 0 };
+
+    ESP_LOGI( TAG, "reader_task" );
+
+    while( true )
+    {
+        if( xQueueReceive( uart_queue_, &event, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+
+        switch( event.type )
+        {
+            case UART_DATA:
+            {
+                int bytes_read = uart_read_bytes( UART_PORT, read_buffer, ( event.size < sizeof( read_buffer ) ) ? event.size : sizeof( read_buffer ), 0 );
+
+                if( bytes_read > 0 )
+                {
+                    receive( read_buffer, bytes_read );
+                }
+
+                break;
+            }
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+            {
+                ESP_LOGW( TAG, "uart overflow: %d", event.type );
+
+                uart_flush_input( UART_PORT );
+                xQueueReset( uart_queue_ );
+
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    vTaskDelete( NULL );
+}
+
+static void receive( const uint8_t *data, size_t length )
+{
+    bool complete   = false;
+    bool crc_error  = false;
+
+    portENTER_CRITICAL( &lock_ );
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        if( ( transaction_.active != true ) || ( transaction_.received >= transaction_.expected ) )
+        {
+            stats_.bytes_discarded++;
+
+            continue;
+        }
+
+        transaction_.response[transaction_.received++] = data[i];
+
+        // an exception reply is shorter than the one we asked for ...
+        if( ( transaction_.received == 2 ) && ( ( transaction_.response[1] & MODBUS_EXCEPTION ) != 0 ) )
+        {
+            transaction_.expected = MODBUS_EXCEPTION_SIZE;
+        }
+
+        if( transaction_.received == transaction_.expected )
+        {
+            uint16_t crc = modbus_crc16( transaction_.response, transaction_.expected - 2 );
+
+            if( ( transaction_.response[transaction_.expected - 2] != (uint8_t)crc ) || ( transaction_.response[transaction_.expected - 1] != (uint8_t)( crc >> 8 ) ) )
+            {
+                transaction_.result = ESP_ERR_INVALID_CRC;
+
+                stats_.crc_errors++;
+                crc_error = true;
+            }
+            else if( ( transaction_.response[1] & ~MODBUS_EXCEPTION ) != transaction_.function )
+            {
+                transaction_.result = ESP_ERR_INVALID_RESPONSE;
+            }
+            else if( ( transaction_.response[1] & MODBUS_EXCEPTION ) != 0 )
+            {
+                transaction_.result = ESP_ERR_INVALID_RESPONSE;
+
+                stats_.exceptions++;
+            }
+            else if( transaction_.response[2] != ( transaction_.expected - 5 ) )
+            {
+                transaction_.result = ESP_ERR_INVALID_SIZE;
+            }
+            else
+            {
+                int64_t latency = esp_timer_get_time() - transaction_.started;
+
+                transaction_.result = ESP_OK;
+
+                stats_.transactions++;
+                stats_.latency_last = latency;
+                stats_.latency_max  = ( latency > stats_.latency_max ) ? latency : stats_.latency_max;
+            }
+
+            transaction_.active = false;
+            complete            = true;
+        }
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    if( crc_error == true )
+    {
+        airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS );
+    }
+
+    if( complete == true )
+    {
+        xSemaphoreGive( done_ );
+    }
+}
@@ -7,10 +7,35 @@
 extern "C" {
 #endif
 
+typedef struct
+{
+    uint16_t meter_status;      // IR1, non zero means the sensor reports an error
+    uint16_t alarm_status;      // IR2
+    uint16_t output_status;     // IR3
+    uint16_t co2;               // IR4, ppm
+    uint16_t abc_period;        // HR32, hours, 0 when automatic baseline correction is disabled
+} senseair_data_t;
+
+typedef struct
+{
+    uint32_t transactions;      // replies that passed crc validation
+    uint32_t timeouts;
+    uint32_t crc_errors;
+    uint32_t exceptions;        // modbus exception replies
+    uint32_t bytes_discarded;   // bytes received outside of a transaction
+
+    int64_t  latency_last;      // request written until reply validated ( us )
+    int64_t  latency_max;
+} senseair_stats_t;
+
 esp_err_t   airshift_senseair_init();
 esp_err_t   airshift_senseair_release();
 
-esp_err_t   airshift_senseair_get( uint32_t *value );
+esp_err_t   airshift_senseair_request();
+esp_err_t   airshift_senseair_wait( senseair_data_t *senseair_data, TickType_t ticks_to_wait );
+
+esp_err_t   airshift_senseair_get( senseair_data_t *senseair_data );
+esp_err_t   airshift_senseair_get_stats( senseair_stats_t *senseair_stats );
 
 #ifdef __cplusplus
 }
@@ -1,15 +1,33 @@
 #include "airshift_sht30.h"
 #include "airshift_i2c.h"
 #include "airshift_common.h"
+#include "airshift_metrics.h"
+#include "airshift_trace.h"
 
-#define SHT30_DEVICE_ADDRESS        0x44
+#include <esp_timer.h>
 
-#define SHT30_COMMAND_SOFT_RESET    0x30a2
-#define SHT30_COMMAND_BREAK         0x3093
-#define SHT30_COMMAND_READ_STATUS   0xf32d
-#define SHT30_COMMAND_CLEAR_STATUS  0x3041
-#define SHT30_COMMAND_PERIODIC_10_H 0x2737
-#define SHT30_COMMAND_FETCH_DATA    0xe000
+#define SHT30_DEVICE_ADDRESS            0x44
+
+#define SHT30_COMMAND_SOFT_RESET        0x30a2
+#define SHT30_COMMAND_BREAK             0x3093
+#define SHT30_COMMAND_READ_STATUS       0xf32d
+#define SHT30_COMMAND_CLEAR_STATUS      0x3041
+#define SHT30_COMMAND_FETCH_DATA        0xe000
+
+#define SHT30_SOFT_RESET_MS             2
+#define SHT30_BREAK_MS                  1
+#define SHT30_FETCH_RETRY_MS            5
+#define SHT30_FETCH_RETRIES             3
+
+// single shot reads are used when the sensor would otherwise sit in periodic mode measuring for nobody, and for averaged samples ...
+#define SHT30_SINGLE_SHOT_MIN_PERIOD_MS 2000
+
+typedef struct
+{
+    sht30_mode_t    mode;
+    uint32_t        period_ms;          // 0 for single shot
+    uint16_t        commands[3];        // indexed by sht30_repeatability_t
+} mode_config_t;
 
 static const char* TAG = "airshift_sht30";
 
@@ -17,6 +35,30 @@ static const char* TAG = "airshift_sht30";
 static esp_err_t    write_command( uint16_t command );
 static esp_err_t    read_command( uint16_t command, uint8_t *read_buffer, size_t buffer_size );
 static uint8_t      calc_crc8( uint8_t *data, int len );
+static esp_err_t    apply_mode( const mode_config_t *mode );
+static esp_err_t    read_single_shot( sht30_data_t *sht30_data );
+static esp_err_t    read_periodic( sht30_data_t *sht30_data );
+static esp_err_t    decode( const uint8_t *read_buffer, sht30_data_t *sht30_data );
+static void         delay_us( int64_t delay );
+
+// slowest mode first, clock stretching is enabled for single shot ...
+static const mode_config_t modes_[] =
+{
+    { .mode = SHT30_MODE_SINGLE_SHOT,   .period_ms = 0,     .commands = { 0x2c06, 0x2c0d, 0x2c10 } },
+    { .mode = SHT30_MODE_PERIODIC_0_5,  .period_ms = 2000,  .commands = { 0x2032, 0x2024, 0x202f } },
+    { .mode = SHT30_MODE_PERIODIC_1,    .period_ms = 1000,  .commands = { 0x2130, 0x2126, 0x212d } },
+    { .mode = SHT30_MODE_PERIODIC_2,    .period_ms = 500,   .commands = { 0x2236, 0x2220, 0x222b } },
+    { .mode = SHT30_MODE_PERIODIC_4,    .period_ms = 250,   .commands = { 0x2334, 0x2322, 0x2329 } },
+    { .mode = SHT30_MODE_PERIODIC_10,   .period_ms = 100,   .commands = { 0x2737, 0x2721, 0x272a } },
+};
+
+// maximum measurement duration per repeatability ( us ) ...
+static const int64_t measurement_duration_[] = { 15500, 6500, 4500 };
+
+static const mode_config_t      *mode_          = NULL;
+static sht30_repeatability_t    repeatability_  = SHT30_REPEATABILITY_HIGH;
+static uint8_t                  averaging_      = 1;
+static int64_t                  next_ready_     = 0;
 
 // Public functions
 esp_err_t airshift_sht30_init()
@@ -25,14 +67,18 @@ esp_err_t airshift_sht30_init()
 
     ESP_LOGI( TAG, "airshift_sht30_init" );
 
+    mode_ = NULL;
+
     // issue a break command ...
     ESP_GOTO_ON_ERROR( write_command( SHT30_COMMAND_BREAK ), error, TAG, "write_command -> SHT30_COMMAND_BREAK failed" );
 
     // issue a soft reset  ...
     ESP_GOTO_ON_ERROR( write_command( SHT30_COMMAND_SOFT_RESET ), error, TAG, "write_command -> SHT30_COMMAND_SOFT_RESET failed" );
 
-    // set measurement mode ...
-    ESP_GOTO_ON_ERROR( write_command( SHT30_COMMAND_PERIODIC_10_H ), error, TAG, "write_command -> SHT30_COMMAND_PERIODIC_10_H failed" );
+    delay_us( SHT30_SOFT_RESET_MS * 1000 );
+
+    // set measurement mode, until told otherwise assume one sample every couple of seconds ...
+    ESP_GOTO_ON_ERROR( airshift_sht30_configure( SHT30_SINGLE_SHOT_MIN_PERIOD_MS, 1, SHT30_REPEATABILITY_HIGH ), error, TAG, "airshift_sht30_configure failed" );
 
     return ESP_OK;
 
@@ -47,49 +93,238 @@ esp_err_t airshift_sht30_release()
 {
     ESP_LOGI( TAG, "airshift_sht30_release" );
 
+    // stop periodic measurements, so the sensor drops to idle current ...
+    if( ( mode_ != NULL ) && ( mode_->period_ms != 0 ) )
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT( write_command( SHT30_COMMAND_BREAK ) );
+    }
+
+    mode_ = NULL;
+
     return ESP_OK;
 }
 
+esp_err_t airshift_sht30_configure( uint32_t sample_interval_ms, uint8_t averaging, sht30_repeatability_t repeatability )
+{
+    esp_err_t               ret     = ESP_FAIL;
+    const mode_config_t     *mode   = &modes_[0];
+
+    ESP_GOTO_ON_FALSE( ( ( averaging > 0 ) && ( averaging <= SHT30_AVERAGING_MAX ) && ( repeatability <= SHT30_REPEATABILITY_LOW ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    // periodic mode only ever has the latest reading, averaged samples are a burst of single shots taken when the sample is
+    // read. Otherwise pick the slowest periodic mode that still keeps up, or single shot when sampling is slow enough ...
+    if( ( averaging == 1 ) && ( sample_interval_ms < SHT30_SINGLE_SHOT_MIN_PERIOD_MS ) )
+    {
+        mode = &modes_[( sizeof( modes_ ) / sizeof( modes_[0] ) ) - 1];
+
+        for( size_t i = 1; i < ( sizeof( modes_ ) / sizeof( modes_[0] ) ); i++ )
+        {
+            if( modes_[i].period_ms <= sample_interval_ms )
+            {
+                mode = &modes_[i];
+
+                break;
+            }
+        }
+    }
+
+    averaging_ = averaging;
+
+    if( ( mode == mode_ ) && ( repeatability == repeatability_ ) )
+    {
+        return ESP_OK;
+    }
+
+    repeatability_ = repeatability;
+
+    ESP_LOGI( TAG, "airshift_sht30_configure -> interval: %lu ms, averaging: %u, mode: %d, repeatability: %d", sample_interval_ms, averaging, mode->mode, repeatability );
+
+    ESP_GOTO_ON_ERROR( apply_mode( mode ), error, TAG, "apply_mode failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_sht30_configure failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+sht30_mode_t airshift_sht30_get_mode()
+{
+    return ( mode_ != NULL ) ? mode_->mode : SHT30_MODE_SINGLE_SHOT;
+}
+
 esp_err_t airshift_sht30_get( sht30_data_t *sht30_data )
 {
-    esp_err_t   ret             = ESP_FAIL;
-    uint8_t     read_buffer[6]  = { 0 };
+    esp_err_t ret = ESP_FAIL;
 
-    ESP_LOGI( TAG, "airshift_sht30_get" );
+    AIRSHIFT_TRACED( TAG, "airshift_sht30_get" );
 
     // reset output ...
     memset( sht30_data, 0, sizeof( sht30_data_t ) );
 
-    // read_command ...
-    ESP_GOTO_ON_ERROR( read_command( SHT30_COMMAND_FETCH_DATA, read_buffer, sizeof( read_buffer ) ), error, TAG, "read_command failed" );
+    ESP_GOTO_ON_FALSE( ( mode_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not configured" );
+
+    if( mode_->period_ms == 0 )
+    {
+        ESP_GOTO_ON_ERROR( read_single_shot( sht30_data ), error, TAG, "read_single_shot failed" );
+    }
+    else
+    {
+        ESP_GOTO_ON_ERROR( read_periodic( sht30_data ), error, TAG, "read_periodic failed" );
+    }
+
+    AIRSHIFT_TRACEI( TAG, "airshift_sht30_get -> temperature: %f, humidity: %f", sht30_data->temperature, sht30_data->humidity );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_sht30_get failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static esp_err_t apply_mode( const mode_config_t *mode )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    // leave periodic mode before issuing any other measurement command ...
+    if( ( mode_ != NULL ) && ( mode_->period_ms != 0 ) )
+    {
+        ESP_GOTO_ON_ERROR( write_command( SHT30_COMMAND_BREAK ), error, TAG, "write_command -> SHT30_COMMAND_BREAK failed" );
+
+        delay_us( SHT30_BREAK_MS * 1000 );
+    }
+
+    mode_ = NULL;
+
+    if( mode->period_ms != 0 )
+    {
+        ESP_GOTO_ON_ERROR( write_command( mode->commands[repeatability_] ), error, TAG, "write_command -> periodic mode failed" );
+
+        // first measurement starts right away ...
+        next_ready_ = esp_timer_get_time() + measurement_duration_[repeatability_];
+    }
+
+    mode_ = mode;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t read_single_shot( sht30_data_t *sht30_data )
+{
+    esp_err_t       ret             = ESP_FAIL;
+    sht30_data_t    reading         = { 0 };
+    uint8_t         read_buffer[6]  = { 0 };
+
+    // a burst of measurements back to back, averaging_ times the conversion time, averaged here ...
+    for( uint8_t i = 0; i < averaging_; i++ )
+    {
+        ESP_GOTO_ON_ERROR( write_command( mode_->commands[repeatability_] ), error, TAG, "write_command -> single shot failed" );
+
+        // wait most of the conversion, clock stretching covers whatever is left ...
+        delay_us( measurement_duration_[repeatability_] );
+
+        ESP_GOTO_ON_ERROR( airshift_i2c_read( SHT30_DEVICE_ADDRESS, read_buffer, sizeof( read_buffer ) ), error, TAG, "airshift_i2c_read failed" );
+
+        ESP_GOTO_ON_ERROR( decode( read_buffer, &reading ), error, TAG, "decode failed" );
+
+        sht30_data->temperature += reading.temperature;
+        sht30_data->humidity    += reading.humidity;
+    }
+
+    sht30_data->temperature /= averaging_;
+    sht30_data->humidity    /= averaging_;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t read_periodic( sht30_data_t *sht30_data )
+{
+    esp_err_t       ret             = ESP_FAIL;
+    uint8_t         read_buffer[6]  = { 0 };
+
+    // align the fetch with the next measurement the sensor will actually have ready ...
+    delay_us( next_ready_ - esp_timer_get_time() );
+
+    for( int attempt = 0; ; attempt++ )
+    {
+        ret = read_command( SHT30_COMMAND_FETCH_DATA, read_buffer, sizeof( read_buffer ) );
+
+        if( ret == ESP_OK )
+        {
+            ret = decode( read_buffer, sht30_data );
+        }
+
+        if( ( ret == ESP_OK ) || ( attempt >= SHT30_FETCH_RETRIES ) )
+        {
+            break;
+        }
+
+        // sensor clock runs slightly slower than ours, data not ready yet ...
+        delay_us( SHT30_FETCH_RETRY_MS * 1000 );
+    }
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "fetch failed" );
+
+    // never fetch sooner than one full period after the data we just read ...
+    next_ready_ = esp_timer_get_time() + ( (int64_t)mode_->period_ms * 1000 );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t decode( const uint8_t *read_buffer, sht30_data_t *sht30_data )
+{
+    esp_err_t ret = ESP_FAIL;
 
     // validate temperature data ...
-    ESP_GOTO_ON_FALSE( ( calc_crc8( read_buffer, 2 ) == read_buffer[2] ), ret, error, TAG, "invalid temperature crc" );
+    ESP_GOTO_ON_FALSE( ( calc_crc8( (uint8_t*)read_buffer, 2 ) == read_buffer[2] ), ESP_ERR_INVALID_CRC, error, TAG, "invalid temperature crc" );
 
     // validate humidity data ...
-    ESP_GOTO_ON_FALSE( ( calc_crc8( &read_buffer[3], 2 ) == read_buffer[5] ), ret, error, TAG, "invalid humidity crc" );
+    ESP_GOTO_ON_FALSE( ( calc_crc8( (uint8_t*)&read_buffer[3], 2 ) == read_buffer[5] ), ESP_ERR_INVALID_CRC, error, TAG, "invalid humidity crc" );
 
     // data good, return our results ...
     sht30_data->temperature = ( 175.0f * (float)airshift_make_word( read_buffer[0], read_buffer[1] ) / 65535.0f - 45.0f );
     sht30_data->humidity    = ( 100.0f * ( (float)airshift_make_word( read_buffer[3], read_buffer[4] ) / 65535.0f ) );
 
-    ESP_LOGI( TAG, "airshift_sht30_get -> temperature: %f, humidity: %f", sht30_data->temperature, sht30_data->humidity );
-
     return ESP_OK;
 
 error:
 
-    ESP_LOGE( TAG, "airshift_sht30_get failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+    airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_I2C_CRC_ERRORS );
 
     return ret;
 }
 
-// Private functions
+static void delay_us( int64_t delay )
+{
+    if( delay > 0 )
+    {
+        // round up, never wake before the deadline ...
+        vTaskDelay( ( delay + ( portTICK_PERIOD_MS * 1000 ) - 1 ) / ( portTICK_PERIOD_MS * 1000 ) );
+    }
+}
+
 static esp_err_t write_command( uint16_t command )
 {
     uint8_t write_buffer[2] = { 0 };
 
-    ESP_LOGI( TAG, "write_command: 0x%02hx", command );
+    AIRSHIFT_TRACED( TAG, "write_command: 0x%04hx", command );
 
 	write_buffer[0] = command >> 8;
 	write_buffer[1] = (uint8_t)command;
@@ -101,7 +336,7 @@ static esp_err_t read_command( uint16_t command, uint8_t *read_buffer, size_t bu
 {
     esp_err_t ret = ESP_FAIL;
 
-    ESP_LOGI( TAG, "read_command: 0x%02hx", command );
+    AIRSHIFT_TRACED( TAG, "read_command: 0x%04hx", command );
 
     // write_command ...
     ESP_GOTO_ON_ERROR( write_command( command ), error, TAG, "write_command failed" );
@@ -122,16 +357,16 @@ static uint8_t calc_crc8( uint8_t *data, int len )
 {
     const uint8_t   POLYNOMIAL  = 0x31;
 	uint8_t         crc         = 0xFF;
-	
+
 	for( int i = 0; i < len; ++i )
     {
         crc ^= *data++;
-        
+
         for( int j = 0; j < 8; ++j )
         {
             crc = ( crc & 0x80 ) ? ( crc << 1 ) ^ POLYNOMIAL : ( crc << 1 );
         }
     }
-    
+
     return crc;
 }
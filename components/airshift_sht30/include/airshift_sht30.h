@@ -7,6 +7,26 @@
 extern "C" {
 #endif
 
+// maximum number of readings averaged into one sample ...
+#define SHT30_AVERAGING_MAX 8
+
+typedef enum
+{
+    SHT30_REPEATABILITY_HIGH,
+    SHT30_REPEATABILITY_MEDIUM,
+    SHT30_REPEATABILITY_LOW,
+} sht30_repeatability_t;
+
+typedef enum
+{
+    SHT30_MODE_SINGLE_SHOT,
+    SHT30_MODE_PERIODIC_0_5,
+    SHT30_MODE_PERIODIC_1,
+    SHT30_MODE_PERIODIC_2,
+    SHT30_MODE_PERIODIC_4,
+    SHT30_MODE_PERIODIC_10,
+} sht30_mode_t;
+
 typedef struct
 {
     float temperature;
@@ -16,7 +36,12 @@ typedef struct
 esp_err_t   airshift_sht30_init();
 esp_err_t   airshift_sht30_release();
 
-esp_err_t   airshift_sht30_get( sht30_data_t *sht30_data );
+// picks single shot or the slowest periodic mode that keeps up with sample_interval_ms, averaging > 1 takes that many single shots
+// back to back for every sample and averages them ...
+esp_err_t       airshift_sht30_configure( uint32_t sample_interval_ms, uint8_t averaging, sht30_repeatability_t repeatability );
+sht30_mode_t    airshift_sht30_get_mode();
+
+esp_err_t       airshift_sht30_get( sht30_data_t *sht30_data );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,309 @@
+#include "airshift_telemetry.h"
+#include "airshift_mqtt.h"
+
+#include <cbor.h>
+
+#define TELEMETRY_DEFAULT_MODE      AIRSHIFT_TELEMETRY_MODE_BOTH    // legacy topics stay on until every consumer reads telemetry/<id>
+#define TELEMETRY_DEFAULT_FORMAT    AIRSHIFT_TELEMETRY_FORMAT_CBOR
+#define TELEMETRY_TOPIC             "telemetry/%s"
+#define TELEMETRY_MESSAGE_SIZE      160
+
+static const char* TAG = "airshift_telemetry";
+
+// Forward declarations
+static esp_err_t    encode_json( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length );
+static esp_err_t    encode_json_record( const airshift_history_record_t *record, char *buffer, size_t buffer_size, size_t *length );
+static esp_err_t    encode_cbor( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length );
+static CborError    encode_cbor_record( CborEncoder *encoder, const airshift_history_record_t *record );
+
+static airshift_telemetry_mode_t    mode_       = TELEMETRY_DEFAULT_MODE;
+static airshift_telemetry_format_t  format_     = TELEMETRY_DEFAULT_FORMAT;
+static airshift_telemetry_stats_t   stats_      = { 0 };
+static portMUX_TYPE                 lock_       = portMUX_INITIALIZER_UNLOCKED;
+static char                         topic_[64]  = { 0 };
+
+// Public functions
+esp_err_t airshift_telemetry_init()
+{
+    ESP_LOGI( TAG, "airshift_telemetry_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    snprintf( topic_, sizeof( topic_ ), TELEMETRY_TOPIC, airshift_mqtt_get_client_id() );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_telemetry_release()
+{
+    ESP_LOGI( TAG, "airshift_telemetry_release" );
+
+    return ESP_OK;
+}
+
+void airshift_telemetry_set_mode( airshift_telemetry_mode_t mode )
+{
+    ESP_LOGI( TAG, "airshift_telemetry_set_mode -> %d", mode );
+
+    mode_ = mode;
+}
+
+airshift_telemetry_mode_t airshift_telemetry_get_mode()
+{
+    return mode_;
+}
+
+void airshift_telemetry_set_format( airshift_telemetry_format_t format )
+{
+    ESP_LOGI( TAG, "airshift_telemetry_set_format -> %d", format );
+
+    format_ = format;
+}
+
+airshift_telemetry_format_t airshift_telemetry_get_format()
+{
+    return format_;
+}
+
+esp_err_t airshift_telemetry_encode( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( ( records != NULL ) && ( count > 0 ) && ( buffer != NULL ) && ( length != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    if( format_ == AIRSHIFT_TELEMETRY_FORMAT_JSON )
+    {
+        ret = encode_json( records, count, buffer, buffer_size, length );
+    }
+    else
+    {
+        ret = encode_cbor( records, count, buffer, buffer_size, length );
+    }
+
+    if( ret != ESP_OK )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        stats_.encode_errors++;
+
+        portEXIT_CRITICAL( &lock_ );
+    }
+
+    return ret;
+
+error:
+
+    return ret;
+}
+
+esp_err_t airshift_telemetry_publish( const airshift_history_record_t *record )
+{
+    esp_err_t   ret                                 = ESP_FAIL;
+    uint8_t     message[TELEMETRY_MESSAGE_SIZE]     = { 0 };
+    size_t      length                              = 0;
+
+    ESP_GOTO_ON_ERROR( airshift_telemetry_encode( record, 1, message, sizeof( message ), &length ), error, TAG, "airshift_telemetry_encode failed" );
+
+    ret = airshift_mqtt_publish( topic_, (const char *)message, length );
+
+    portENTER_CRITICAL( &lock_ );
+
+    if( ret == ESP_OK )
+    {
+        stats_.messages++;
+        stats_.samples++;
+        stats_.bytes += length;
+    }
+    else
+    {
+        stats_.publish_errors++;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    ESP_GOTO_ON_ERROR( ret, error, TAG, "airshift_mqtt_publish failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_telemetry_publish failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_telemetry_get_stats( airshift_telemetry_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static esp_err_t encode_json( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length )
+{
+    esp_err_t   ret     = ESP_FAIL;
+    char        *out    = (char *)buffer;
+    size_t      used    = 0;
+    size_t      written = 0;
+
+    // a single record is sent bare, a batch as an array ...
+    if( count > 1 )
+    {
+        ESP_GOTO_ON_FALSE( ( buffer_size > 1 ), ESP_ERR_NO_MEM, error, TAG, "buffer too small" );
+
+        out[used++] = '[';
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        if( i > 0 )
+        {
+            ESP_GOTO_ON_FALSE( ( ( used + 1 ) < buffer_size ), ESP_ERR_NO_MEM, error, TAG, "buffer too small" );
+
+            out[used++] = ',';
+        }
+
+        ESP_GOTO_ON_ERROR( encode_json_record( &records[i], &out[used], buffer_size - used, &written ), error, TAG, "encode_json_record failed" );
+
+        used += written;
+    }
+
+    if( count > 1 )
+    {
+        ESP_GOTO_ON_FALSE( ( ( used + 1 ) < buffer_size ), ESP_ERR_NO_MEM, error, TAG, "buffer too small" );
+
+        out[used++] = ']';
+    }
+
+    *length = used;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+static esp_err_t encode_json_record( const airshift_history_record_t *record, char *buffer, size_t buffer_size, size_t *length )
+{
+    size_t  used    = 0;
+    int     written = 0;
+
+    written = snprintf( buffer, buffer_size, "{\"seq\":%lu,\"ts\":%lu,\"utc\":%s", record->sequence, record->timestamp, ( record->flags & AIRSHIFT_HISTORY_FLAG_UTC ) ? "true" : "false" );
+
+    if( ( written < 0 ) || ( (size_t)written >= buffer_size ) )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    used = written;
+
+    // channels without a reading are left out ...
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        if( record->flags & AIRSHIFT_CHANNEL_BIT( i ) )
+        {
+            written = snprintf( &buffer[used], buffer_size - used, ",\"%s\":%d", airshift_channel_name( i ), record->values[i] );
+
+            if( ( written < 0 ) || ( (size_t)written >= ( buffer_size - used ) ) )
+            {
+                return ESP_ERR_NO_MEM;
+            }
+
+            used += written;
+        }
+    }
+
+    if( ( used + 1 ) >= buffer_size )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    buffer[used++]  = '}';
+    buffer[used]    = '\0';
+    *length         = used;
+
+    return ESP_OK;
+}
+
+static esp_err_t encode_cbor( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length )
+{
+    CborEncoder encoder = { 0 };
+    CborEncoder array   = { 0 };
+    CborError   error   = CborNoError;
+
+    cbor_encoder_init( &encoder, buffer, buffer_size, 0 );
+
+    if( count == 1 )
+    {
+        error = encode_cbor_record( &encoder, &records[0] );
+    }
+    else
+    {
+        error = cbor_encoder_create_array( &encoder, &array, count );
+
+        for( size_t i = 0; ( i < count ) && ( error == CborNoError ); i++ )
+        {
+            error = encode_cbor_record( &array, &records[i] );
+        }
+
+        if( error == CborNoError )
+        {
+            error = cbor_encoder_close_container( &encoder, &array );
+        }
+    }
+
+    if( error != CborNoError )
+    {
+        return ( error & CborErrorOutOfMemory ) ? ESP_ERR_NO_MEM : ESP_FAIL;
+    }
+
+    *length = cbor_encoder_get_buffer_size( &encoder, buffer );
+
+    return ESP_OK;
+}
+
+static CborError encode_cbor_record( CborEncoder *encoder, const airshift_history_record_t *record )
+{
+    CborEncoder map     = { 0 };
+    CborError   error   = CborNoError;
+    size_t      pairs   = 3;
+
+    // a definite length map saves the break byte ...
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        pairs += ( record->flags & AIRSHIFT_CHANNEL_BIT( i ) ) ? 1 : 0;
+    }
+
+    // same keys as the json encoding, so consumers decode both the same way ...
+    error |= cbor_encoder_create_map( encoder, &map, pairs );
+    error |= cbor_encode_text_stringz( &map, "seq" );
+    error |= cbor_encode_uint( &map, record->sequence );
+    error |= cbor_encode_text_stringz( &map, "ts" );
+    error |= cbor_encode_uint( &map, record->timestamp );
+    error |= cbor_encode_text_stringz( &map, "utc" );
+    error |= cbor_encode_boolean( &map, ( record->flags & AIRSHIFT_HISTORY_FLAG_UTC ) != 0 );
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        if( record->flags & AIRSHIFT_CHANNEL_BIT( i ) )
+        {
+            error |= cbor_encode_text_stringz( &map, airshift_channel_name( i ) );
+            error |= cbor_encode_int( &map, record->values[i] );
+        }
+    }
+
+    error |= cbor_encoder_close_container( encoder, &map );
+
+    return error;
+}
@@ -0,0 +1,52 @@
+#ifndef AIRSHIFT_TELEMETRY_H
+#define AIRSHIFT_TELEMETRY_H
+
+#include "airshift_header_common.h"
+#include "airshift_history.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// legacy is one plain text publish per channel ( co2/<id>, temp/<id>, ... ), batched is one telemetry/<id> message per sample ...
+typedef enum
+{
+    AIRSHIFT_TELEMETRY_MODE_LEGACY  = 0x01,
+    AIRSHIFT_TELEMETRY_MODE_BATCHED = 0x02,
+    AIRSHIFT_TELEMETRY_MODE_BOTH    = 0x03,
+} airshift_telemetry_mode_t;
+
+typedef enum
+{
+    AIRSHIFT_TELEMETRY_FORMAT_JSON,
+    AIRSHIFT_TELEMETRY_FORMAT_CBOR,
+} airshift_telemetry_format_t;
+
+typedef struct
+{
+    uint32_t    messages;
+    uint32_t    samples;
+    uint32_t    encode_errors;
+    uint32_t    publish_errors;
+    uint64_t    bytes;          // encoded payload bytes
+} airshift_telemetry_stats_t;
+
+esp_err_t                   airshift_telemetry_init();
+esp_err_t                   airshift_telemetry_release();
+
+void                        airshift_telemetry_set_mode( airshift_telemetry_mode_t mode );
+airshift_telemetry_mode_t   airshift_telemetry_get_mode();
+void                        airshift_telemetry_set_format( airshift_telemetry_format_t format );
+airshift_telemetry_format_t airshift_telemetry_get_format();
+
+// one record encodes as an object, several as an array of objects, values stay fixed point ( see airshift_channel_t ) ...
+esp_err_t                   airshift_telemetry_encode( const airshift_history_record_t *records, size_t count, uint8_t *buffer, size_t buffer_size, size_t *length );
+esp_err_t                   airshift_telemetry_publish( const airshift_history_record_t *record );
+
+esp_err_t                   airshift_telemetry_get_stats( airshift_telemetry_stats_t *stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_TELEMETRY_H
@@ -0,0 +1,477 @@
+#include "airshift_timeseries.h"
+
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_console.h>
+#include <stdlib.h>
+
+// buckets retained per tier, storage is 6 bytes per bucket per channel ...
+#define SECOND_TIER_CAPACITY    300     // 5 minutes
+#define MINUTE_TIER_CAPACITY    180     // 3 hours
+#define HOUR_TIER_CAPACITY      72      // 3 days
+
+#define STORAGE_SIZE            ( 3 * AIRSHIFT_CHANNEL_COUNT * ( SECOND_TIER_CAPACITY + MINUTE_TIER_CAPACITY + HOUR_TIER_CAPACITY ) )
+
+#define COMMAND_POINTS_MAX      60      // buckets the console prints at most, they sit on the console task's stack
+
+typedef struct
+{
+    const char  *name;
+    uint32_t    interval_s;
+    uint16_t    capacity;
+} tier_config_t;
+
+typedef struct
+{
+    // struct of arrays, one row of capacity values per channel ...
+    int16_t     *min;
+    int16_t     *mean;
+    int16_t     *max;
+
+    int64_t     bucket;         // index of the bucket being accumulated ( timestamp / interval ), -1 until the first sample
+    uint16_t    head;           // slot the next closed bucket is written to
+    uint16_t    count;          // closed buckets held
+
+    // running aggregate of the open bucket ...
+    int32_t     sum[AIRSHIFT_CHANNEL_COUNT];
+    uint16_t    samples[AIRSHIFT_CHANNEL_COUNT];
+    int16_t     low[AIRSHIFT_CHANNEL_COUNT];
+    int16_t     high[AIRSHIFT_CHANNEL_COUNT];
+} tier_t;
+
+static const char* TAG = "airshift_timeseries";
+
+// Forward declarations
+static void     push_tier( airshift_timeseries_tier_t tier, const airshift_sample_t *sample );
+static void     close_bucket( airshift_timeseries_tier_t tier );
+static void     reset_bucket( tier_t *state );
+static int16_t  divide_rounded( int32_t sum, uint16_t count );
+static int      timeseries_command( int argc, char **argv );
+static void     print_point( const char *label, airshift_channel_t channel, const airshift_timeseries_point_t *point );
+
+static const tier_config_t tier_configs_[AIRSHIFT_TIMESERIES_TIER_COUNT] =
+{
+    [AIRSHIFT_TIMESERIES_TIER_SECOND]   = { .name = "second",   .interval_s = 1,    .capacity = SECOND_TIER_CAPACITY },
+    [AIRSHIFT_TIMESERIES_TIER_MINUTE]   = { .name = "minute",   .interval_s = 60,   .capacity = MINUTE_TIER_CAPACITY },
+    [AIRSHIFT_TIMESERIES_TIER_HOUR]     = { .name = "hour",     .interval_s = 3600, .capacity = HOUR_TIER_CAPACITY },
+};
+
+// the windows the console summarizes, one per tier ...
+static const uint32_t summary_windows_s_[] = { 5 * 60, 3 * 60 * 60, 3 * 24 * 60 * 60 };
+
+static const esp_console_cmd_t command_ = { .command = "timeseries", .help = "Tiers and min / mean / max of every channel, 'timeseries <channel> [second|minute|hour] [count]' lists the latest buckets", .hint = "[<channel> [<tier>] [<count>]]", .func = &timeseries_command };
+
+static int16_t              storage_[STORAGE_SIZE]                  = { 0 };
+static tier_t               tiers_[AIRSHIFT_TIMESERIES_TIER_COUNT]  = { 0 };
+static SemaphoreHandle_t    mutex_                                  = NULL;
+
+// Public functions
+esp_err_t airshift_timeseries_init()
+{
+    esp_err_t   ret     = ESP_FAIL;
+    int16_t     *next   = storage_;
+
+    ESP_LOGI( TAG, "airshift_timeseries_init" );
+
+    mutex_ = xSemaphoreCreateMutex();
+
+    ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_NO_MEM, error, TAG, "xSemaphoreCreateMutex failed" );
+
+    // carve each tier's rows out of the static pool ...
+    for( int i = 0; i < AIRSHIFT_TIMESERIES_TIER_COUNT; i++ )
+    {
+        size_t rows = (size_t)AIRSHIFT_CHANNEL_COUNT * tier_configs_[i].capacity;
+
+        memset( &tiers_[i], 0, sizeof( tier_t ) );
+
+        tiers_[i].min       = next; next += rows;
+        tiers_[i].mean      = next; next += rows;
+        tiers_[i].max       = next; next += rows;
+        tiers_[i].bucket    = -1;
+
+        reset_bucket( &tiers_[i] );
+    }
+
+    ESP_LOGI( TAG, "airshift_timeseries_init -> %u bytes", sizeof( storage_ ) );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_timeseries_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_timeseries_release()
+{
+    ESP_LOGI( TAG, "airshift_timeseries_release" );
+
+    if( mutex_ != NULL )
+    {
+        vSemaphoreDelete( mutex_ );
+
+        mutex_ = NULL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_timeseries_push( const airshift_sample_t *sample )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( mutex_ != NULL ), ESP_ERR_INVALID_STATE, error, TAG, "not initialized" );
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    // every tier aggregates raw samples, so each bucket is exact regardless of tier ...
+    for( int i = 0; i < AIRSHIFT_TIMESERIES_TIER_COUNT; i++ )
+    {
+        push_tier( i, sample );
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_timeseries_push failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+size_t airshift_timeseries_query( airshift_timeseries_tier_t tier, airshift_channel_t channel, airshift_timeseries_point_t *points, size_t max_points, int64_t *start )
+{
+    const tier_config_t *config = NULL;
+    tier_t              *state  = NULL;
+    size_t              count   = 0;
+    size_t              row     = 0;
+    size_t              slot    = 0;
+
+    if( ( mutex_ == NULL ) || ( tier >= AIRSHIFT_TIMESERIES_TIER_COUNT ) || ( channel >= AIRSHIFT_CHANNEL_COUNT ) || ( points == NULL ) )
+    {
+        return 0;
+    }
+
+    config  = &tier_configs_[tier];
+    state   = &tiers_[tier];
+    row     = (size_t)channel * config->capacity;
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    count   = ( state->count < max_points ) ? state->count : max_points;
+    slot    = ( state->head + config->capacity - count ) % config->capacity;
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        points[i].min   = state->min[row + slot];
+        points[i].mean  = state->mean[row + slot];
+        points[i].max   = state->max[row + slot];
+
+        slot = ( slot + 1 ) % config->capacity;
+    }
+
+    // closed buckets are contiguous and end right before the open one ...
+    if( start != NULL )
+    {
+        *start = ( state->bucket - (int64_t)count ) * config->interval_s * 1000 * 1000;
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    return count;
+}
+
+esp_err_t airshift_timeseries_summary( airshift_channel_t channel, uint32_t window_s, airshift_timeseries_point_t *summary )
+{
+    esp_err_t                   ret         = ESP_FAIL;
+    airshift_timeseries_tier_t  tier        = AIRSHIFT_TIMESERIES_TIER_HOUR;
+    airshift_timeseries_point_t point       = { 0 };
+    const tier_config_t         *config     = NULL;
+    tier_t                      *state      = NULL;
+    size_t                      buckets     = 0;
+    size_t                      row         = 0;
+    size_t                      slot        = 0;
+    int32_t                     sum         = 0;
+    uint16_t                    valid       = 0;
+
+    ESP_GOTO_ON_FALSE( ( ( mutex_ != NULL ) && ( channel < AIRSHIFT_CHANNEL_COUNT ) && ( summary != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    // finest tier whose retention covers the window ...
+    for( int i = 0; i < AIRSHIFT_TIMESERIES_TIER_COUNT; i++ )
+    {
+        if( ( (uint64_t)tier_configs_[i].interval_s * tier_configs_[i].capacity ) >= window_s )
+        {
+            tier = i;
+
+            break;
+        }
+    }
+
+    config  = &tier_configs_[tier];
+    state   = &tiers_[tier];
+    row     = (size_t)channel * config->capacity;
+    buckets = ( window_s + config->interval_s - 1 ) / config->interval_s;
+
+    point.min = INT16_MAX;
+    point.max = INT16_MIN;
+
+    xSemaphoreTake( mutex_, portMAX_DELAY );
+
+    buckets = ( buckets < state->count ) ? buckets : state->count;
+    slot    = ( state->head + config->capacity - buckets ) % config->capacity;
+
+    for( size_t i = 0; i < buckets; i++ )
+    {
+        if( state->mean[row + slot] != AIRSHIFT_VALUE_INVALID )
+        {
+            point.min   = ( state->min[row + slot] < point.min ) ? state->min[row + slot] : point.min;
+            point.max   = ( state->max[row + slot] > point.max ) ? state->max[row + slot] : point.max;
+            sum        += state->mean[row + slot];
+            valid++;
+        }
+
+        slot = ( slot + 1 ) % config->capacity;
+    }
+
+    xSemaphoreGive( mutex_ );
+
+    // a window without readings is an answer, not an error ...
+    if( valid == 0 )
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    point.mean  = divide_rounded( sum, valid );
+    *summary    = point;
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+esp_err_t airshift_timeseries_get_info( airshift_timeseries_tier_t tier, airshift_timeseries_info_t *info )
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_GOTO_ON_FALSE( ( ( tier < AIRSHIFT_TIMESERIES_TIER_COUNT ) && ( info != NULL ) ), ESP_ERR_INVALID_ARG, error, TAG, "invalid arguments" );
+
+    info->interval_s    = tier_configs_[tier].interval_s;
+    info->capacity      = tier_configs_[tier].capacity;
+    info->count         = tiers_[tier].count;
+    info->bytes         = 3 * AIRSHIFT_CHANNEL_COUNT * tier_configs_[tier].capacity * sizeof( int16_t );
+
+    return ESP_OK;
+
+error:
+
+    return ret;
+}
+
+esp_err_t airshift_timeseries_register_console()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_timeseries_register_console" );
+
+    ESP_GOTO_ON_ERROR( esp_console_cmd_register( &command_ ), error, TAG, "esp_console_cmd_register failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_timeseries_register_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+// Private functions
+static void push_tier( airshift_timeseries_tier_t tier, const airshift_sample_t *sample )
+{
+    const tier_config_t *config     = &tier_configs_[tier];
+    tier_t              *state      = &tiers_[tier];
+    int64_t             bucket      = sample->timestamp / ( (int64_t)config->interval_s * 1000 * 1000 );
+    int64_t             missing     = 0;
+
+    if( state->bucket < 0 )
+    {
+        state->bucket = bucket;
+    }
+    else if( bucket < state->bucket )
+    {
+        // late sample for a bucket already closed, drop it ...
+        return;
+    }
+    else if( bucket > state->bucket )
+    {
+        close_bucket( tier );
+
+        // buckets nobody reported into are stored as gaps, never more than the ring holds ...
+        missing = bucket - state->bucket - 1;
+        missing = ( missing < config->capacity ) ? missing : config->capacity;
+
+        for( int64_t i = 0; i < missing; i++ )
+        {
+            close_bucket( tier );
+        }
+
+        state->bucket = bucket;
+    }
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        if( sample->valid_mask & AIRSHIFT_CHANNEL_BIT( i ) )
+        {
+            state->sum[i]      += sample->values[i];
+            state->low[i]       = ( sample->values[i] < state->low[i] ) ? sample->values[i] : state->low[i];
+            state->high[i]      = ( sample->values[i] > state->high[i] ) ? sample->values[i] : state->high[i];
+            state->samples[i]  += 1;
+        }
+    }
+}
+
+static void close_bucket( airshift_timeseries_tier_t tier )
+{
+    const tier_config_t *config = &tier_configs_[tier];
+    tier_t              *state  = &tiers_[tier];
+    size_t              index   = 0;
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        index = ( (size_t)i * config->capacity ) + state->head;
+
+        if( state->samples[i] > 0 )
+        {
+            state->min[index]   = state->low[i];
+            state->mean[index]  = divide_rounded( state->sum[i], state->samples[i] );
+            state->max[index]   = state->high[i];
+        }
+        else
+        {
+            state->min[index]   = AIRSHIFT_VALUE_INVALID;
+            state->mean[index]  = AIRSHIFT_VALUE_INVALID;
+            state->max[index]   = AIRSHIFT_VALUE_INVALID;
+        }
+    }
+
+    state->head     = ( state->head + 1 ) % config->capacity;
+    state->count    = ( state->count < config->capacity ) ? ( state->count + 1 ) : state->count;
+
+    reset_bucket( state );
+}
+
+static void reset_bucket( tier_t *state )
+{
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        state->sum[i]       = 0;
+        state->samples[i]   = 0;
+        state->low[i]       = INT16_MAX;
+        state->high[i]      = INT16_MIN;
+    }
+}
+
+static int16_t divide_rounded( int32_t sum, uint16_t count )
+{
+    return (int16_t)( ( sum >= 0 ) ? ( ( sum + ( count / 2 ) ) / count ) : ( ( sum - ( count / 2 ) ) / count ) );
+}
+
+static int timeseries_command( int argc, char **argv )
+{
+    airshift_timeseries_point_t points[COMMAND_POINTS_MAX]  = { 0 };
+    airshift_timeseries_point_t summary                     = { 0 };
+    airshift_timeseries_info_t  info                        = { 0 };
+    airshift_timeseries_tier_t  tier                        = AIRSHIFT_TIMESERIES_TIER_MINUTE;
+    airshift_channel_t          channel                     = AIRSHIFT_CHANNEL_COUNT;
+    char                        label[16]                   = { 0 };
+    size_t                      count                       = COMMAND_POINTS_MAX;
+    int64_t                     start                       = 0;
+    int64_t                     now                         = esp_timer_get_time();
+
+    // no arguments, what every tier holds and how each channel did over its span ...
+    if( argc == 1 )
+    {
+        printf( "%-8s %10s %10s %10s\n", "tier", "bucket s", "buckets", "bytes" );
+
+        for( int i = 0; i < AIRSHIFT_TIMESERIES_TIER_COUNT; i++ )
+        {
+            airshift_timeseries_get_info( i, &info );
+
+            printf( "%-8s %10lu %4u / %-4u %10u\n", tier_configs_[i].name, info.interval_s, info.count, info.capacity, info.bytes );
+        }
+
+        printf( "%-8s %10s %10s %10s %10s\n", "channel", "window s", "min", "mean", "max" );
+
+        for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+        {
+            for( size_t j = 0; j < ( sizeof( summary_windows_s_ ) / sizeof( summary_windows_s_[0] ) ); j++ )
+            {
+                // no readings in the window leaves it invalid ...
+                summary.mean = AIRSHIFT_VALUE_INVALID;
+
+                airshift_timeseries_summary( i, summary_windows_s_[j], &summary );
+
+                snprintf( label, sizeof( label ), "%lu", summary_windows_s_[j] );
+
+                printf( "%-8s ", airshift_channel_name( i ) );
+                print_point( label, i, &summary );
+            }
+        }
+
+        return 0;
+    }
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        channel = ( strcmp( argv[1], airshift_channel_name( i ) ) == 0 ) ? i : channel;
+    }
+
+    for( int i = 0; ( argc > 2 ) && ( i < AIRSHIFT_TIMESERIES_TIER_COUNT ); i++ )
+    {
+        tier = ( strcmp( argv[2], tier_configs_[i].name ) == 0 ) ? i : tier;
+    }
+
+    if( argc > 3 )
+    {
+        count = strtoul( argv[3], NULL, 0 );
+        count = ( count < COMMAND_POINTS_MAX ) ? count : COMMAND_POINTS_MAX;
+    }
+
+    if( channel == AIRSHIFT_CHANNEL_COUNT )
+    {
+        printf( "unknown channel: %s\n", argv[1] );
+
+        return 1;
+    }
+
+    // ... otherwise the latest closed buckets of one channel, oldest first ...
+    count = airshift_timeseries_query( tier, channel, points, count, &start );
+
+    printf( "%-8s %10s %10s %10s %10s\n", "channel", "age s", "min", "mean", "max" );
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        snprintf( label, sizeof( label ), "%lld", ( now - start ) / ( 1000 * 1000 ) - (int64_t)( i * tier_configs_[tier].interval_s ) );
+
+        printf( "%-8s ", airshift_channel_name( channel ) );
+        print_point( label, channel, &points[i] );
+    }
+
+    return 0;
+}
+
+static void print_point( const char *label, airshift_channel_t channel, const airshift_timeseries_point_t *point )
+{
+    if( point->mean == AIRSHIFT_VALUE_INVALID )
+    {
+        printf( "%10s %10s %10s %10s\n", label, "-", "-", "-" );
+
+        return;
+    }
+
+    printf( "%10s %10.2f %10.2f %10.2f\n", label, airshift_channel_from_fixed( channel, point->min ), airshift_channel_from_fixed( channel, point->mean ), airshift_channel_from_fixed( channel, point->max ) );
+}
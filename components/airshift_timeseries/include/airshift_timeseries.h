@@ -0,0 +1,54 @@
+#ifndef AIRSHIFT_TIMESERIES_H
+#define AIRSHIFT_TIMESERIES_H
+
+#include "airshift_header_common.h"
+#include "airshift_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    AIRSHIFT_TIMESERIES_TIER_SECOND,
+    AIRSHIFT_TIMESERIES_TIER_MINUTE,
+    AIRSHIFT_TIMESERIES_TIER_HOUR,
+    AIRSHIFT_TIMESERIES_TIER_COUNT
+} airshift_timeseries_tier_t;
+
+// One bucket, fixed point, AIRSHIFT_VALUE_INVALID in every field when the bucket holds no readings ...
+typedef struct
+{
+    int16_t min;
+    int16_t mean;
+    int16_t max;
+} airshift_timeseries_point_t;
+
+typedef struct
+{
+    uint32_t    interval_s;     // bucket width
+    uint16_t    capacity;       // buckets retained
+    uint16_t    count;          // closed buckets currently held
+    size_t      bytes;          // storage reserved for this tier
+} airshift_timeseries_info_t;
+
+esp_err_t   airshift_timeseries_init();
+esp_err_t   airshift_timeseries_release();
+
+esp_err_t   airshift_timeseries_push( const airshift_sample_t *sample );
+
+// copies up to max_points closed buckets, oldest first, ending with the most recent, start receives the first bucket's timestamp ( us ) ...
+size_t      airshift_timeseries_query( airshift_timeseries_tier_t tier, airshift_channel_t channel, airshift_timeseries_point_t *points, size_t max_points, int64_t *start );
+
+// min / mean / max over the last window_s seconds, from the finest tier that covers the window ...
+esp_err_t   airshift_timeseries_summary( airshift_channel_t channel, uint32_t window_s, airshift_timeseries_point_t *summary );
+
+esp_err_t   airshift_timeseries_get_info( airshift_timeseries_tier_t tier, airshift_timeseries_info_t *info );
+
+esp_err_t   airshift_timeseries_register_console();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_TIMESERIES_H
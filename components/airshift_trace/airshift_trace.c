@@ -0,0 +1,421 @@
+#include "airshift_trace.h"
+
+#include <esp_timer.h>
+#include <stdatomic.h>
+
+// ring of 32 bit words, a power of two so the free running indexes wrap with a mask ...
+#define RING_WORDS              2048
+#define RING_MASK               ( RING_WORDS - 1 )
+
+// record: header, timestamp, format, tag, then two words per argument ...
+#define HEADER_COMMIT           0x80000000
+#define HEADER_LEVEL_SHIFT      28
+#define HEADER_COUNT_SHIFT      24
+#define HEADER_LENGTH_MASK      0xff
+#define POINTER_WORDS           ( sizeof( uintptr_t ) / sizeof( uint32_t ) )
+#define RECORD_WORDS( count )   ( 1 + 2 + ( 2 * POINTER_WORDS ) + ( 2 * ( count ) ) )
+#define RECORD_WORDS_MAX        RECORD_WORDS( AIRSHIFT_TRACE_ARGUMENTS_MAX )
+
+#define LINE_SIZE               256
+#define SPEC_SIZE               16
+
+#define DECODE_TASK_STACK_SIZE  3072
+#define DECODE_TASK_PRIORITY    1
+#define DECODE_PERIOD_MS        1000
+
+static const char* TAG = "airshift_trace";
+
+// Forward declarations
+static void         decode_task( void *arguments );
+static void         drain();
+static void         print_record( const uint32_t *record );
+static size_t       format_record( const char *format, const uint64_t *arguments, size_t count, char *line, size_t line_size );
+static int64_t      narrow_signed( uint64_t word, const char *modifier );
+static uint64_t     narrow_unsigned( uint64_t word, const char *modifier );
+static uint64_t     read_word( const uint32_t *words );
+static const void   *read_pointer( const uint32_t *words );
+
+static _Atomic uint32_t ring_[RING_WORDS]   = { 0 };
+static _Atomic uint32_t head_               = 0;    // next word a producer reserves
+static _Atomic uint32_t tail_               = 0;    // next word the decoder reads
+static _Atomic uint32_t written_            = 0;
+static _Atomic uint32_t dropped_            = 0;
+static _Atomic uint32_t high_water_         = 0;
+static TaskHandle_t     decode_task_        = NULL;
+static uint32_t         dropped_reported_   = 0;
+
+// Public functions
+esp_err_t airshift_trace_init()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_trace_init" );
+
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( decode_task, "trace", DECODE_TASK_STACK_SIZE, NULL, DECODE_TASK_PRIORITY, &decode_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> trace failed" );
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_trace_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_trace_release()
+{
+    ESP_LOGI( TAG, "airshift_trace_release" );
+
+    if( decode_task_ != NULL )
+    {
+        vTaskDelete( decode_task_ );
+
+        decode_task_ = NULL;
+    }
+
+    // whatever is still queued goes out now ...
+    drain();
+
+    return ESP_OK;
+}
+
+void airshift_trace_write( esp_log_level_t level, const char *tag, const char *format, const uint64_t *arguments, size_t count )
+{
+    const uint32_t  length      = RECORD_WORDS( count );
+    const int64_t   timestamp   = esp_timer_get_time();
+    uint32_t        head        = atomic_load_explicit( &head_, memory_order_relaxed );
+    uint32_t        used        = 0;
+    uint32_t        index       = 0;
+
+    // reserve, a compare and swap on the head is all producers ever contend on, tasks, both cores and isrs alike ...
+    do
+    {
+        used = head + length - atomic_load_explicit( &tail_, memory_order_acquire );
+
+        if( used > RING_WORDS )
+        {
+            atomic_fetch_add_explicit( &dropped_, 1, memory_order_relaxed );
+
+            return;
+        }
+    }
+    while( atomic_compare_exchange_weak_explicit( &head_, &head, head + length, memory_order_relaxed, memory_order_relaxed ) != true );
+
+    index = head + 1;
+
+    atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)timestamp, memory_order_relaxed );
+    atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)( (uint64_t)timestamp >> 32 ), memory_order_relaxed );
+
+    for( size_t i = 0; i < POINTER_WORDS; i++ )
+    {
+        atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)( (uint64_t)(uintptr_t)format >> ( 32 * i ) ), memory_order_relaxed );
+    }
+
+    for( size_t i = 0; i < POINTER_WORDS; i++ )
+    {
+        atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)( (uint64_t)(uintptr_t)tag >> ( 32 * i ) ), memory_order_relaxed );
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)arguments[i], memory_order_relaxed );
+        atomic_store_explicit( &ring_[index++ & RING_MASK], (uint32_t)( arguments[i] >> 32 ), memory_order_relaxed );
+    }
+
+    // the header goes in last, once it is non zero the whole record is visible to the decoder ...
+    atomic_store_explicit( &ring_[head & RING_MASK], HEADER_COMMIT | ( (uint32_t)level << HEADER_LEVEL_SHIFT ) | ( (uint32_t)count << HEADER_COUNT_SHIFT ) | length, memory_order_release );
+
+    atomic_fetch_add_explicit( &written_, 1, memory_order_relaxed );
+
+    // approximate, racing producers may each miss the other's update ...
+    if( used > atomic_load_explicit( &high_water_, memory_order_relaxed ) )
+    {
+        atomic_store_explicit( &high_water_, used, memory_order_relaxed );
+    }
+}
+
+void airshift_trace_get_stats( airshift_trace_stats_t *stats )
+{
+    stats->written      = atomic_load_explicit( &written_, memory_order_relaxed );
+    stats->dropped      = atomic_load_explicit( &dropped_, memory_order_relaxed );
+    stats->high_water   = atomic_load_explicit( &high_water_, memory_order_relaxed );
+    stats->capacity     = RING_WORDS;
+}
+
+// Private functions
+static void decode_task( void *arguments )
+{
+    while( true )
+    {
+        // no wakeups from the producers, that would cost them a notify each ...
+        vTaskDelay( pdMS_TO_TICKS( DECODE_PERIOD_MS ) );
+
+        drain();
+    }
+}
+
+static void drain()
+{
+    uint32_t    record[RECORD_WORDS_MAX]    = { 0 };
+    uint32_t    tail                        = atomic_load_explicit( &tail_, memory_order_relaxed );
+    uint32_t    header                      = 0;
+    uint32_t    length                      = 0;
+    uint32_t    dropped                     = 0;
+
+    while( true )
+    {
+        header = atomic_load_explicit( &ring_[tail & RING_MASK], memory_order_acquire );
+
+        // reserved but not committed yet, it is picked up on the next pass ...
+        if( ( header & HEADER_COMMIT ) == 0 )
+        {
+            break;
+        }
+
+        length = header & HEADER_LENGTH_MASK;
+
+        // copy out and zero, an unwritten header has to read as not committed the next time round ...
+        for( uint32_t i = 0; i < length; i++ )
+        {
+            record[i] = atomic_load_explicit( &ring_[( tail + i ) & RING_MASK], memory_order_relaxed );
+
+            atomic_store_explicit( &ring_[( tail + i ) & RING_MASK], 0, memory_order_relaxed );
+        }
+
+        tail += length;
+
+        atomic_store_explicit( &tail_, tail, memory_order_release );
+
+        print_record( record );
+    }
+
+    dropped = atomic_load_explicit( &dropped_, memory_order_relaxed );
+
+    if( dropped != dropped_reported_ )
+    {
+        ESP_LOGW( TAG, "%lu records dropped, ring full", (unsigned long)( dropped - dropped_reported_ ) );
+
+        dropped_reported_ = dropped;
+    }
+}
+
+static void print_record( const uint32_t *record )
+{
+    static const char   letters[]                               = { 'N', 'E', 'W', 'I', 'D', 'V' };
+    esp_log_level_t     level                                   = (esp_log_level_t)( ( record[0] >> HEADER_LEVEL_SHIFT ) & 0x7 );
+    size_t              count                                   = ( record[0] >> HEADER_COUNT_SHIFT ) & 0xf;
+    int64_t             timestamp                               = (int64_t)read_word( &record[1] );
+    const char          *format                                 = read_pointer( &record[3] );
+    const char          *tag                                    = read_pointer( &record[3 + POINTER_WORDS] );
+    uint64_t            arguments[AIRSHIFT_TRACE_ARGUMENTS_MAX] = { 0 };
+    char                line[LINE_SIZE]                         = { 0 };
+
+    // filtered at runtime, nothing is formatted for a tag that would not print it ...
+    if( level > esp_log_level_get( tag ) )
+    {
+        return;
+    }
+
+    for( size_t i = 0; i < count; i++ )
+    {
+        arguments[i] = read_word( &record[3 + ( 2 * POINTER_WORDS ) + ( 2 * i )] );
+    }
+
+    format_record( format, arguments, count, line, sizeof( line ) );
+
+    // the same prefix ESP_LOGx prints, the timestamp is when the trace was taken not when it is printed ...
+    esp_log_write( level, tag, "%c (%lu) %s: %s\n", letters[level], (unsigned long)( timestamp / 1000 ), tag, line );
+}
+
+static size_t format_record( const char *format, const uint64_t *arguments, size_t count, char *line, size_t line_size )
+{
+    char        spec[SPEC_SIZE] = { 0 };
+    char        modifier[3]     = { 0 };
+    size_t      used            = 0;
+    size_t      next            = 0;
+    size_t      flags           = 0;
+    size_t      length          = 0;
+    int         written         = 0;
+    uint64_t    word            = 0;
+    double      real            = 0.0;
+
+    while( ( *format != '\0' ) && ( used < ( line_size - 1 ) ) )
+    {
+        if( ( format[0] != '%' ) || ( format[1] == '%' ) )
+        {
+            line[used++]    = format[0];
+            format         += ( format[0] == '%' ) ? 2 : 1;
+
+            continue;
+        }
+
+        // flags, width and precision pass through to snprintf, the length modifier only says how the word is narrowed ...
+        flags   = strspn( &format[1], "-+ #0123456789." ) + 1;
+        length  = strspn( &format[flags], "hlzjt" );
+
+        if( ( format[flags + length] == '\0' ) || ( ( flags + 4 ) > sizeof( spec ) ) || ( length >= sizeof( modifier ) ) )
+        {
+            break;
+        }
+
+        memcpy( spec, format, flags );
+        memcpy( modifier, &format[flags], length );
+
+        modifier[length]    = '\0';
+        word                = ( next < count ) ? arguments[next] : 0;
+        format             += flags + length;
+
+        switch( *format )
+        {
+            case 'd':
+            case 'i':
+            {
+                memcpy( &spec[flags], "lld", 4 );
+
+                written = snprintf( &line[used], line_size - used, spec, narrow_signed( word, modifier ) );
+
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+            {
+                memcpy( &spec[flags], "ll", 2 );
+
+                spec[flags + 2] = *format;
+                spec[flags + 3] = '\0';
+                written         = snprintf( &line[used], line_size - used, spec, narrow_unsigned( word, modifier ) );
+
+                break;
+            }
+            case 'c':
+            {
+                memcpy( &spec[flags], "c", 2 );
+
+                written = snprintf( &line[used], line_size - used, spec, (int)word );
+
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+            {
+                spec[flags]     = *format;
+                spec[flags + 1] = '\0';
+
+                memcpy( &real, &word, sizeof( real ) );
+
+                written = snprintf( &line[used], line_size - used, spec, real );
+
+                break;
+            }
+            case 's':
+            case 'p':
+            {
+                spec[flags]     = *format;
+                spec[flags + 1] = '\0';
+
+                written = ( *format == 's' ) ? snprintf( &line[used], line_size - used, spec, (const char *)(uintptr_t)word )
+                                             : snprintf( &line[used], line_size - used, spec, (void *)(uintptr_t)word );
+
+                break;
+            }
+            default:
+            {
+                // not something a trace can carry, show it unformatted ...
+                written = snprintf( &line[used], line_size - used, "%.*s", (int)( flags + length + 1 ), format - flags - length );
+
+                break;
+            }
+        }
+
+        if( written < 0 )
+        {
+            break;
+        }
+
+        used    = ( ( used + written ) < line_size ) ? ( used + written ) : ( line_size - 1 );
+        format++;
+        next++;
+    }
+
+    line[used] = '\0';
+
+    return used;
+}
+
+static int64_t narrow_signed( uint64_t word, const char *modifier )
+{
+    // the argument was widened from whatever the format says it is, cut it back to that size ...
+    if( strcmp( modifier, "hh" ) == 0 )
+    {
+        return (signed char)word;
+    }
+    else if( strcmp( modifier, "h" ) == 0 )
+    {
+        return (short)word;
+    }
+    else if( strcmp( modifier, "l" ) == 0 )
+    {
+        return (long)word;
+    }
+    else if( ( strcmp( modifier, "ll" ) == 0 ) || ( strcmp( modifier, "j" ) == 0 ) )
+    {
+        return (int64_t)word;
+    }
+    else if( ( strcmp( modifier, "z" ) == 0 ) || ( strcmp( modifier, "t" ) == 0 ) )
+    {
+        return (ptrdiff_t)word;
+    }
+
+    return (int)word;
+}
+
+static uint64_t narrow_unsigned( uint64_t word, const char *modifier )
+{
+    if( strcmp( modifier, "hh" ) == 0 )
+    {
+        return (unsigned char)word;
+    }
+    else if( strcmp( modifier, "h" ) == 0 )
+    {
+        return (unsigned short)word;
+    }
+    else if( strcmp( modifier, "l" ) == 0 )
+    {
+        return (unsigned long)word;
+    }
+    else if( ( strcmp( modifier, "ll" ) == 0 ) || ( strcmp( modifier, "j" ) == 0 ) )
+    {
+        return word;
+    }
+    else if( ( strcmp( modifier, "z" ) == 0 ) || ( strcmp( modifier, "t" ) == 0 ) )
+    {
+        return (size_t)word;
+    }
+
+    return (unsigned int)word;
+}
+
+static uint64_t read_word( const uint32_t *words )
+{
+    return (uint64_t)words[0] | ( (uint64_t)words[1] << 32 );
+}
+
+static const void *read_pointer( const uint32_t *words )
+{
+    uint64_t address = 0;
+
+    for( size_t i = 0; i < POINTER_WORDS; i++ )
+    {
+        address |= (uint64_t)words[i] << ( 32 * i );
+    }
+
+    return (const void *)(uintptr_t)address;
+}
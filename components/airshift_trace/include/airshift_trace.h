@@ -0,0 +1,112 @@
+#ifndef AIRSHIFT_TRACE_H
+#define AIRSHIFT_TRACE_H
+
+#include "airshift_header_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deferred logging for hot paths. A trace records the format string's address and the raw arguments into a lock-free ring, the
+// text is only formatted later by a low-priority task. Arguments are copied by value, so a %s argument must point at storage that
+// outlives the record ( literals, constant tables ), the same goes for the tag ...
+//
+// AIRSHIFT_TRACE_LEVEL is the compile time level, a component lowers or raises it for its own sources in its CMakeLists.txt:
+//
+//   target_compile_definitions(${COMPONENT_LIB} PRIVATE AIRSHIFT_TRACE_LEVEL=AIRSHIFT_TRACE_LEVEL_DEBUG)
+//
+// Anything above it compiles to nothing, what passes is still filtered at runtime by esp_log_level_set when it is printed.
+
+#define AIRSHIFT_TRACE_LEVEL_NONE       0
+#define AIRSHIFT_TRACE_LEVEL_ERROR      1
+#define AIRSHIFT_TRACE_LEVEL_WARN       2
+#define AIRSHIFT_TRACE_LEVEL_INFO       3
+#define AIRSHIFT_TRACE_LEVEL_DEBUG      4
+#define AIRSHIFT_TRACE_LEVEL_VERBOSE    5
+
+#ifndef AIRSHIFT_TRACE_LEVEL
+#define AIRSHIFT_TRACE_LEVEL            AIRSHIFT_TRACE_LEVEL_INFO
+#endif
+
+#define AIRSHIFT_TRACE_ARGUMENTS_MAX    12      // more than this does not compile
+
+typedef struct
+{
+    uint32_t    written;
+    uint32_t    dropped;        // ring full, the record was never stored
+    uint32_t    high_water;     // words in use at most
+    uint32_t    capacity;       // words
+} airshift_trace_stats_t;
+
+esp_err_t   airshift_trace_init();
+esp_err_t   airshift_trace_release();
+
+void        airshift_trace_write( esp_log_level_t level, const char *tag, const char *format, const uint64_t *arguments, size_t count );
+void        airshift_trace_get_stats( airshift_trace_stats_t *stats );
+
+#ifndef __cplusplus
+
+#define AIRSHIFT_TRACEE( tag, format, ... )     AIRSHIFT_TRACE( AIRSHIFT_TRACE_LEVEL_ERROR, ESP_LOG_ERROR, tag, format, ##__VA_ARGS__ )
+#define AIRSHIFT_TRACEW( tag, format, ... )     AIRSHIFT_TRACE( AIRSHIFT_TRACE_LEVEL_WARN, ESP_LOG_WARN, tag, format, ##__VA_ARGS__ )
+#define AIRSHIFT_TRACEI( tag, format, ... )     AIRSHIFT_TRACE( AIRSHIFT_TRACE_LEVEL_INFO, ESP_LOG_INFO, tag, format, ##__VA_ARGS__ )
+#define AIRSHIFT_TRACED( tag, format, ... )     AIRSHIFT_TRACE( AIRSHIFT_TRACE_LEVEL_DEBUG, ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__ )
+#define AIRSHIFT_TRACEV( tag, format, ... )     AIRSHIFT_TRACE( AIRSHIFT_TRACE_LEVEL_VERBOSE, ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__ )
+
+// the level test is a constant, a disabled trace leaves no code behind ...
+#define AIRSHIFT_TRACE( trace_level, log_level, tag, format, ... )                                                                  \
+    do                                                                                                                              \
+    {                                                                                                                               \
+        if( ( trace_level ) <= AIRSHIFT_TRACE_LEVEL )                                                                               \
+        {                                                                                                                           \
+            const uint64_t airshift_trace_arguments_[] = { 0, AIRSHIFT_TRACE_MAP( __VA_ARGS__ ) };                                  \
+                                                                                                                                    \
+            airshift_trace_write( log_level, tag, format, &airshift_trace_arguments_[1], AIRSHIFT_TRACE_COUNT( __VA_ARGS__ ) );     \
+        }                                                                                                                           \
+    }                                                                                                                               \
+    while( 0 )
+
+// Argument packing, every argument becomes one 64 bit word. floats are promoted to double like printf does, pointers keep their
+// address, everything else is widened as an integer and narrowed again by the conversion that prints it ...
+
+static inline uint64_t airshift_trace_from_integer( int64_t value )         { return (uint64_t)value; }
+static inline uint64_t airshift_trace_from_pointer( const void *value )     { return (uint64_t)(uintptr_t)value; }
+static inline uint64_t airshift_trace_from_double( double value )           { uint64_t word = 0; memcpy( &word, &value, sizeof( word ) ); return word; }
+
+#define AIRSHIFT_TRACE_WORD( value )                                                                                                \
+    _Generic( ( value ),                                                                                                            \
+        float:          airshift_trace_from_double,                                                                                 \
+        double:         airshift_trace_from_double,                                                                                 \
+        char*:          airshift_trace_from_pointer,                                                                                \
+        const char*:    airshift_trace_from_pointer,                                                                                \
+        void*:          airshift_trace_from_pointer,                                                                                \
+        const void*:    airshift_trace_from_pointer,                                                                                \
+        default:        airshift_trace_from_integer )( value )
+
+#define AIRSHIFT_TRACE_COUNT( ... )                 AIRSHIFT_TRACE_COUNT_( 0, ##__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 )
+#define AIRSHIFT_TRACE_COUNT_( _0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, count, ... )  count
+
+#define AIRSHIFT_TRACE_MAP( ... )                   AIRSHIFT_TRACE_MAP_( AIRSHIFT_TRACE_COUNT( __VA_ARGS__ ), ##__VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_( count, ... )           AIRSHIFT_TRACE_MAP__( count, ##__VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP__( count, ... )          AIRSHIFT_TRACE_MAP_##count( __VA_ARGS__ )
+
+#define AIRSHIFT_TRACE_MAP_0( ... )
+#define AIRSHIFT_TRACE_MAP_1( a )                   AIRSHIFT_TRACE_WORD( a )
+#define AIRSHIFT_TRACE_MAP_2( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_1( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_3( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_2( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_4( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_3( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_5( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_4( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_6( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_5( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_7( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_6( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_8( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_7( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_9( a, ... )              AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_8( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_10( a, ... )             AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_9( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_11( a, ... )             AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_10( __VA_ARGS__ )
+#define AIRSHIFT_TRACE_MAP_12( a, ... )             AIRSHIFT_TRACE_WORD( a ), AIRSHIFT_TRACE_MAP_11( __VA_ARGS__ )
+
+#endif // __cplusplus
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_TRACE_H
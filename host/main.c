@@ -0,0 +1,286 @@
+// Host build harness, runs app_main against simulated sensors and reports what the acquisition pipeline costs per cycle ...
+#include "airshift_header_common.h"
+#include "airshift_host.h"
+#include "airshift_sim.h"
+
+#include <esp_timer.h>
+#include <esp_partition.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "airshift_acquisition.h"
+#include "airshift_pms7003.h"
+#include "airshift_senseair.h"
+#include "airshift_history.h"
+#include "airshift_air_quality.h"
+#include "airshift_trace.h"
+
+#define DEFAULT_SPEED           10.0
+#define DEFAULT_DURATION_S      300
+#define DEFAULT_SEED            1
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_PARTITION_TYPE  0x40
+#define HISTORY_PARTITION_SIZE  0x1A000
+
+#define MAIN_TASK_STACK_SIZE    8192
+#define MAIN_TASK_PRIORITY      1
+
+#define START_TIMEOUT_S         120     // warmup is 30 s, anything past this and the pipeline never came up
+#define TASKS_MAX               32
+
+typedef struct
+{
+    double      speed;
+    uint32_t    duration_s;
+    uint32_t    seed;
+    float       noise_rate;
+    float       error_rate;
+    float       timeout_rate;
+    const char  *history_path;
+    bool        verbose;
+} options_t;
+
+typedef struct
+{
+    int64_t             time;
+    int64_t             process_cpu_time;
+    host_task_info_t    tasks[TASKS_MAX];
+    size_t              task_count;
+} snapshot_t;
+
+// Forward declarations
+void                app_main( void );
+static void         main_task( void *arguments );
+static void         usage( const char *name );
+static bool         parse( int argc, char **argv, options_t *options );
+static void         take_snapshot( snapshot_t *snapshot );
+static int64_t      task_cpu_time( const snapshot_t *snapshot, const char *name );
+static void         report( const snapshot_t *start, const snapshot_t *end, uint32_t cycles_start );
+
+static const char *sensor_names_[AIRSHIFT_ACQUISITION_SENSOR_COUNT] = { "pms7003", "senseair", "sht30" };
+
+// Public functions
+int main( int argc, char **argv )
+{
+    options_t                       options     = { .speed = DEFAULT_SPEED, .duration_s = DEFAULT_DURATION_S, .seed = DEFAULT_SEED };
+    airshift_sim_profile_t          profile     = { 0 };
+    airshift_acquisition_stats_t    stats       = { 0 };
+    snapshot_t                      start       = { 0 };
+    snapshot_t                      end         = { 0 };
+    int64_t                         deadline    = 0;
+
+    if( parse( argc, argv, &options ) != true )
+    {
+        usage( argv[0] );
+
+        return 2;
+    }
+
+    esp_log_level_set( "*", ( options.verbose == true ) ? ESP_LOG_INFO : ESP_LOG_WARN );
+
+    host_clock_init( options.speed );
+
+    ESP_ERROR_CHECK( host_partition_register( HISTORY_PARTITION_LABEL, ESP_PARTITION_TYPE_DATA, HISTORY_PARTITION_TYPE, HISTORY_PARTITION_SIZE, options.history_path ) );
+
+    profile = (airshift_sim_profile_t){ .seed = options.seed, .noise_rate = options.noise_rate, .error_rate = options.error_rate, .timeout_rate = options.timeout_rate };
+
+    ESP_ERROR_CHECK( airshift_sim_pms7003_attach( UART_NUM_2, &profile ) );
+    ESP_ERROR_CHECK( airshift_sim_senseair_attach( UART_NUM_1, &profile ) );
+    ESP_ERROR_CHECK( airshift_sim_sht30_attach( I2C_NUM_0, &profile ) );
+
+    xTaskCreate( main_task, "main", MAIN_TASK_STACK_SIZE, NULL, MAIN_TASK_PRIORITY, NULL );
+
+    // wait out the warmup, measuring starts with the first acquisition cycle ...
+    deadline = esp_timer_get_time() + ( (int64_t)START_TIMEOUT_S * 1000 * 1000 );
+
+    do
+    {
+        host_clock_sleep_until( esp_timer_get_time() + ( 100 * 1000 ) );
+
+        airshift_acquisition_get_stats( &stats );
+    }
+    while( ( stats.cycles == 0 ) && ( esp_timer_get_time() < deadline ) );
+
+    if( stats.cycles == 0 )
+    {
+        fprintf( stderr, "acquisition never started\n" );
+
+        return 1;
+    }
+
+    take_snapshot( &start );
+
+    host_clock_sleep_until( start.time + ( (int64_t)options.duration_s * 1000 * 1000 ) );
+
+    take_snapshot( &end );
+
+    report( &start, &end, stats.cycles );
+
+    airshift_acquisition_get_stats( &stats );
+
+    return ( stats.cycles > 0 ) ? 0 : 1;
+}
+
+// Private functions
+static void main_task( void *arguments )
+{
+    app_main();
+
+    vTaskDelete( NULL );
+}
+
+static void usage( const char *name )
+{
+    fprintf( stderr, "usage: %s [ -s speed ] [ -d seconds ] [ -r seed ] [ -n noise ] [ -e errors ] [ -t timeouts ] [ -f history file ] [ -v ]\n", name );
+    fprintf( stderr, "  -s  clock speed, simulated seconds per wall clock second ( default %.0f )\n", DEFAULT_SPEED );
+    fprintf( stderr, "  -d  simulated seconds to measure after the first acquisition cycle ( default %d )\n", DEFAULT_DURATION_S );
+    fprintf( stderr, "  -r  simulator seed ( default %d )\n", DEFAULT_SEED );
+    fprintf( stderr, "  -n, -e, -t  noise, checksum error and timeout rate per frame, 0 .. 1\n" );
+    fprintf( stderr, "  -f  keep the history partition in a file, it survives between runs\n" );
+    fprintf( stderr, "  -v  log at info level, default is warnings only\n" );
+}
+
+static bool parse( int argc, char **argv, options_t *options )
+{
+    int option = 0;
+
+    while( ( option = getopt( argc, argv, "s:d:r:n:e:t:f:vh" ) ) != -1 )
+    {
+        switch( option )
+        {
+            case 's': options->speed        = strtod( optarg, NULL );               break;
+            case 'd': options->duration_s   = strtoul( optarg, NULL, 0 );           break;
+            case 'r': options->seed         = strtoul( optarg, NULL, 0 );           break;
+            case 'n': options->noise_rate   = strtof( optarg, NULL );               break;
+            case 'e': options->error_rate   = strtof( optarg, NULL );               break;
+            case 't': options->timeout_rate = strtof( optarg, NULL );               break;
+            case 'f': options->history_path = optarg;                               break;
+            case 'v': options->verbose      = true;                                 break;
+            default:  return false;
+        }
+    }
+
+    return ( options->speed > 0.0 ) && ( options->duration_s > 0 ) && ( ( options->noise_rate + options->error_rate + options->timeout_rate ) <= 1.0f );
+}
+
+static void take_snapshot( snapshot_t *snapshot )
+{
+    snapshot->time              = esp_timer_get_time();
+    snapshot->process_cpu_time  = host_process_cpu_time();
+    snapshot->task_count        = host_task_get_info( snapshot->tasks, TASKS_MAX );
+}
+
+static int64_t task_cpu_time( const snapshot_t *snapshot, const char *name )
+{
+    int64_t cpu_time = 0;
+
+    // several tasks may share a name, they are reported together ...
+    for( size_t i = 0; i < snapshot->task_count; i++ )
+    {
+        if( strcmp( snapshot->tasks[i].name, name ) == 0 )
+        {
+            cpu_time += snapshot->tasks[i].cpu_time;
+        }
+    }
+
+    return cpu_time;
+}
+
+static void report( const snapshot_t *start, const snapshot_t *end, uint32_t cycles_start )
+{
+    airshift_acquisition_stats_t    acquisition = { 0 };
+    pms7003_stats_t                 pms7003     = { 0 };
+    senseair_stats_t                senseair    = { 0 };
+    airshift_history_stats_t        history     = { 0 };
+    airshift_air_quality_stats_t    air_quality = { 0 };
+    airshift_air_quality_result_t   quality     = { 0 };
+    airshift_trace_stats_t          trace       = { 0 };
+    airshift_sim_stats_t            sim         = { 0 };
+    int64_t                         elapsed     = end->time - start->time;
+    int64_t                         process     = end->process_cpu_time - start->process_cpu_time;
+    uint32_t                        cycles      = 0;
+    int                             result      = 0;
+
+    airshift_acquisition_get_stats( &acquisition );
+    airshift_pms7003_get_stats( &pms7003 );
+    airshift_senseair_get_stats( &senseair );
+    airshift_history_get_stats( &history );
+    airshift_air_quality_get_stats( &air_quality );
+    airshift_air_quality_get( &quality );
+    airshift_trace_get_stats( &trace );
+
+    cycles = ( acquisition.cycles > cycles_start ) ? ( acquisition.cycles - cycles_start ) : 0;
+
+    printf( "simulated: %.1f s at %.1fx, cycles: %" PRIu32 " ( %" PRIu32 " measured )\n", (double)elapsed / 1e6, host_clock_get_speed(), acquisition.cycles, cycles );
+    printf( "acquisition: deadline misses: %" PRIu32 ", overruns: %" PRIu32 ", dropped: %" PRIu32 "\n", acquisition.deadline_misses, acquisition.overruns, acquisition.dropped );
+    printf( "latency: avg %" PRId64 " us, max %" PRId64 " us, jitter max %" PRId64 " us ( simulated clock )\n", acquisition.latency_avg, acquisition.latency_max, acquisition.jitter_max );
+
+    for( int i = 0; i < AIRSHIFT_ACQUISITION_SENSOR_COUNT; i++ )
+    {
+        printf( "  %-9s errors: %" PRIu32 ", latency: max %" PRId64 " us\n", sensor_names_[i], acquisition.sensor_errors[i], acquisition.sensor_latency_max[i] );
+    }
+
+    // what the drivers counted next to what the simulators injected ...
+    airshift_sim_get_stats( AIRSHIFT_SIM_SENSOR_PMS7003, &sim );
+
+    printf( "pms7003: frames: %" PRIu32 ", checksum errors: %" PRIu32 ", length errors: %" PRIu32 ", resyncs: %" PRIu32 ", discarded: %" PRIu32 " bytes, overflows: %" PRIu32 "\n",
+        pms7003.frames, pms7003.checksum_errors, pms7003.length_errors, pms7003.resyncs, pms7003.bytes_discarded, pms7003.overflows );
+    printf( "  duty cycle: wakeups: %" PRIu32 ", settling frames: %" PRIu32 ", period: %" PRIu32 " s, awake: %.1f %%\n",
+        pms7003.wakeups, pms7003.settling_frames, pms7003.period_ms / 1000, 100.0 * (double)pms7003.awake_time / (double)( end->time ) );
+    printf( "  injected: frames: %" PRIu32 ", noise: %" PRIu32 ", errors: %" PRIu32 ", dropped: %" PRIu32 "\n", sim.frames, sim.noise, sim.errors, sim.timeouts );
+
+    airshift_sim_get_stats( AIRSHIFT_SIM_SENSOR_SENSEAIR, &sim );
+
+    printf( "senseair: transactions: %" PRIu32 ", timeouts: %" PRIu32 ", crc errors: %" PRIu32 ", exceptions: %" PRIu32 ", discarded: %" PRIu32 " bytes, latency: max %" PRId64 " us\n",
+        senseair.transactions, senseair.timeouts, senseair.crc_errors, senseair.exceptions, senseair.bytes_discarded, senseair.latency_max );
+    printf( "  injected: replies: %" PRIu32 ", noise: %" PRIu32 ", errors: %" PRIu32 ", timeouts: %" PRIu32 "\n", sim.frames, sim.noise, sim.errors, sim.timeouts );
+
+    airshift_sim_get_stats( AIRSHIFT_SIM_SENSOR_SHT30, &sim );
+
+    printf( "sht30:\n  injected: measurements: %" PRIu32 ", nacks: %" PRIu32 ", errors: %" PRIu32 ", timeouts: %" PRIu32 "\n", sim.frames, sim.noise, sim.errors, sim.timeouts );
+
+    printf( "history: records: %" PRIu32 ", batches: %" PRIu32 ", erased: %" PRIu32 " sectors, crc errors: %" PRIu32 ", capacity: %" PRIu32 ", index: %" PRId64 " us\n",
+        history.records_written, history.batches_written, history.sectors_erased, history.crc_errors, history.capacity, history.index_time );
+
+    printf( "air quality: %s, updates: %" PRIu32 ", transitions: %" PRIu32 ", means: co2 %.0f, pm2.5 %.1f, pm10 %.1f, rh %.1f\n",
+        airshift_air_quality_name( quality.quality ), air_quality.updates, air_quality.transitions, quality.means[AIRSHIFT_AIR_QUALITY_INPUT_CO2],
+        quality.means[AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5], quality.means[AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0], quality.means[AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY] );
+
+    printf( "trace: records: %" PRIu32 ", dropped: %" PRIu32 ", ring: %" PRIu32 " of %" PRIu32 " words at most\n", trace.written, trace.dropped, trace.high_water, trace.capacity );
+
+    if( cycles == 0 )
+    {
+        return;
+    }
+
+    // stage percentiles, the same table the device prints on its console ...
+    host_console_run( "metrics", &result );
+
+    // ... and what the time series kept, the same summary too ...
+    host_console_run( "timeseries", &result );
+
+    // cpu time is real thread time, it does not scale with the clock ...
+    printf( "cpu: %" PRId64 " us per cycle, %.3f %% of one core ( simulated time )\n", process / cycles, 100.0 * (double)process / (double)elapsed );
+
+    for( size_t i = 0; i < end->task_count; i++ )
+    {
+        bool    seen    = false;
+        int64_t used    = 0;
+
+        for( size_t j = 0; j < i; j++ )
+        {
+            seen |= ( strcmp( end->tasks[i].name, end->tasks[j].name ) == 0 );
+        }
+
+        used = task_cpu_time( end, end->tasks[i].name ) - task_cpu_time( start, end->tasks[i].name );
+
+        if( ( seen == true ) || ( used <= 0 ) )
+        {
+            continue;
+        }
+
+        printf( "  %-20s %8" PRId64 " us per cycle\n", end->tasks[i].name, used / cycles );
+    }
+}
@@ -0,0 +1,132 @@
+#include "cbor.h"
+
+#include <string.h>
+
+#define MAJOR_UNSIGNED      0
+#define MAJOR_NEGATIVE      1
+#define MAJOR_TEXT          3
+#define MAJOR_ARRAY         4
+#define MAJOR_MAP           5
+#define MAJOR_SIMPLE        7
+
+#define SIMPLE_FALSE        20
+#define SIMPLE_TRUE         21
+
+#define REMAINING_UNCHECKED 0       // the top level takes any number of items
+
+// Forward declarations
+static CborError    append( CborEncoder *encoder, const uint8_t *data, size_t length );
+static CborError    encode_head( CborEncoder *encoder, uint8_t major, uint64_t value );
+static CborError    create_container( CborEncoder *parent, CborEncoder *container, uint8_t major, size_t items, size_t length );
+
+// Public functions
+void cbor_encoder_init( CborEncoder *encoder, uint8_t *buffer, size_t size, int flags )
+{
+    encoder->data       = buffer;
+    encoder->end        = buffer + size;
+    encoder->remaining  = REMAINING_UNCHECKED;
+    encoder->flags      = flags;
+}
+
+CborError cbor_encoder_create_array( CborEncoder *parent, CborEncoder *array, size_t length )
+{
+    return create_container( parent, array, MAJOR_ARRAY, length, length );
+}
+
+CborError cbor_encoder_create_map( CborEncoder *parent, CborEncoder *map, size_t length )
+{
+    return create_container( parent, map, MAJOR_MAP, length * 2, length );
+}
+
+CborError cbor_encoder_close_container( CborEncoder *parent, const CborEncoder *container )
+{
+    parent->data = container->data;
+
+    return ( container->remaining == 1 ) ? CborNoError : CborErrorTooFewItems;
+}
+
+CborError cbor_encode_uint( CborEncoder *encoder, uint64_t value )
+{
+    return encode_head( encoder, MAJOR_UNSIGNED, value );
+}
+
+CborError cbor_encode_int( CborEncoder *encoder, int64_t value )
+{
+    // -1 - n is stored as n ...
+    return ( value < 0 ) ? encode_head( encoder, MAJOR_NEGATIVE, (uint64_t)( -1 - value ) ) : encode_head( encoder, MAJOR_UNSIGNED, (uint64_t)value );
+}
+
+CborError cbor_encode_boolean( CborEncoder *encoder, bool value )
+{
+    return encode_head( encoder, MAJOR_SIMPLE, value ? SIMPLE_TRUE : SIMPLE_FALSE );
+}
+
+CborError cbor_encode_text_stringz( CborEncoder *encoder, const char *string )
+{
+    size_t      length  = strlen( string );
+    CborError   error   = encode_head( encoder, MAJOR_TEXT, length );
+
+    return ( error == CborNoError ) ? append( encoder, (const uint8_t *)string, length ) : error;
+}
+
+size_t cbor_encoder_get_buffer_size( const CborEncoder *encoder, const uint8_t *buffer )
+{
+    return (size_t)( encoder->data - buffer );
+}
+
+// Private functions
+static CborError append( CborEncoder *encoder, const uint8_t *data, size_t length )
+{
+    if( length > (size_t)( encoder->end - encoder->data ) )
+    {
+        encoder->data = (uint8_t *)encoder->end;
+
+        return CborErrorOutOfMemory;
+    }
+
+    memcpy( encoder->data, data, length );
+
+    encoder->data += length;
+
+    return CborNoError;
+}
+
+static CborError encode_head( CborEncoder *encoder, uint8_t major, uint64_t value )
+{
+    uint8_t head[9]     = { 0 };
+    size_t  extra       = 0;
+
+    if( encoder->remaining != REMAINING_UNCHECKED )
+    {
+        if( encoder->remaining == 1 )
+        {
+            return CborErrorTooManyItems;
+        }
+
+        encoder->remaining--;
+    }
+
+    // values below 24 fit the initial byte, larger ones follow it in 1, 2, 4 or 8 bytes, big endian ...
+    extra = ( value < 24 ) ? 0 : ( value <= UINT8_MAX ) ? 1 : ( value <= UINT16_MAX ) ? 2 : ( value <= UINT32_MAX ) ? 4 : 8;
+
+    head[0] = (uint8_t)( major << 5 ) | (uint8_t)( ( extra == 0 ) ? value : ( extra == 1 ) ? 24 : ( extra == 2 ) ? 25 : ( extra == 4 ) ? 26 : 27 );
+
+    for( size_t i = 0; i < extra; i++ )
+    {
+        head[1 + i] = (uint8_t)( value >> ( 8 * ( extra - 1 - i ) ) );
+    }
+
+    return append( encoder, head, 1 + extra );
+}
+
+static CborError create_container( CborEncoder *parent, CborEncoder *container, uint8_t major, size_t items, size_t length )
+{
+    CborError error = encode_head( parent, major, length );
+
+    container->data         = parent->data;
+    container->end          = parent->end;
+    container->remaining    = items + 1;
+    container->flags        = parent->flags;
+
+    return error;
+}
@@ -0,0 +1,133 @@
+#include "esp_console.h"
+#include "airshift_host.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define COMMANDS_MAX    16
+#define ARGUMENTS_MAX   8
+#define COMMAND_LINE_MAX 128
+
+struct esp_console_repl_s
+{
+    esp_console_repl_config_t config;
+};
+
+// Forward declarations
+static int  help_command( int argc, char **argv );
+
+static pthread_mutex_t      lock_                   = PTHREAD_MUTEX_INITIALIZER;
+static esp_console_cmd_t    commands_[COMMANDS_MAX] = { 0 };
+static size_t               count_                  = 0;
+static esp_console_repl_t   repl_                   = { 0 };
+
+// Public functions
+esp_err_t esp_console_cmd_register( const esp_console_cmd_t *cmd )
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    if( ( cmd == NULL ) || ( cmd->command == NULL ) || ( cmd->func == NULL ) || ( strchr( cmd->command, ' ' ) != NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    if( count_ < COMMANDS_MAX )
+    {
+        commands_[count_++] = *cmd;
+        ret                 = ESP_OK;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t esp_console_register_help_command( void )
+{
+    const esp_console_cmd_t command = { .command = "help", .help = "Print the list of registered commands", .func = &help_command };
+
+    return esp_console_cmd_register( &command );
+}
+
+esp_err_t esp_console_new_repl_uart( const esp_console_dev_uart_config_t *dev_config, const esp_console_repl_config_t *repl_config, esp_console_repl_t **ret_repl )
+{
+    if( ( dev_config == NULL ) || ( repl_config == NULL ) || ( ret_repl == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    repl_.config    = *repl_config;
+    *ret_repl       = &repl_;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_console_start_repl( esp_console_repl_t *repl )
+{
+    // stdin belongs to the harness, nothing reads a prompt ...
+    return ( repl != NULL ) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t host_console_run( const char *command_line, int *result )
+{
+    char                    line[COMMAND_LINE_MAX]  = { 0 };
+    char                    *argv[ARGUMENTS_MAX]    = { 0 };
+    char                    *save                   = NULL;
+    int                     argc                    = 0;
+    esp_console_cmd_func_t  func                    = NULL;
+
+    if( ( command_line == NULL ) || ( strlen( command_line ) >= sizeof( line ) ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    strcpy( line, command_line );
+
+    for( char *token = strtok_r( line, " ", &save ); ( token != NULL ) && ( argc < ARGUMENTS_MAX ); token = strtok_r( NULL, " ", &save ) )
+    {
+        argv[argc++] = token;
+    }
+
+    if( argc == 0 )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    for( size_t i = 0; i < count_; i++ )
+    {
+        if( strcmp( commands_[i].command, argv[0] ) == 0 )
+        {
+            func = commands_[i].func;
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    if( func == NULL )
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    *result = func( argc, argv );
+
+    return ESP_OK;
+}
+
+// Private functions
+static int help_command( int argc, char **argv )
+{
+    pthread_mutex_lock( &lock_ );
+
+    for( size_t i = 0; i < count_; i++ )
+    {
+        printf( "%s %s\n  %s\n", commands_[i].command, ( commands_[i].hint != NULL ) ? commands_[i].hint : "", ( commands_[i].help != NULL ) ? commands_[i].help : "" );
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return 0;
+}
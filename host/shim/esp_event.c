@@ -0,0 +1,252 @@
+#include "esp_event.h"
+#include "esp_log.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define EVENT_QUEUE_LENGTH      32
+#define EVENT_HANDLERS_MAX      32
+#define EVENT_TASK_STACK_SIZE   4096
+#define EVENT_TASK_PRIORITY     20
+
+typedef struct
+{
+    bool                    used;
+    esp_event_base_t        base;
+    int32_t                 id;
+    esp_event_handler_t     handler;
+    void                    *arg;
+} handler_t;
+
+typedef struct
+{
+    esp_event_base_t        base;
+    int32_t                 id;
+    void                    *data;
+} event_t;
+
+static const char* TAG = "esp_event";
+
+// Forward declarations
+static void         event_task( void *arguments );
+static bool         matches( const handler_t *handler, esp_event_base_t base, int32_t id );
+
+static QueueHandle_t    queue_                          = NULL;
+static TaskHandle_t     task_                           = NULL;
+static portMUX_TYPE     lock_                           = portMUX_INITIALIZER_UNLOCKED;
+static handler_t        handlers_[EVENT_HANDLERS_MAX]   = { 0 };
+
+// Public functions
+esp_err_t esp_event_loop_create_default( void )
+{
+    if( queue_ != NULL )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    queue_ = xQueueCreate( EVENT_QUEUE_LENGTH, sizeof( event_t ) );
+
+    if( queue_ == NULL )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if( xTaskCreate( event_task, "sys_evt", EVENT_TASK_STACK_SIZE, NULL, EVENT_TASK_PRIORITY, &task_ ) != pdPASS )
+    {
+        vQueueDelete( queue_ );
+
+        queue_ = NULL;
+
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_delete_default( void )
+{
+    if( queue_ == NULL )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    vTaskDelete( task_ );
+
+    task_ = NULL;
+
+    vQueueDelete( queue_ );
+
+    queue_ = NULL;
+
+    portENTER_CRITICAL( &lock_ );
+
+    memset( handlers_, 0, sizeof( handlers_ ) );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register( esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg )
+{
+    return esp_event_handler_instance_register( event_base, event_id, event_handler, event_handler_arg, NULL );
+}
+
+esp_err_t esp_event_handler_unregister( esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler )
+{
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    portENTER_CRITICAL( &lock_ );
+
+    for( int i = 0; i < EVENT_HANDLERS_MAX; i++ )
+    {
+        if( ( handlers_[i].used == true ) && ( handlers_[i].base == event_base ) && ( handlers_[i].id == event_id ) && ( handlers_[i].handler == event_handler ) )
+        {
+            handlers_[i].used   = false;
+            ret                 = ESP_OK;
+        }
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ret;
+}
+
+esp_err_t esp_event_handler_instance_register( esp_event_base_t event_base, int32_t event_id, esp_event_handler_t event_handler, void *event_handler_arg, esp_event_handler_instance_t *instance )
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    if( event_handler == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    for( int i = 0; i < EVENT_HANDLERS_MAX; i++ )
+    {
+        if( handlers_[i].used != true )
+        {
+            handlers_[i] = (handler_t){ .used = true, .base = event_base, .id = event_id, .handler = event_handler, .arg = event_handler_arg };
+
+            if( instance != NULL )
+            {
+                *instance = &handlers_[i];
+            }
+
+            ret = ESP_OK;
+
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ret;
+}
+
+esp_err_t esp_event_handler_instance_unregister( esp_event_base_t event_base, int32_t event_id, esp_event_handler_instance_t instance )
+{
+    handler_t *handler = (handler_t *)instance;
+
+    if( handler == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    handler->used = false;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post( esp_event_base_t event_base, int32_t event_id, const void *event_data, size_t event_data_size, TickType_t ticks_to_wait )
+{
+    event_t event = { .base = event_base, .id = event_id, .data = NULL };
+
+    if( queue_ == NULL )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // the loop owns a copy of the data, as on the target ...
+    if( ( event_data != NULL ) && ( event_data_size > 0 ) )
+    {
+        event.data = malloc( event_data_size );
+
+        if( event.data == NULL )
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        memcpy( event.data, event_data, event_data_size );
+    }
+
+    if( xQueueSend( queue_, &event, ticks_to_wait ) != pdTRUE )
+    {
+        ESP_LOGW( TAG, "event queue full, dropped %s:%ld", event_base, (long)event_id );
+
+        free( event.data );
+
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+// Private functions
+static void event_task( void *arguments )
+{
+    event_t     event                           = { 0 };
+    handler_t   matched[EVENT_HANDLERS_MAX]     = { 0 };
+
+    while( true )
+    {
+        int count = 0;
+
+        if( xQueueReceive( queue_, &event, portMAX_DELAY ) != pdTRUE )
+        {
+            continue;
+        }
+
+        // handlers may register or unregister from inside a callback, run them from a snapshot ...
+        portENTER_CRITICAL( &lock_ );
+
+        for( int i = 0; i < EVENT_HANDLERS_MAX; i++ )
+        {
+            if( matches( &handlers_[i], event.base, event.id ) == true )
+            {
+                matched[count++] = handlers_[i];
+            }
+        }
+
+        portEXIT_CRITICAL( &lock_ );
+
+        for( int i = 0; i < count; i++ )
+        {
+            matched[i].handler( matched[i].arg, event.base, event.id, event.data );
+        }
+
+        free( event.data );
+    }
+}
+
+static bool matches( const handler_t *handler, esp_event_base_t base, int32_t id )
+{
+    if( handler->used != true )
+    {
+        return false;
+    }
+
+    if( ( handler->base != ESP_EVENT_ANY_BASE ) && ( handler->base != base ) && ( strcmp( handler->base, base ) != 0 ) )
+    {
+        return false;
+    }
+
+    return ( handler->id == ESP_EVENT_ANY_ID ) || ( handler->id == id );
+}
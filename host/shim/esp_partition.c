@@ -0,0 +1,205 @@
+#include "esp_partition.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "airshift_host.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PARTITIONS_MAX  4
+
+typedef struct
+{
+    esp_partition_t partition;
+    uint8_t         *data;
+} partition_t;
+
+static const char* TAG = "esp_partition";
+
+// Forward declarations
+static const partition_t    *lookup( const esp_partition_t *partition, size_t offset, size_t size );
+
+static partition_t  partitions_[PARTITIONS_MAX]     = { 0 };
+static size_t       count_                          = 0;
+static portMUX_TYPE lock_                           = portMUX_INITIALIZER_UNLOCKED;
+
+// Public functions
+esp_err_t host_partition_register( const char *label, uint8_t type, uint8_t subtype, size_t size, const char *path )
+{
+    partition_t *entry  = NULL;
+    uint8_t     *data   = NULL;
+
+    if( ( label == NULL ) || ( size == 0 ) || ( ( size % SPI_FLASH_SEC_SIZE ) != 0 ) || ( count_ >= PARTITIONS_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if( path != NULL )
+    {
+        struct stat status  = { 0 };
+        int         fd      = open( path, O_RDWR | O_CREAT, 0644 );
+        bool        blank   = false;
+
+        if( fd < 0 )
+        {
+            ESP_LOGE( TAG, "open %s failed", path );
+
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        blank = ( fstat( fd, &status ) == 0 ) && ( (size_t)status.st_size < size );
+
+        if( ( blank == true ) && ( ftruncate( fd, size ) != 0 ) )
+        {
+            close( fd );
+
+            return ESP_ERR_NO_MEM;
+        }
+
+        // writes land in the file directly, a killed run leaves flash exactly as a power cut would ...
+        data = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+
+        close( fd );
+
+        if( data == MAP_FAILED )
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        if( blank == true )
+        {
+            memset( data, 0xff, size );
+        }
+    }
+    else
+    {
+        data = malloc( size );
+
+        if( data == NULL )
+        {
+            return ESP_ERR_NO_MEM;
+        }
+
+        memset( data, 0xff, size );
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    entry = &partitions_[count_++];
+
+    entry->partition.type       = (esp_partition_type_t)type;
+    entry->partition.subtype    = (esp_partition_subtype_t)subtype;
+    entry->partition.size       = size;
+    entry->partition.erase_size = SPI_FLASH_SEC_SIZE;
+    entry->data                 = data;
+
+    strncpy( entry->partition.label, label, sizeof( entry->partition.label ) - 1 );
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+const esp_partition_t *esp_partition_find_first( esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label )
+{
+    const esp_partition_t *found = NULL;
+
+    portENTER_CRITICAL( &lock_ );
+
+    for( size_t i = 0; i < count_; i++ )
+    {
+        const esp_partition_t *partition = &partitions_[i].partition;
+
+        if( ( type != ESP_PARTITION_TYPE_ANY ) && ( partition->type != type ) )
+        {
+            continue;
+        }
+
+        if( ( subtype != ESP_PARTITION_SUBTYPE_ANY ) && ( partition->subtype != subtype ) )
+        {
+            continue;
+        }
+
+        if( ( label != NULL ) && ( strcmp( partition->label, label ) != 0 ) )
+        {
+            continue;
+        }
+
+        found = partition;
+
+        break;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return found;
+}
+
+esp_err_t esp_partition_read( const esp_partition_t *partition, size_t src_offset, void *dst, size_t size )
+{
+    const partition_t *entry = lookup( partition, src_offset, size );
+
+    if( entry == NULL )
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    memcpy( dst, &entry->data[src_offset], size );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write( const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size )
+{
+    const partition_t   *entry  = lookup( partition, dst_offset, size );
+    const uint8_t       *bytes  = (const uint8_t *)src;
+
+    if( entry == NULL )
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // nor flash, programming only ever clears bits ...
+    for( size_t i = 0; i < size; i++ )
+    {
+        entry->data[dst_offset + i] &= bytes[i];
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range( const esp_partition_t *partition, size_t offset, size_t size )
+{
+    const partition_t *entry = lookup( partition, offset, size );
+
+    if( entry == NULL )
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if( ( ( offset % SPI_FLASH_SEC_SIZE ) != 0 ) || ( ( size % SPI_FLASH_SEC_SIZE ) != 0 ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset( &entry->data[offset], 0xff, size );
+
+    return ESP_OK;
+}
+
+// Private functions
+static const partition_t *lookup( const esp_partition_t *partition, size_t offset, size_t size )
+{
+    for( size_t i = 0; i < count_; i++ )
+    {
+        if( &partitions_[i].partition == partition )
+        {
+            return ( ( offset + size ) <= partition->size ) ? &partitions_[i] : NULL;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,206 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_sleep.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "airshift_host.h"
+
+#include <stdarg.h>
+#include <string.h>
+
+#define LOG_TAGS_MAX    32
+
+typedef struct
+{
+    const char      *tag;
+    esp_log_level_t level;
+} log_level_t;
+
+typedef struct
+{
+    esp_err_t       code;
+    const char      *name;
+} error_name_t;
+
+static const char* TAG = "esp_system";
+
+static const error_name_t error_names_[] =
+{
+    { ESP_OK,                       "ESP_OK" },
+    { ESP_FAIL,                     "ESP_FAIL" },
+    { ESP_ERR_NO_MEM,               "ESP_ERR_NO_MEM" },
+    { ESP_ERR_INVALID_ARG,          "ESP_ERR_INVALID_ARG" },
+    { ESP_ERR_INVALID_STATE,        "ESP_ERR_INVALID_STATE" },
+    { ESP_ERR_INVALID_SIZE,         "ESP_ERR_INVALID_SIZE" },
+    { ESP_ERR_NOT_FOUND,            "ESP_ERR_NOT_FOUND" },
+    { ESP_ERR_NOT_SUPPORTED,        "ESP_ERR_NOT_SUPPORTED" },
+    { ESP_ERR_TIMEOUT,              "ESP_ERR_TIMEOUT" },
+    { ESP_ERR_INVALID_RESPONSE,     "ESP_ERR_INVALID_RESPONSE" },
+    { ESP_ERR_INVALID_CRC,          "ESP_ERR_INVALID_CRC" },
+    { ESP_ERR_INVALID_VERSION,      "ESP_ERR_INVALID_VERSION" },
+    { ESP_ERR_INVALID_MAC,          "ESP_ERR_INVALID_MAC" },
+    { ESP_ERR_NOT_FINISHED,         "ESP_ERR_NOT_FINISHED" },
+    { ESP_ERR_NVS_NOT_INITIALIZED,  "ESP_ERR_NVS_NOT_INITIALIZED" },
+    { ESP_ERR_NVS_NOT_FOUND,        "ESP_ERR_NVS_NOT_FOUND" },
+    { ESP_ERR_NVS_READ_ONLY,        "ESP_ERR_NVS_READ_ONLY" },
+    { ESP_ERR_NVS_NOT_ENOUGH_SPACE, "ESP_ERR_NVS_NOT_ENOUGH_SPACE" },
+    { ESP_ERR_NVS_INVALID_HANDLE,   "ESP_ERR_NVS_INVALID_HANDLE" },
+    { ESP_ERR_NVS_INVALID_LENGTH,   "ESP_ERR_NVS_INVALID_LENGTH" },
+};
+
+static portMUX_TYPE     log_lock_                   = portMUX_INITIALIZER_UNLOCKED;
+static esp_log_level_t  log_default_                = CONFIG_LOG_DEFAULT_LEVEL;
+static log_level_t      log_levels_[LOG_TAGS_MAX]   = { 0 };
+
+// Public functions
+const char *esp_err_to_name( esp_err_t code )
+{
+    for( size_t i = 0; i < ( sizeof( error_names_ ) / sizeof( error_names_[0] ) ); i++ )
+    {
+        if( error_names_[i].code == code )
+        {
+            return error_names_[i].name;
+        }
+    }
+
+    return "UNKNOWN ERROR";
+}
+
+void esp_log_level_set( const char *tag, esp_log_level_t level )
+{
+    portENTER_CRITICAL( &log_lock_ );
+
+    if( strcmp( tag, "*" ) == 0 )
+    {
+        log_default_ = level;
+
+        memset( log_levels_, 0, sizeof( log_levels_ ) );
+    }
+    else
+    {
+        for( int i = 0; i < LOG_TAGS_MAX; i++ )
+        {
+            if( ( log_levels_[i].tag == NULL ) || ( strcmp( log_levels_[i].tag, tag ) == 0 ) )
+            {
+                log_levels_[i].tag      = tag;
+                log_levels_[i].level    = level;
+
+                break;
+            }
+        }
+    }
+
+    portEXIT_CRITICAL( &log_lock_ );
+}
+
+esp_log_level_t esp_log_level_get( const char *tag )
+{
+    esp_log_level_t limit = log_default_;
+
+    portENTER_CRITICAL( &log_lock_ );
+
+    for( int i = 0; ( i < LOG_TAGS_MAX ) && ( log_levels_[i].tag != NULL ); i++ )
+    {
+        if( strcmp( log_levels_[i].tag, tag ) == 0 )
+        {
+            limit = log_levels_[i].level;
+
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL( &log_lock_ );
+
+    return limit;
+}
+
+void esp_log_write( esp_log_level_t level, const char *tag, const char *format, ... )
+{
+    va_list arguments;
+
+    if( level <= esp_log_level_get( tag ) )
+    {
+        // the prefix comes from the ESP_LOGx macros like on the target, timestamps are ms on the scaled clock ...
+        va_start( arguments, format );
+        vfprintf( stdout, format, arguments );
+        va_end( arguments );
+    }
+}
+
+uint32_t esp_log_timestamp( void )
+{
+    return (uint32_t)( host_clock_now() / 1000 );
+}
+
+esp_reset_reason_t esp_reset_reason( void )
+{
+    return ESP_RST_POWERON;
+}
+
+void esp_restart( void )
+{
+    ESP_LOGW( TAG, "esp_restart, exiting" );
+
+    fflush( stdout );
+
+    exit( 0 );
+}
+
+uint32_t esp_get_free_heap_size( void )
+{
+    return UINT32_MAX;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause( void )
+{
+    return ESP_SLEEP_WAKEUP_UNDEFINED;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status( void )
+{
+    return 0;
+}
+
+esp_err_t esp_read_mac( uint8_t *mac, esp_mac_type_t type )
+{
+    // locally administered, so it never collides with a real device on the same broker ...
+    const uint8_t base[6] = { 0x02, 0x00, 0x00, 0xa1, 0x4b, 0x00 };
+
+    if( mac == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy( mac, base, sizeof( base ) );
+
+    mac[5] += (uint8_t)type;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_init( void )
+{
+    return ESP_OK;
+}
+
+uint16_t esp_rom_crc16_le( uint16_t crc, const uint8_t *buf, uint32_t len )
+{
+    // crc16 ccitt, reflected, inverted in and out like the rom routine ...
+    crc = ~crc;
+
+    for( uint32_t i = 0; i < len; i++ )
+    {
+        crc ^= buf[i];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x0001 ) ? ( ( crc >> 1 ) ^ 0x8408 ) : ( crc >> 1 );
+        }
+    }
+
+    return ~crc;
+}
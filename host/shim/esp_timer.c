@@ -0,0 +1,281 @@
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "airshift_host.h"
+
+#include <stdlib.h>
+
+#define TIMER_TASK_STACK_SIZE   4096
+#define TIMER_TASK_PRIORITY     22
+
+struct esp_timer
+{
+    esp_timer_cb_t      callback;
+    void                *arg;
+    const char          *name;
+    bool                armed;
+    int64_t             alarm;
+    uint64_t            period;         // 0 for one shot timers
+    struct esp_timer    *next;
+};
+
+static const char* TAG = "esp_timer";
+
+// Forward declarations
+static void         timer_task( void *arguments );
+static void         timer_task_start();
+static void         arm( esp_timer_handle_t timer, int64_t alarm, uint64_t period );
+
+static pthread_mutex_t      lock_       = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       changed_;
+static pthread_once_t       once_       = PTHREAD_ONCE_INIT;
+static struct esp_timer     *timers_    = NULL;
+
+// Public functions
+esp_err_t esp_timer_create( const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle )
+{
+    struct esp_timer *timer = NULL;
+
+    if( ( create_args == NULL ) || ( create_args->callback == NULL ) || ( out_handle == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_once( &once_, timer_task_start );
+
+    timer = calloc( 1, sizeof( struct esp_timer ) );
+
+    if( timer == NULL )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    timer->callback = create_args->callback;
+    timer->arg      = create_args->arg;
+    timer->name     = create_args->name;
+
+    pthread_mutex_lock( &lock_ );
+
+    timer->next = timers_;
+    timers_     = timer;
+
+    pthread_mutex_unlock( &lock_ );
+
+    *out_handle = timer;
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once( esp_timer_handle_t timer, uint64_t timeout_us )
+{
+    if( esp_timer_is_active( timer ) == true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    arm( timer, esp_timer_get_time() + (int64_t)timeout_us, 0 );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic( esp_timer_handle_t timer, uint64_t period )
+{
+    if( esp_timer_is_active( timer ) == true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    arm( timer, esp_timer_get_time() + (int64_t)period, period );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_restart( esp_timer_handle_t timer, uint64_t timeout_us )
+{
+    if( esp_timer_is_active( timer ) != true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    arm( timer, esp_timer_get_time() + (int64_t)timeout_us, ( timer->period != 0 ) ? timeout_us : 0 );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop( esp_timer_handle_t timer )
+{
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+
+    pthread_mutex_lock( &lock_ );
+
+    if( timer->armed == true )
+    {
+        timer->armed    = false;
+        ret             = ESP_OK;
+
+        pthread_cond_broadcast( &changed_ );
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t esp_timer_delete( esp_timer_handle_t timer )
+{
+    if( timer == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    if( timer->armed == true )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for( struct esp_timer **link = &timers_; *link != NULL; link = &( *link )->next )
+    {
+        if( *link == timer )
+        {
+            *link = timer->next;
+
+            break;
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    free( timer );
+
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time( void )
+{
+    return host_clock_now();
+}
+
+int64_t esp_timer_get_next_alarm( void )
+{
+    int64_t next = INT64_MAX;
+
+    pthread_mutex_lock( &lock_ );
+
+    for( struct esp_timer *timer = timers_; timer != NULL; timer = timer->next )
+    {
+        if( ( timer->armed == true ) && ( timer->alarm < next ) )
+        {
+            next = timer->alarm;
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return next;
+}
+
+bool esp_timer_is_active( esp_timer_handle_t timer )
+{
+    bool armed = false;
+
+    pthread_mutex_lock( &lock_ );
+
+    armed = timer->armed;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return armed;
+}
+
+// Private functions
+static void timer_task_start()
+{
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init( &attributes );
+    pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+    pthread_cond_init( &changed_, &attributes );
+    pthread_condattr_destroy( &attributes );
+
+    // callbacks are dispatched from a task, as with ESP_TIMER_TASK on the target ...
+    if( xTaskCreate( timer_task, "esp_timer", TIMER_TASK_STACK_SIZE, NULL, TIMER_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        ESP_LOGE( TAG, "xTaskCreate -> esp_timer failed" );
+    }
+}
+
+static void arm( esp_timer_handle_t timer, int64_t alarm, uint64_t period )
+{
+    pthread_mutex_lock( &lock_ );
+
+    timer->alarm    = alarm;
+    timer->period   = period;
+    timer->armed    = true;
+
+    pthread_cond_broadcast( &changed_ );
+
+    pthread_mutex_unlock( &lock_ );
+}
+
+static void timer_task( void *arguments )
+{
+    pthread_mutex_lock( &lock_ );
+
+    while( true )
+    {
+        struct esp_timer    *due    = NULL;
+        int64_t             now     = esp_timer_get_time();
+
+        for( struct esp_timer *timer = timers_; timer != NULL; timer = timer->next )
+        {
+            if( ( timer->armed == true ) && ( ( due == NULL ) || ( timer->alarm < due->alarm ) ) )
+            {
+                due = timer;
+            }
+        }
+
+        if( due == NULL )
+        {
+            pthread_cond_wait( &changed_, &lock_ );
+
+            continue;
+        }
+
+        if( due->alarm > now )
+        {
+            struct timespec timespec = { 0 };
+
+            host_clock_to_timespec( due->alarm, &timespec );
+
+            pthread_cond_timedwait( &changed_, &lock_, &timespec );
+
+            continue;
+        }
+
+        // periodic timers keep their phase, a late callback does not push the next one out ...
+        if( due->period != 0 )
+        {
+            due->alarm += (int64_t)due->period;
+        }
+        else
+        {
+            due->armed = false;
+        }
+
+        {
+            esp_timer_cb_t  callback    = due->callback;
+            void            *arg        = due->arg;
+
+            pthread_mutex_unlock( &lock_ );
+
+            callback( arg );
+
+            pthread_mutex_lock( &lock_ );
+        }
+    }
+}
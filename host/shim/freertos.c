@@ -0,0 +1,854 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "airshift_host.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TASK_NAME_SIZE      16
+#define TASK_STACK_MIN      ( 256 * 1024 )      // host code paths ( libc printf ) need more than the target sizes
+
+struct host_task
+{
+    pthread_t           thread;
+    char                name[TASK_NAME_SIZE];
+    UBaseType_t         priority;
+    TaskFunction_t      function;
+    void                *arguments;
+    clockid_t           clock;
+    bool                clock_valid;
+    bool                running;
+    int64_t             cpu_time;               // cpu time of a task that has ended
+    uint32_t            notify_value;
+    bool                notify_pending;
+    pthread_cond_t      notify_cond;
+    struct host_task    *next;
+};
+
+struct host_queue
+{
+    uint8_t             *storage;
+    UBaseType_t         length;
+    UBaseType_t         item_size;
+    UBaseType_t         count;
+    UBaseType_t         head;
+    pthread_cond_t      not_empty;
+    pthread_cond_t      not_full;
+};
+
+struct host_event_group
+{
+    EventBits_t         bits;
+    pthread_cond_t      changed;
+};
+
+// Forward declarations
+static void         *task_entry( void *arguments );
+static void         task_finish( struct host_task *task );
+static bool         block( pthread_cond_t *cond, int64_t deadline );
+static void         unlock_kernel( void *arguments );
+static void         cond_init( pthread_cond_t *cond );
+static int64_t      timespec_to_us( struct timespec timespec );
+
+// one lock for every kernel object, simple and plenty for a handful of tasks ...
+static pthread_mutex_t          kernel_     = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task         *tasks_     = NULL;
+static __thread struct host_task *current_  = NULL;
+
+static double                   speed_      = 1.0;
+static struct timespec          origin_     = { 0 };
+
+// Public functions
+void host_clock_init( double speed )
+{
+    speed_ = ( speed > 0 ) ? speed : 1.0;
+
+    clock_gettime( CLOCK_MONOTONIC, &origin_ );
+}
+
+double host_clock_get_speed()
+{
+    return speed_;
+}
+
+int64_t host_clock_now()
+{
+    struct timespec now = { 0 };
+
+    if( ( origin_.tv_sec == 0 ) && ( origin_.tv_nsec == 0 ) )
+    {
+        host_clock_init( speed_ );
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (int64_t)( (double)( timespec_to_us( now ) - timespec_to_us( origin_ ) ) * speed_ );
+}
+
+void host_clock_to_timespec( int64_t deadline, struct timespec *timespec )
+{
+    int64_t real = timespec_to_us( origin_ ) + (int64_t)( (double)deadline / speed_ );
+
+    timespec->tv_sec    = real / 1000000;
+    timespec->tv_nsec   = ( real % 1000000 ) * 1000;
+}
+
+int64_t host_clock_deadline( TickType_t ticks_to_wait )
+{
+    if( ticks_to_wait == portMAX_DELAY )
+    {
+        return INT64_MAX;
+    }
+
+    return host_clock_now() + ( (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000 );
+}
+
+void host_clock_sleep_until( int64_t deadline )
+{
+    struct timespec timespec = { 0 };
+
+    host_clock_to_timespec( deadline, &timespec );
+
+    while( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &timespec, NULL ) == EINTR );
+}
+
+size_t host_task_get_info( host_task_info_t *info, size_t max )
+{
+    size_t count = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    for( struct host_task *task = tasks_; ( task != NULL ) && ( count < max ); task = task->next, count++ )
+    {
+        struct timespec cpu = { 0 };
+
+        info[count].name        = task->name;
+        info[count].priority    = task->priority;
+        info[count].running     = task->running;
+        info[count].cpu_time    = task->cpu_time;
+
+        if( ( task->running == true ) && ( task->clock_valid == true ) && ( clock_gettime( task->clock, &cpu ) == 0 ) )
+        {
+            info[count].cpu_time = timespec_to_us( cpu );
+        }
+    }
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return count;
+}
+
+int64_t host_process_cpu_time()
+{
+    struct timespec cpu = { 0 };
+
+    clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &cpu );
+
+    return timespec_to_us( cpu );
+}
+
+BaseType_t xTaskCreate( TaskFunction_t function, const char *name, uint32_t stack_depth, void *arguments, UBaseType_t priority, TaskHandle_t *handle )
+{
+    struct host_task    *task       = calloc( 1, sizeof( struct host_task ) );
+    pthread_attr_t      attributes;
+
+    if( task == NULL )
+    {
+        return pdFAIL;
+    }
+
+    strncpy( task->name, ( name != NULL ) ? name : "", sizeof( task->name ) - 1 );
+    task->priority  = priority;
+    task->function  = function;
+    task->arguments = arguments;
+    task->running   = true;
+
+    cond_init( &task->notify_cond );
+
+    pthread_mutex_lock( &kernel_ );
+
+    task->next  = tasks_;
+    tasks_      = task;
+
+    pthread_attr_init( &attributes );
+    pthread_attr_setstacksize( &attributes, ( stack_depth > TASK_STACK_MIN ) ? stack_depth : TASK_STACK_MIN );
+    pthread_attr_setdetachstate( &attributes, PTHREAD_CREATE_DETACHED );
+
+    // the handle is valid before the task first runs, as on the target ...
+    if( handle != NULL )
+    {
+        *handle = task;
+    }
+
+    if( pthread_create( &task->thread, &attributes, task_entry, task ) != 0 )
+    {
+        task->running = false;
+
+        pthread_mutex_unlock( &kernel_ );
+        pthread_attr_destroy( &attributes );
+
+        if( handle != NULL )
+        {
+            *handle = NULL;
+        }
+
+        return pdFAIL;
+    }
+
+    pthread_mutex_unlock( &kernel_ );
+    pthread_attr_destroy( &attributes );
+
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore( TaskFunction_t function, const char *name, uint32_t stack_depth, void *arguments, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core )
+{
+    return xTaskCreate( function, name, stack_depth, arguments, priority, handle );
+}
+
+void vTaskDelete( TaskHandle_t task )
+{
+    if( ( task == NULL ) || ( task == current_ ) )
+    {
+        task_finish( current_ );
+
+        pthread_exit( NULL );
+    }
+
+    pthread_mutex_lock( &kernel_ );
+
+    if( task->running == true )
+    {
+        struct timespec cpu = { 0 };
+
+        if( ( task->clock_valid == true ) && ( clock_gettime( task->clock, &cpu ) == 0 ) )
+        {
+            task->cpu_time = timespec_to_us( cpu );
+        }
+
+        task->running = false;
+
+        pthread_cancel( task->thread );
+    }
+
+    pthread_mutex_unlock( &kernel_ );
+}
+
+void vTaskDelay( TickType_t ticks )
+{
+    host_clock_sleep_until( host_clock_deadline( ticks ) );
+}
+
+BaseType_t xTaskDelayUntil( TickType_t *previous_wake_time, TickType_t increment )
+{
+    TickType_t  wake    = *previous_wake_time + increment;
+    BaseType_t  delayed = ( (int32_t)( wake - xTaskGetTickCount() ) > 0 ) ? pdTRUE : pdFALSE;
+
+    if( delayed == pdTRUE )
+    {
+        host_clock_sleep_until( (int64_t)wake * portTICK_PERIOD_MS * 1000 );
+    }
+
+    *previous_wake_time = wake;
+
+    return delayed;
+}
+
+TickType_t xTaskGetTickCount( void )
+{
+    return (TickType_t)( host_clock_now() / ( portTICK_PERIOD_MS * 1000 ) );
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return current_;
+}
+
+const char *pcTaskGetName( TaskHandle_t task )
+{
+    task = ( task != NULL ) ? task : current_;
+
+    return ( task != NULL ) ? task->name : "main";
+}
+
+UBaseType_t uxTaskPriorityGet( TaskHandle_t task )
+{
+    task = ( task != NULL ) ? task : current_;
+
+    return ( task != NULL ) ? task->priority : 0;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark( TaskHandle_t task )
+{
+    // not measured on the host ...
+    return TASK_STACK_MIN;
+}
+
+uint32_t ulTaskNotifyTake( BaseType_t clear_on_exit, TickType_t ticks_to_wait )
+{
+    struct host_task    *task       = current_;
+    int64_t             deadline    = host_clock_deadline( ticks_to_wait );
+    uint32_t            value       = 0;
+
+    if( task == NULL )
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( ( task->notify_value == 0 ) && ( block( &task->notify_cond, deadline ) == true ) );
+
+    value = task->notify_value;
+
+    if( value != 0 )
+    {
+        task->notify_value = ( clear_on_exit == pdTRUE ) ? 0 : ( value - 1 );
+    }
+
+    task->notify_pending = false;
+
+    pthread_cleanup_pop( 1 );
+
+    return value;
+}
+
+BaseType_t xTaskNotifyGive( TaskHandle_t task )
+{
+    return xTaskNotify( task, 0, eIncrement );
+}
+
+void vTaskNotifyGiveFromISR( TaskHandle_t task, BaseType_t *higher_priority_task_woken )
+{
+    if( higher_priority_task_woken != NULL )
+    {
+        *higher_priority_task_woken = pdFALSE;
+    }
+
+    xTaskNotify( task, 0, eIncrement );
+}
+
+BaseType_t xTaskNotify( TaskHandle_t task, uint32_t value, eNotifyAction action )
+{
+    BaseType_t ret = pdPASS;
+
+    if( task == NULL )
+    {
+        return pdFAIL;
+    }
+
+    pthread_mutex_lock( &kernel_ );
+
+    switch( action )
+    {
+        case eSetBits:
+        {
+            task->notify_value |= value;
+
+            break;
+        }
+        case eIncrement:
+        {
+            task->notify_value++;
+
+            break;
+        }
+        case eSetValueWithOverwrite:
+        {
+            task->notify_value = value;
+
+            break;
+        }
+        case eSetValueWithoutOverwrite:
+        {
+            if( task->notify_pending == true )
+            {
+                ret = pdFAIL;
+            }
+            else
+            {
+                task->notify_value = value;
+            }
+
+            break;
+        }
+        case eNoAction:
+        {
+            break;
+        }
+    }
+
+    task->notify_pending = true;
+
+    pthread_cond_broadcast( &task->notify_cond );
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return ret;
+}
+
+BaseType_t xTaskNotifyWait( uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks_to_wait )
+{
+    struct host_task    *task       = current_;
+    int64_t             deadline    = host_clock_deadline( ticks_to_wait );
+    BaseType_t          ret         = pdFAIL;
+
+    if( task == NULL )
+    {
+        return pdFAIL;
+    }
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    if( task->notify_pending == false )
+    {
+        task->notify_value &= ~clear_on_entry;
+    }
+
+    while( ( task->notify_pending == false ) && ( block( &task->notify_cond, deadline ) == true ) );
+
+    if( value != NULL )
+    {
+        *value = task->notify_value;
+    }
+
+    if( task->notify_pending == true )
+    {
+        task->notify_value      &= ~clear_on_exit;
+        task->notify_pending    = false;
+        ret                     = pdPASS;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return ret;
+}
+
+QueueHandle_t xQueueCreate( UBaseType_t length, UBaseType_t item_size )
+{
+    struct host_queue *queue = calloc( 1, sizeof( struct host_queue ) );
+
+    if( ( queue == NULL ) || ( length == 0 ) )
+    {
+        free( queue );
+
+        return NULL;
+    }
+
+    queue->length       = length;
+    queue->item_size    = item_size;
+
+    if( item_size > 0 )
+    {
+        queue->storage = calloc( length, item_size );
+
+        if( queue->storage == NULL )
+        {
+            free( queue );
+
+            return NULL;
+        }
+    }
+
+    cond_init( &queue->not_empty );
+    cond_init( &queue->not_full );
+
+    return queue;
+}
+
+QueueHandle_t xQueueCreateCountingSemaphore( UBaseType_t max_count, UBaseType_t initial_count )
+{
+    struct host_queue *queue = xQueueCreate( max_count, 0 );
+
+    if( queue != NULL )
+    {
+        queue->count = ( initial_count < max_count ) ? initial_count : max_count;
+    }
+
+    return queue;
+}
+
+void vQueueDelete( QueueHandle_t queue )
+{
+    if( queue == NULL )
+    {
+        return;
+    }
+
+    pthread_cond_destroy( &queue->not_empty );
+    pthread_cond_destroy( &queue->not_full );
+
+    free( queue->storage );
+    free( queue );
+}
+
+BaseType_t xQueueSendToBack( QueueHandle_t queue, const void *item, TickType_t ticks_to_wait )
+{
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+    BaseType_t  ret         = pdFAIL;
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( ( queue->count >= queue->length ) && ( block( &queue->not_full, deadline ) == true ) );
+
+    if( queue->count < queue->length )
+    {
+        if( queue->item_size > 0 )
+        {
+            memcpy( &queue->storage[( ( queue->head + queue->count ) % queue->length ) * queue->item_size], item, queue->item_size );
+        }
+
+        queue->count++;
+
+        pthread_cond_signal( &queue->not_empty );
+
+        ret = pdPASS;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return ret;
+}
+
+BaseType_t xQueueSendToFront( QueueHandle_t queue, const void *item, TickType_t ticks_to_wait )
+{
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+    BaseType_t  ret         = pdFAIL;
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( ( queue->count >= queue->length ) && ( block( &queue->not_full, deadline ) == true ) );
+
+    if( queue->count < queue->length )
+    {
+        queue->head = ( queue->head + queue->length - 1 ) % queue->length;
+
+        if( queue->item_size > 0 )
+        {
+            memcpy( &queue->storage[queue->head * queue->item_size], item, queue->item_size );
+        }
+
+        queue->count++;
+
+        pthread_cond_signal( &queue->not_empty );
+
+        ret = pdPASS;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return ret;
+}
+
+BaseType_t xQueueOverwrite( QueueHandle_t queue, const void *item )
+{
+    pthread_mutex_lock( &kernel_ );
+
+    // only meaningful for queues of length one ...
+    queue->head     = 0;
+    queue->count    = 1;
+
+    if( queue->item_size > 0 )
+    {
+        memcpy( queue->storage, item, queue->item_size );
+    }
+
+    pthread_cond_signal( &queue->not_empty );
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive( QueueHandle_t queue, void *item, TickType_t ticks_to_wait )
+{
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+    BaseType_t  ret         = pdFAIL;
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( ( queue->count == 0 ) && ( block( &queue->not_empty, deadline ) == true ) );
+
+    if( queue->count > 0 )
+    {
+        if( queue->item_size > 0 )
+        {
+            memcpy( item, &queue->storage[queue->head * queue->item_size], queue->item_size );
+        }
+
+        queue->head = ( queue->head + 1 ) % queue->length;
+        queue->count--;
+
+        pthread_cond_signal( &queue->not_full );
+
+        ret = pdPASS;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return ret;
+}
+
+BaseType_t xQueuePeek( QueueHandle_t queue, void *item, TickType_t ticks_to_wait )
+{
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+    BaseType_t  ret         = pdFAIL;
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( ( queue->count == 0 ) && ( block( &queue->not_empty, deadline ) == true ) );
+
+    if( queue->count > 0 )
+    {
+        if( queue->item_size > 0 )
+        {
+            memcpy( item, &queue->storage[queue->head * queue->item_size], queue->item_size );
+        }
+
+        ret = pdPASS;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return ret;
+}
+
+BaseType_t xQueueReset( QueueHandle_t queue )
+{
+    pthread_mutex_lock( &kernel_ );
+
+    queue->head     = 0;
+    queue->count    = 0;
+
+    pthread_cond_broadcast( &queue->not_full );
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting( QueueHandle_t queue )
+{
+    UBaseType_t count = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    count = queue->count;
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable( QueueHandle_t queue )
+{
+    UBaseType_t spaces = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    spaces = queue->length - queue->count;
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return spaces;
+}
+
+EventGroupHandle_t xEventGroupCreate( void )
+{
+    struct host_event_group *group = calloc( 1, sizeof( struct host_event_group ) );
+
+    if( group != NULL )
+    {
+        cond_init( &group->changed );
+    }
+
+    return group;
+}
+
+void vEventGroupDelete( EventGroupHandle_t group )
+{
+    if( group == NULL )
+    {
+        return;
+    }
+
+    pthread_cond_destroy( &group->changed );
+
+    free( group );
+}
+
+EventBits_t xEventGroupSetBits( EventGroupHandle_t group, EventBits_t bits )
+{
+    EventBits_t current = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    group->bits |= bits;
+    current     = group->bits;
+
+    pthread_cond_broadcast( &group->changed );
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return current;
+}
+
+EventBits_t xEventGroupClearBits( EventGroupHandle_t group, EventBits_t bits )
+{
+    EventBits_t previous = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    previous    = group->bits;
+    group->bits &= ~bits;
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits( EventGroupHandle_t group )
+{
+    EventBits_t current = 0;
+
+    pthread_mutex_lock( &kernel_ );
+
+    current = group->bits;
+
+    pthread_mutex_unlock( &kernel_ );
+
+    return current;
+}
+
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks_to_wait )
+{
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+    EventBits_t current     = 0;
+    bool        satisfied   = false;
+
+    pthread_mutex_lock( &kernel_ );
+    pthread_cleanup_push( unlock_kernel, NULL );
+
+    while( true )
+    {
+        current     = group->bits;
+        satisfied   = ( wait_for_all == pdTRUE ) ? ( ( current & bits ) == bits ) : ( ( current & bits ) != 0 );
+
+        if( ( satisfied == true ) || ( block( &group->changed, deadline ) == false ) )
+        {
+            break;
+        }
+    }
+
+    // one last look, the bits may have been set right as the wait timed out ...
+    current     = group->bits;
+    satisfied   = ( wait_for_all == pdTRUE ) ? ( ( current & bits ) == bits ) : ( ( current & bits ) != 0 );
+
+    if( ( satisfied == true ) && ( clear_on_exit == pdTRUE ) )
+    {
+        group->bits &= ~bits;
+    }
+
+    pthread_cleanup_pop( 1 );
+
+    return current;
+}
+
+// Private functions
+static void *task_entry( void *arguments )
+{
+    struct host_task *task = (struct host_task *)arguments;
+
+    current_ = task;
+
+    pthread_mutex_lock( &kernel_ );
+
+    task->clock_valid = ( pthread_getcpuclockid( pthread_self(), &task->clock ) == 0 );
+
+    pthread_mutex_unlock( &kernel_ );
+
+    pthread_setname_np( pthread_self(), task->name );
+
+    task->function( task->arguments );
+
+    // a FreeRTOS task must never return, treat it as deleting itself ...
+    task_finish( task );
+
+    return NULL;
+}
+
+static void task_finish( struct host_task *task )
+{
+    struct timespec cpu = { 0 };
+
+    if( task == NULL )
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &kernel_ );
+
+    if( ( task->clock_valid == true ) && ( clock_gettime( task->clock, &cpu ) == 0 ) )
+    {
+        task->cpu_time = timespec_to_us( cpu );
+    }
+
+    task->running = false;
+
+    pthread_mutex_unlock( &kernel_ );
+}
+
+static bool block( pthread_cond_t *cond, int64_t deadline )
+{
+    struct timespec timespec = { 0 };
+
+    if( deadline == INT64_MAX )
+    {
+        pthread_cond_wait( cond, &kernel_ );
+
+        return true;
+    }
+
+    if( host_clock_now() >= deadline )
+    {
+        return false;
+    }
+
+    host_clock_to_timespec( deadline, &timespec );
+
+    // a spurious or early wake up just goes around the caller's loop again ...
+    pthread_cond_timedwait( cond, &kernel_, &timespec );
+
+    return true;
+}
+
+static void unlock_kernel( void *arguments )
+{
+    pthread_mutex_unlock( &kernel_ );
+}
+
+static void cond_init( pthread_cond_t *cond )
+{
+    pthread_condattr_t attributes;
+
+    pthread_condattr_init( &attributes );
+    pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+    pthread_cond_init( cond, &attributes );
+    pthread_condattr_destroy( &attributes );
+}
+
+static int64_t timespec_to_us( struct timespec timespec )
+{
+    return ( (int64_t)timespec.tv_sec * 1000000 ) + ( timespec.tv_nsec / 1000 );
+}
@@ -0,0 +1,143 @@
+#include "driver/i2c.h"
+#include "airshift_host.h"
+
+#define I2C_DEVICES_MAX     8
+
+typedef struct
+{
+    bool                installed;
+    pthread_mutex_t     bus;
+    host_i2c_device_t   devices[I2C_DEVICES_MAX];
+    size_t              count;
+} port_t;
+
+// Forward declarations
+static const host_i2c_device_t  *lookup( i2c_port_t port, uint8_t address );
+
+static port_t ports_[I2C_NUM_MAX] =
+{
+    { .bus = PTHREAD_MUTEX_INITIALIZER },
+    { .bus = PTHREAD_MUTEX_INITIALIZER },
+};
+
+// Public functions
+esp_err_t host_i2c_attach( i2c_port_t port, const host_i2c_device_t *device )
+{
+    if( ( port < 0 ) || ( port >= I2C_NUM_MAX ) || ( device == NULL ) || ( ports_[port].count >= I2C_DEVICES_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &ports_[port].bus );
+
+    ports_[port].devices[ports_[port].count++] = *device;
+
+    pthread_mutex_unlock( &ports_[port].bus );
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_param_config( i2c_port_t i2c_num, const i2c_config_t *i2c_conf )
+{
+    return ( ( i2c_num >= 0 ) && ( i2c_num < I2C_NUM_MAX ) && ( i2c_conf != NULL ) ) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_driver_install( i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags )
+{
+    if( ( i2c_num < 0 ) || ( i2c_num >= I2C_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if( ports_[i2c_num].installed == true )
+    {
+        return ESP_FAIL;
+    }
+
+    ports_[i2c_num].installed = true;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_delete( i2c_port_t i2c_num )
+{
+    if( ( i2c_num < 0 ) || ( i2c_num >= I2C_NUM_MAX ) || ( ports_[i2c_num].installed != true ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ports_[i2c_num].installed = false;
+
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_to_device( i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks_to_wait )
+{
+    const host_i2c_device_t *device = lookup( i2c_num, device_address );
+    esp_err_t               ret     = ESP_FAIL;
+
+    if( ( i2c_num < 0 ) || ( i2c_num >= I2C_NUM_MAX ) || ( ports_[i2c_num].installed != true ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // one transaction on the bus at a time, the driver serializes the same way ...
+    pthread_mutex_lock( &ports_[i2c_num].bus );
+
+    if( ( device != NULL ) && ( device->write != NULL ) )
+    {
+        ret = device->write( device->context, write_buffer, write_size, ticks_to_wait );
+    }
+
+    pthread_mutex_unlock( &ports_[i2c_num].bus );
+
+    return ret;
+}
+
+esp_err_t i2c_master_read_from_device( i2c_port_t i2c_num, uint8_t device_address, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait )
+{
+    const host_i2c_device_t *device = lookup( i2c_num, device_address );
+    esp_err_t               ret     = ESP_FAIL;
+
+    if( ( i2c_num < 0 ) || ( i2c_num >= I2C_NUM_MAX ) || ( ports_[i2c_num].installed != true ) )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock( &ports_[i2c_num].bus );
+
+    if( ( device != NULL ) && ( device->read != NULL ) )
+    {
+        ret = device->read( device->context, read_buffer, read_size, ticks_to_wait );
+    }
+
+    pthread_mutex_unlock( &ports_[i2c_num].bus );
+
+    return ret;
+}
+
+esp_err_t i2c_master_write_read_device( i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait )
+{
+    esp_err_t ret = i2c_master_write_to_device( i2c_num, device_address, write_buffer, write_size, ticks_to_wait );
+
+    return ( ret == ESP_OK ) ? i2c_master_read_from_device( i2c_num, device_address, read_buffer, read_size, ticks_to_wait ) : ret;
+}
+
+// Private functions
+static const host_i2c_device_t *lookup( i2c_port_t port, uint8_t address )
+{
+    if( ( port < 0 ) || ( port >= I2C_NUM_MAX ) )
+    {
+        return NULL;
+    }
+
+    for( size_t i = 0; i < ports_[port].count; i++ )
+    {
+        if( ports_[port].devices[i].address == address )
+        {
+            return &ports_[port].devices[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,78 @@
+// Host build only, the knobs the simulator and harness turn that have no ESP-IDF equivalent ...
+#ifndef AIRSHIFT_HOST_H
+#define AIRSHIFT_HOST_H
+
+#include <time.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/uart.h"
+#include "driver/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Clock, esp_timer_get_time and every FreeRTOS timeout run speed times faster than the wall clock ...
+void        host_clock_init( double speed );
+double      host_clock_get_speed();
+int64_t     host_clock_now();
+void        host_clock_to_timespec( int64_t deadline, struct timespec *timespec );
+int64_t     host_clock_deadline( TickType_t ticks_to_wait );
+void        host_clock_sleep_until( int64_t deadline );
+
+// Tasks, cpu time is the real thread cpu time, it does not scale with the clock ...
+typedef struct
+{
+    const char  *name;
+    UBaseType_t priority;
+    bool        running;
+    int64_t     cpu_time;       // us
+} host_task_info_t;
+
+size_t      host_task_get_info( host_task_info_t *info, size_t max );
+int64_t     host_process_cpu_time();
+
+// Uart, a backend plays the device on the other end of the wire ...
+typedef struct
+{
+    void        *context;
+    void        ( *write )( void *context, const uint8_t *data, size_t length );
+} host_uart_backend_t;
+
+esp_err_t   host_uart_attach( uart_port_t port, const host_uart_backend_t *backend );
+int         host_uart_receive( uart_port_t port, const uint8_t *data, size_t length );
+
+// I2c, a device answers to one address, returning ESP_FAIL from either callback is a nack ...
+typedef struct
+{
+    uint8_t     address;
+    void        *context;
+    esp_err_t   ( *write )( void *context, const uint8_t *data, size_t length, TickType_t ticks_to_wait );
+    esp_err_t   ( *read )( void *context, uint8_t *data, size_t length, TickType_t ticks_to_wait );
+} host_i2c_device_t;
+
+esp_err_t   host_i2c_attach( i2c_port_t port, const host_i2c_device_t *device );
+
+// Mqtt, a backend plays the broker, it sees every publish before esp_mqtt_client_publish returns its msg_id, host_mqtt_deliver
+// raises a client event on the calling thread, the way the mqtt task would ...
+typedef struct
+{
+    void        *context;
+    void        ( *publish )( void *context, int msg_id, const char *topic, const char *data, int length, int qos );
+} host_mqtt_backend_t;
+
+esp_err_t   host_mqtt_attach( const host_mqtt_backend_t *backend );
+esp_err_t   host_mqtt_deliver( int32_t event_id, int msg_id );
+
+// Console, runs a command registered with esp_console_cmd_register, result receives its return value ...
+esp_err_t   host_console_run( const char *command_line, int *result );
+
+// Flash, partitions live in ram, or in a file when path is given so they survive between runs ...
+esp_err_t   host_partition_register( const char *label, uint8_t type, uint8_t subtype, size_t size, const char *path );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_HOST_H
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The tinycbor encoder subset the firmware uses, definite lengths only ...
+typedef enum
+{
+    CborNoError             = 0,
+    CborUnknownError,
+    CborErrorTooManyItems   = 768,
+    CborErrorTooFewItems,
+    CborErrorOutOfMemory    = (int)( ~0U / 2 + 1 ),
+} CborError;
+
+typedef struct CborEncoder
+{
+    uint8_t         *data;
+    const uint8_t   *end;
+    size_t          remaining;      // items still to come in this container, plus one
+    int             flags;
+} CborEncoder;
+
+void        cbor_encoder_init( CborEncoder *encoder, uint8_t *buffer, size_t size, int flags );
+CborError   cbor_encoder_create_array( CborEncoder *parent, CborEncoder *array, size_t length );
+CborError   cbor_encoder_create_map( CborEncoder *parent, CborEncoder *map, size_t length );
+CborError   cbor_encoder_close_container( CborEncoder *parent, const CborEncoder *container );
+CborError   cbor_encode_uint( CborEncoder *encoder, uint64_t value );
+CborError   cbor_encode_int( CborEncoder *encoder, int64_t value );
+CborError   cbor_encode_boolean( CborEncoder *encoder, bool value );
+CborError   cbor_encode_text_stringz( CborEncoder *encoder, const char *string );
+size_t      cbor_encoder_get_buffer_size( const CborEncoder *encoder, const uint8_t *buffer );
+
+#ifdef __cplusplus
+}
+#endif
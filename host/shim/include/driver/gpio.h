@@ -0,0 +1,52 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int gpio_num_t;
+
+#define GPIO_NUM_NC     ( -1 )
+#define GPIO_NUM_0      0
+#define GPIO_NUM_1      1
+#define GPIO_NUM_2      2
+#define GPIO_NUM_3      3
+#define GPIO_NUM_4      4
+#define GPIO_NUM_5      5
+#define GPIO_NUM_6      6
+#define GPIO_NUM_7      7
+#define GPIO_NUM_8      8
+#define GPIO_NUM_9      9
+#define GPIO_NUM_10     10
+#define GPIO_NUM_11     11
+#define GPIO_NUM_12     12
+#define GPIO_NUM_13     13
+#define GPIO_NUM_14     14
+#define GPIO_NUM_15     15
+#define GPIO_NUM_16     16
+#define GPIO_NUM_17     17
+#define GPIO_NUM_18     18
+#define GPIO_NUM_19     19
+#define GPIO_NUM_20     20
+#define GPIO_NUM_21     21
+#define GPIO_NUM_35     35
+#define GPIO_NUM_36     36
+#define GPIO_NUM_37     37
+#define GPIO_NUM_38     38
+#define GPIO_NUM_39     39
+#define GPIO_NUM_40     40
+#define GPIO_NUM_41     41
+#define GPIO_NUM_42     42
+#define GPIO_NUM_48     48
+
+typedef enum
+{
+    GPIO_PULLUP_DISABLE,
+    GPIO_PULLUP_ENABLE
+} gpio_pullup_t;
+
+#ifdef __cplusplus
+}
+#endif
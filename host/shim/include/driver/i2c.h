@@ -0,0 +1,56 @@
+// Host build, transactions are routed by address to the devices attached with host_i2c_attach,
+// an address nobody answers to is a nack ...
+#pragma once
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0       0
+#define I2C_NUM_1       1
+#define I2C_NUM_MAX     2
+
+typedef enum
+{
+    I2C_MODE_SLAVE,
+    I2C_MODE_MASTER
+} i2c_mode_t;
+
+typedef struct
+{
+    i2c_mode_t      mode;
+    int             sda_io_num;
+    int             scl_io_num;
+    bool            sda_pullup_en;
+    bool            scl_pullup_en;
+    union
+    {
+        struct
+        {
+            uint32_t clk_speed;
+        } master;
+        struct
+        {
+            uint8_t     addr_10bit_en;
+            uint16_t    slave_addr;
+        } slave;
+    };
+    uint32_t        clk_flags;
+} i2c_config_t;
+
+esp_err_t   i2c_param_config( i2c_port_t i2c_num, const i2c_config_t *i2c_conf );
+esp_err_t   i2c_driver_install( i2c_port_t i2c_num, i2c_mode_t mode, size_t slv_rx_buf_len, size_t slv_tx_buf_len, int intr_alloc_flags );
+esp_err_t   i2c_driver_delete( i2c_port_t i2c_num );
+esp_err_t   i2c_master_write_to_device( i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks_to_wait );
+esp_err_t   i2c_master_read_from_device( i2c_port_t i2c_num, uint8_t device_address, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait );
+esp_err_t   i2c_master_write_read_device( i2c_port_t i2c_num, uint8_t device_address, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks_to_wait );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,72 @@
+// Host build, bytes written go to the backend attached with host_uart_attach, bytes the backend
+// sends back arrive through the ring buffer and event queue the same way the uart isr delivers them ...
+#pragma once
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int uart_port_t;
+
+#define UART_NUM_0              0
+#define UART_NUM_1              1
+#define UART_NUM_2              2
+#define UART_NUM_MAX            3
+#define UART_PIN_NO_CHANGE      ( -1 )
+#define ESP_INTR_FLAG_IRAM      ( 1 << 10 )
+
+typedef enum { UART_DATA_5_BITS, UART_DATA_6_BITS, UART_DATA_7_BITS, UART_DATA_8_BITS } uart_word_length_t;
+typedef enum { UART_PARITY_DISABLE, UART_PARITY_EVEN = 2, UART_PARITY_ODD } uart_parity_t;
+typedef enum { UART_STOP_BITS_1 = 1, UART_STOP_BITS_1_5, UART_STOP_BITS_2 } uart_stop_bits_t;
+typedef enum { UART_HW_FLOWCTRL_DISABLE } uart_hw_flowcontrol_t;
+typedef enum { UART_SCLK_APB, UART_SCLK_XTAL, UART_SCLK_RTC, UART_SCLK_DEFAULT = UART_SCLK_APB } uart_sclk_t;
+
+typedef struct
+{
+    int                     baud_rate;
+    uart_word_length_t      data_bits;
+    uart_parity_t           parity;
+    uart_stop_bits_t        stop_bits;
+    uart_hw_flowcontrol_t   flow_ctrl;
+    uint8_t                 rx_flow_ctrl_thresh;
+    uart_sclk_t             source_clk;
+} uart_config_t;
+
+typedef enum
+{
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct
+{
+    uart_event_type_t   type;
+    size_t              size;
+    bool                timeout_flag;
+} uart_event_t;
+
+esp_err_t   uart_driver_install( uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags );
+esp_err_t   uart_driver_delete( uart_port_t uart_num );
+bool        uart_is_driver_installed( uart_port_t uart_num );
+esp_err_t   uart_param_config( uart_port_t uart_num, const uart_config_t *uart_config );
+esp_err_t   uart_set_pin( uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num );
+int         uart_write_bytes( uart_port_t uart_num, const void *src, size_t size );
+int         uart_read_bytes( uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait );
+esp_err_t   uart_flush_input( uart_port_t uart_num );
+esp_err_t   uart_get_buffered_data_len( uart_port_t uart_num, size_t *size );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+void            esp_log_level_set( const char *tag, esp_log_level_t level );
+esp_log_level_t esp_log_level_get( const char *tag );
+void            esp_log_write( esp_log_level_t level, const char *tag, const char *format, ... ) __attribute__( ( format( printf, 3, 4 ) ) );
+uint32_t        esp_log_timestamp( void );
+
+// same expansion as the target, the prefix is part of the format and esp_log_write only filters and prints ...
+#define LOG_FORMAT( letter, format )    #letter " (%lu) %s: " format "\n"
+
+#define ESP_LOGE( tag, format, ... )    esp_log_write( ESP_LOG_ERROR, tag, LOG_FORMAT( E, format ), (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__ )
+#define ESP_LOGW( tag, format, ... )    esp_log_write( ESP_LOG_WARN, tag, LOG_FORMAT( W, format ), (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__ )
+#define ESP_LOGI( tag, format, ... )    esp_log_write( ESP_LOG_INFO, tag, LOG_FORMAT( I, format ), (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__ )
+#define ESP_LOGD( tag, format, ... )    esp_log_write( ESP_LOG_DEBUG, tag, LOG_FORMAT( D, format ), (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__ )
+#define ESP_LOGV( tag, format, ... )    esp_log_write( ESP_LOG_VERBOSE, tag, LOG_FORMAT( V, format ), (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__ )
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint16_t    esp_rom_crc16_le( uint16_t crc, const uint8_t *buf, uint32_t len );
+
+#ifdef __cplusplus
+}
+#endif
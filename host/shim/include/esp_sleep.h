@@ -0,0 +1,23 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    ESP_SLEEP_WAKEUP_UNDEFINED,
+    ESP_SLEEP_WAKEUP_ALL,
+    ESP_SLEEP_WAKEUP_EXT0,
+    ESP_SLEEP_WAKEUP_EXT1,
+    ESP_SLEEP_WAKEUP_TIMER
+} esp_sleep_wakeup_cause_t;
+
+esp_sleep_wakeup_cause_t    esp_sleep_get_wakeup_cause( void );
+uint64_t                    esp_sleep_get_ext1_wakeup_status( void );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+// Host build, FreeRTOS API on top of pthreads. Tasks are threads, priorities are recorded but not enforced
+// and every timeout runs on the scaled host clock ( see airshift_host.h ) ...
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t    TickType_t;
+typedef int32_t     BaseType_t;
+typedef uint32_t    UBaseType_t;
+typedef uint32_t    StackType_t;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      pdTRUE
+#define pdFAIL                      pdFALSE
+
+#define configTICK_RATE_HZ          CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES        25
+#define portTICK_PERIOD_MS          ( (TickType_t)1000 / configTICK_RATE_HZ )
+#define portMAX_DELAY               ( (TickType_t)0xffffffffUL )
+#define tskNO_AFFINITY              0x7fffffff
+
+#define pdMS_TO_TICKS( ms )         ( (TickType_t)( ( (TickType_t)( ms ) * (TickType_t)configTICK_RATE_HZ ) / (TickType_t)1000U ) )
+#define pdTICKS_TO_MS( ticks )      ( (TickType_t)( ( (uint64_t)( ticks ) * 1000U ) / configTICK_RATE_HZ ) )
+
+// critical sections nest and may be entered from the same thread more than once ...
+typedef struct
+{
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define portENTER_CRITICAL( mux )       pthread_mutex_lock( &( mux )->mutex )
+#define portEXIT_CRITICAL( mux )        pthread_mutex_unlock( &( mux )->mutex )
+#define portENTER_CRITICAL_ISR( mux )   portENTER_CRITICAL( mux )
+#define portEXIT_CRITICAL_ISR( mux )    portEXIT_CRITICAL( mux )
+#define portYIELD_FROM_ISR( woken )     ( (void)( woken ) )
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_event_group *EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t  xEventGroupCreate( void );
+void                vEventGroupDelete( EventGroupHandle_t group );
+EventBits_t         xEventGroupSetBits( EventGroupHandle_t group, EventBits_t bits );
+EventBits_t         xEventGroupClearBits( EventGroupHandle_t group, EventBits_t bits );
+EventBits_t         xEventGroupGetBits( EventGroupHandle_t group );
+EventBits_t         xEventGroupWaitBits( EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit, BaseType_t wait_for_all, TickType_t ticks_to_wait );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t   xQueueCreate( UBaseType_t length, UBaseType_t item_size );
+void            vQueueDelete( QueueHandle_t queue );
+BaseType_t      xQueueSendToBack( QueueHandle_t queue, const void *item, TickType_t ticks_to_wait );
+BaseType_t      xQueueSendToFront( QueueHandle_t queue, const void *item, TickType_t ticks_to_wait );
+BaseType_t      xQueueOverwrite( QueueHandle_t queue, const void *item );
+BaseType_t      xQueueReceive( QueueHandle_t queue, void *item, TickType_t ticks_to_wait );
+BaseType_t      xQueuePeek( QueueHandle_t queue, void *item, TickType_t ticks_to_wait );
+BaseType_t      xQueueReset( QueueHandle_t queue );
+UBaseType_t     uxQueueMessagesWaiting( QueueHandle_t queue );
+UBaseType_t     uxQueueSpacesAvailable( QueueHandle_t queue );
+
+#define xQueueSend( queue, item, ticks_to_wait )                        xQueueSendToBack( queue, item, ticks_to_wait )
+#define xQueueSendFromISR( queue, item, woken )                         ( ( *( woken ) = pdFALSE ), xQueueSendToBack( queue, item, 0 ) )
+#define xQueueReceiveFromISR( queue, item, woken )                      ( ( *( woken ) = pdFALSE ), xQueueReceive( queue, item, 0 ) )
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// semaphores are queues of zero sized items, as in FreeRTOS, mutexes have no priority inheritance here ...
+typedef QueueHandle_t SemaphoreHandle_t;
+
+QueueHandle_t   xQueueCreateCountingSemaphore( UBaseType_t max_count, UBaseType_t initial_count );
+
+#define xSemaphoreCreateBinary()                        xQueueCreateCountingSemaphore( 1, 0 )
+#define xSemaphoreCreateMutex()                         xQueueCreateCountingSemaphore( 1, 1 )
+#define xSemaphoreCreateCounting( max, initial )        xQueueCreateCountingSemaphore( max, initial )
+#define xSemaphoreTake( semaphore, ticks_to_wait )      xQueueReceive( semaphore, NULL, ticks_to_wait )
+#define xSemaphoreGive( semaphore )                     xQueueSendToBack( semaphore, NULL, 0 )
+#define xSemaphoreGiveFromISR( semaphore, woken )       ( ( *( woken ) = pdFALSE ), xQueueSendToBack( semaphore, NULL, 0 ) )
+#define uxSemaphoreGetCount( semaphore )                uxQueueMessagesWaiting( semaphore )
+#define vSemaphoreDelete( semaphore )                   vQueueDelete( semaphore )
+
+#ifdef __cplusplus
+}
+#endif
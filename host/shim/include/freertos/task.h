@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct host_task *TaskHandle_t;
+typedef void ( *TaskFunction_t )( void * );
+
+typedef enum
+{
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite
+} eNotifyAction;
+
+BaseType_t      xTaskCreate( TaskFunction_t function, const char *name, uint32_t stack_depth, void *arguments, UBaseType_t priority, TaskHandle_t *handle );
+BaseType_t      xTaskCreatePinnedToCore( TaskFunction_t function, const char *name, uint32_t stack_depth, void *arguments, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core );
+void            vTaskDelete( TaskHandle_t task );
+void            vTaskDelay( TickType_t ticks );
+BaseType_t      xTaskDelayUntil( TickType_t *previous_wake_time, TickType_t increment );
+TickType_t      xTaskGetTickCount( void );
+TaskHandle_t    xTaskGetCurrentTaskHandle( void );
+const char      *pcTaskGetName( TaskHandle_t task );
+UBaseType_t     uxTaskPriorityGet( TaskHandle_t task );
+UBaseType_t     uxTaskGetStackHighWaterMark( TaskHandle_t task );
+
+uint32_t        ulTaskNotifyTake( BaseType_t clear_on_exit, TickType_t ticks_to_wait );
+BaseType_t      xTaskNotifyGive( TaskHandle_t task );
+void            vTaskNotifyGiveFromISR( TaskHandle_t task, BaseType_t *higher_priority_task_woken );
+BaseType_t      xTaskNotify( TaskHandle_t task, uint32_t value, eNotifyAction action );
+BaseType_t      xTaskNotifyWait( uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks_to_wait );
+
+#define vTaskDelayUntil( previous_wake_time, increment )    ( (void)xTaskDelayUntil( previous_wake_time, increment ) )
+
+#ifdef __cplusplus
+}
+#endif
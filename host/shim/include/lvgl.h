@@ -0,0 +1,16 @@
+// Host build, the ui is stubbed, only what main calls directly is declared ...
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t    lv_task_handler( void );
+uint32_t    lv_timer_handler( void );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_ERR_NVS_BASE                0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED     ( ESP_ERR_NVS_BASE + 0x01 )
+#define ESP_ERR_NVS_NOT_FOUND           ( ESP_ERR_NVS_BASE + 0x02 )
+#define ESP_ERR_NVS_READ_ONLY           ( ESP_ERR_NVS_BASE + 0x04 )
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE    ( ESP_ERR_NVS_BASE + 0x05 )
+#define ESP_ERR_NVS_INVALID_NAME        ( ESP_ERR_NVS_BASE + 0x06 )
+#define ESP_ERR_NVS_INVALID_HANDLE      ( ESP_ERR_NVS_BASE + 0x07 )
+#define ESP_ERR_NVS_KEY_TOO_LONG        ( ESP_ERR_NVS_BASE + 0x09 )
+#define ESP_ERR_NVS_INVALID_LENGTH      ( ESP_ERR_NVS_BASE + 0x0c )
+#define ESP_ERR_NVS_NO_FREE_PAGES       ( ESP_ERR_NVS_BASE + 0x0d )
+#define ESP_ERR_NVS_VALUE_TOO_LONG      ( ESP_ERR_NVS_BASE + 0x0e )
+#define ESP_ERR_NVS_NEW_VERSION_FOUND   ( ESP_ERR_NVS_BASE + 0x10 )
+
+#define NVS_KEY_NAME_MAX_SIZE           16
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+
+typedef enum
+{
+    NVS_TYPE_I16    = 0x12,
+    NVS_TYPE_I32    = 0x14,
+    NVS_TYPE_STR    = 0x21,
+    NVS_TYPE_BLOB   = 0x42,
+    NVS_TYPE_ANY    = 0xff
+} nvs_type_t;
+
+typedef struct
+{
+    size_t used_entries;
+    size_t free_entries;
+    size_t available_entries;
+    size_t total_entries;
+    size_t namespace_count;
+} nvs_stats_t;
+
+esp_err_t   nvs_open( const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle );
+void        nvs_close( nvs_handle_t handle );
+esp_err_t   nvs_commit( nvs_handle_t handle );
+
+esp_err_t   nvs_set_i16( nvs_handle_t handle, const char *key, int16_t value );
+esp_err_t   nvs_set_i32( nvs_handle_t handle, const char *key, int32_t value );
+esp_err_t   nvs_set_str( nvs_handle_t handle, const char *key, const char *value );
+esp_err_t   nvs_set_blob( nvs_handle_t handle, const char *key, const void *value, size_t length );
+
+esp_err_t   nvs_get_i16( nvs_handle_t handle, const char *key, int16_t *out_value );
+esp_err_t   nvs_get_i32( nvs_handle_t handle, const char *key, int32_t *out_value );
+esp_err_t   nvs_get_str( nvs_handle_t handle, const char *key, char *out_value, size_t *length );
+esp_err_t   nvs_get_blob( nvs_handle_t handle, const char *key, void *out_value, size_t *length );
+
+esp_err_t   nvs_find_key( nvs_handle_t handle, const char *key, nvs_type_t *out_type );
+esp_err_t   nvs_erase_key( nvs_handle_t handle, const char *key );
+esp_err_t   nvs_erase_all( nvs_handle_t handle );
+
+esp_err_t   nvs_get_stats( const char *part_name, nvs_stats_t *nvs_stats );
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,7 @@
+// Host build configuration, the subset of the esp32s3 sdkconfig the components depend on ...
+#pragma once
+
+#define CONFIG_IDF_TARGET               "linux"
+#define CONFIG_IDF_TARGET_LINUX         1
+#define CONFIG_FREERTOS_HZ              100
+#define CONFIG_LOG_DEFAULT_LEVEL        3
@@ -0,0 +1,201 @@
+#include "mqtt_client.h"
+#include "esp_log.h"
+#include "airshift_host.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define MSG_ID_MAX      65535
+
+struct esp_mqtt_client
+{
+    bool                initialized;
+    bool                connected;
+    int                 msg_id;
+    esp_event_handler_t handler;
+    void                *handler_arg;
+    host_mqtt_backend_t backend;
+};
+
+static const char* TAG = "mqtt_client";
+
+static pthread_mutex_t          lock_   = PTHREAD_MUTEX_INITIALIZER;
+static struct esp_mqtt_client   client_ = { 0 };
+
+// Public functions
+esp_err_t host_mqtt_attach( const host_mqtt_backend_t *backend )
+{
+    if( backend == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    client_.backend = *backend;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t host_mqtt_deliver( int32_t event_id, int msg_id )
+{
+    esp_mqtt_event_t    event           = { 0 };
+    esp_event_handler_t handler         = NULL;
+    void                *handler_arg    = NULL;
+
+    pthread_mutex_lock( &lock_ );
+
+    handler     = client_.handler;
+    handler_arg = client_.handler_arg;
+
+    if( ( event_id == MQTT_EVENT_CONNECTED ) || ( event_id == MQTT_EVENT_DISCONNECTED ) )
+    {
+        client_.connected = ( event_id == MQTT_EVENT_CONNECTED );
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    if( handler == NULL )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    event.event_id  = (esp_mqtt_event_id_t)event_id;
+    event.client    = &client_;
+    event.msg_id    = msg_id;
+
+    // never with the lock held, the handler publishes ...
+    handler( handler_arg, "MQTT_EVENTS", event_id, &event );
+
+    return ESP_OK;
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init( const esp_mqtt_client_config_t *config )
+{
+    if( config == NULL )
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    client_.initialized = true;
+    client_.connected   = false;
+    client_.msg_id      = 0;
+    client_.handler     = NULL;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return &client_;
+}
+
+esp_err_t esp_mqtt_client_start( esp_mqtt_client_handle_t client )
+{
+    if( ( client == NULL ) || ( client->initialized != true ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // the broker is always there, connected before start returns ...
+    return host_mqtt_deliver( MQTT_EVENT_CONNECTED, 0 );
+}
+
+esp_err_t esp_mqtt_client_stop( esp_mqtt_client_handle_t client )
+{
+    if( ( client == NULL ) || ( client->initialized != true ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    client->connected = false;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_register_event( esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler, void *event_handler_arg )
+{
+    // one handler for every event, all the firmware registers ...
+    if( ( client == NULL ) || ( event != MQTT_EVENT_ANY ) || ( event_handler == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    client->handler     = event_handler;
+    client->handler_arg = event_handler_arg;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_unregister_event( esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event, esp_event_handler_t event_handler )
+{
+    if( client == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    if( client->handler != event_handler )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    client->handler     = NULL;
+    client->handler_arg = NULL;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+int esp_mqtt_client_publish( esp_mqtt_client_handle_t client, const char *topic, const char *data, int len, int qos, int retain )
+{
+    host_mqtt_backend_t backend = { 0 };
+    int                 msg_id  = 0;
+
+    if( ( client == NULL ) || ( topic == NULL ) )
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    if( client->connected != true )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        ESP_LOGW( TAG, "publish while disconnected, %s dropped", topic );
+
+        return -1;
+    }
+
+    // qos 0 has no packet identifier, the client reports 0 ...
+    if( qos > 0 )
+    {
+        client->msg_id  = ( client->msg_id >= MSG_ID_MAX ) ? 1 : ( client->msg_id + 1 );
+        msg_id          = client->msg_id;
+    }
+
+    backend = client->backend;
+
+    pthread_mutex_unlock( &lock_ );
+
+    if( backend.publish != NULL )
+    {
+        backend.publish( backend.context, msg_id, topic, data, len, qos );
+    }
+
+    return msg_id;
+}
@@ -0,0 +1,487 @@
+// Host build, keys live in ram for the life of the process, sets land at once and survive nvs_flash_deinit as they would in flash ...
+#include "nvs_flash.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NAMESPACES_MAX  16
+#define HANDLES_MAX     16
+#define ENTRIES_MAX     64
+#define VALUE_MAX       512     // bytes, strings with their terminator and blobs
+
+typedef struct
+{
+    bool            used;
+    char            name[NVS_KEY_NAME_MAX_SIZE];
+} space_t;
+
+typedef struct
+{
+    bool            used;
+    uint8_t         space;
+    nvs_open_mode_t mode;
+} handle_t;
+
+typedef struct
+{
+    bool            used;
+    uint8_t         space;
+    char            key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t      type;
+    uint8_t         value[VALUE_MAX];
+    size_t          length;
+} entry_t;
+
+// Forward declarations
+static handle_t *   lookup_handle( nvs_handle_t handle );
+static entry_t *    find_entry( uint8_t space, const char *key );
+static esp_err_t    set_value( nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length );
+static esp_err_t    get_value( nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *length, bool exact );
+
+static pthread_mutex_t  lock_                   = PTHREAD_MUTEX_INITIALIZER;
+static bool             initialized_            = false;
+static space_t          spaces_[NAMESPACES_MAX] = { 0 };
+static handle_t         handles_[HANDLES_MAX]   = { 0 };
+static entry_t          entries_[ENTRIES_MAX]   = { 0 };
+
+// Public functions
+esp_err_t nvs_flash_init( void )
+{
+    pthread_mutex_lock( &lock_ );
+
+    initialized_ = true;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_deinit( void )
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock( &lock_ );
+
+    if( initialized_ == true )
+    {
+        memset( handles_, 0, sizeof( handles_ ) );
+
+        initialized_ = false;
+    }
+    else
+    {
+        ret = ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t nvs_flash_erase( void )
+{
+    pthread_mutex_lock( &lock_ );
+
+    memset( spaces_, 0, sizeof( spaces_ ) );
+    memset( handles_, 0, sizeof( handles_ ) );
+    memset( entries_, 0, sizeof( entries_ ) );
+
+    initialized_ = false;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t nvs_open( const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle )
+{
+    esp_err_t   ret     = ESP_OK;
+    int         space   = -1;
+    int         handle  = -1;
+
+    if( ( namespace_name == NULL ) || ( out_handle == NULL ) || ( strlen( namespace_name ) >= NVS_KEY_NAME_MAX_SIZE ) )
+    {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    if( initialized_ != true )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+
+    for( int i = 0; ( i < NAMESPACES_MAX ) && ( space < 0 ); i++ )
+    {
+        space = ( ( spaces_[i].used == true ) && ( strcmp( spaces_[i].name, namespace_name ) == 0 ) ) ? i : space;
+    }
+
+    // read only never creates a namespace ...
+    if( ( space < 0 ) && ( open_mode == NVS_READWRITE ) )
+    {
+        for( int i = 0; ( i < NAMESPACES_MAX ) && ( space < 0 ); i++ )
+        {
+            space = ( spaces_[i].used == false ) ? i : space;
+        }
+
+        if( space >= 0 )
+        {
+            spaces_[space].used = true;
+
+            strcpy( spaces_[space].name, namespace_name );
+        }
+    }
+
+    for( int i = 0; ( i < HANDLES_MAX ) && ( handle < 0 ); i++ )
+    {
+        handle = ( handles_[i].used == false ) ? i : handle;
+    }
+
+    if( space < 0 )
+    {
+        ret = ( open_mode == NVS_READWRITE ) ? ESP_ERR_NVS_NOT_ENOUGH_SPACE : ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if( handle < 0 )
+    {
+        ret = ESP_ERR_NO_MEM;
+    }
+    else
+    {
+        handles_[handle].used   = true;
+        handles_[handle].space  = (uint8_t)space;
+        handles_[handle].mode   = open_mode;
+
+        // handle 0 is never valid ...
+        *out_handle = (nvs_handle_t)( handle + 1 );
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+void nvs_close( nvs_handle_t handle )
+{
+    handle_t *entry = NULL;
+
+    pthread_mutex_lock( &lock_ );
+
+    entry = lookup_handle( handle );
+
+    if( entry != NULL )
+    {
+        entry->used = false;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+}
+
+esp_err_t nvs_commit( nvs_handle_t handle )
+{
+    esp_err_t ret = ESP_OK;
+
+    pthread_mutex_lock( &lock_ );
+
+    ret = ( lookup_handle( handle ) != NULL ) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t nvs_set_i16( nvs_handle_t handle, const char *key, int16_t value )
+{
+    return set_value( handle, key, NVS_TYPE_I16, &value, sizeof( value ) );
+}
+
+esp_err_t nvs_set_i32( nvs_handle_t handle, const char *key, int32_t value )
+{
+    return set_value( handle, key, NVS_TYPE_I32, &value, sizeof( value ) );
+}
+
+esp_err_t nvs_set_str( nvs_handle_t handle, const char *key, const char *value )
+{
+    return set_value( handle, key, NVS_TYPE_STR, value, ( value != NULL ) ? ( strlen( value ) + 1 ) : 0 );
+}
+
+esp_err_t nvs_set_blob( nvs_handle_t handle, const char *key, const void *value, size_t length )
+{
+    return set_value( handle, key, NVS_TYPE_BLOB, value, length );
+}
+
+esp_err_t nvs_get_i16( nvs_handle_t handle, const char *key, int16_t *out_value )
+{
+    size_t length = sizeof( *out_value );
+
+    return get_value( handle, key, NVS_TYPE_I16, out_value, &length, true );
+}
+
+esp_err_t nvs_get_i32( nvs_handle_t handle, const char *key, int32_t *out_value )
+{
+    size_t length = sizeof( *out_value );
+
+    return get_value( handle, key, NVS_TYPE_I32, out_value, &length, true );
+}
+
+esp_err_t nvs_get_str( nvs_handle_t handle, const char *key, char *out_value, size_t *length )
+{
+    return get_value( handle, key, NVS_TYPE_STR, out_value, length, false );
+}
+
+esp_err_t nvs_get_blob( nvs_handle_t handle, const char *key, void *out_value, size_t *length )
+{
+    return get_value( handle, key, NVS_TYPE_BLOB, out_value, length, false );
+}
+
+esp_err_t nvs_find_key( nvs_handle_t handle, const char *key, nvs_type_t *out_type )
+{
+    esp_err_t   ret     = ESP_ERR_NVS_NOT_FOUND;
+    handle_t    *entry  = NULL;
+    entry_t     *item   = NULL;
+
+    pthread_mutex_lock( &lock_ );
+
+    entry   = lookup_handle( handle );
+    item    = ( ( entry != NULL ) && ( key != NULL ) ) ? find_entry( entry->space, key ) : NULL;
+
+    if( entry == NULL )
+    {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if( item != NULL )
+    {
+        ret = ESP_OK;
+
+        if( out_type != NULL )
+        {
+            *out_type = item->type;
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t nvs_erase_key( nvs_handle_t handle, const char *key )
+{
+    esp_err_t   ret     = ESP_ERR_NVS_NOT_FOUND;
+    handle_t    *entry  = NULL;
+    entry_t     *item   = NULL;
+
+    pthread_mutex_lock( &lock_ );
+
+    entry   = lookup_handle( handle );
+    item    = ( ( entry != NULL ) && ( key != NULL ) ) ? find_entry( entry->space, key ) : NULL;
+
+    if( entry == NULL )
+    {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if( entry->mode != NVS_READWRITE )
+    {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    }
+    else if( item != NULL )
+    {
+        item->used  = false;
+        ret         = ESP_OK;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t nvs_erase_all( nvs_handle_t handle )
+{
+    esp_err_t   ret     = ESP_OK;
+    handle_t    *entry  = NULL;
+
+    pthread_mutex_lock( &lock_ );
+
+    entry = lookup_handle( handle );
+
+    if( entry == NULL )
+    {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if( entry->mode != NVS_READWRITE )
+    {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    }
+    else
+    {
+        for( int i = 0; i < ENTRIES_MAX; i++ )
+        {
+            entries_[i].used = ( entries_[i].space == entry->space ) ? false : entries_[i].used;
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+esp_err_t nvs_get_stats( const char *part_name, nvs_stats_t *nvs_stats )
+{
+    if( nvs_stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset( nvs_stats, 0, sizeof( nvs_stats_t ) );
+
+    pthread_mutex_lock( &lock_ );
+
+    for( int i = 0; i < ENTRIES_MAX; i++ )
+    {
+        nvs_stats->used_entries += ( entries_[i].used == true ) ? 1 : 0;
+    }
+
+    for( int i = 0; i < NAMESPACES_MAX; i++ )
+    {
+        nvs_stats->namespace_count += ( spaces_[i].used == true ) ? 1 : 0;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    nvs_stats->total_entries        = ENTRIES_MAX;
+    nvs_stats->free_entries         = ENTRIES_MAX - nvs_stats->used_entries;
+    nvs_stats->available_entries    = nvs_stats->free_entries;
+
+    return ESP_OK;
+}
+
+// Private functions
+// Lock held ...
+static handle_t * lookup_handle( nvs_handle_t handle )
+{
+    if( ( initialized_ != true ) || ( handle == 0 ) || ( handle > HANDLES_MAX ) || ( handles_[handle - 1].used != true ) )
+    {
+        return NULL;
+    }
+
+    return &handles_[handle - 1];
+}
+
+// Lock held, any type, a key holds one value ...
+static entry_t * find_entry( uint8_t space, const char *key )
+{
+    for( int i = 0; i < ENTRIES_MAX; i++ )
+    {
+        if( ( entries_[i].used == true ) && ( entries_[i].space == space ) && ( strcmp( entries_[i].key, key ) == 0 ) )
+        {
+            return &entries_[i];
+        }
+    }
+
+    return NULL;
+}
+
+static esp_err_t set_value( nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length )
+{
+    esp_err_t   ret     = ESP_OK;
+    handle_t    *entry  = NULL;
+    entry_t     *item   = NULL;
+
+    if( ( key == NULL ) || ( strlen( key ) >= NVS_KEY_NAME_MAX_SIZE ) )
+    {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+
+    if( ( value == NULL ) || ( length > VALUE_MAX ) )
+    {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    entry = lookup_handle( handle );
+
+    if( entry == NULL )
+    {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if( entry->mode != NVS_READWRITE )
+    {
+        ret = ESP_ERR_NVS_READ_ONLY;
+    }
+    else
+    {
+        // a value of another type under the same key is replaced ...
+        item = find_entry( entry->space, key );
+
+        for( int i = 0; ( i < ENTRIES_MAX ) && ( item == NULL ); i++ )
+        {
+            item = ( entries_[i].used == false ) ? &entries_[i] : NULL;
+        }
+
+        if( item == NULL )
+        {
+            ret = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+        }
+        else
+        {
+            item->used      = true;
+            item->space     = entry->space;
+            item->type      = type;
+            item->length    = length;
+
+            strcpy( item->key, key );
+            memcpy( item->value, value, length );
+        }
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
+
+// Integers are exact, strings and blobs follow nvs_get_str and nvs_get_blob, no buffer asks for the length ...
+static esp_err_t get_value( nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *length, bool exact )
+{
+    esp_err_t   ret     = ESP_OK;
+    handle_t    *entry  = NULL;
+    entry_t     *item   = NULL;
+
+    if( ( key == NULL ) || ( length == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    entry   = lookup_handle( handle );
+    item    = ( entry != NULL ) ? find_entry( entry->space, key ) : NULL;
+
+    if( entry == NULL )
+    {
+        ret = ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    else if( ( item == NULL ) || ( item->type != type ) )
+    {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    }
+    else if( ( exact == false ) && ( value == NULL ) )
+    {
+        *length = item->length;
+    }
+    else if( *length < item->length )
+    {
+        ret = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    else
+    {
+        memcpy( value, item->value, item->length );
+
+        *length = item->length;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ret;
+}
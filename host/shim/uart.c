@@ -0,0 +1,295 @@
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "airshift_host.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    bool                installed;
+    QueueHandle_t       queue;
+    uint8_t             *ring;
+    size_t              size;
+    size_t              head;
+    size_t              count;
+    host_uart_backend_t backend;
+    pthread_cond_t      readable;
+} port_t;
+
+static const char* TAG = "uart";
+
+// Forward declarations
+static void         post( port_t *port, uart_event_type_t type, size_t size );
+
+static pthread_mutex_t  lock_                   = PTHREAD_MUTEX_INITIALIZER;
+static port_t           ports_[UART_NUM_MAX]    = { 0 };
+
+// Public functions
+esp_err_t host_uart_attach( uart_port_t port, const host_uart_backend_t *backend )
+{
+    if( ( port < 0 ) || ( port >= UART_NUM_MAX ) || ( backend == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    ports_[port].backend = *backend;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+int host_uart_receive( uart_port_t port, const uint8_t *data, size_t length )
+{
+    port_t *entry = &ports_[port];
+
+    pthread_mutex_lock( &lock_ );
+
+    if( entry->installed != true )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        return -1;
+    }
+
+    // nobody drained the ring buffer in time, the bytes are gone, exactly like the isr would drop them ...
+    if( ( entry->count + length ) > entry->size )
+    {
+        post( entry, UART_BUFFER_FULL, 0 );
+
+        pthread_mutex_unlock( &lock_ );
+
+        return 0;
+    }
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        entry->ring[( entry->head + entry->count + i ) % entry->size] = data[i];
+    }
+
+    entry->count += length;
+
+    pthread_cond_broadcast( &entry->readable );
+
+    post( entry, UART_DATA, length );
+
+    pthread_mutex_unlock( &lock_ );
+
+    return (int)length;
+}
+
+esp_err_t uart_driver_install( uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags )
+{
+    port_t              *entry  = NULL;
+    pthread_condattr_t  attributes;
+
+    if( ( uart_num < 0 ) || ( uart_num >= UART_NUM_MAX ) || ( rx_buffer_size <= 0 ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    entry = &ports_[uart_num];
+
+    pthread_mutex_lock( &lock_ );
+
+    if( entry->installed == true )
+    {
+        pthread_mutex_unlock( &lock_ );
+
+        return ESP_FAIL;
+    }
+
+    entry->ring     = malloc( rx_buffer_size );
+    entry->size     = rx_buffer_size;
+    entry->head     = 0;
+    entry->count    = 0;
+    entry->queue    = ( ( queue_size > 0 ) && ( uart_queue != NULL ) ) ? xQueueCreate( queue_size, sizeof( uart_event_t ) ) : NULL;
+
+    pthread_condattr_init( &attributes );
+    pthread_condattr_setclock( &attributes, CLOCK_MONOTONIC );
+    pthread_cond_init( &entry->readable, &attributes );
+    pthread_condattr_destroy( &attributes );
+
+    if( uart_queue != NULL )
+    {
+        *uart_queue = entry->queue;
+    }
+
+    entry->installed = ( entry->ring != NULL );
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ( entry->installed == true ) ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t uart_driver_delete( uart_port_t uart_num )
+{
+    port_t *entry = NULL;
+
+    if( ( uart_num < 0 ) || ( uart_num >= UART_NUM_MAX ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    entry = &ports_[uart_num];
+
+    pthread_mutex_lock( &lock_ );
+
+    // same as the target, deleting a driver that is not installed is not an error ...
+    if( entry->installed == true )
+    {
+        entry->installed = false;
+
+        if( entry->queue != NULL )
+        {
+            vQueueDelete( entry->queue );
+        }
+
+        free( entry->ring );
+
+        pthread_cond_destroy( &entry->readable );
+
+        entry->queue    = NULL;
+        entry->ring     = NULL;
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+bool uart_is_driver_installed( uart_port_t uart_num )
+{
+    return ( uart_num >= 0 ) && ( uart_num < UART_NUM_MAX ) && ( ports_[uart_num].installed == true );
+}
+
+esp_err_t uart_param_config( uart_port_t uart_num, const uart_config_t *uart_config )
+{
+    return ( ( uart_num >= 0 ) && ( uart_num < UART_NUM_MAX ) && ( uart_config != NULL ) ) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_pin( uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num )
+{
+    return ( ( uart_num >= 0 ) && ( uart_num < UART_NUM_MAX ) ) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+int uart_write_bytes( uart_port_t uart_num, const void *src, size_t size )
+{
+    host_uart_backend_t backend = { 0 };
+
+    if( uart_is_driver_installed( uart_num ) != true )
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    backend = ports_[uart_num].backend;
+
+    pthread_mutex_unlock( &lock_ );
+
+    // with nothing attached the bytes just leave on the wire ...
+    if( backend.write != NULL )
+    {
+        backend.write( backend.context, (const uint8_t *)src, size );
+    }
+
+    return (int)size;
+}
+
+int uart_read_bytes( uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait )
+{
+    port_t      *entry      = &ports_[uart_num];
+    uint8_t     *out        = (uint8_t *)buf;
+    uint32_t    copied      = 0;
+    int64_t     deadline    = host_clock_deadline( ticks_to_wait );
+
+    if( uart_is_driver_installed( uart_num ) != true )
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    // like the target, wait for the full length or the timeout, whichever comes first ...
+    while( copied < length )
+    {
+        struct timespec timespec = { 0 };
+
+        while( ( entry->count > 0 ) && ( copied < length ) )
+        {
+            out[copied++]   = entry->ring[entry->head];
+            entry->head     = ( entry->head + 1 ) % entry->size;
+            entry->count--;
+        }
+
+        if( ( copied == length ) || ( host_clock_now() >= deadline ) )
+        {
+            break;
+        }
+
+        if( deadline == INT64_MAX )
+        {
+            pthread_cond_wait( &entry->readable, &lock_ );
+
+            continue;
+        }
+
+        host_clock_to_timespec( deadline, &timespec );
+
+        pthread_cond_timedwait( &entry->readable, &lock_, &timespec );
+    }
+
+    pthread_mutex_unlock( &lock_ );
+
+    return (int)copied;
+}
+
+esp_err_t uart_flush_input( uart_port_t uart_num )
+{
+    if( uart_is_driver_installed( uart_num ) != true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    ports_[uart_num].head   = 0;
+    ports_[uart_num].count  = 0;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len( uart_port_t uart_num, size_t *size )
+{
+    if( uart_is_driver_installed( uart_num ) != true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    pthread_mutex_lock( &lock_ );
+
+    *size = ports_[uart_num].count;
+
+    pthread_mutex_unlock( &lock_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static void post( port_t *port, uart_event_type_t type, size_t size )
+{
+    uart_event_t event = { .type = type, .size = size, .timeout_flag = false };
+
+    // a full event queue loses the event, the bytes stay in the ring buffer, as on the target ...
+    if( ( port->queue != NULL ) && ( xQueueSend( port->queue, &event, 0 ) != pdTRUE ) )
+    {
+        ESP_LOGD( TAG, "event queue full, event %d lost", type );
+    }
+}
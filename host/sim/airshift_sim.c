@@ -0,0 +1,104 @@
+#include "airshift_sim.h"
+
+#define DAY_PERIOD_S        3600.0f     // one simulated day per hour
+#define CO2_PERIOD_S        1800.0f     // occupancy, a room filling up and airing out twice a day
+#define PM_EVENT_PERIOD_S   600.0f      // someone cooking every ten minutes ...
+#define PM_EVENT_LENGTH_S   90.0f       // ... for a minute and a half
+
+// Forward declarations
+
+static portMUX_TYPE         lock_                               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_sim_stats_t stats_[AIRSHIFT_SIM_SENSOR_COUNT]   = { 0 };
+
+// Public functions
+esp_err_t airshift_sim_get_stats( airshift_sim_sensor_t sensor, airshift_sim_stats_t *stats )
+{
+    if( ( sensor >= AIRSHIFT_SIM_SENSOR_COUNT ) || ( stats == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_[sensor];
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+void airshift_sim_get_environment( int64_t now, airshift_sim_environment_t *environment )
+{
+    const float seconds     = (float)now / 1e6f;
+    const float day         = sinf( 2.0f * (float)M_PI * seconds / DAY_PERIOD_S );
+    const float occupancy   = 0.5f - ( 0.5f * cosf( 2.0f * (float)M_PI * seconds / CO2_PERIOD_S ) );
+    const float event       = fmodf( seconds, PM_EVENT_PERIOD_S );
+
+    environment->co2            = 450.0f + ( 900.0f * occupancy );
+    environment->temperature    = 21.5f + ( 1.5f * day );
+    environment->humidity       = 45.0f - ( 6.0f * day );
+    environment->pm_2_5         = 6.0f + ( 3.0f * occupancy );
+
+    // a sharp rise and a slow decay ...
+    if( event < PM_EVENT_LENGTH_S )
+    {
+        environment->pm_2_5 += 60.0f * expf( -event / 30.0f ) * fminf( event / 5.0f, 1.0f );
+    }
+
+    environment->pm_1_0     = 0.7f * environment->pm_2_5;
+    environment->pm_10_0    = 1.3f * environment->pm_2_5;
+}
+
+uint32_t airshift_sim_random( uint32_t *state )
+{
+    // xorshift32, deterministic per seed and cheap enough to not show up in the benchmark ...
+    uint32_t x = ( *state != 0 ) ? *state : 0x9e3779b9;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    *state = x;
+
+    return x;
+}
+
+float airshift_sim_uniform( uint32_t *state, float low, float high )
+{
+    return low + ( ( high - low ) * ( (float)( airshift_sim_random( state ) >> 8 ) / (float)( 1 << 24 ) ) );
+}
+
+airshift_sim_fault_t airshift_sim_roll( airshift_sim_sensor_t sensor, const airshift_sim_profile_t *profile, uint32_t *state )
+{
+    float                   roll    = airshift_sim_uniform( state, 0.0f, 1.0f );
+    airshift_sim_fault_t    fault   = AIRSHIFT_SIM_FAULT_NONE;
+
+    if( roll < profile->timeout_rate )
+    {
+        fault = AIRSHIFT_SIM_FAULT_TIMEOUT;
+    }
+    else if( roll < ( profile->timeout_rate + profile->error_rate ) )
+    {
+        fault = AIRSHIFT_SIM_FAULT_ERROR;
+    }
+    else if( roll < ( profile->timeout_rate + profile->error_rate + profile->noise_rate ) )
+    {
+        fault = AIRSHIFT_SIM_FAULT_NOISE;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    switch( fault )
+    {
+        case AIRSHIFT_SIM_FAULT_NONE:       stats_[sensor].frames++;    break;
+        case AIRSHIFT_SIM_FAULT_NOISE:      stats_[sensor].noise++;     break;
+        case AIRSHIFT_SIM_FAULT_ERROR:      stats_[sensor].errors++;    break;
+        case AIRSHIFT_SIM_FAULT_TIMEOUT:    stats_[sensor].timeouts++;  break;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return fault;
+}
+
+// Private functions
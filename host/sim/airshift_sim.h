@@ -0,0 +1,76 @@
+#ifndef AIRSHIFT_SIM_H
+#define AIRSHIFT_SIM_H
+
+#include "airshift_header_common.h"
+#include "airshift_common.h"
+#include "airshift_host.h"
+
+#include <esp_timer.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    AIRSHIFT_SIM_SENSOR_PMS7003,
+    AIRSHIFT_SIM_SENSOR_SENSEAIR,
+    AIRSHIFT_SIM_SENSOR_SHT30,
+    AIRSHIFT_SIM_SENSOR_COUNT
+} airshift_sim_sensor_t;
+
+// Fault rates are per frame, reply or i2c transfer, each sensor draws from its own seeded generator ...
+typedef struct
+{
+    uint32_t    seed;
+    float       noise_rate;     // uart: garbage bytes on the line, i2c: a nack
+    float       error_rate;     // a corrupted checksum / crc
+    float       timeout_rate;   // uart: a frame or reply that never comes, i2c: a bus timeout
+} airshift_sim_profile_t;
+
+// What the simulators actually sent, to hold against what the drivers counted ...
+typedef struct
+{
+    uint32_t    frames;         // frames, replies or measurements delivered intact
+    uint32_t    noise;
+    uint32_t    errors;
+    uint32_t    timeouts;
+} airshift_sim_stats_t;
+
+// The air the simulated sensors measure, a scripted day compressed into an hour ...
+typedef struct
+{
+    float       co2;            // ppm
+    float       temperature;    // C
+    float       humidity;       // %RH
+    float       pm_1_0;         // ug/m3
+    float       pm_2_5;
+    float       pm_10_0;
+} airshift_sim_environment_t;
+
+esp_err_t   airshift_sim_pms7003_attach( uart_port_t port, const airshift_sim_profile_t *profile );
+esp_err_t   airshift_sim_senseair_attach( uart_port_t port, const airshift_sim_profile_t *profile );
+esp_err_t   airshift_sim_sht30_attach( i2c_port_t port, const airshift_sim_profile_t *profile );
+
+esp_err_t   airshift_sim_get_stats( airshift_sim_sensor_t sensor, airshift_sim_stats_t *stats );
+void        airshift_sim_get_environment( int64_t now, airshift_sim_environment_t *environment );
+
+// shared by the simulators ...
+typedef enum
+{
+    AIRSHIFT_SIM_FAULT_NONE,
+    AIRSHIFT_SIM_FAULT_NOISE,
+    AIRSHIFT_SIM_FAULT_ERROR,
+    AIRSHIFT_SIM_FAULT_TIMEOUT
+} airshift_sim_fault_t;
+
+uint32_t                airshift_sim_random( uint32_t *state );
+float                   airshift_sim_uniform( uint32_t *state, float low, float high );
+airshift_sim_fault_t    airshift_sim_roll( airshift_sim_sensor_t sensor, const airshift_sim_profile_t *profile, uint32_t *state );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AIRSHIFT_SIM_H
@@ -0,0 +1,264 @@
+#include "airshift_sim.h"
+
+#include <freertos/queue.h>
+
+#define START_CHARACTER_1       0x42
+#define START_CHARACTER_2       0x4d
+#define FRAME_SIZE              32
+#define COMMAND_SIZE            7
+#define ACK_SIZE                8
+
+#define COMMAND_CHANGE_MODE     0xe1
+#define COMMAND_READ_PASSIVE    0xe2
+#define COMMAND_SLEEP           0xe4
+
+#define FRAME_PERIOD_MS         900     // active mode streams every 200 .. 800 ms, slower once readings settle
+#define FRAME_JITTER_MS         100
+#define WAKEUP_MS               1500    // fan spin up before the first frame
+#define NOISE_BYTES_MAX         12
+
+#define STREAM_TASK_STACK_SIZE  4096
+#define STREAM_TASK_PRIORITY    12
+
+static const char* TAG = "sim_pms7003";
+
+// Forward declarations
+static void         write( void *context, const uint8_t *data, size_t length );
+static void         stream_task( void *arguments );
+static void         handle_command( const uint8_t *command );
+static void         send_frame();
+static void         send_ack( uint8_t command, uint8_t data );
+static void         send( const uint8_t *data, size_t length );
+static void         put_word( uint8_t *frame, size_t offset, uint16_t value );
+
+static uart_port_t              port_       = UART_NUM_2;
+static airshift_sim_profile_t   profile_    = { 0 };
+static uint32_t                 random_     = 0;
+static QueueHandle_t            commands_   = NULL;
+static bool                     awake_      = true;
+static bool                     active_     = true;
+static int64_t                  next_frame_ = 0;
+
+// Public functions
+esp_err_t airshift_sim_pms7003_attach( uart_port_t port, const airshift_sim_profile_t *profile )
+{
+    const host_uart_backend_t backend = { .context = NULL, .write = write };
+
+    port_       = port;
+    profile_    = *profile;
+    random_     = profile->seed ^ 0x504d5337;
+    commands_   = xQueueCreate( 4, COMMAND_SIZE );
+
+    if( commands_ == NULL )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if( xTaskCreate( stream_task, "sim_pms7003", STREAM_TASK_STACK_SIZE, NULL, STREAM_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return host_uart_attach( port, &backend );
+}
+
+// Private functions
+static void write( void *context, const uint8_t *data, size_t length )
+{
+    // commands are always written whole, anything else is ignored by the sensor too ...
+    if( ( length != COMMAND_SIZE ) || ( data[0] != START_CHARACTER_1 ) || ( data[1] != START_CHARACTER_2 ) )
+    {
+        ESP_LOGW( TAG, "ignored %u byte write", (unsigned)length );
+
+        return;
+    }
+
+    xQueueSend( commands_, data, 0 );
+}
+
+static void stream_task( void *arguments )
+{
+    uint8_t command[COMMAND_SIZE] = { 0 };
+
+    next_frame_ = esp_timer_get_time() + ( WAKEUP_MS * 1000 );
+
+    while( true )
+    {
+        TickType_t wait = portMAX_DELAY;
+
+        if( ( awake_ == true ) && ( active_ == true ) )
+        {
+            int64_t remaining = next_frame_ - esp_timer_get_time();
+
+            wait = ( remaining > 0 ) ? (TickType_t)( ( remaining + ( portTICK_PERIOD_MS * 1000 ) - 1 ) / ( portTICK_PERIOD_MS * 1000 ) ) : 0;
+        }
+
+        if( xQueueReceive( commands_, command, wait ) == pdTRUE )
+        {
+            handle_command( command );
+
+            continue;
+        }
+
+        send_frame();
+
+        next_frame_ += ( FRAME_PERIOD_MS + (int64_t)airshift_sim_uniform( &random_, -FRAME_JITTER_MS, FRAME_JITTER_MS ) ) * 1000;
+    }
+}
+
+static void handle_command( const uint8_t *command )
+{
+    uint16_t checksum = 0;
+
+    for( size_t i = 0; i < 5; i++ )
+    {
+        checksum += command[i];
+    }
+
+    if( checksum != airshift_make_word( command[5], command[6] ) )
+    {
+        ESP_LOGW( TAG, "command checksum mismatch" );
+
+        return;
+    }
+
+    switch( command[2] )
+    {
+        case COMMAND_SLEEP:
+        {
+            bool wakeup = ( command[4] != 0 );
+
+            // the fan needs to spin up again before there is anything to report ...
+            if( ( wakeup == true ) && ( awake_ != true ) )
+            {
+                next_frame_ = esp_timer_get_time() + ( WAKEUP_MS * 1000 );
+            }
+
+            awake_ = wakeup;
+
+            break;
+        }
+        case COMMAND_CHANGE_MODE:
+        {
+            active_ = ( command[4] != 0 );
+
+            break;
+        }
+        case COMMAND_READ_PASSIVE:
+        {
+            if( awake_ == true )
+            {
+                send_frame();
+            }
+
+            return;
+        }
+        default:
+        {
+            return;
+        }
+    }
+
+    send_ack( command[2], command[4] );
+}
+
+static void send_frame()
+{
+    uint8_t                     frame[FRAME_SIZE]           = { START_CHARACTER_1, START_CHARACTER_2, 0x00, 0x1c };
+    uint8_t                     noise[NOISE_BYTES_MAX]      = { 0 };
+    uint16_t                    checksum                    = 0;
+    airshift_sim_environment_t  environment                 = { 0 };
+    airshift_sim_fault_t        fault                       = airshift_sim_roll( AIRSHIFT_SIM_SENSOR_PMS7003, &profile_, &random_ );
+    float                       pm[3]                       = { 0 };
+
+    if( fault == AIRSHIFT_SIM_FAULT_TIMEOUT )
+    {
+        return;
+    }
+
+    airshift_sim_get_environment( esp_timer_get_time(), &environment );
+
+    // counting noise, a couple of ug/m3 at low concentrations ...
+    pm[0] = fmaxf( 0.0f, environment.pm_1_0 + airshift_sim_uniform( &random_, -1.5f, 1.5f ) );
+    pm[1] = fmaxf( 0.0f, environment.pm_2_5 + airshift_sim_uniform( &random_, -2.0f, 2.0f ) );
+    pm[2] = fmaxf( 0.0f, environment.pm_10_0 + airshift_sim_uniform( &random_, -3.0f, 3.0f ) );
+
+    // standard particle and atmospheric environment readings match indoors ...
+    for( int i = 0; i < 3; i++ )
+    {
+        put_word( frame, 4 + ( 2 * i ), (uint16_t)( pm[i] + 0.5f ) );
+        put_word( frame, 10 + ( 2 * i ), (uint16_t)( pm[i] + 0.5f ) );
+    }
+
+    // particle counts per 0.1 l, roughly proportional to mass ...
+    put_word( frame, 16, (uint16_t)( pm[0] * 150.0f ) );
+    put_word( frame, 18, (uint16_t)( pm[0] * 45.0f ) );
+    put_word( frame, 20, (uint16_t)( pm[0] * 8.0f ) );
+    put_word( frame, 22, (uint16_t)( pm[1] * 1.2f ) );
+    put_word( frame, 24, (uint16_t)( pm[2] * 0.3f ) );
+    put_word( frame, 26, (uint16_t)( pm[2] * 0.1f ) );
+
+    put_word( frame, 28, 0x9700 );
+
+    for( size_t i = 0; i < ( FRAME_SIZE - 2 ); i++ )
+    {
+        checksum += frame[i];
+    }
+
+    put_word( frame, 30, checksum );
+
+    if( fault == AIRSHIFT_SIM_FAULT_NOISE )
+    {
+        size_t count = 1 + ( airshift_sim_random( &random_ ) % NOISE_BYTES_MAX );
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            noise[i] = (uint8_t)airshift_sim_random( &random_ );
+        }
+
+        send( noise, count );
+    }
+    else if( fault == AIRSHIFT_SIM_FAULT_ERROR )
+    {
+        // a flipped bit in the payload, the length field is left alone so only the checksum can catch it ...
+        frame[4 + ( airshift_sim_random( &random_ ) % ( FRAME_SIZE - 6 ) )] ^= (uint8_t)( 1 << ( airshift_sim_random( &random_ ) % 8 ) );
+    }
+
+    send( frame, sizeof( frame ) );
+}
+
+static void send_ack( uint8_t command, uint8_t data )
+{
+    uint8_t     ack[ACK_SIZE]   = { START_CHARACTER_1, START_CHARACTER_2, 0x00, 0x04, command, data };
+    uint16_t    checksum        = 0;
+
+    for( size_t i = 0; i < ( ACK_SIZE - 2 ); i++ )
+    {
+        checksum += ack[i];
+    }
+
+    put_word( ack, ACK_SIZE - 2, checksum );
+
+    send( ack, sizeof( ack ) );
+}
+
+static void send( const uint8_t *data, size_t length )
+{
+    size_t offset = 0;
+
+    // the isr hands bytes over in whatever chunks the fifo happened to hold, frames straddle them ...
+    while( offset < length )
+    {
+        size_t chunk = 1 + ( airshift_sim_random( &random_ ) % ( length - offset ) );
+
+        host_uart_receive( port_, &data[offset], chunk );
+
+        offset += chunk;
+    }
+}
+
+static void put_word( uint8_t *frame, size_t offset, uint16_t value )
+{
+    frame[offset]       = (uint8_t)( value >> 8 );
+    frame[offset + 1]   = (uint8_t)value;
+}
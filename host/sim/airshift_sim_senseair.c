@@ -0,0 +1,204 @@
+#include "airshift_sim.h"
+
+#include <freertos/queue.h>
+
+#define MODBUS_REQUEST_SIZE         8
+#define MODBUS_READ_HOLDING         0x03
+#define MODBUS_READ_INPUT           0x04
+#define MODBUS_EXCEPTION            0x80
+#define MODBUS_ILLEGAL_ADDRESS      0x02
+#define MODBUS_REGISTERS_MAX        8
+
+#define INPUT_REGISTER_COUNT        4
+#define HOLDING_ABC_PERIOD          0x001f
+#define ABC_PERIOD_HOURS            180
+
+#define BYTE_TIME_US                1042    // 10 bits at 9600 baud
+#define PROCESSING_MIN_MS           15
+#define PROCESSING_MAX_MS           40
+#define NOISE_BYTES_MAX             4
+
+#define REPLY_TASK_STACK_SIZE       4096
+#define REPLY_TASK_PRIORITY         12
+
+static const char* TAG = "sim_senseair";
+
+// Forward declarations
+static void         write( void *context, const uint8_t *data, size_t length );
+static void         reply_task( void *arguments );
+static void         reply( const uint8_t *request );
+static size_t       build_reply( const uint8_t *request, uint8_t *response );
+static uint16_t     crc16( const uint8_t *data, size_t length );
+
+static uart_port_t              port_       = UART_NUM_1;
+static airshift_sim_profile_t   profile_    = { 0 };
+static uint32_t                 random_     = 0;
+static QueueHandle_t            requests_   = NULL;
+
+// Public functions
+esp_err_t airshift_sim_senseair_attach( uart_port_t port, const airshift_sim_profile_t *profile )
+{
+    const host_uart_backend_t backend = { .context = NULL, .write = write };
+
+    port_       = port;
+    profile_    = *profile;
+    random_     = profile->seed ^ 0x53384c50;
+    requests_   = xQueueCreate( 2, MODBUS_REQUEST_SIZE );
+
+    if( requests_ == NULL )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if( xTaskCreate( reply_task, "sim_senseair", REPLY_TASK_STACK_SIZE, NULL, REPLY_TASK_PRIORITY, NULL ) != pdPASS )
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return host_uart_attach( port, &backend );
+}
+
+// Private functions
+static void write( void *context, const uint8_t *data, size_t length )
+{
+    uint16_t crc = 0;
+
+    if( length != MODBUS_REQUEST_SIZE )
+    {
+        ESP_LOGW( TAG, "ignored %u byte write", (unsigned)length );
+
+        return;
+    }
+
+    crc = crc16( data, MODBUS_REQUEST_SIZE - 2 );
+
+    // a request with a bad crc is silently dropped, the master times out ...
+    if( ( data[6] != (uint8_t)crc ) || ( data[7] != (uint8_t)( crc >> 8 ) ) )
+    {
+        ESP_LOGW( TAG, "request crc mismatch" );
+
+        return;
+    }
+
+    xQueueSend( requests_, data, 0 );
+}
+
+static void reply_task( void *arguments )
+{
+    uint8_t request[MODBUS_REQUEST_SIZE] = { 0 };
+
+    while( true )
+    {
+        if( xQueueReceive( requests_, request, portMAX_DELAY ) == pdTRUE )
+        {
+            reply( request );
+        }
+    }
+}
+
+static void reply( const uint8_t *request )
+{
+    uint8_t                 response[5 + ( 2 * MODBUS_REGISTERS_MAX )]  = { 0 };
+    uint8_t                 noise[NOISE_BYTES_MAX]                      = { 0 };
+    size_t                  length                                      = build_reply( request, response );
+    airshift_sim_fault_t    fault                                       = airshift_sim_roll( AIRSHIFT_SIM_SENSOR_SENSEAIR, &profile_, &random_ );
+    int64_t                 delay                                       = 0;
+
+    if( ( length == 0 ) || ( fault == AIRSHIFT_SIM_FAULT_TIMEOUT ) )
+    {
+        return;
+    }
+
+    // request on the wire, the sensor thinks, then the reply on the wire ...
+    delay = ( ( MODBUS_REQUEST_SIZE + length ) * BYTE_TIME_US ) + (int64_t)( airshift_sim_uniform( &random_, PROCESSING_MIN_MS, PROCESSING_MAX_MS ) * 1000 );
+
+    host_clock_sleep_until( esp_timer_get_time() + delay );
+
+    if( fault == AIRSHIFT_SIM_FAULT_NOISE )
+    {
+        size_t count = 1 + ( airshift_sim_random( &random_ ) % NOISE_BYTES_MAX );
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            noise[i] = (uint8_t)airshift_sim_random( &random_ );
+        }
+
+        host_uart_receive( port_, noise, count );
+    }
+    else if( fault == AIRSHIFT_SIM_FAULT_ERROR )
+    {
+        response[length - 1] ^= 0x5a;
+    }
+
+    host_uart_receive( port_, response, length );
+}
+
+static size_t build_reply( const uint8_t *request, uint8_t *response )
+{
+    uint16_t                    address                             = airshift_make_word( request[2], request[3] );
+    uint16_t                    count                               = airshift_make_word( request[4], request[5] );
+    uint16_t                    registers[MODBUS_REGISTERS_MAX]     = { 0 };
+    airshift_sim_environment_t  environment                         = { 0 };
+    size_t                      length                              = 0;
+    uint16_t                    crc                                 = 0;
+    bool                        valid                               = false;
+
+    airshift_sim_get_environment( esp_timer_get_time(), &environment );
+
+    if( ( request[1] == MODBUS_READ_INPUT ) && ( address == 0 ) && ( count <= INPUT_REGISTER_COUNT ) )
+    {
+        // IR1 meter status, IR2 alarm status, IR3 output status, IR4 space co2 ...
+        registers[3]    = (uint16_t)fmaxf( 0.0f, environment.co2 + airshift_sim_uniform( &random_, -15.0f, 15.0f ) );
+        valid           = true;
+    }
+    else if( ( request[1] == MODBUS_READ_HOLDING ) && ( address == HOLDING_ABC_PERIOD ) && ( count == 1 ) )
+    {
+        registers[0]    = ABC_PERIOD_HOURS;
+        valid           = true;
+    }
+
+    response[0] = request[0];
+
+    if( valid == true )
+    {
+        response[1] = request[1];
+        response[2] = (uint8_t)( count * 2 );
+
+        for( uint16_t i = 0; i < count; i++ )
+        {
+            response[3 + ( 2 * i )] = (uint8_t)( registers[i] >> 8 );
+            response[4 + ( 2 * i )] = (uint8_t)registers[i];
+        }
+
+        length = 3 + ( 2 * count );
+    }
+    else
+    {
+        response[1] = request[1] | MODBUS_EXCEPTION;
+        response[2] = MODBUS_ILLEGAL_ADDRESS;
+        length      = 3;
+    }
+
+    crc                 = crc16( response, length );
+    response[length++]  = (uint8_t)crc;
+    response[length++]  = (uint8_t)( crc >> 8 );
+
+    return length;
+}
+
+static uint16_t crc16( const uint8_t *data, size_t length )
+{
+    uint16_t crc = 0xffff;
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x0001 ) ? ( ( crc >> 1 ) ^ 0xa001 ) : ( crc >> 1 );
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,234 @@
+#include "airshift_sim.h"
+
+#define DEVICE_ADDRESS          0x44
+
+#define COMMAND_SOFT_RESET      0x30a2
+#define COMMAND_BREAK           0x3093
+#define COMMAND_READ_STATUS     0xf32d
+#define COMMAND_CLEAR_STATUS    0x3041
+#define COMMAND_FETCH_DATA      0xe000
+
+#define CLOCK_SKEW              1.005   // the sensor's own oscillator runs half a percent slow
+
+typedef enum
+{
+    STATE_IDLE,
+    STATE_SINGLE_SHOT,
+    STATE_PERIODIC
+} state_t;
+
+typedef struct
+{
+    uint16_t    command;
+    uint32_t    period_ms;          // 0 for single shot
+    int         repeatability;      // index into measurement_duration_
+} command_t;
+
+// Forward declarations
+static esp_err_t    write( void *context, const uint8_t *data, size_t length, TickType_t ticks_to_wait );
+static esp_err_t    read( void *context, uint8_t *data, size_t length, TickType_t ticks_to_wait );
+static esp_err_t    measure( uint8_t *data, size_t length, TickType_t ticks_to_wait );
+static uint8_t      crc8( const uint8_t *data, size_t length );
+
+static const command_t commands_[] =
+{
+    { 0x2c06,    0, 0 }, { 0x2c0d,    0, 1 }, { 0x2c10,    0, 2 },
+    { 0x2032, 2000, 0 }, { 0x2024, 2000, 1 }, { 0x202f, 2000, 2 },
+    { 0x2130, 1000, 0 }, { 0x2126, 1000, 1 }, { 0x212d, 1000, 2 },
+    { 0x2236,  500, 0 }, { 0x2220,  500, 1 }, { 0x222b,  500, 2 },
+    { 0x2334,  250, 0 }, { 0x2322,  250, 1 }, { 0x2329,  250, 2 },
+    { 0x2737,  100, 0 }, { 0x2721,  100, 1 }, { 0x272a,  100, 2 },
+};
+
+// maximum measurement duration per repeatability ( us ) ...
+static const int64_t measurement_duration_[] = { 15500, 6500, 4500 };
+
+static airshift_sim_profile_t   profile_    = { 0 };
+static uint32_t                 random_     = 0;
+static state_t                  state_      = STATE_IDLE;
+static const command_t          *mode_      = NULL;
+static int64_t                  started_    = 0;        // single shot or periodic start
+static int64_t                  fetched_    = 0;        // periodic measurements already handed out
+static bool                     fetch_      = false;    // fetch command issued, a read may follow
+
+// Public functions
+esp_err_t airshift_sim_sht30_attach( i2c_port_t port, const airshift_sim_profile_t *profile )
+{
+    const host_i2c_device_t device = { .address = DEVICE_ADDRESS, .context = NULL, .write = write, .read = read };
+
+    profile_    = *profile;
+    random_     = profile->seed ^ 0x53485433;
+
+    return host_i2c_attach( port, &device );
+}
+
+// Private functions
+static esp_err_t write( void *context, const uint8_t *data, size_t length, TickType_t ticks_to_wait )
+{
+    uint16_t command = 0;
+
+    if( length != 2 )
+    {
+        return ESP_FAIL;
+    }
+
+    command = airshift_make_word( data[0], data[1] );
+    fetch_  = false;
+
+    switch( command )
+    {
+        case COMMAND_BREAK:
+        case COMMAND_SOFT_RESET:
+        {
+            state_ = STATE_IDLE;
+
+            return ESP_OK;
+        }
+        case COMMAND_FETCH_DATA:
+        {
+            fetch_ = ( state_ == STATE_PERIODIC );
+
+            return ESP_OK;
+        }
+        case COMMAND_READ_STATUS:
+        case COMMAND_CLEAR_STATUS:
+        {
+            return ESP_OK;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    // measurement commands are only accepted while idle, periodic mode wants a break first ...
+    for( size_t i = 0; i < ( sizeof( commands_ ) / sizeof( commands_[0] ) ); i++ )
+    {
+        if( commands_[i].command == command )
+        {
+            if( state_ == STATE_PERIODIC )
+            {
+                return ESP_FAIL;
+            }
+
+            mode_       = &commands_[i];
+            state_      = ( mode_->period_ms == 0 ) ? STATE_SINGLE_SHOT : STATE_PERIODIC;
+            started_    = esp_timer_get_time();
+            fetched_    = 0;
+
+            return ESP_OK;
+        }
+    }
+
+    return ESP_FAIL;
+}
+
+static esp_err_t read( void *context, uint8_t *data, size_t length, TickType_t ticks_to_wait )
+{
+    int64_t duration = 0;
+
+    if( ( length != 6 ) || ( mode_ == NULL ) )
+    {
+        return ESP_FAIL;
+    }
+
+    duration = measurement_duration_[mode_->repeatability];
+
+    if( state_ == STATE_SINGLE_SHOT )
+    {
+        // clock stretching, scl is held low until the conversion is done ...
+        host_clock_sleep_until( started_ + duration );
+
+        state_ = STATE_IDLE;
+
+        return measure( data, length, ticks_to_wait );
+    }
+
+    if( ( state_ == STATE_PERIODIC ) && ( fetch_ == true ) )
+    {
+        int64_t period      = (int64_t)( (double)mode_->period_ms * 1000.0 * CLOCK_SKEW );
+        int64_t elapsed     = esp_timer_get_time() - started_ - duration;
+        int64_t completed   = ( elapsed >= 0 ) ? ( ( elapsed / period ) + 1 ) : 0;
+
+        fetch_ = false;
+
+        // nothing new since the last fetch, the sensor nacks the read header ...
+        if( completed <= fetched_ )
+        {
+            return ESP_FAIL;
+        }
+
+        fetched_ = completed;
+
+        return measure( data, length, ticks_to_wait );
+    }
+
+    return ESP_FAIL;
+}
+
+static esp_err_t measure( uint8_t *data, size_t length, TickType_t ticks_to_wait )
+{
+    airshift_sim_environment_t  environment = { 0 };
+    airshift_sim_fault_t        fault       = airshift_sim_roll( AIRSHIFT_SIM_SENSOR_SHT30, &profile_, &random_ );
+    float                       temperature = 0.0f;
+    float                       humidity    = 0.0f;
+    uint16_t                    raw[2]      = { 0 };
+
+    switch( fault )
+    {
+        case AIRSHIFT_SIM_FAULT_NOISE:
+        {
+            return ESP_FAIL;
+        }
+        case AIRSHIFT_SIM_FAULT_TIMEOUT:
+        {
+            // the bus hangs, the driver gives up once its timeout runs out ...
+            host_clock_sleep_until( host_clock_deadline( ticks_to_wait ) );
+
+            return ESP_ERR_TIMEOUT;
+        }
+        default:
+        {
+            break;
+        }
+    }
+
+    airshift_sim_get_environment( esp_timer_get_time(), &environment );
+
+    temperature = fminf( fmaxf( environment.temperature + airshift_sim_uniform( &random_, -0.1f, 0.1f ), -45.0f ), 130.0f );
+    humidity    = fminf( fmaxf( environment.humidity + airshift_sim_uniform( &random_, -1.0f, 1.0f ), 0.0f ), 100.0f );
+
+    raw[0] = (uint16_t)( ( temperature + 45.0f ) / 175.0f * 65535.0f );
+    raw[1] = (uint16_t)( humidity / 100.0f * 65535.0f );
+
+    for( int i = 0; i < 2; i++ )
+    {
+        data[( 3 * i ) + 0] = (uint8_t)( raw[i] >> 8 );
+        data[( 3 * i ) + 1] = (uint8_t)raw[i];
+        data[( 3 * i ) + 2] = crc8( &data[3 * i], 2 );
+    }
+
+    if( fault == AIRSHIFT_SIM_FAULT_ERROR )
+    {
+        data[( airshift_sim_random( &random_ ) & 1 ) ? 2 : 5] ^= 0xa5;
+    }
+
+    return ESP_OK;
+}
+
+static uint8_t crc8( const uint8_t *data, size_t length )
+{
+    uint8_t crc = 0xff;
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x80 ) ? (uint8_t)( ( crc << 1 ) ^ 0x31 ) : (uint8_t)( crc << 1 );
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,26 @@
+// Host build, there is no panel ...
+#include "airshift_display.h"
+
+static const char* TAG = "airshift_display";
+
+// Public functions
+esp_err_t airshift_display_init()
+{
+    ESP_LOGI( TAG, "airshift_display_init" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_display_release()
+{
+    ESP_LOGI( TAG, "airshift_display_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_display_get_stats( airshift_display_stats_t *stats )
+{
+    memset( stats, 0, sizeof( airshift_display_stats_t ) );
+
+    return ESP_OK;
+}
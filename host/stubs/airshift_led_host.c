@@ -0,0 +1,31 @@
+// Host build, there is no led strip ...
+#include "airshift_led.h"
+
+static const char* TAG = "airshift_led";
+
+// Public functions
+esp_err_t airshift_led_init()
+{
+    ESP_LOGI( TAG, "airshift_led_init" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_led_release()
+{
+    ESP_LOGI( TAG, "airshift_led_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_led_set( airshift_led_position_t airshift_led_position, airshift_led_color_t airshift_led_color )
+{
+    ESP_LOGD( TAG, "led %d: %d", airshift_led_position, airshift_led_color );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_led_reset()
+{
+    return ESP_OK;
+}
@@ -0,0 +1,54 @@
+// Host build, the device is already commissioned and on the network the moment matter starts ...
+#include "airshift_matter.h"
+#include "airshift_event.h"
+
+static const char* TAG = "airshift_matter";
+
+// Public functions
+esp_err_t airshift_matter_init()
+{
+    ESP_LOGI( TAG, "airshift_matter_init" );
+
+    return esp_event_post( AIRSHIFT_EVENT_MATTER, AIRSHIFT_EVENT_MATTER_IP_EVENT_STA_GOT_IP, NULL, 0, portMAX_DELAY );
+}
+
+esp_err_t airshift_matter_release()
+{
+    ESP_LOGI( TAG, "airshift_matter_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_get_qrcode_payload( char *payload, size_t size )
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t airshift_matter_update( const airshift_matter_measurements_t *measurements )
+{
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_set_reporting( airshift_matter_measurement_t measurement, const airshift_matter_reporting_t *reporting )
+{
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_get_reporting( airshift_matter_measurement_t measurement, airshift_matter_reporting_t *reporting )
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t airshift_matter_register_console()
+{
+    return ESP_OK;
+}
+
+esp_err_t airshift_matter_get_stats( airshift_matter_stats_t *stats )
+{
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    memset( stats, 0, sizeof( *stats ) );
+
+    return ESP_OK;
+}
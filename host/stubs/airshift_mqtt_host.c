@@ -0,0 +1,116 @@
+// Host build, a broker that is always reachable and acks everything as soon as it is published ...
+#include "airshift_mqtt.h"
+#include "airshift_event.h"
+#include "airshift_common.h"
+
+#include <esp_timer.h>
+
+static const char* TAG = "airshift_mqtt";
+
+// Forward declarations
+
+static portMUX_TYPE             lock_           = portMUX_INITIALIZER_UNLOCKED;
+static airshift_mqtt_stats_t    stats_          = { 0 };
+static char                     client_id_[32]  = { 0 };
+static bool                     connected_      = false;
+static int                      msg_id_         = 0;
+
+// Public functions
+esp_err_t airshift_mqtt_init()
+{
+    esp_err_t ret = ESP_FAIL;
+
+    ESP_LOGI( TAG, "airshift_mqtt_init" );
+
+    ESP_GOTO_ON_ERROR( airshift_get_mac_address( client_id_, NULL ), error, TAG, "get_mac_address failed" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    stats_.since = esp_timer_get_time();
+
+    return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_mqtt_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
+}
+
+esp_err_t airshift_mqtt_release()
+{
+    ESP_LOGI( TAG, "airshift_mqtt_release" );
+
+    connected_ = false;
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_mqtt_start()
+{
+    ESP_LOGI( TAG, "airshift_mqtt_start" );
+
+    connected_ = true;
+
+    return esp_event_post( AIRSHIFT_EVENT_MQTT, AIRSHIFT_EVENT_MQTT_CONNECTED, NULL, 0, portMAX_DELAY );
+}
+
+esp_err_t airshift_mqtt_publish( const char *topic, const char *message, size_t message_len )
+{
+    int msg_id = 0;
+
+    return airshift_mqtt_publish_tracked( topic, message, message_len, &msg_id );
+}
+
+esp_err_t airshift_mqtt_publish_tracked( const char *topic, const char *message, size_t message_len, int *msg_id )
+{
+    if( ( topic == NULL ) || ( message == NULL ) || ( msg_id == NULL ) )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if( connected_ != true )
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *msg_id = ++msg_id_;
+
+    // fixed header, topic length, topic, packet id, payload ...
+    stats_.publishes++;
+    stats_.acks++;
+    stats_.payload_bytes    += message_len;
+    stats_.wire_bytes       += 2 + 2 + strlen( topic ) + 2 + message_len;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return esp_event_post( AIRSHIFT_EVENT_MQTT, AIRSHIFT_EVENT_MQTT_PUBLISHED, msg_id, sizeof( int ), 0 );
+}
+
+bool airshift_mqtt_is_connected()
+{
+    return connected_;
+}
+
+const char *airshift_mqtt_get_client_id()
+{
+    return client_id_;
+}
+
+esp_err_t airshift_mqtt_get_stats( airshift_mqtt_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
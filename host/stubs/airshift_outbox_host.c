@@ -0,0 +1,44 @@
+// Host build, the stub broker never drops the connection, so nothing ever needs backfilling ...
+#include "airshift_outbox.h"
+
+static const char* TAG = "airshift_outbox";
+
+// Forward declarations
+
+static airshift_outbox_stats_t  stats_  = { 0 };
+
+// Public functions
+esp_err_t airshift_outbox_init()
+{
+    ESP_LOGI( TAG, "airshift_outbox_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_outbox_release()
+{
+    ESP_LOGI( TAG, "airshift_outbox_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_outbox_push( const airshift_history_record_t *record )
+{
+    stats_.queued++;
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_outbox_get_stats( airshift_outbox_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = stats_;
+
+    return ESP_OK;
+}
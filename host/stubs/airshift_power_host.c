@@ -0,0 +1,57 @@
+// Host build, there is no esp_pm, locks only count ...
+#include "airshift_power.h"
+
+#include <esp_timer.h>
+
+static const char* TAG = "airshift_power";
+
+static portMUX_TYPE             lock_       = portMUX_INITIALIZER_UNLOCKED;
+static airshift_power_stats_t   stats_      = { 0 };
+
+// Public functions
+esp_err_t airshift_power_init()
+{
+    ESP_LOGI( TAG, "airshift_power_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    stats_.since = esp_timer_get_time();
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_power_release()
+{
+    ESP_LOGI( TAG, "airshift_power_release" );
+
+    return ESP_OK;
+}
+
+void airshift_power_lock( airshift_power_lock_t lock )
+{
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.acquisitions[lock]++;
+
+    portEXIT_CRITICAL( &lock_ );
+}
+
+void airshift_power_unlock( airshift_power_lock_t lock )
+{
+}
+
+esp_err_t airshift_power_get_stats( airshift_power_stats_t *stats )
+{
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_power_register_console()
+{
+    return ESP_OK;
+}
@@ -0,0 +1,86 @@
+// Host build, batched messages go out as json only, the harness measures the pipeline, not the encoding ( tests/test_telemetry.c does ) ...
+#include "airshift_telemetry.h"
+#include "airshift_mqtt.h"
+
+#include <inttypes.h>
+
+#define TELEMETRY_TOPIC_SIZE    64
+#define TELEMETRY_MESSAGE_SIZE  256
+
+static const char* TAG = "airshift_telemetry";
+
+// Forward declarations
+
+static airshift_telemetry_stats_t   stats_  = { 0 };
+
+// Public functions
+esp_err_t airshift_telemetry_init()
+{
+    ESP_LOGI( TAG, "airshift_telemetry_init" );
+
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_telemetry_release()
+{
+    ESP_LOGI( TAG, "airshift_telemetry_release" );
+
+    return ESP_OK;
+}
+
+void airshift_telemetry_set_mode( airshift_telemetry_mode_t mode )
+{
+}
+
+airshift_telemetry_mode_t airshift_telemetry_get_mode()
+{
+    return AIRSHIFT_TELEMETRY_MODE_BATCHED;
+}
+
+void airshift_telemetry_set_format( airshift_telemetry_format_t format )
+{
+}
+
+airshift_telemetry_format_t airshift_telemetry_get_format()
+{
+    return AIRSHIFT_TELEMETRY_FORMAT_JSON;
+}
+
+esp_err_t airshift_telemetry_publish( const airshift_history_record_t *record )
+{
+    char    topic[TELEMETRY_TOPIC_SIZE]     = { 0 };
+    char    message[TELEMETRY_MESSAGE_SIZE] = { 0 };
+    int     length                          = 0;
+
+    length = snprintf( message, sizeof( message ), "{\"seq\":%" PRIu32 ",\"ts\":%" PRIu32 ",\"flags\":%u,\"v\":[%d,%d,%d,%d,%d,%d]}",
+        record->sequence, record->timestamp, record->flags, record->values[0], record->values[1], record->values[2], record->values[3], record->values[4], record->values[5] );
+
+    snprintf( topic, sizeof( topic ), "telemetry/%s", airshift_mqtt_get_client_id() );
+
+    stats_.messages++;
+    stats_.samples++;
+    stats_.bytes += length;
+
+    if( airshift_mqtt_publish( topic, message, length ) != ESP_OK )
+    {
+        stats_.publish_errors++;
+
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_telemetry_get_stats( airshift_telemetry_stats_t *stats )
+{
+    if( stats == NULL )
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *stats = stats_;
+
+    return ESP_OK;
+}
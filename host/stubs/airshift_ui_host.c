@@ -0,0 +1,56 @@
+// Host build, readings shown on screen are only logged ...
+#include "airshift_ui.h"
+
+static const char* TAG = "airshift_ui";
+
+// Public functions
+esp_err_t airshift_ui_init()
+{
+    ESP_LOGI( TAG, "airshift_ui_init" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_ui_release()
+{
+    ESP_LOGI( TAG, "airshift_ui_release" );
+
+    return ESP_OK;
+}
+
+esp_err_t airshift_ui_display_qrcode( const char *payload )
+{
+    return ESP_OK;
+}
+
+esp_err_t airshift_ui_display_main()
+{
+    return ESP_OK;
+}
+
+void airshift_ui_set_co2( uint16_t value )
+{
+    ESP_LOGD( TAG, "co2: %u", value );
+}
+
+void airshift_ui_set_temperature( float value )
+{
+    ESP_LOGD( TAG, "temperature: %.1f", value );
+}
+
+void airshift_ui_set_particulate_matter( uint16_t value )
+{
+    ESP_LOGD( TAG, "pm2.5: %u", value );
+}
+
+void airshift_ui_set_air_quality( airshift_air_quality_t quality )
+{
+    ESP_LOGD( TAG, "air quality: %s", airshift_air_quality_name( quality ) );
+}
+
+esp_err_t airshift_ui_get_stats( airshift_ui_stats_t *stats )
+{
+    memset( stats, 0, sizeof( airshift_ui_stats_t ) );
+
+    return ESP_OK;
+}
@@ -0,0 +1,12 @@
+// Host build, there is nothing to render ...
+#include <lvgl.h>
+
+uint32_t lv_task_handler()
+{
+    return 0;
+}
+
+uint32_t lv_timer_handler()
+{
+    return 0;
+}
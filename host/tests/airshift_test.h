@@ -0,0 +1,52 @@
+// Host tests, every check runs, the failed ones are reported with their location and the binary exits non zero ...
+#ifndef AIRSHIFT_TEST_H
+#define AIRSHIFT_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+
+static int test_failures_ = 0;
+
+#define TEST_ASSERT( condition )                                                                                    \
+    do                                                                                                              \
+    {                                                                                                               \
+        if( !( condition ) )                                                                                        \
+        {                                                                                                           \
+            fprintf( stderr, "%s:%d: %s: assertion failed: %s\n", __FILE__, __LINE__, __func__, #condition );      \
+            test_failures_++;                                                                                       \
+        }                                                                                                           \
+    } while( 0 )
+
+#define TEST_ASSERT_EQUAL( expected, actual )                                                                       \
+    do                                                                                                              \
+    {                                                                                                               \
+        long long expected_ = (long long)( expected );                                                              \
+        long long actual_   = (long long)( actual );                                                                \
+                                                                                                                    \
+        if( expected_ != actual_ )                                                                                  \
+        {                                                                                                           \
+            fprintf( stderr, "%s:%d: %s: %s is %lld, expected %lld\n", __FILE__, __LINE__, __func__, #actual, actual_, expected_ );   \
+            test_failures_++;                                                                                       \
+        }                                                                                                           \
+    } while( 0 )
+
+#define TEST_ASSERT_EQUAL_STRING( expected, actual )                                                                \
+    do                                                                                                              \
+    {                                                                                                               \
+        if( strcmp( ( expected ), ( actual ) ) != 0 )                                                               \
+        {                                                                                                           \
+            fprintf( stderr, "%s:%d: %s: %s is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, __func__, #actual, ( actual ), ( expected ) );  \
+            test_failures_++;                                                                                       \
+        }                                                                                                           \
+    } while( 0 )
+
+#define TEST_RUN( test )                                                                                            \
+    do                                                                                                              \
+    {                                                                                                               \
+        printf( "%s\n", #test );                                                                                    \
+        test();                                                                                                     \
+    } while( 0 )
+
+#define TEST_RESULT()   ( ( test_failures_ == 0 ) ? 0 : 1 )
+
+#endif // AIRSHIFT_TEST_H
@@ -0,0 +1,195 @@
+// Air quality levels, getting worse shows at once, getting better only once the mean clears the breakpoint by the hysteresis ...
+#include "airshift_test.h"
+#include "airshift_air_quality.h"
+
+// Forward declarations
+static void                     test_unknown_until_reading();
+static void                     test_hysteresis();
+static void                     test_missing_reading_holds();
+static void                     test_worst_input_decides();
+static void                     test_humidity_comfort_band();
+static void                     test_rolling_mean();
+static void                     test_config_validation();
+static void                     reset( uint16_t window );
+static airshift_air_quality_t   update( airshift_channel_t channel, float value );
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    TEST_RUN( test_unknown_until_reading );
+    TEST_RUN( test_hysteresis );
+    TEST_RUN( test_missing_reading_holds );
+    TEST_RUN( test_worst_input_decides );
+    TEST_RUN( test_humidity_comfort_band );
+    TEST_RUN( test_rolling_mean );
+    TEST_RUN( test_config_validation );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_unknown_until_reading()
+{
+    airshift_sample_t               sample  = { 0 };
+    airshift_air_quality_result_t   result  = { 0 };
+
+    reset( 1 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_update( &sample, &result ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_UNKNOWN, result.quality );
+
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_CO2, 400.0f ) );
+}
+
+static void test_hysteresis()
+{
+    reset( 1 );
+
+    // co2 breakpoints are 800, 1000, 1500 .. ppm with 50 ppm of hysteresis ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_CO2, 700.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_MODERATE, update( AIRSHIFT_CHANNEL_CO2, 1100.0f ) );
+
+    // ... just below a breakpoint is not enough to improve ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_MODERATE, update( AIRSHIFT_CHANNEL_CO2, 990.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_MODERATE, update( AIRSHIFT_CHANNEL_CO2, 951.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_CO2, 949.0f ) );
+
+    // ... rising back into the band held on to is no change ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_CO2, 990.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_CO2, 760.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_CO2, 740.0f ) );
+
+    // ... while crossing a breakpoint upwards shows at once, several levels at a time ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_CO2, 800.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_EXTREMELY_POOR, update( AIRSHIFT_CHANNEL_CO2, 3000.0f ) );
+
+    // ... and a large drop improves several levels at once too ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_CO2, 500.0f ) );
+}
+
+static void test_missing_reading_holds()
+{
+    airshift_sample_t               sample  = { 0 };
+    airshift_air_quality_result_t   result  = { 0 };
+
+    reset( 1 );
+
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_POOR, update( AIRSHIFT_CHANNEL_CO2, 1600.0f ) );
+
+    sample.values[AIRSHIFT_CHANNEL_CO2] = AIRSHIFT_VALUE_INVALID;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_update( &sample, &result ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_POOR, result.quality );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_POOR, result.levels[AIRSHIFT_AIR_QUALITY_INPUT_CO2] );
+}
+
+static void test_worst_input_decides()
+{
+    airshift_sample_t               sample  = { 0 };
+    airshift_air_quality_result_t   result  = { 0 };
+
+    reset( 1 );
+
+    sample.valid_mask                       = AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_CO2 ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_PM_2_5 ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_PM_10_0 );
+    sample.values[AIRSHIFT_CHANNEL_CO2]     = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_CO2, 600.0f );
+    sample.values[AIRSHIFT_CHANNEL_PM_2_5]  = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_PM_2_5, 60.0f );
+    sample.values[AIRSHIFT_CHANNEL_PM_10_0] = airshift_channel_to_fixed( AIRSHIFT_CHANNEL_PM_10_0, 100.0f );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_update( &sample, &result ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_POOR, result.quality );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5, result.dominant );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, result.levels[AIRSHIFT_AIR_QUALITY_INPUT_CO2] );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, result.levels[AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0] );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_UNKNOWN, result.levels[AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY] );
+}
+
+static void test_humidity_comfort_band()
+{
+    reset( 1 );
+
+    // inside 30 .. 60 %RH is good, outside it the distance to the band is classified ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_HUMIDITY, 45.0f ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_MODERATE, update( AIRSHIFT_CHANNEL_HUMIDITY, 75.0f ) );
+
+    reset( 1 );
+
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_HUMIDITY, 25.0f ) );
+}
+
+static void test_rolling_mean()
+{
+    airshift_air_quality_result_t result = { 0 };
+
+    reset( 4 );
+
+    // a single spike is averaged out over the window ...
+    update( AIRSHIFT_CHANNEL_CO2, 600.0f );
+    update( AIRSHIFT_CHANNEL_CO2, 600.0f );
+    update( AIRSHIFT_CHANNEL_CO2, 600.0f );
+
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_GOOD, update( AIRSHIFT_CHANNEL_CO2, 1300.0f ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_get( &result ) );
+    TEST_ASSERT_EQUAL( 775, (int)result.means[AIRSHIFT_AIR_QUALITY_INPUT_CO2] );
+
+    // ... the oldest sample leaves as the newest enters ...
+    TEST_ASSERT_EQUAL( AIRSHIFT_AIR_QUALITY_FAIR, update( AIRSHIFT_CHANNEL_CO2, 1000.0f ) );
+}
+
+static void test_config_validation()
+{
+    airshift_air_quality_config_t config = { 0 };
+
+    reset( 1 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_get_config( AIRSHIFT_AIR_QUALITY_INPUT_CO2, &config ) );
+
+    config.window = 0;
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_air_quality_set_config( AIRSHIFT_AIR_QUALITY_INPUT_CO2, &config ) );
+
+    config.window           = 1;
+    config.breakpoints[2]   = config.breakpoints[1] - 1.0f;
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_air_quality_set_config( AIRSHIFT_AIR_QUALITY_INPUT_CO2, &config ) );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_air_quality_set_config( AIRSHIFT_AIR_QUALITY_INPUT_COUNT, &config ) );
+}
+
+// Default breakpoints, the given window for every input ...
+static void reset( uint16_t window )
+{
+    airshift_air_quality_config_t config = { 0 };
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_init() );
+
+    for( int i = 0; i < AIRSHIFT_AIR_QUALITY_INPUT_COUNT; i++ )
+    {
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_get_config( i, &config ) );
+
+        config.window = window;
+
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_set_config( i, &config ) );
+    }
+}
+
+// One reading of a single channel, returns the level of the input it feeds ...
+static airshift_air_quality_t update( airshift_channel_t channel, float value )
+{
+    airshift_sample_t               sample  = { 0 };
+    airshift_air_quality_result_t   result  = { 0 };
+
+    sample.valid_mask       = AIRSHIFT_CHANNEL_BIT( channel );
+    sample.values[channel]  = airshift_channel_to_fixed( channel, value );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_air_quality_update( &sample, &result ) );
+
+    switch( channel )
+    {
+        case AIRSHIFT_CHANNEL_CO2:      return result.levels[AIRSHIFT_AIR_QUALITY_INPUT_CO2];
+        case AIRSHIFT_CHANNEL_PM_2_5:   return result.levels[AIRSHIFT_AIR_QUALITY_INPUT_PM_2_5];
+        case AIRSHIFT_CHANNEL_PM_10_0:  return result.levels[AIRSHIFT_AIR_QUALITY_INPUT_PM_10_0];
+        case AIRSHIFT_CHANNEL_HUMIDITY: return result.levels[AIRSHIFT_AIR_QUALITY_INPUT_HUMIDITY];
+        default:                        return result.quality;
+    }
+}
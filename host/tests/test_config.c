@@ -0,0 +1,212 @@
+// Configuration blobs written by older, newer and padded layouts load into the current one and are stored back unpadded ...
+#include "airshift_test.h"
+#include "airshift_config.h"
+#include "airshift_nvs.h"
+
+#include <stddef.h>
+
+#define CONFIG_NVS_NAMESPACE    "config"
+#define CONFIG_NVS_KEY          "blob"
+#define CONFIG_BLOB_MAX         256
+
+// what airshift_config.c stores, the header and then the fields up to the end of the last one ...
+typedef struct __attribute__(( packed ))
+{
+    uint16_t    version;
+    uint16_t    size;
+    uint8_t     config[CONFIG_BLOB_MAX - 4];
+} blob_t;
+
+// Forward declarations
+static void     test_defaults();
+static void     test_store_unpadded();
+static void     test_migrate_older();
+static void     test_migrate_newer();
+static void     test_migrate_padded();
+static void     test_size_mismatch();
+static void     test_set_field_range();
+static size_t   config_size();
+static void     store_blob( uint16_t version, uint16_t size, const airshift_config_t *config, size_t length );
+static size_t   load_blob( blob_t *blob );
+
+static const airshift_config_t defaults_ =
+{
+#define X( type, field, value ) .field = value,
+    AIRSHIFT_CONFIG_FIELDS( X )
+#undef X
+};
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    ESP_ERROR_CHECK( airshift_nvs_init() );
+
+    TEST_RUN( test_defaults );
+    TEST_RUN( test_store_unpadded );
+    TEST_RUN( test_migrate_older );
+    TEST_RUN( test_migrate_newer );
+    TEST_RUN( test_migrate_padded );
+    TEST_RUN( test_size_mismatch );
+    TEST_RUN( test_set_field_range );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_defaults()
+{
+    airshift_nvs_erase_value( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT( memcmp( airshift_config(), &defaults_, sizeof( defaults_ ) ) == 0 );
+
+    // ... nothing is written until something changes ...
+    TEST_ASSERT( !airshift_nvs_key_exists( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY ) );
+}
+
+static void test_store_unpadded()
+{
+    blob_t blob = { 0 };
+
+    airshift_nvs_erase_value( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_set_field( "publish_period_s", 30 ) );
+
+    TEST_ASSERT_EQUAL( 4 + config_size(), load_blob( &blob ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_CONFIG_VERSION, blob.version );
+    TEST_ASSERT_EQUAL( config_size(), blob.size );
+
+    // ... and the next boot reads it back ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT_EQUAL( 30, airshift_config()->publish_period_s );
+    TEST_ASSERT_EQUAL( defaults_.history_period_s, airshift_config()->history_period_s );
+}
+
+static void test_migrate_older()
+{
+    airshift_config_t   config  = defaults_;
+    blob_t              blob    = { 0 };
+
+    config.publish_period_s = 20;
+    config.history_period_s = 7;
+    config.diag_period_s    = 90;
+
+    // a layout that ended half way into diag_period_s, only fields stored whole are taken ...
+    store_blob( AIRSHIFT_CONFIG_VERSION - 1, offsetof( airshift_config_t, diag_period_s ) + 2, &config, offsetof( airshift_config_t, diag_period_s ) + 2 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT_EQUAL( 20, airshift_config()->publish_period_s );
+    TEST_ASSERT_EQUAL( 7, airshift_config()->history_period_s );
+    TEST_ASSERT_EQUAL( defaults_.diag_period_s, airshift_config()->diag_period_s );
+    TEST_ASSERT_EQUAL( defaults_.telemetry_mode, airshift_config()->telemetry_mode );
+    TEST_ASSERT_EQUAL( defaults_.telemetry_format, airshift_config()->telemetry_format );
+
+    // ... and it is stored again in the current layout ...
+    TEST_ASSERT_EQUAL( 4 + config_size(), load_blob( &blob ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_CONFIG_VERSION, blob.version );
+    TEST_ASSERT_EQUAL( config_size(), blob.size );
+}
+
+static void test_migrate_newer()
+{
+    uint8_t data[CONFIG_BLOB_MAX]   = { 0 };
+    blob_t  blob                    = { 0 };
+
+    // a newer firmware appended a field, rolling back keeps everything this one knows ...
+    memset( data, 0xAA, sizeof( data ) );
+    memcpy( data, &defaults_, config_size() );
+    ( (airshift_config_t *)data )->publish_period_s = 45;
+
+    store_blob( AIRSHIFT_CONFIG_VERSION + 1, config_size() + 4, (const airshift_config_t *)data, config_size() + 4 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT_EQUAL( 45, airshift_config()->publish_period_s );
+    TEST_ASSERT_EQUAL( defaults_.telemetry_format, airshift_config()->telemetry_format );
+
+    TEST_ASSERT_EQUAL( 4 + config_size(), load_blob( &blob ) );
+    TEST_ASSERT_EQUAL( config_size(), blob.size );
+}
+
+static void test_migrate_padded()
+{
+    airshift_config_t   config  = { 0 };
+    blob_t              blob    = { 0 };
+
+    // earlier builds stored the whole struct, tail padding included, it must not be taken for a field ...
+    memset( &config, 0xFF, sizeof( config ) );
+    memcpy( &config, &defaults_, config_size() );
+    config.diag_period_s = 120;
+
+    store_blob( AIRSHIFT_CONFIG_VERSION, sizeof( airshift_config_t ), &config, sizeof( airshift_config_t ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT_EQUAL( 120, airshift_config()->diag_period_s );
+    TEST_ASSERT_EQUAL( defaults_.telemetry_format, airshift_config()->telemetry_format );
+
+    TEST_ASSERT_EQUAL( 4 + config_size(), load_blob( &blob ) );
+    TEST_ASSERT_EQUAL( config_size(), blob.size );
+}
+
+static void test_size_mismatch()
+{
+    airshift_config_t config = defaults_;
+
+    // the header claims more than was stored, nothing in it can be trusted ...
+    config.publish_period_s = 99;
+
+    store_blob( AIRSHIFT_CONFIG_VERSION, config_size() + 8, &config, config_size() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+    TEST_ASSERT( memcmp( airshift_config(), &defaults_, sizeof( defaults_ ) ) == 0 );
+}
+
+static void test_set_field_range()
+{
+    airshift_nvs_erase_value( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_init() );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_config_set_field( "telemetry_mode", 256 ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_config_set_field( "publish_period_s", -1 ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_config_set_field( "no_such_field", 1 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_set_field( "telemetry_mode", 255 ) );
+    TEST_ASSERT_EQUAL( 255, airshift_config()->telemetry_mode );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_config_reset() );
+    TEST_ASSERT( memcmp( airshift_config(), &defaults_, sizeof( defaults_ ) ) == 0 );
+}
+
+// Up to the end of the last field, the size the current layout is stored with ...
+static size_t config_size()
+{
+    size_t size = 0;
+
+#define X( type, field, value ) size = offsetof( airshift_config_t, field ) + sizeof( type );
+    AIRSHIFT_CONFIG_FIELDS( X )
+#undef X
+
+    return size;
+}
+
+static void store_blob( uint16_t version, uint16_t size, const airshift_config_t *config, size_t length )
+{
+    blob_t blob = { .version = version, .size = size };
+
+    memcpy( blob.config, config, length );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_blob( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY, &blob, 4 + length ) );
+}
+
+static size_t load_blob( blob_t *blob )
+{
+    size_t length = sizeof( blob_t );
+
+    memset( blob, 0, sizeof( blob_t ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_blob( CONFIG_NVS_NAMESPACE, CONFIG_NVS_KEY, blob, &length ) );
+
+    return length;
+}
@@ -0,0 +1,300 @@
+// History log, sequences map onto sector and slot, the index is rebuilt from flash at boot and survives the log wrapping ...
+#include "airshift_test.h"
+#include "airshift_history.h"
+#include "airshift_host.h"
+
+#include <esp_partition.h>
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_PARTITION_TYPE  0x40
+#define HISTORY_SECTOR_SIZE     4096
+#define HISTORY_SECTORS         3
+#define HISTORY_MAGIC           0x54534841
+
+#define SECTOR_HEADER_SIZE      32
+#define SECTOR_FIRST_SEQUENCE   12      // offset in the sector header
+#define RECORD_SIZE             24
+#define RECORD_VALUES           10      // offset in the record
+#define RECORDS_PER_SECTOR      ( ( HISTORY_SECTOR_SIZE - SECTOR_HEADER_SIZE ) / RECORD_SIZE )
+
+// Forward declarations
+static void     test_no_partition();
+static void     test_empty();
+static void     test_append_read();
+static void     test_index_recovery();
+static void     test_wrap();
+static void     test_corrupt_record();
+static void     erase();
+static void     append( uint32_t count );
+static bool     check_record( uint32_t sequence );
+static size_t   record_offset( uint32_t sequence );
+
+static const esp_partition_t *partition_ = NULL;
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    // ... before the partition exists ...
+    TEST_RUN( test_no_partition );
+
+    ESP_ERROR_CHECK( host_partition_register( HISTORY_PARTITION_LABEL, ESP_PARTITION_TYPE_DATA, HISTORY_PARTITION_TYPE, HISTORY_SECTORS * HISTORY_SECTOR_SIZE, NULL ) );
+
+    partition_ = esp_partition_find_first( ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, HISTORY_PARTITION_LABEL );
+
+    TEST_RUN( test_empty );
+    TEST_RUN( test_append_read );
+    TEST_RUN( test_index_recovery );
+    TEST_RUN( test_wrap );
+    TEST_RUN( test_corrupt_record );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_no_partition()
+{
+    airshift_sample_t           sample  = { .valid_mask = AIRSHIFT_CHANNEL_ALL };
+    airshift_history_record_t   record  = { 0 };
+
+    // units updated over the air may lack the partition, appends still hand out records ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_append( &sample, &record ) );
+    TEST_ASSERT_EQUAL( 0, record.sequence );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_append( &sample, &record ) );
+    TEST_ASSERT_EQUAL( 1, record.sequence );
+
+    // ... but nothing is kept ...
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_history_read( 0, &record ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void test_empty()
+{
+    airshift_history_record_t   record  = { 0 };
+    airshift_history_stats_t    stats   = { 0 };
+    uint32_t                    oldest  = 0;
+    uint32_t                    next    = 0;
+
+    erase();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+    TEST_ASSERT_EQUAL( 0, oldest );
+    TEST_ASSERT_EQUAL( 0, next );
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_history_read( 0, &record ) );
+
+    // one sector is always being recycled ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( ( HISTORY_SECTORS - 1 ) * RECORDS_PER_SECTOR, stats.capacity );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void test_append_read()
+{
+    airshift_history_record_t record = { 0 };
+
+    erase();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+
+    // records still in the ram batch read back like flushed ones ...
+    append( 3 );
+
+    TEST_ASSERT( check_record( 0 ) );
+    TEST_ASSERT( check_record( 2 ) );
+
+    append( 17 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_flush() );
+
+    for( uint32_t sequence = 0; sequence < 20; sequence++ )
+    {
+        TEST_ASSERT( check_record( sequence ) );
+    }
+
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_history_read( 20, &record ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void test_index_recovery()
+{
+    airshift_history_record_t   record  = { 0 };
+    airshift_sample_t           sample  = { .valid_mask = AIRSHIFT_CHANNEL_ALL };
+    uint32_t                    oldest  = 0;
+    uint32_t                    next    = 0;
+
+    erase();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+
+    // release flushes the partial batch ...
+    append( 21 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+    TEST_ASSERT_EQUAL( 0, oldest );
+    TEST_ASSERT_EQUAL( 21, next );
+    TEST_ASSERT( check_record( 13 ) );
+    TEST_ASSERT( check_record( 20 ) );
+
+    // ... and sequences carry on where they stopped, never reused ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_append( &sample, &record ) );
+    TEST_ASSERT_EQUAL( 21, record.sequence );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void test_wrap()
+{
+    airshift_history_record_t   record      = { 0 };
+    airshift_history_stats_t    stats       = { 0 };
+    uint32_t                    oldest      = 0;
+    uint32_t                    next        = 0;
+    uint32_t                    recovered   = 0;
+    uint32_t                    count       = ( HISTORY_SECTORS * RECORDS_PER_SECTOR ) + 10;
+
+    erase();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+
+    append( count );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_flush() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_stats( &stats ) );
+    TEST_ASSERT( stats.sectors_erased > 0 );
+
+    // the oldest sector was recycled, at least capacity records are still held ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+    TEST_ASSERT_EQUAL( count, next );
+    TEST_ASSERT( oldest > 0 );
+    TEST_ASSERT( ( next - oldest ) >= stats.capacity );
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_history_read( oldest - 1, &record ) );
+    TEST_ASSERT( check_record( oldest ) );
+    TEST_ASSERT( check_record( next - 1 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+
+    // ... and the index rebuilt at boot finds the same range ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &recovered, &count ) );
+    TEST_ASSERT_EQUAL( oldest, recovered );
+    TEST_ASSERT_EQUAL( next, count );
+    TEST_ASSERT( check_record( oldest ) );
+    TEST_ASSERT( check_record( next - 1 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void test_corrupt_record()
+{
+    airshift_history_record_t   record      = { 0 };
+    airshift_history_stats_t    stats       = { 0 };
+    const uint8_t               zeros[2]    = { 0 };
+    uint32_t                    oldest      = 0;
+    uint32_t                    next        = 0;
+
+    erase();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+
+    append( 20 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+
+    // flash only clears bits, a value flipped in place is what a torn or worn write leaves ...
+    TEST_ASSERT_EQUAL( ESP_OK, esp_partition_write( partition_, record_offset( 5 ) + RECORD_VALUES, zeros, sizeof( zeros ) ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_init() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+    TEST_ASSERT_EQUAL( 0, oldest );
+    TEST_ASSERT_EQUAL( 20, next );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_CRC, airshift_history_read( 5, &record ) );
+    TEST_ASSERT( check_record( 4 ) );
+    TEST_ASSERT( check_record( 6 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 1, stats.crc_errors );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_release() );
+}
+
+static void erase()
+{
+    TEST_ASSERT_EQUAL( ESP_OK, esp_partition_erase_range( partition_, 0, partition_->size ) );
+}
+
+// Every value is derived from the sequence, so any record can be checked on its own ...
+static void append( uint32_t count )
+{
+    airshift_sample_t           sample  = { .valid_mask = AIRSHIFT_CHANNEL_ALL };
+    airshift_history_record_t   record  = { 0 };
+    uint32_t                    oldest  = 0;
+    uint32_t                    next    = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+
+    for( uint32_t sequence = next; sequence < ( next + count ); sequence++ )
+    {
+        for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+        {
+            sample.values[i] = (int16_t)( sequence + i );
+        }
+
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_history_append( &sample, &record ) );
+        TEST_ASSERT_EQUAL( sequence, record.sequence );
+    }
+}
+
+static bool check_record( uint32_t sequence )
+{
+    airshift_history_record_t record = { 0 };
+
+    if( airshift_history_read( sequence, &record ) != ESP_OK )
+    {
+        return false;
+    }
+
+    for( int i = 0; i < AIRSHIFT_CHANNEL_COUNT; i++ )
+    {
+        if( record.values[i] != (int16_t)( sequence + i ) )
+        {
+            return false;
+        }
+    }
+
+    return ( record.sequence == sequence ) && ( ( record.flags & AIRSHIFT_CHANNEL_ALL ) == AIRSHIFT_CHANNEL_ALL );
+}
+
+// Where a record sits in flash, from the sector headers ...
+static size_t record_offset( uint32_t sequence )
+{
+    uint8_t     header[SECTOR_HEADER_SIZE]  = { 0 };
+    uint32_t    magic                       = 0;
+    uint32_t    first                       = 0;
+
+    for( uint32_t sector = 0; sector < HISTORY_SECTORS; sector++ )
+    {
+        TEST_ASSERT_EQUAL( ESP_OK, esp_partition_read( partition_, sector * HISTORY_SECTOR_SIZE, header, sizeof( header ) ) );
+
+        memcpy( &magic, &header[0], sizeof( magic ) );
+        memcpy( &first, &header[SECTOR_FIRST_SEQUENCE], sizeof( first ) );
+
+        if( ( magic == HISTORY_MAGIC ) && ( sequence >= first ) && ( sequence < ( first + RECORDS_PER_SECTOR ) ) )
+        {
+            return ( sector * HISTORY_SECTOR_SIZE ) + SECTOR_HEADER_SIZE + ( ( sequence - first ) * RECORD_SIZE );
+        }
+    }
+
+    TEST_ASSERT( false );
+
+    return 0;
+}
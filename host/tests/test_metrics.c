@@ -0,0 +1,133 @@
+// Stage latency percentiles, the upper edge of their histogram bucket, never more than 25% above the true value ...
+#include "airshift_test.h"
+#include "airshift_metrics.h"
+
+#define STAGE   AIRSHIFT_METRICS_STAGE_HISTORY_APPEND
+
+// Forward declarations
+static void     test_empty();
+static void     test_exact_small_values();
+static void     test_uniform();
+static void     test_bucket_error();
+static void     test_overflow_bucket();
+static void     test_counters();
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    TEST_RUN( test_empty );
+    TEST_RUN( test_exact_small_values );
+    TEST_RUN( test_uniform );
+    TEST_RUN( test_bucket_error );
+    TEST_RUN( test_overflow_bucket );
+    TEST_RUN( test_counters );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_empty()
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    airshift_metrics_reset();
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_metrics_get_summary( STAGE, &summary ) );
+    TEST_ASSERT_EQUAL( 0, summary.count );
+    TEST_ASSERT_EQUAL( 0, summary.p50 );
+    TEST_ASSERT_EQUAL( 0, summary.max );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_metrics_get_summary( AIRSHIFT_METRICS_STAGE_COUNT, &summary ) );
+}
+
+static void test_exact_small_values()
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    airshift_metrics_reset();
+
+    // below 4 us every value has a bucket of its own, negative durations count as 0 ...
+    airshift_metrics_record( STAGE, -5 );
+    airshift_metrics_record( STAGE, 1 );
+    airshift_metrics_record( STAGE, 2 );
+    airshift_metrics_record( STAGE, 3 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_metrics_get_summary( STAGE, &summary ) );
+    TEST_ASSERT_EQUAL( 4, summary.count );
+    TEST_ASSERT_EQUAL( 1, summary.p50 );
+    TEST_ASSERT_EQUAL( 3, summary.p99 );
+    TEST_ASSERT_EQUAL( 3, summary.max );
+    TEST_ASSERT_EQUAL( 1, summary.avg );
+}
+
+static void test_uniform()
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    airshift_metrics_reset();
+
+    for( int64_t duration = 1; duration <= 100; duration++ )
+    {
+        airshift_metrics_record( STAGE, duration );
+    }
+
+    // 50 lands in [ 48, 55 ], 99 in [ 96, 111 ], which is capped at the largest value seen ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_metrics_get_summary( STAGE, &summary ) );
+    TEST_ASSERT_EQUAL( 100, summary.count );
+    TEST_ASSERT_EQUAL( 55, summary.p50 );
+    TEST_ASSERT_EQUAL( 100, summary.p99 );
+    TEST_ASSERT_EQUAL( 100, summary.max );
+    TEST_ASSERT_EQUAL( 50, summary.avg );
+}
+
+static void test_bucket_error()
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    // the median of one value and a larger one is the edge of the bucket holding the first ...
+    for( int64_t duration = 1; duration < 30 * 1000 * 1000; duration += ( duration / 7 ) + 1 )
+    {
+        airshift_metrics_reset();
+
+        airshift_metrics_record( STAGE, duration );
+        airshift_metrics_record( STAGE, 40 * 1000 * 1000 );
+
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_metrics_get_summary( STAGE, &summary ) );
+        TEST_ASSERT( summary.p50 >= duration );
+        TEST_ASSERT( ( summary.p50 * 4 ) <= ( duration * 5 ) );
+    }
+}
+
+static void test_overflow_bucket()
+{
+    airshift_metrics_summary_t summary = { 0 };
+
+    airshift_metrics_reset();
+
+    // anything past 2^25 us shares the last bucket, max still has the real value ...
+    airshift_metrics_record( STAGE, 100 * 1000 * 1000 );
+    airshift_metrics_record( STAGE, 200 * 1000 * 1000 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_metrics_get_summary( STAGE, &summary ) );
+    TEST_ASSERT_EQUAL( ( 1 << 25 ) - 1, summary.p50 );
+    TEST_ASSERT_EQUAL( ( 1 << 25 ) - 1, summary.p99 );
+    TEST_ASSERT_EQUAL( 200 * 1000 * 1000, summary.max );
+}
+
+static void test_counters()
+{
+    airshift_metrics_reset();
+
+    airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_I2C_NACKS );
+    airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_I2C_NACKS );
+    airshift_metrics_count( AIRSHIFT_METRICS_COUNTER_COUNT );
+
+    TEST_ASSERT_EQUAL( 2, airshift_metrics_get_counter( AIRSHIFT_METRICS_COUNTER_I2C_NACKS ) );
+    TEST_ASSERT_EQUAL( 0, airshift_metrics_get_counter( AIRSHIFT_METRICS_COUNTER_I2C_TIMEOUTS ) );
+
+    airshift_metrics_reset();
+
+    TEST_ASSERT_EQUAL( 0, airshift_metrics_get_counter( AIRSHIFT_METRICS_COUNTER_I2C_NACKS ) );
+}
@@ -0,0 +1,274 @@
+// Mqtt publish window, qos 1 messages hold a slot until their PUBACK, even one handled before esp_mqtt_client_publish returned ...
+#include "airshift_test.h"
+#include "airshift_mqtt.h"
+#include "airshift_event.h"
+#include "airshift_host.h"
+
+#include <mqtt_client.h>
+
+#define INFLIGHT_WINDOW     4
+#define TICKETS_MAX         32
+#define WAIT_TIMEOUT_MS     1000
+
+#define TOPIC_QOS_1         "telemetry/test"
+#define TOPIC_QOS_0         "co2/test"
+#define MESSAGE             "{\"co2\":612}"
+
+typedef enum
+{
+    ACK_LATER,      // the test acknowledges with host_mqtt_deliver
+    ACK_EARLY,      // the PUBACK is handled before the client returns the msg_id
+} ack_t;
+
+// Forward declarations
+static void     test_publish_before_connect();
+static void     test_ack_before_msg_id();
+static void     test_window();
+static void     test_unknown_ack();
+static void     test_qos_0();
+static int      publish( const char *topic );
+static bool     wait_tickets( size_t count );
+static void     broker_publish( void *context, int msg_id, const char *topic, const char *data, int length, int qos );
+static void     event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data );
+
+static portMUX_TYPE lock_                   = portMUX_INITIALIZER_UNLOCKED;
+static ack_t        ack_                    = ACK_LATER;
+static int          msg_ids_[TICKETS_MAX]   = { 0 };     // as the broker saw them
+static size_t       msg_id_count_           = 0;
+static int          tickets_[TICKETS_MAX]   = { 0 };     // as AIRSHIFT_EVENT_MQTT_PUBLISHED reported them
+static size_t       ticket_count_           = 0;
+
+// Public functions
+int main( int argc, char **argv )
+{
+    const host_mqtt_backend_t backend = { .context = NULL, .publish = broker_publish };
+
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    ESP_ERROR_CHECK( airshift_event_init() );
+    ESP_ERROR_CHECK( esp_event_handler_register( AIRSHIFT_EVENT_MQTT, ESP_EVENT_ANY_ID, event_handler, NULL ) );
+
+    ESP_ERROR_CHECK( host_mqtt_attach( &backend ) );
+    ESP_ERROR_CHECK( airshift_mqtt_init() );
+
+    TEST_RUN( test_publish_before_connect );
+    TEST_RUN( test_ack_before_msg_id );
+    TEST_RUN( test_window );
+    TEST_RUN( test_unknown_ack );
+    TEST_RUN( test_qos_0 );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_publish_before_connect()
+{
+    airshift_mqtt_stats_t   stats   = { 0 };
+    int                     ticket  = 0;
+
+    ack_ = ACK_LATER;
+
+    // queued until the client connects ...
+    ticket = publish( TOPIC_QOS_1 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 0, stats.publishes );
+    TEST_ASSERT_EQUAL( 1, stats.queue_depth );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 1, stats.publishes );
+    TEST_ASSERT_EQUAL( 0, stats.queue_depth );
+    TEST_ASSERT_EQUAL( 1, stats.inflight );
+    TEST_ASSERT_EQUAL( 1, msg_id_count_ );
+
+    // ... and done once the broker acknowledges ...
+    TEST_ASSERT_EQUAL( ESP_OK, host_mqtt_deliver( MQTT_EVENT_PUBLISHED, msg_ids_[0] ) );
+    TEST_ASSERT( wait_tickets( 1 ) );
+    TEST_ASSERT_EQUAL( ticket, tickets_[0] );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 1, stats.acks );
+    TEST_ASSERT_EQUAL( 0, stats.inflight );
+}
+
+static void test_ack_before_msg_id()
+{
+    airshift_mqtt_stats_t   before                          = { 0 };
+    airshift_mqtt_stats_t   after                           = { 0 };
+    int                     tickets[2 * INFLIGHT_WINDOW]    = { 0 };
+    size_t                  first                           = ticket_count_;
+
+    ack_ = ACK_EARLY;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &before ) );
+
+    // twice the window, a PUBACK that found no slot would leave it taken and stall the rest ...
+    for( size_t i = 0; i < ( sizeof( tickets ) / sizeof( tickets[0] ) ); i++ )
+    {
+        tickets[i] = publish( TOPIC_QOS_1 );
+    }
+
+    TEST_ASSERT( wait_tickets( first + ( sizeof( tickets ) / sizeof( tickets[0] ) ) ) );
+
+    for( size_t i = 0; i < ( sizeof( tickets ) / sizeof( tickets[0] ) ); i++ )
+    {
+        TEST_ASSERT_EQUAL( tickets[i], tickets_[first + i] );
+    }
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.publishes + ( sizeof( tickets ) / sizeof( tickets[0] ) ), after.publishes );
+    TEST_ASSERT_EQUAL( before.acks + ( sizeof( tickets ) / sizeof( tickets[0] ) ), after.acks );
+    TEST_ASSERT_EQUAL( 0, after.inflight );
+    TEST_ASSERT_EQUAL( 0, after.queue_depth );
+    TEST_ASSERT_EQUAL( 0, after.ack_timeouts );
+}
+
+static void test_window()
+{
+    airshift_mqtt_stats_t   before  = { 0 };
+    airshift_mqtt_stats_t   stats   = { 0 };
+    size_t                  first   = msg_id_count_;
+    size_t                  tickets = ticket_count_;
+
+    ack_ = ACK_LATER;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &before ) );
+
+    for( int i = 0; i < INFLIGHT_WINDOW + 2; i++ )
+    {
+        publish( TOPIC_QOS_1 );
+    }
+
+    // ... the window is full, the rest waits in the queue ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( before.publishes + INFLIGHT_WINDOW, stats.publishes );
+    TEST_ASSERT_EQUAL( INFLIGHT_WINDOW, stats.inflight );
+    TEST_ASSERT_EQUAL( 2, stats.queue_depth );
+
+    // ... every PUBACK lets one more out ...
+    TEST_ASSERT_EQUAL( ESP_OK, host_mqtt_deliver( MQTT_EVENT_PUBLISHED, msg_ids_[first] ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( before.publishes + INFLIGHT_WINDOW + 1, stats.publishes );
+    TEST_ASSERT_EQUAL( INFLIGHT_WINDOW, stats.inflight );
+    TEST_ASSERT_EQUAL( 1, stats.queue_depth );
+
+    for( size_t i = first + 1; i < msg_id_count_; i++ )
+    {
+        TEST_ASSERT_EQUAL( ESP_OK, host_mqtt_deliver( MQTT_EVENT_PUBLISHED, msg_ids_[i] ) );
+    }
+
+    TEST_ASSERT( wait_tickets( tickets + INFLIGHT_WINDOW + 2 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( before.publishes + INFLIGHT_WINDOW + 2, stats.publishes );
+    TEST_ASSERT_EQUAL( before.acks + INFLIGHT_WINDOW + 2, stats.acks );
+    TEST_ASSERT_EQUAL( 0, stats.inflight );
+    TEST_ASSERT_EQUAL( 0, stats.queue_depth );
+}
+
+static void test_unknown_ack()
+{
+    airshift_mqtt_stats_t   before  = { 0 };
+    airshift_mqtt_stats_t   after   = { 0 };
+    size_t                  tickets = ticket_count_;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &before ) );
+
+    // nothing in flight, a stray PUBACK is ignored ...
+    TEST_ASSERT_EQUAL( ESP_OK, host_mqtt_deliver( MQTT_EVENT_PUBLISHED, 9999 ) );
+    TEST_ASSERT( !wait_tickets( tickets + 1 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.acks, after.acks );
+    TEST_ASSERT_EQUAL( 0, after.inflight );
+}
+
+static void test_qos_0()
+{
+    airshift_mqtt_stats_t   stats   = { 0 };
+    int                     ticket  = 0;
+    size_t                  first   = ticket_count_;
+
+    ack_ = ACK_LATER;
+
+    // ... no PUBACK, done once it is handed to the client ...
+    ticket = publish( TOPIC_QOS_0 );
+
+    TEST_ASSERT( wait_tickets( first + 1 ) );
+    TEST_ASSERT_EQUAL( ticket, tickets_[first] );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 0, stats.inflight );
+}
+
+static int publish( const char *topic )
+{
+    int ticket = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_publish_tracked( topic, MESSAGE, strlen( MESSAGE ), &ticket ) );
+
+    return ticket;
+}
+
+// The event loop delivers AIRSHIFT_EVENT_MQTT_PUBLISHED on its own task ...
+static bool wait_tickets( size_t count )
+{
+    size_t received = 0;
+
+    for( int waited = 0; waited <= WAIT_TIMEOUT_MS; waited += 10 )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        received = ticket_count_;
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( received >= count )
+        {
+            return true;
+        }
+
+        vTaskDelay( pdMS_TO_TICKS( 10 ) );
+    }
+
+    return false;
+}
+
+// The broker, called by esp_mqtt_client_publish before it returns ...
+static void broker_publish( void *context, int msg_id, const char *topic, const char *data, int length, int qos )
+{
+    if( qos == 0 )
+    {
+        return;
+    }
+
+    TEST_ASSERT( msg_id_count_ < TICKETS_MAX );
+
+    msg_ids_[msg_id_count_++] = msg_id;
+
+    // ... as the mqtt task would if it handled the PUBACK before the publishing task got the msg_id ...
+    if( ack_ == ACK_EARLY )
+    {
+        host_mqtt_deliver( MQTT_EVENT_PUBLISHED, msg_id );
+    }
+}
+
+static void event_handler( void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data )
+{
+    if( event_id != AIRSHIFT_EVENT_MQTT_PUBLISHED )
+    {
+        return;
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    if( ticket_count_ < TICKETS_MAX )
+    {
+        tickets_[ticket_count_++] = *(int *)event_data;
+    }
+
+    portEXIT_CRITICAL( &lock_ );
+}
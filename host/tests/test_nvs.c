@@ -0,0 +1,292 @@
+// Nvs write cache, writes wait in ram and reads see them at once, they reach the flash together from a quiet slot, a full table,
+// a read of another type or the deadline, erase_all drops what was still waiting ...
+#include "airshift_test.h"
+#include "airshift_nvs.h"
+#include "airshift_host.h"
+
+#include <esp_timer.h>
+
+#define CLOCK_SPEED         10.0    // the deadline is 10 s, a second of wall clock here
+
+#define PENDING_MAX         16
+#define COMMIT_DELAY_MS     2000
+#define COMMIT_DEADLINE_MS  10000
+
+#define NAMESPACE           "test"
+#define OTHER_NAMESPACE     "other"
+
+// Forward declarations
+static void         test_read_pending();
+static void         test_pending_erase();
+static void         test_type_mismatch_flush();
+static void         test_erase_all_drops_pending();
+static void         test_full_table_flush();
+static void         test_commit_if_due();
+static void         test_deadline();
+static esp_err_t    flash_get_int32( const char *namespace, const char *key, int32_t *value );
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    host_clock_init( CLOCK_SPEED );
+
+    ESP_ERROR_CHECK( airshift_nvs_init() );
+
+    TEST_RUN( test_read_pending );
+    TEST_RUN( test_pending_erase );
+    TEST_RUN( test_type_mismatch_flush );
+    TEST_RUN( test_erase_all_drops_pending );
+    TEST_RUN( test_full_table_flush );
+    TEST_RUN( test_commit_if_due );
+    TEST_RUN( test_deadline );
+
+    ESP_ERROR_CHECK( airshift_nvs_release() );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_read_pending()
+{
+    airshift_nvs_stats_t    before      = { 0 };
+    airshift_nvs_stats_t    after       = { 0 };
+    int32_t                 value       = 0;
+    int16_t                 small       = 0;
+    char                    text[16]    = { 0 };
+    size_t                  length      = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &before ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "int32", 7 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int16( NAMESPACE, "int16", -3 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_string( NAMESPACE, "string", "airshift" ) );
+
+    // the flash has none of it yet ...
+    TEST_ASSERT( flash_get_int32( NAMESPACE, "int32", &value ) != ESP_OK );
+
+    // ... the reads see every one of them ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int32( NAMESPACE, "int32", &value ) );
+    TEST_ASSERT_EQUAL( 7, value );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int16( NAMESPACE, "int16", &small ) );
+    TEST_ASSERT_EQUAL( -3, small );
+    TEST_ASSERT( airshift_nvs_key_exists( NAMESPACE, "string" ) );
+
+    // ... a string without a buffer reports its length, terminator included, a short buffer is refused ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_string( NAMESPACE, "string", NULL, &length ) );
+    TEST_ASSERT_EQUAL( 9, length );
+
+    length = 4;
+    TEST_ASSERT_EQUAL( ESP_ERR_NVS_INVALID_LENGTH, airshift_nvs_get_string( NAMESPACE, "string", text, &length ) );
+
+    length = sizeof( text );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_string( NAMESPACE, "string", text, &length ) );
+    TEST_ASSERT_EQUAL_STRING( "airshift", text );
+
+    // ... a second write replaces the first before either reaches the flash ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "int32", 8 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.writes + 4, after.writes );
+    TEST_ASSERT_EQUAL( before.coalesced + 1, after.coalesced );
+    TEST_ASSERT_EQUAL( before.flushes, after.flushes );
+
+    // ... and one flush writes three values with one commit ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes + 1, after.flushes );
+    TEST_ASSERT_EQUAL( before.operations + 3, after.operations );
+    TEST_ASSERT_EQUAL( before.commits + 1, after.commits );
+
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "int32", &value ) );
+    TEST_ASSERT_EQUAL( 8, value );
+}
+
+static void test_pending_erase()
+{
+    int32_t value = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "erased", 11 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+
+    // an erase waiting for the flash hides the value already there ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_erase_value( NAMESPACE, "erased" ) );
+
+    TEST_ASSERT( !airshift_nvs_key_exists( NAMESPACE, "erased" ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_NVS_NOT_FOUND, airshift_nvs_get_int32( NAMESPACE, "erased", &value ) );
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "erased", &value ) );
+
+    // ... until it gets there, erasing a key that was never written is no error ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_erase_value( NAMESPACE, "never" ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_NVS_NOT_FOUND, flash_get_int32( NAMESPACE, "erased", &value ) );
+}
+
+static void test_type_mismatch_flush()
+{
+    airshift_nvs_stats_t    before      = { 0 };
+    airshift_nvs_stats_t    after       = { 0 };
+    int32_t                 value       = 0;
+    char                    text[16]    = { 0 };
+    size_t                  length      = sizeof( text );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "typed", 5 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &before ) );
+
+    // read as another type, the pending value goes out first and the flash reports the mismatch the way it always would ...
+    TEST_ASSERT_EQUAL( ESP_ERR_NVS_NOT_FOUND, airshift_nvs_get_string( NAMESPACE, "typed", text, &length ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes + 1, after.flushes );
+    TEST_ASSERT_EQUAL( before.operations + 1, after.operations );
+
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "typed", &value ) );
+    TEST_ASSERT_EQUAL( 5, value );
+
+    // ... and the right type still reads it ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int32( NAMESPACE, "typed", &value ) );
+    TEST_ASSERT_EQUAL( 5, value );
+}
+
+static void test_erase_all_drops_pending()
+{
+    airshift_nvs_stats_t    before  = { 0 };
+    airshift_nvs_stats_t    after   = { 0 };
+    int32_t                 value   = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "stored", 1 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "pending", 2 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( OTHER_NAMESPACE, "pending", 3 ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &before ) );
+
+    // the namespace is gone at once, stored or pending, nothing of it is written first ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_erase_all( NAMESPACE ) );
+
+    TEST_ASSERT( !airshift_nvs_key_exists( NAMESPACE, "stored" ) );
+    TEST_ASSERT( !airshift_nvs_key_exists( NAMESPACE, "pending" ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes, after.flushes );
+
+    // ... the other namespace still waits, and is all the next flush writes ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int32( OTHER_NAMESPACE, "pending", &value ) );
+    TEST_ASSERT_EQUAL( 3, value );
+    TEST_ASSERT( flash_get_int32( OTHER_NAMESPACE, "pending", &value ) != ESP_OK );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.operations + 1, after.operations );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_NVS_NOT_FOUND, flash_get_int32( NAMESPACE, "pending", &value ) );
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( OTHER_NAMESPACE, "pending", &value ) );
+    TEST_ASSERT_EQUAL( 3, value );
+}
+
+static void test_full_table_flush()
+{
+    airshift_nvs_stats_t    before      = { 0 };
+    airshift_nvs_stats_t    after       = { 0 };
+    char                    key[16]     = { 0 };
+    int32_t                 value       = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &before ) );
+
+    for( int i = 0; i < PENDING_MAX; i++ )
+    {
+        snprintf( key, sizeof( key ), "key%d", i );
+
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, key, i ) );
+    }
+
+    // the table is full, rewriting a key already in it needs no slot ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "key0", 100 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes, after.flushes );
+
+    // ... one more key writes the whole table out rather than refusing ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "overflow", -1 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes + 1, after.flushes );
+    TEST_ASSERT_EQUAL( before.operations + PENDING_MAX, after.operations );
+
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "key0", &value ) );
+    TEST_ASSERT_EQUAL( 100, value );
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "key15", &value ) );
+    TEST_ASSERT_EQUAL( 15, value );
+
+    // ... and the new key is the first of the next batch ...
+    TEST_ASSERT( flash_get_int32( NAMESPACE, "overflow", &value ) != ESP_OK );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int32( NAMESPACE, "overflow", &value ) );
+    TEST_ASSERT_EQUAL( -1, value );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_flush() );
+}
+
+static void test_commit_if_due()
+{
+    int32_t value = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "due", 21 ) );
+
+    // too soon, repeated writes to the key would still be coalesced ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_commit_if_due() );
+    TEST_ASSERT( flash_get_int32( NAMESPACE, "due", &value ) != ESP_OK );
+
+    // ... past the delay, but well before the deadline ...
+    vTaskDelay( pdMS_TO_TICKS( COMMIT_DELAY_MS + 500 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_commit_if_due() );
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "due", &value ) );
+    TEST_ASSERT_EQUAL( 21, value );
+}
+
+static void test_deadline()
+{
+    airshift_nvs_stats_t    before  = { 0 };
+    airshift_nvs_stats_t    after   = { 0 };
+    int32_t                 value   = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &before ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_write_int32( NAMESPACE, "deadline", 42 ) );
+
+    // nobody offers a quiet slot, the commit task writes it once the deadline passes ...
+    vTaskDelay( pdMS_TO_TICKS( COMMIT_DEADLINE_MS / 2 ) );
+
+    TEST_ASSERT( flash_get_int32( NAMESPACE, "deadline", &value ) != ESP_OK );
+
+    vTaskDelay( pdMS_TO_TICKS( COMMIT_DEADLINE_MS ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, flash_get_int32( NAMESPACE, "deadline", &value ) );
+    TEST_ASSERT_EQUAL( 42, value );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.flushes + 1, after.flushes );
+}
+
+// What is actually on the flash, past the cache ...
+static esp_err_t flash_get_int32( const char *namespace, const char *key, int32_t *value )
+{
+    esp_err_t       ret     = ESP_FAIL;
+    nvs_handle_t    handle  = 0;
+
+    ret = nvs_open( namespace, NVS_READONLY, &handle );
+
+    if( ret != ESP_OK )
+    {
+        return ret;
+    }
+
+    ret = nvs_get_i32( handle, key, value );
+
+    nvs_close( handle );
+
+    return ret;
+}
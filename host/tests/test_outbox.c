@@ -0,0 +1,209 @@
+// Outbox, records pushed while the broker is away are backfilled once it is back, the cursor survives a reboot and whatever the
+// history log recycled in the meantime is counted as lost ...
+#include "airshift_test.h"
+#include "airshift_outbox.h"
+#include "airshift_history.h"
+#include "airshift_telemetry.h"
+#include "airshift_event.h"
+#include "airshift_mqtt.h"
+#include "airshift_nvs.h"
+#include "airshift_host.h"
+
+#include <esp_partition.h>
+#include <esp_timer.h>
+
+#define CLOCK_SPEED             100.0   // backfill is rate limited to a batch every 2 s
+#define DRAIN_TIMEOUT_MS        ( 10 * 60 * 1000 )
+
+#define HISTORY_PARTITION_LABEL "history"
+#define HISTORY_PARTITION_TYPE  0x40
+#define HISTORY_PARTITION_SIZE  ( 3 * 4096 )
+
+#define OUTBOX_NVS_NAMESPACE    "outbox"
+#define OUTBOX_NVS_CURSOR       "cursor"
+#define OUTBOX_CACHE_RECORDS    32
+#define OUTBOX_BATCH_RECORDS    10
+
+// Forward declarations
+static void     test_push_while_offline();
+static void     test_drain_on_connect();
+static void     test_drain_from_flash();
+static void     test_cursor_survives_reboot();
+static void     test_recycled_before_delivery();
+static uint32_t push( uint32_t count );
+static bool     wait_drained();
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    host_clock_init( CLOCK_SPEED );
+
+    ESP_ERROR_CHECK( host_partition_register( HISTORY_PARTITION_LABEL, ESP_PARTITION_TYPE_DATA, HISTORY_PARTITION_TYPE, HISTORY_PARTITION_SIZE, NULL ) );
+
+    ESP_ERROR_CHECK( airshift_nvs_init() );
+    ESP_ERROR_CHECK( airshift_event_init() );
+    ESP_ERROR_CHECK( airshift_mqtt_init() );
+    ESP_ERROR_CHECK( airshift_history_init() );
+    ESP_ERROR_CHECK( airshift_telemetry_init() );
+    ESP_ERROR_CHECK( airshift_outbox_init() );
+
+    TEST_RUN( test_push_while_offline );
+    TEST_RUN( test_drain_on_connect );
+    TEST_RUN( test_drain_from_flash );
+    TEST_RUN( test_cursor_survives_reboot );
+    TEST_RUN( test_recycled_before_delivery );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_push_while_offline()
+{
+    airshift_outbox_stats_t stats   = { 0 };
+    int32_t                 cursor  = 0;
+    uint32_t                first   = 0;
+
+    first = push( 5 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 5, stats.queued );
+    TEST_ASSERT_EQUAL( 5, stats.pending );
+    TEST_ASSERT_EQUAL( 0, stats.batches );
+
+    // only the start of the outage is written to nvs ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_nvs_get_int32( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR, &cursor ) );
+    TEST_ASSERT_EQUAL( first, cursor );
+}
+
+static void test_drain_on_connect()
+{
+    airshift_outbox_stats_t before  = { 0 };
+    airshift_outbox_stats_t after   = { 0 };
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &before ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+    TEST_ASSERT( wait_drained() );
+
+    // everything still cached, one batch, and the cursor is gone once the backlog is ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.batches + 1, after.batches );
+    TEST_ASSERT_EQUAL( before.cache_hits + 5, after.cache_hits );
+    TEST_ASSERT_EQUAL( before.flash_reads, after.flash_reads );
+    TEST_ASSERT_EQUAL( 0, after.lost );
+    TEST_ASSERT( !airshift_nvs_key_exists( OUTBOX_NVS_NAMESPACE, OUTBOX_NVS_CURSOR ) );
+}
+
+static void test_drain_from_flash()
+{
+    airshift_outbox_stats_t before  = { 0 };
+    airshift_outbox_stats_t after   = { 0 };
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_release() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &before ) );
+
+    // more than the cache holds, the oldest are read back from the log ...
+    push( OUTBOX_CACHE_RECORDS + 8 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+    TEST_ASSERT( wait_drained() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.batches + ( ( OUTBOX_CACHE_RECORDS + 8 ) / OUTBOX_BATCH_RECORDS ), after.batches );
+    TEST_ASSERT_EQUAL( before.cache_hits + OUTBOX_CACHE_RECORDS, after.cache_hits );
+    TEST_ASSERT_EQUAL( before.flash_reads + 8, after.flash_reads );
+    TEST_ASSERT_EQUAL( before.lost, after.lost );
+}
+
+static void test_cursor_survives_reboot()
+{
+    airshift_outbox_stats_t stats   = { 0 };
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_release() );
+
+    push( 12 );
+
+    // a reboot loses the cache, the backlog is everything logged since the stored cursor ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_release() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_init() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 12, stats.pending );
+    TEST_ASSERT_EQUAL( 0, stats.queued );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+    TEST_ASSERT( wait_drained() );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &stats ) );
+    TEST_ASSERT_EQUAL( 12, stats.flash_reads );
+    TEST_ASSERT_EQUAL( 0, stats.cache_hits );
+    TEST_ASSERT_EQUAL( 2, stats.batches );
+    TEST_ASSERT_EQUAL( 0, stats.lost );
+}
+
+static void test_recycled_before_delivery()
+{
+    airshift_outbox_stats_t     before      = { 0 };
+    airshift_outbox_stats_t     after       = { 0 };
+    airshift_history_stats_t    history     = { 0 };
+    uint32_t                    first       = 0;
+    uint32_t                    oldest      = 0;
+    uint32_t                    next        = 0;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_release() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_stats( &history ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &before ) );
+
+    // an outage longer than the log holds, capacity is what survives a recycle, twice that is sure to recycle the start of it ...
+    first = push( 2 * history.capacity );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_flush() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_history_get_range( &oldest, &next ) );
+    TEST_ASSERT( oldest > first );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+    TEST_ASSERT( wait_drained() );
+
+    // ... every record is either delivered or counted as lost, never both ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.lost + ( oldest - first ), after.lost );
+    TEST_ASSERT_EQUAL( next - oldest, ( after.cache_hits - before.cache_hits ) + ( after.flash_reads - before.flash_reads ) );
+}
+
+// Logs count records and hands each to the outbox, as the sampling task does while the broker is away, returns the first sequence ...
+static uint32_t push( uint32_t count )
+{
+    airshift_sample_t           sample  = { .valid_mask = AIRSHIFT_CHANNEL_ALL };
+    airshift_history_record_t   record  = { 0 };
+    uint32_t                    first   = 0;
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        sample.values[AIRSHIFT_CHANNEL_CO2] = (int16_t)( 400 + i );
+
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_history_append( &sample, &record ) );
+        TEST_ASSERT_EQUAL( ESP_OK, airshift_outbox_push( &record ) );
+
+        first = ( i == 0 ) ? record.sequence : first;
+    }
+
+    return first;
+}
+
+static bool wait_drained()
+{
+    airshift_outbox_stats_t stats       = { 0 };
+    int64_t                 deadline    = esp_timer_get_time() + ( (int64_t)DRAIN_TIMEOUT_MS * 1000 );
+
+    do
+    {
+        vTaskDelay( pdMS_TO_TICKS( 100 ) );
+
+        airshift_outbox_get_stats( &stats );
+    }
+    while( ( stats.pending > 0 ) && ( esp_timer_get_time() < deadline ) );
+
+    return ( stats.pending == 0 );
+}
@@ -0,0 +1,273 @@
+// Senseair modbus framing, requests go out with their crc, replies are only taken whole, with a valid crc, echoing the function asked for ...
+#include "airshift_test.h"
+#include "airshift_senseair.h"
+#include "airshift_metrics.h"
+#include "airshift_host.h"
+
+#define UART_PORT               UART_NUM_1
+
+#define MODBUS_ADDRESS_ANY      0xfe
+#define MODBUS_READ_HOLDING     0x03
+#define MODBUS_READ_INPUT       0x04
+#define MODBUS_EXCEPTION        0x80
+#define MODBUS_ILLEGAL_ADDRESS  0x02
+#define MODBUS_REQUEST_SIZE     8
+#define MODBUS_RESPONSE_MAX     32
+
+#define ABC_PERIOD_HOURS        180
+#define CO2_PPM                 612
+
+typedef enum
+{
+    REPLY_REGISTERS,
+    REPLY_SPLIT,            // the same reply in two reads
+    REPLY_BAD_CRC,
+    REPLY_WRONG_FUNCTION,   // a valid reply to a different request
+    REPLY_WRONG_COUNT,      // byte count disagrees with the registers asked for
+    REPLY_EXCEPTION,
+    REPLY_NONE,
+} reply_t;
+
+// Forward declarations
+static void         test_abc_period_at_init();
+static void         test_request_framing();
+static void         test_split_reply();
+static void         test_crc_error();
+static void         test_wrong_function();
+static void         test_wrong_count();
+static void         test_exception();
+static void         test_timeout();
+static void         write( void *context, const uint8_t *data, size_t length );
+static uint16_t     crc16( const uint8_t *data, size_t length );
+
+static reply_t      reply_                          = REPLY_REGISTERS;
+static uint8_t      request_[MODBUS_REQUEST_SIZE]   = { 0 };
+
+// Public functions
+int main( int argc, char **argv )
+{
+    const host_uart_backend_t backend = { .context = NULL, .write = write };
+
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    ESP_ERROR_CHECK( host_uart_attach( UART_PORT, &backend ) );
+    ESP_ERROR_CHECK( airshift_senseair_init() );
+
+    TEST_RUN( test_abc_period_at_init );
+    TEST_RUN( test_request_framing );
+    TEST_RUN( test_split_reply );
+    TEST_RUN( test_crc_error );
+    TEST_RUN( test_wrong_function );
+    TEST_RUN( test_wrong_count );
+    TEST_RUN( test_exception );
+    TEST_RUN( test_timeout );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_abc_period_at_init()
+{
+    const uint8_t   expected[MODBUS_REQUEST_SIZE]   = { 0xfe, 0x03, 0x00, 0x1f, 0x00, 0x01, 0xa1, 0xc3 };
+    senseair_data_t data                            = { 0 };
+
+    // HR32 is read once by init and cached ...
+    TEST_ASSERT( memcmp( expected, request_, sizeof( expected ) ) == 0 );
+
+    reply_ = REPLY_REGISTERS;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( ABC_PERIOD_HOURS, data.abc_period );
+}
+
+static void test_request_framing()
+{
+    const uint8_t       expected[MODBUS_REQUEST_SIZE]   = { 0xfe, 0x04, 0x00, 0x00, 0x00, 0x04, 0xe5, 0xc6 };
+    senseair_data_t     data                            = { 0 };
+    senseair_stats_t    before                          = { 0 };
+    senseair_stats_t    after                           = { 0 };
+
+    reply_ = REPLY_REGISTERS;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &before ) );
+
+    // IR1 .. IR4 in one transaction, crc low byte first ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get( &data ) );
+    TEST_ASSERT( memcmp( expected, request_, sizeof( expected ) ) == 0 );
+    TEST_ASSERT_EQUAL( 0, data.meter_status );
+    TEST_ASSERT_EQUAL( 0x0102, data.alarm_status );
+    TEST_ASSERT_EQUAL( 0x0304, data.output_status );
+    TEST_ASSERT_EQUAL( CO2_PPM, data.co2 );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.transactions + 1, after.transactions );
+}
+
+static void test_split_reply()
+{
+    senseair_data_t data = { 0 };
+
+    reply_ = REPLY_SPLIT;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( CO2_PPM, data.co2 );
+}
+
+static void test_crc_error()
+{
+    senseair_data_t     data        = { 0 };
+    senseair_stats_t    before      = { 0 };
+    senseair_stats_t    after       = { 0 };
+    uint32_t            counted     = airshift_metrics_get_counter( AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS );
+
+    reply_ = REPLY_BAD_CRC;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &before ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_CRC, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &after ) );
+
+    TEST_ASSERT_EQUAL( before.crc_errors + 1, after.crc_errors );
+    TEST_ASSERT_EQUAL( before.transactions, after.transactions );
+    TEST_ASSERT_EQUAL( counted + 1, airshift_metrics_get_counter( AIRSHIFT_METRICS_COUNTER_UART_CRC_ERRORS ) );
+}
+
+static void test_wrong_function()
+{
+    senseair_data_t     data    = { 0 };
+    senseair_stats_t    before  = { 0 };
+    senseair_stats_t    after   = { 0 };
+
+    // a late reply to an abandoned holding register read has the right length and crc ...
+    reply_ = REPLY_WRONG_FUNCTION;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &before ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_RESPONSE, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &after ) );
+
+    TEST_ASSERT_EQUAL( before.transactions, after.transactions );
+    TEST_ASSERT_EQUAL( before.exceptions, after.exceptions );
+}
+
+static void test_wrong_count()
+{
+    senseair_data_t data = { 0 };
+
+    reply_ = REPLY_WRONG_COUNT;
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_SIZE, airshift_senseair_get( &data ) );
+}
+
+static void test_exception()
+{
+    senseair_data_t     data    = { 0 };
+    senseair_stats_t    before  = { 0 };
+    senseair_stats_t    after   = { 0 };
+
+    // ... an exception reply is shorter, it completes the transaction all the same ...
+    reply_ = REPLY_EXCEPTION;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &before ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_RESPONSE, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &after ) );
+
+    TEST_ASSERT_EQUAL( before.exceptions + 1, after.exceptions );
+}
+
+static void test_timeout()
+{
+    const uint8_t       late[3] = { MODBUS_ADDRESS_ANY, MODBUS_READ_INPUT, 0x08 };
+    senseair_data_t     data    = { 0 };
+    senseair_stats_t    before  = { 0 };
+    senseair_stats_t    after   = { 0 };
+
+    reply_ = REPLY_NONE;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &before ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_TIMEOUT, airshift_senseair_get( &data ) );
+
+    // bytes arriving after the transaction was given up on are dropped ...
+    host_uart_receive( UART_PORT, late, sizeof( late ) );
+    vTaskDelay( pdMS_TO_TICKS( 50 ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.timeouts + 1, after.timeouts );
+    TEST_ASSERT_EQUAL( before.bytes_discarded + sizeof( late ), after.bytes_discarded );
+
+    // ... and the next transaction starts clean ...
+    reply_ = REPLY_REGISTERS;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_senseair_get( &data ) );
+    TEST_ASSERT_EQUAL( CO2_PPM, data.co2 );
+}
+
+// The sensor, answers every request synchronously as reply_ says ...
+static void write( void *context, const uint8_t *data, size_t length )
+{
+    const uint16_t  registers[4]                    = { 0x0000, 0x0102, 0x0304, CO2_PPM };
+    uint8_t         response[MODBUS_RESPONSE_MAX]   = { 0 };
+    size_t          size                            = 0;
+    uint16_t        count                           = 0;
+    uint16_t        crc                             = 0;
+
+    TEST_ASSERT_EQUAL( MODBUS_REQUEST_SIZE, length );
+
+    memcpy( request_, data, sizeof( request_ ) );
+
+    if( reply_ == REPLY_NONE )
+    {
+        return;
+    }
+
+    count               = data[5];
+    response[size++]    = MODBUS_ADDRESS_ANY;
+
+    if( reply_ == REPLY_EXCEPTION )
+    {
+        response[size++] = data[1] | MODBUS_EXCEPTION;
+        response[size++] = MODBUS_ILLEGAL_ADDRESS;
+    }
+    else
+    {
+        response[size++] = ( reply_ == REPLY_WRONG_FUNCTION ) ? ( ( data[1] == MODBUS_READ_INPUT ) ? MODBUS_READ_HOLDING : MODBUS_READ_INPUT ) : data[1];
+        response[size++] = (uint8_t)( ( reply_ == REPLY_WRONG_COUNT ) ? ( 2 * count ) - 2 : 2 * count );
+
+        for( uint16_t i = 0; i < count; i++ )
+        {
+            uint16_t value = ( data[1] == MODBUS_READ_HOLDING ) ? ABC_PERIOD_HOURS : registers[i % 4];
+
+            response[size++] = (uint8_t)( value >> 8 );
+            response[size++] = (uint8_t)value;
+        }
+    }
+
+    crc                 = crc16( response, size ) ^ ( ( reply_ == REPLY_BAD_CRC ) ? 0x0001 : 0x0000 );
+    response[size++]    = (uint8_t)crc;
+    response[size++]    = (uint8_t)( crc >> 8 );
+
+    if( reply_ != REPLY_SPLIT )
+    {
+        host_uart_receive( UART_PORT, response, size );
+
+        return;
+    }
+
+    host_uart_receive( UART_PORT, response, 2 );
+    host_uart_receive( UART_PORT, &response[2], size - 2 );
+}
+
+static uint16_t crc16( const uint8_t *data, size_t length )
+{
+    uint16_t crc = 0xffff;
+
+    for( size_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+
+        for( int j = 0; j < 8; j++ )
+        {
+            crc = ( crc & 0x0001 ) ? ( ( crc >> 1 ) ^ 0xa001 ) : ( crc >> 1 );
+        }
+    }
+
+    return crc;
+}
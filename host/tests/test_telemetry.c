@@ -0,0 +1,207 @@
+// Telemetry encoding, json and cbor carry the same keys, channels without a reading are left out ...
+#include "airshift_test.h"
+#include "airshift_telemetry.h"
+#include "airshift_event.h"
+#include "airshift_mqtt.h"
+
+#define MESSAGE_SIZE    256
+
+// Forward declarations
+static void     test_json_record();
+static void     test_json_batch();
+static void     test_cbor_record();
+static void     test_cbor_batch();
+static void     test_buffer_too_small();
+static void     test_invalid_arguments();
+static void     test_publish();
+static void     make_record( uint32_t sequence, airshift_history_record_t *record );
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    ESP_ERROR_CHECK( airshift_event_init() );
+    ESP_ERROR_CHECK( airshift_mqtt_init() );
+    ESP_ERROR_CHECK( airshift_telemetry_init() );
+
+    TEST_RUN( test_json_record );
+    TEST_RUN( test_json_batch );
+    TEST_RUN( test_cbor_record );
+    TEST_RUN( test_cbor_batch );
+    TEST_RUN( test_buffer_too_small );
+    TEST_RUN( test_invalid_arguments );
+    TEST_RUN( test_publish );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_json_record()
+{
+    airshift_history_record_t   record                  = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      length                  = 0;
+
+    make_record( 7, &record );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_JSON );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( &record, 1, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL_STRING( "{\"seq\":7,\"ts\":1700000000,\"utc\":true,\"co2\":612,\"temp\":-50}", (const char *)message );
+    TEST_ASSERT_EQUAL( strlen( (const char *)message ), length );
+
+    // ... no utc yet, the timestamp is seconds since boot ...
+    record.flags &= ~AIRSHIFT_HISTORY_FLAG_UTC;
+    record.flags &= ~AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_TEMPERATURE );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( &record, 1, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL_STRING( "{\"seq\":7,\"ts\":1700000000,\"utc\":false,\"co2\":612}", (const char *)message );
+}
+
+static void test_json_batch()
+{
+    airshift_history_record_t   records[2]              = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      length                  = 0;
+
+    make_record( 7, &records[0] );
+    make_record( 8, &records[1] );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_JSON );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( records, 2, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( '[', message[0] );
+    TEST_ASSERT_EQUAL( ']', message[length - 1] );
+
+    message[length] = '\0';
+
+    TEST_ASSERT_EQUAL_STRING( "[{\"seq\":7,\"ts\":1700000000,\"utc\":true,\"co2\":612,\"temp\":-50},{\"seq\":8,\"ts\":1700000000,\"utc\":true,\"co2\":612,\"temp\":-50}]", (const char *)message );
+}
+
+static void test_cbor_record()
+{
+    airshift_history_record_t   record                  = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      length                  = 0;
+
+    // { "seq": 7, "ts": 1700000000, "utc": true, "co2": 612, "temp": -50 } ...
+    const uint8_t expected[] =
+    {
+        0xA5,
+        0x63, 's', 'e', 'q',        0x07,
+        0x62, 't', 's',             0x1A, 0x65, 0x53, 0xF1, 0x00,
+        0x63, 'u', 't', 'c',        0xF5,
+        0x63, 'c', 'o', '2',        0x19, 0x02, 0x64,
+        0x64, 't', 'e', 'm', 'p',   0x38, 0x31,
+    };
+
+    make_record( 7, &record );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_CBOR );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( &record, 1, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( sizeof( expected ), length );
+    TEST_ASSERT( memcmp( expected, message, sizeof( expected ) ) == 0 );
+}
+
+static void test_cbor_batch()
+{
+    airshift_history_record_t   records[3]              = { 0 };
+    uint8_t                     single[MESSAGE_SIZE]    = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      single_length           = 0;
+    size_t                      length                  = 0;
+
+    make_record( 7, &records[0] );
+    make_record( 8, &records[1] );
+    make_record( 9, &records[2] );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_CBOR );
+
+    // a definite length array of the same maps ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( &records[2], 1, single, sizeof( single ), &single_length ) );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_encode( records, 3, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( 0x83, message[0] );
+    TEST_ASSERT_EQUAL( 1 + ( 3 * single_length ), length );
+    TEST_ASSERT( memcmp( single, &message[1 + ( 2 * single_length )], single_length ) == 0 );
+}
+
+static void test_buffer_too_small()
+{
+    airshift_history_record_t   records[2]              = { 0 };
+    airshift_telemetry_stats_t  before                  = { 0 };
+    airshift_telemetry_stats_t  after                   = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      length                  = 0;
+
+    make_record( 7, &records[0] );
+    make_record( 8, &records[1] );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_get_stats( &before ) );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_JSON );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_NO_MEM, airshift_telemetry_encode( records, 1, message, 20, &length ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_NO_MEM, airshift_telemetry_encode( records, 2, message, 70, &length ) );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_CBOR );
+
+    TEST_ASSERT_EQUAL( ESP_ERR_NO_MEM, airshift_telemetry_encode( records, 1, message, 20, &length ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_NO_MEM, airshift_telemetry_encode( records, 2, message, 40, &length ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.encode_errors + 4, after.encode_errors );
+}
+
+static void test_invalid_arguments()
+{
+    airshift_history_record_t   record                  = { 0 };
+    uint8_t                     message[MESSAGE_SIZE]   = { 0 };
+    size_t                      length                  = 0;
+
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_telemetry_encode( NULL, 1, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_telemetry_encode( &record, 0, message, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_telemetry_encode( &record, 1, NULL, sizeof( message ), &length ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_telemetry_encode( &record, 1, message, sizeof( message ), NULL ) );
+}
+
+static void test_publish()
+{
+    airshift_history_record_t   record  = { 0 };
+    airshift_telemetry_stats_t  before  = { 0 };
+    airshift_telemetry_stats_t  after   = { 0 };
+    airshift_mqtt_stats_t       mqtt    = { 0 };
+
+    make_record( 7, &record );
+
+    airshift_telemetry_set_format( AIRSHIFT_TELEMETRY_FORMAT_CBOR );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_get_stats( &before ) );
+
+    // no broker, counted as a publish error ...
+    TEST_ASSERT( airshift_telemetry_publish( &record ) != ESP_OK );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_start() );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_publish( &record ) );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_telemetry_get_stats( &after ) );
+    TEST_ASSERT_EQUAL( before.publish_errors + 1, after.publish_errors );
+    TEST_ASSERT_EQUAL( before.messages + 1, after.messages );
+    TEST_ASSERT_EQUAL( before.bytes + 33, after.bytes );
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_mqtt_get_stats( &mqtt ) );
+    TEST_ASSERT_EQUAL( 33, mqtt.payload_bytes );
+}
+
+// Co2 and a negative temperature, utc time ...
+static void make_record( uint32_t sequence, airshift_history_record_t *record )
+{
+    memset( record, 0, sizeof( airshift_history_record_t ) );
+
+    record->sequence                                = sequence;
+    record->timestamp                               = 1700000000;
+    record->flags                                   = AIRSHIFT_HISTORY_FLAG_UTC | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_CO2 ) | AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_TEMPERATURE );
+    record->values[AIRSHIFT_CHANNEL_CO2]            = 612;
+    record->values[AIRSHIFT_CHANNEL_TEMPERATURE]    = -50;
+}
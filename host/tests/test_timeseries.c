@@ -0,0 +1,256 @@
+// Time series, every tier aggregates the raw samples into its own buckets, queries return closed buckets oldest first and the
+// summary reads the finest tier that covers its window ...
+#include "airshift_test.h"
+#include "airshift_timeseries.h"
+#include "airshift_host.h"
+
+#include <esp_console.h>
+
+#define SECOND_US       ( 1000LL * 1000 )
+#define MINUTE_S        60
+#define HOUR_S          ( 60 * 60 )
+
+#define SECOND_CAPACITY 300
+#define MINUTE_CAPACITY 180
+
+// Forward declarations
+static void test_second_tier();
+static void test_minute_tier();
+static void test_hour_tier();
+static void test_gaps_and_late_samples();
+static void test_query_latest();
+static void test_summary();
+static void test_console();
+static void reset();
+static void push( int64_t second, int16_t co2 );
+
+// Public functions
+int main( int argc, char **argv )
+{
+    esp_log_level_set( "*", ESP_LOG_NONE );
+
+    ESP_ERROR_CHECK( airshift_timeseries_register_console() );
+
+    TEST_RUN( test_second_tier );
+    TEST_RUN( test_minute_tier );
+    TEST_RUN( test_hour_tier );
+    TEST_RUN( test_gaps_and_late_samples );
+    TEST_RUN( test_query_latest );
+    TEST_RUN( test_summary );
+    TEST_RUN( test_console );
+
+    return TEST_RESULT();
+}
+
+// Private functions
+static void test_second_tier()
+{
+    airshift_timeseries_point_t points[16]  = { 0 };
+    int64_t                     start       = -1;
+
+    reset();
+
+    for( int64_t i = 0; i < 10; i++ )
+    {
+        push( i, (int16_t)( 400 + i ) );
+    }
+
+    // the bucket being accumulated is not returned until a later sample closes it ...
+    TEST_ASSERT_EQUAL( 9, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_CO2, points, 16, &start ) );
+
+    push( 10, 410 );
+
+    TEST_ASSERT_EQUAL( 10, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_CO2, points, 16, &start ) );
+    TEST_ASSERT_EQUAL( 0, start );
+
+    for( int i = 0; i < 10; i++ )
+    {
+        TEST_ASSERT_EQUAL( 400 + i, points[i].min );
+        TEST_ASSERT_EQUAL( 400 + i, points[i].mean );
+        TEST_ASSERT_EQUAL( 400 + i, points[i].max );
+    }
+
+    // ... a channel nobody reported into holds gaps ...
+    TEST_ASSERT_EQUAL( 10, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_TEMPERATURE, points, 16, NULL ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_VALUE_INVALID, points[0].mean );
+    TEST_ASSERT_EQUAL( AIRSHIFT_VALUE_INVALID, points[9].min );
+}
+
+static void test_minute_tier()
+{
+    airshift_timeseries_point_t points[4]   = { 0 };
+    int64_t                     start       = -1;
+
+    reset();
+
+    // two minutes of a ramp, each minute bucket is min / mean / max of its 60 samples ...
+    for( int64_t i = 0; i <= 2 * MINUTE_S; i++ )
+    {
+        push( i, (int16_t)i );
+    }
+
+    TEST_ASSERT_EQUAL( 2, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_MINUTE, AIRSHIFT_CHANNEL_CO2, points, 4, &start ) );
+    TEST_ASSERT_EQUAL( 0, start );
+
+    TEST_ASSERT_EQUAL( 0, points[0].min );
+    TEST_ASSERT_EQUAL( 30, points[0].mean );
+    TEST_ASSERT_EQUAL( 59, points[0].max );
+
+    TEST_ASSERT_EQUAL( 60, points[1].min );
+    TEST_ASSERT_EQUAL( 90, points[1].mean );
+    TEST_ASSERT_EQUAL( 119, points[1].max );
+
+    // ... the hour is still open ...
+    TEST_ASSERT_EQUAL( 0, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_HOUR, AIRSHIFT_CHANNEL_CO2, points, 4, NULL ) );
+}
+
+static void test_hour_tier()
+{
+    airshift_timeseries_point_t points[4]   = { 0 };
+    airshift_timeseries_info_t  info        = { 0 };
+    int64_t                     start       = -1;
+
+    reset();
+
+    // a sample a minute for three hours, one level per hour ...
+    for( int64_t i = 0; i <= 3 * HOUR_S; i += MINUTE_S )
+    {
+        push( i, (int16_t)( 500 + ( 100 * ( i / HOUR_S ) ) ) );
+    }
+
+    TEST_ASSERT_EQUAL( 3, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_HOUR, AIRSHIFT_CHANNEL_CO2, points, 4, &start ) );
+    TEST_ASSERT_EQUAL( 0, start );
+    TEST_ASSERT_EQUAL( 500, points[0].mean );
+    TEST_ASSERT_EQUAL( 600, points[1].mean );
+    TEST_ASSERT_EQUAL( 700, points[2].mean );
+    TEST_ASSERT_EQUAL( 700, points[2].min );
+
+    // ... the minute tier is full, the second tier kept the last five minutes, mostly gaps ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_get_info( AIRSHIFT_TIMESERIES_TIER_MINUTE, &info ) );
+    TEST_ASSERT_EQUAL( MINUTE_CAPACITY, info.count );
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_get_info( AIRSHIFT_TIMESERIES_TIER_SECOND, &info ) );
+    TEST_ASSERT_EQUAL( SECOND_CAPACITY, info.count );
+}
+
+static void test_gaps_and_late_samples()
+{
+    airshift_timeseries_point_t points[8]   = { 0 };
+
+    reset();
+
+    push( 0, 400 );
+    push( 5, 450 );
+
+    // the seconds nobody reported into are stored as gaps ...
+    TEST_ASSERT_EQUAL( 5, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_CO2, points, 8, NULL ) );
+    TEST_ASSERT_EQUAL( 400, points[0].mean );
+
+    for( int i = 1; i < 5; i++ )
+    {
+        TEST_ASSERT_EQUAL( AIRSHIFT_VALUE_INVALID, points[i].mean );
+    }
+
+    // ... a sample for a bucket already closed is dropped ...
+    push( 2, 999 );
+    push( 6, 460 );
+
+    TEST_ASSERT_EQUAL( 6, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_CO2, points, 8, NULL ) );
+    TEST_ASSERT_EQUAL( AIRSHIFT_VALUE_INVALID, points[2].mean );
+    TEST_ASSERT_EQUAL( 450, points[5].mean );
+}
+
+static void test_query_latest()
+{
+    airshift_timeseries_point_t points[10]  = { 0 };
+    int64_t                     start       = -1;
+
+    reset();
+
+    // past the ring's capacity, the oldest buckets were overwritten ...
+    for( int64_t i = 0; i <= 400; i++ )
+    {
+        push( i, (int16_t)i );
+    }
+
+    TEST_ASSERT_EQUAL( 10, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_CO2, points, 10, &start ) );
+    TEST_ASSERT_EQUAL( 390 * SECOND_US, start );
+    TEST_ASSERT_EQUAL( 390, points[0].mean );
+    TEST_ASSERT_EQUAL( 399, points[9].mean );
+
+    // ... and never more than it holds ...
+    TEST_ASSERT_EQUAL( 0, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_COUNT, AIRSHIFT_CHANNEL_CO2, points, 10, NULL ) );
+    TEST_ASSERT_EQUAL( 0, airshift_timeseries_query( AIRSHIFT_TIMESERIES_TIER_SECOND, AIRSHIFT_CHANNEL_COUNT, points, 10, NULL ) );
+}
+
+static void test_summary()
+{
+    airshift_timeseries_point_t summary = { 0 };
+
+    reset();
+
+    // ten minutes of a sawtooth, every minute the same 400 .. 459 ...
+    for( int64_t i = 0; i <= 10 * MINUTE_S; i++ )
+    {
+        push( i, (int16_t)( 400 + ( i % MINUTE_S ) ) );
+    }
+
+    // ... the last minute, from the second tier ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_summary( AIRSHIFT_CHANNEL_CO2, MINUTE_S, &summary ) );
+    TEST_ASSERT_EQUAL( 400, summary.min );
+    TEST_ASSERT_EQUAL( 430, summary.mean );
+    TEST_ASSERT_EQUAL( 459, summary.max );
+
+    // ... ten minutes is past the second tier, from the minute tier, same answer ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_summary( AIRSHIFT_CHANNEL_CO2, 10 * MINUTE_S, &summary ) );
+    TEST_ASSERT_EQUAL( 400, summary.min );
+    TEST_ASSERT_EQUAL( 430, summary.mean );
+    TEST_ASSERT_EQUAL( 459, summary.max );
+
+    // ... the last 5 seconds only ...
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_summary( AIRSHIFT_CHANNEL_CO2, 5, &summary ) );
+    TEST_ASSERT_EQUAL( 455, summary.min );
+    TEST_ASSERT_EQUAL( 457, summary.mean );
+    TEST_ASSERT_EQUAL( 459, summary.max );
+
+    // ... nothing to summarize ...
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_timeseries_summary( AIRSHIFT_CHANNEL_TEMPERATURE, MINUTE_S, &summary ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_NOT_FOUND, airshift_timeseries_summary( AIRSHIFT_CHANNEL_CO2, 24 * HOUR_S, &summary ) );
+    TEST_ASSERT_EQUAL( ESP_ERR_INVALID_ARG, airshift_timeseries_summary( AIRSHIFT_CHANNEL_COUNT, MINUTE_S, &summary ) );
+}
+
+static void test_console()
+{
+    int result = -1;
+
+    reset();
+
+    for( int64_t i = 0; i <= 2 * MINUTE_S; i++ )
+    {
+        push( i, (int16_t)( 400 + i ) );
+    }
+
+    TEST_ASSERT_EQUAL( ESP_OK, host_console_run( "timeseries", &result ) );
+    TEST_ASSERT_EQUAL( 0, result );
+
+    TEST_ASSERT_EQUAL( ESP_OK, host_console_run( "timeseries co2 minute 2", &result ) );
+    TEST_ASSERT_EQUAL( 0, result );
+
+    TEST_ASSERT_EQUAL( ESP_OK, host_console_run( "timeseries radon", &result ) );
+    TEST_ASSERT_EQUAL( 1, result );
+}
+
+static void reset()
+{
+    airshift_timeseries_release();
+
+    ESP_ERROR_CHECK( airshift_timeseries_init() );
+}
+
+static void push( int64_t second, int16_t co2 )
+{
+    airshift_sample_t sample = { .timestamp = second * SECOND_US, .valid_mask = AIRSHIFT_CHANNEL_BIT( AIRSHIFT_CHANNEL_CO2 ) };
+
+    sample.values[AIRSHIFT_CHANNEL_CO2] = co2;
+
+    TEST_ASSERT_EQUAL( ESP_OK, airshift_timeseries_push( &sample ) );
+}
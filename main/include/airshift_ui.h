@@ -2,20 +2,38 @@
 #define AIRSHIFT_UI_COMMON_H
 
 #include "airshift_header_common.h"
+#include "airshift_air_quality.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct
+{
+    uint32_t    wakeups;            // lvgl task iterations, timer deadlines and published changes
+    uint32_t    commits;            // refreshes that had at least one published change
+    uint32_t    fields_applied;
+    uint32_t    fields_unchanged;   // published, but what is on screen already matched
+    uint32_t    renders;            // frames lvgl actually redrew
+    uint64_t    invalidated_pixels;
+    uint32_t    invalidated_max;    // pixels, one frame
+    int64_t     render_time_max;    // us, one frame
+} airshift_ui_stats_t;
+
+// Starts the lvgl task, call after airshift_display_init, from then on nothing else may call into lvgl ...
 esp_err_t   airshift_ui_init();
 esp_err_t   airshift_ui_release();
 
-esp_err_t   airshift_ui_display_qrcode();
+// Any task, these only publish into the view-model and wake the lvgl task, they never touch lvgl ...
+esp_err_t   airshift_ui_display_qrcode( const char *payload );
 esp_err_t   airshift_ui_display_main();
 
 void        airshift_ui_set_co2( uint16_t value );
 void        airshift_ui_set_temperature( float value );
 void        airshift_ui_set_particulate_matter( uint16_t value );
+void        airshift_ui_set_air_quality( airshift_air_quality_t quality );
+
+esp_err_t   airshift_ui_get_stats( airshift_ui_stats_t *stats );
 
 #ifdef __cplusplus
 }
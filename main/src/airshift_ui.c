@@ -1,46 +1,153 @@
 #include "airshift_ui.h"
+#include "airshift_assets.h"
 #include "airshift_display.h"
+#include "airshift_metrics.h"
+#include "airshift_power.h"
+#include "airshift_trace.h"
 
-LV_IMG_DECLARE( qrcode )
+#include <esp_timer.h>
+#include <stdatomic.h>
+
+#define CO2_FULL_SCALE      2500    // ppm, unhealthy, the arc is full
+
+#define QRCODE_SIZE         150     // px, 6 px a module for a version 2 code, the corners stay inside the round screen
+#define QRCODE_PAYLOAD_SIZE 64
+
+#define LVGL_TASK_STACK_SIZE    6144
+#define LVGL_TASK_PRIORITY      4
+
+typedef enum
+{
+    FIELD_SCREEN,
+    FIELD_QRCODE,       // payload_ sequence number, the payload itself does not fit a field
+    FIELD_CO2,
+    FIELD_TEMPERATURE,
+    FIELD_PARTICULATE_MATTER,
+    FIELD_AIR_QUALITY,
+    FIELD_COUNT
+} field_t;
+
+#define FIELD_BIT( field )  ( 1UL << ( field ) )
+#define FIELD_VALUES        ( FIELD_BIT( FIELD_CO2 ) | FIELD_BIT( FIELD_TEMPERATURE ) | FIELD_BIT( FIELD_PARTICULATE_MATTER ) | FIELD_BIT( FIELD_AIR_QUALITY ) )
+
+typedef enum
+{
+    SCREEN_NONE,
+    SCREEN_QRCODE,
+    SCREEN_MAIN
+} screen_t;
 
 static const char* TAG = "airshift_ui";
 
-// Forward declarations
+// the co2 arc takes the colour of the fused air quality, unknown keeps the colour it is built with ...
+static const uint32_t air_quality_colors_[AIRSHIFT_AIR_QUALITY_COUNT] =
+{
+    [AIRSHIFT_AIR_QUALITY_UNKNOWN]          = 0x36B9F6,
+    [AIRSHIFT_AIR_QUALITY_GOOD]             = 0x2ECC71,
+    [AIRSHIFT_AIR_QUALITY_FAIR]             = 0x9BD34A,
+    [AIRSHIFT_AIR_QUALITY_MODERATE]         = 0xF1C40F,
+    [AIRSHIFT_AIR_QUALITY_POOR]             = 0xE67E22,
+    [AIRSHIFT_AIR_QUALITY_VERY_POOR]        = 0xE74C3C,
+    [AIRSHIFT_AIR_QUALITY_EXTREMELY_POOR]   = 0x8E44AD,
+};
 
-static lv_obj_t *arc_co2_           = NULL;
-static lv_obj_t *label_co2_value_   = NULL;
-static lv_obj_t *label_temp_        = NULL;
-static lv_obj_t *label_pm_          = NULL;
+// Forward declarations
+static void         lvgl_task( void *arguments );
+static uint32_t     refresh();
+static void         publish( field_t field, uint32_t value );
+static uint32_t     apply( uint32_t dirty );
+static bool         set_label_text( lv_obj_t *label, const char *text );
+static void         build_qrcode();
+static void         build_main();
+static void         monitor_callback( lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px );
+
+// view-model, written by any task, a set bit in dirty_ means the field holds something the lvgl task has not looked at yet ...
+static _Atomic uint32_t     values_[FIELD_COUNT]    = { 0 };
+static _Atomic uint32_t     dirty_                  = 0;
+static TaskHandle_t         lvgl_task_              = NULL;
+
+// lvgl task only ...
+static screen_t             screen_             = SCREEN_NONE;
+static uint32_t             seen_               = 0;    // fields published at least once
+static uint32_t             invalidated_        = 0;    // pixels redrawn by the current lv_task_handler call
+static lv_obj_t             *qrcode_            = NULL;
+static lv_obj_t             *arc_co2_           = NULL;
+static lv_obj_t             *label_co2_value_   = NULL;
+static lv_obj_t             *label_temp_        = NULL;
+static lv_obj_t             *label_pm_          = NULL;
+static uint32_t             air_quality_        = AIRSHIFT_AIR_QUALITY_UNKNOWN;     // what the arc shows
+
+static portMUX_TYPE         lock_               = portMUX_INITIALIZER_UNLOCKED;
+static airshift_ui_stats_t  stats_              = { 0 };
+static char                 payload_[QRCODE_PAYLOAD_SIZE]   = { 0 };
+static uint32_t             payload_sequence_   = 0;
 
 // Public functions
 esp_err_t airshift_ui_init()
 {
+    esp_err_t   ret     = ESP_FAIL;
+    lv_disp_t   *disp   = lv_disp_get_default();
+
     ESP_LOGI( TAG, "airshift_ui_init" );
 
+    memset( &stats_, 0, sizeof( stats_ ) );
+
+    // lvgl reports the pixels of every frame it redraws ...
+    if( disp != NULL )
+    {
+        disp->driver->monitor_cb = monitor_callback;
+    }
+
+    ESP_GOTO_ON_FALSE( ( xTaskCreate( lvgl_task, "lvgl", LVGL_TASK_STACK_SIZE, NULL, LVGL_TASK_PRIORITY, &lvgl_task_ ) == pdPASS ), ESP_ERR_NO_MEM, error, TAG, "xTaskCreate -> lvgl failed" );
+
     return ESP_OK;
+
+error:
+
+    ESP_LOGE( TAG, "airshift_ui_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+    return ret;
 }
 
 esp_err_t airshift_ui_release()
 {
+    lv_disp_t *disp = lv_disp_get_default();
+
     ESP_LOGI( TAG, "airshift_ui_release" );
 
+    if( lvgl_task_ != NULL )
+    {
+        vTaskDelete( lvgl_task_ );
+
+        lvgl_task_ = NULL;
+    }
+
+    if( disp != NULL )
+    {
+        disp->driver->monitor_cb = NULL;
+    }
+
     return ESP_OK;
 }
 
-esp_err_t airshift_ui_display_qrcode()
+esp_err_t airshift_ui_display_qrcode( const char *payload )
 {
-    lv_obj_t *image = NULL;
+    uint32_t sequence = 0;
 
-    ESP_LOGI( TAG, "airshift_ui_display_qrcode" );
+    ESP_RETURN_ON_FALSE( ( ( payload != NULL ) && ( strlen( payload ) < QRCODE_PAYLOAD_SIZE ) ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
 
-    lv_obj_set_style_bg_opa( lv_scr_act(), LV_OPA_100, LV_PART_MAIN );
-    lv_obj_set_style_bg_color( lv_scr_act(), lv_color_white(), LV_PART_MAIN );
-    
-    image = lv_img_create( lv_scr_act() );
+    ESP_LOGI( TAG, "airshift_ui_display_qrcode -> %s", payload );
+
+    portENTER_CRITICAL( &lock_ );
+
+    strcpy( payload_, payload );
+
+    sequence = ++payload_sequence_;
 
-    lv_img_set_src( image, &qrcode );
+    portEXIT_CRITICAL( &lock_ );
 
-    lv_obj_center( image );
+    publish( FIELD_QRCODE, sequence );
+    publish( FIELD_SCREEN, SCREEN_QRCODE );
 
     return ESP_OK;
 }
@@ -49,6 +156,296 @@ esp_err_t airshift_ui_display_main()
 {
     ESP_LOGI( TAG, "airshift_ui_display_main" );
 
+    publish( FIELD_SCREEN, SCREEN_MAIN );
+
+    return ESP_OK;
+}
+
+void airshift_ui_set_co2( uint16_t value )
+{
+    publish( FIELD_CO2, value );
+}
+
+void airshift_ui_set_temperature( float value )
+{
+    uint32_t bits = 0;
+
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    publish( FIELD_TEMPERATURE, bits );
+}
+
+void airshift_ui_set_particulate_matter( uint16_t value )
+{
+    publish( FIELD_PARTICULATE_MATTER, value );
+}
+
+void airshift_ui_set_air_quality( airshift_air_quality_t quality )
+{
+    publish( FIELD_AIR_QUALITY, ( quality < AIRSHIFT_AIR_QUALITY_COUNT ) ? quality : AIRSHIFT_AIR_QUALITY_UNKNOWN );
+}
+
+esp_err_t airshift_ui_get_stats( airshift_ui_stats_t *stats )
+{
+    ESP_RETURN_ON_FALSE( ( stats != NULL ), ESP_ERR_INVALID_ARG, TAG, "invalid arguments" );
+
+    portENTER_CRITICAL( &lock_ );
+
+    *stats = stats_;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return ESP_OK;
+}
+
+// Private functions
+static void lvgl_task( void *arguments )
+{
+    uint32_t next = 0;
+
+    while( true )
+    {
+        next = refresh();
+
+        // asleep until lvgl's next timer is due, rounded up so it never wakes early and spins, or until something is published ...
+        ulTaskNotifyTake( pdTRUE, ( next == LV_NO_TIMER_READY ) ? portMAX_DELAY : ( ( next + portTICK_PERIOD_MS - 1 ) / portTICK_PERIOD_MS ) );
+    }
+}
+
+static uint32_t refresh()
+{
+    uint32_t    dirty       = atomic_exchange_explicit( &dirty_, 0, memory_order_acquire );
+    uint32_t    applied     = 0;
+    uint32_t    next        = 0;
+    int64_t     started     = 0;
+    int64_t     elapsed     = 0;
+
+    // render at full speed, the sooner the frame is out the sooner the chip sleeps again, the spi driver holds its own lock for the dma ...
+    airshift_power_lock( AIRSHIFT_POWER_LOCK_DISPLAY );
+
+    if( dirty != 0 )
+    {
+        applied = apply( dirty );
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.wakeups++;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    invalidated_    = 0;
+    started         = esp_timer_get_time();
+
+    next = lv_task_handler();
+
+    airshift_power_unlock( AIRSHIFT_POWER_LOCK_DISPLAY );
+
+    // a call that only ran timers and drew nothing is not a render ...
+    if( invalidated_ == 0 )
+    {
+        return next;
+    }
+
+    elapsed = esp_timer_get_time() - started;
+
+    airshift_metrics_record( AIRSHIFT_METRICS_STAGE_UI_RENDER, elapsed );
+
+    AIRSHIFT_TRACED( TAG, "refresh -> dirty: 0x%lx, applied: %lu, invalidated: %lu px, render: %lld us", dirty, applied, invalidated_, elapsed );
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.renders++;
+    stats_.invalidated_pixels  += invalidated_;
+    stats_.invalidated_max      = ( invalidated_ > stats_.invalidated_max ) ? invalidated_ : stats_.invalidated_max;
+    stats_.render_time_max      = ( elapsed > stats_.render_time_max ) ? elapsed : stats_.render_time_max;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return next;
+}
+
+static void publish( field_t field, uint32_t value )
+{
+    // value first, the release on the dirty bit makes it visible to whoever clears the bit ...
+    atomic_store_explicit( &values_[field], value, memory_order_relaxed );
+
+    // only the first change since the last refresh has to wake the lvgl task ...
+    if( ( atomic_fetch_or_explicit( &dirty_, FIELD_BIT( field ), memory_order_release ) == 0 ) && ( lvgl_task_ != NULL ) )
+    {
+        xTaskNotifyGive( lvgl_task_ );
+    }
+}
+
+static uint32_t apply( uint32_t dirty )
+{
+    char        label_text[16]                  = { 0 };
+    char        payload[QRCODE_PAYLOAD_SIZE]    = { 0 };
+    uint32_t    applied                         = 0;
+    uint32_t    unchanged                       = 0;
+    uint32_t    value                           = 0;
+    float       temperature                     = 0.0f;
+    int16_t     percentage                      = 0;
+    bool        changed                         = false;
+
+    seen_ |= dirty;
+
+    if( ( dirty & FIELD_BIT( FIELD_SCREEN ) ) && ( atomic_load_explicit( &values_[FIELD_SCREEN], memory_order_relaxed ) != screen_ ) )
+    {
+        screen_ = atomic_load_explicit( &values_[FIELD_SCREEN], memory_order_relaxed );
+
+        // the old widgets go with the old screen ...
+        lv_obj_clean( lv_scr_act() );
+
+        qrcode_             = NULL;
+        arc_co2_            = NULL;
+        label_co2_value_    = NULL;
+        label_temp_         = NULL;
+        label_pm_           = NULL;
+        air_quality_        = AIRSHIFT_AIR_QUALITY_UNKNOWN;
+
+        if( screen_ == SCREEN_QRCODE )
+        {
+            build_qrcode();
+
+            // a fresh canvas, the last published payload goes onto it ...
+            dirty |= ( seen_ & FIELD_BIT( FIELD_QRCODE ) );
+        }
+        else if( screen_ == SCREEN_MAIN )
+        {
+            build_main();
+
+            // fresh widgets, everything published so far goes onto them ...
+            dirty |= ( seen_ & FIELD_VALUES );
+        }
+
+        applied++;
+    }
+
+    // encoded here rather than stored as an image, a version 2 code at 1 bit per pixel is a few kB of lvgl heap ...
+    if( ( screen_ == SCREEN_QRCODE ) && ( dirty & FIELD_BIT( FIELD_QRCODE ) ) )
+    {
+        portENTER_CRITICAL( &lock_ );
+
+        memcpy( payload, payload_, sizeof( payload ) );
+
+        portEXIT_CRITICAL( &lock_ );
+
+        if( lv_qrcode_update( qrcode_, payload, strlen( payload ) ) != LV_RES_OK )
+        {
+            ESP_LOGE( TAG, "lv_qrcode_update failed: %s", payload );
+        }
+
+        applied++;
+    }
+
+    // values published while another screen is up stay in values_ until the main screen is built ...
+    if( screen_ == SCREEN_MAIN )
+    {
+        if( dirty & FIELD_BIT( FIELD_CO2 ) )
+        {
+            value       = atomic_load_explicit( &values_[FIELD_CO2], memory_order_relaxed );
+            percentage  = (int16_t)( ( (float)value / (float)CO2_FULL_SCALE ) * 100.0f );
+
+            // the arc clamps to its range, an unclamped percentage would never compare equal and redraw every time ...
+            percentage  = ( percentage > 100 ) ? 100 : ( ( percentage < 0 ) ? 0 : percentage );
+
+            snprintf( label_text, sizeof( label_text ), "%hu", (uint16_t)value );
+
+            changed = set_label_text( label_co2_value_, label_text );
+
+            if( lv_arc_get_value( arc_co2_ ) != percentage )
+            {
+                lv_arc_set_value( arc_co2_, percentage );
+
+                changed = true;
+            }
+
+            applied     += ( changed == true ) ? 1 : 0;
+            unchanged   += ( changed == true ) ? 0 : 1;
+        }
+
+        if( dirty & FIELD_BIT( FIELD_TEMPERATURE ) )
+        {
+            value = atomic_load_explicit( &values_[FIELD_TEMPERATURE], memory_order_relaxed );
+
+            memcpy( &temperature, &value, sizeof( temperature ) );
+
+            snprintf( label_text, sizeof( label_text ), "T: %.0f C", temperature );
+
+            changed = set_label_text( label_temp_, label_text );
+
+            applied     += ( changed == true ) ? 1 : 0;
+            unchanged   += ( changed == true ) ? 0 : 1;
+        }
+
+        if( dirty & FIELD_BIT( FIELD_PARTICULATE_MATTER ) )
+        {
+            value = atomic_load_explicit( &values_[FIELD_PARTICULATE_MATTER], memory_order_relaxed );
+
+            snprintf( label_text, sizeof( label_text ), "PM: %hu", (uint16_t)value );
+
+            changed = set_label_text( label_pm_, label_text );
+
+            applied     += ( changed == true ) ? 1 : 0;
+            unchanged   += ( changed == true ) ? 0 : 1;
+        }
+
+        if( dirty & FIELD_BIT( FIELD_AIR_QUALITY ) )
+        {
+            value   = atomic_load_explicit( &values_[FIELD_AIR_QUALITY], memory_order_relaxed );
+            changed = ( value != air_quality_ );
+
+            if( changed == true )
+            {
+                air_quality_ = value;
+
+                lv_obj_set_style_arc_color( arc_co2_, lv_color_hex( air_quality_colors_[value] ), LV_PART_INDICATOR | LV_STATE_DEFAULT );
+            }
+
+            applied     += ( changed == true ) ? 1 : 0;
+            unchanged   += ( changed == true ) ? 0 : 1;
+        }
+    }
+
+    portENTER_CRITICAL( &lock_ );
+
+    stats_.commits++;
+    stats_.fields_applied      += applied;
+    stats_.fields_unchanged    += unchanged;
+
+    portEXIT_CRITICAL( &lock_ );
+
+    return applied;
+}
+
+static bool set_label_text( lv_obj_t *label, const char *text )
+{
+    // lv_label_set_text invalidates even when the text is the same ...
+    if( strcmp( lv_label_get_text( label ), text ) == 0 )
+    {
+        return false;
+    }
+
+    lv_label_set_text( label, text );
+
+    return true;
+}
+
+static void build_qrcode()
+{
+    // white screen, it doubles as the quiet zone around the code ...
+    lv_obj_set_style_bg_opa( lv_scr_act(), LV_OPA_100, LV_PART_MAIN );
+    lv_obj_set_style_bg_color( lv_scr_act(), lv_color_white(), LV_PART_MAIN );
+
+    // an indexed 1 bit canvas, lv_qrcode_update scales the modules to whole pixels and centers them ...
+    qrcode_ = lv_qrcode_create( lv_scr_act(), QRCODE_SIZE, lv_color_black(), lv_color_white() );
+
+    lv_obj_center( qrcode_ );
+}
+
+static void build_main()
+{
     lv_obj_t *ui_home = lv_scr_act();
     lv_obj_t *label_co2_name;
     lv_obj_t *label_air;
@@ -56,6 +453,7 @@ esp_err_t airshift_ui_display_main()
     lv_obj_set_style_bg_color(ui_home, lv_color_hex(0x707585), LV_PART_MAIN | LV_STATE_DEFAULT );
     lv_obj_set_style_bg_opa(ui_home, 255, LV_PART_MAIN| LV_STATE_DEFAULT);
     lv_obj_set_style_bg_grad_color(ui_home, lv_color_hex(0x455060), LV_PART_MAIN | LV_STATE_DEFAULT );
+    lv_obj_set_style_text_font(ui_home, &airshift_font_text_14, LV_PART_MAIN| LV_STATE_DEFAULT);
 
     arc_co2_ = lv_arc_create(ui_home);
     lv_arc_set_value( arc_co2_, 0 );
@@ -75,7 +473,7 @@ esp_err_t airshift_ui_display_main()
     lv_obj_set_style_arc_opa(arc_co2_, 255, LV_PART_MAIN| LV_STATE_DEFAULT);
     lv_obj_set_style_arc_width(arc_co2_, 8, LV_PART_MAIN| LV_STATE_DEFAULT);
 
-    lv_obj_set_style_arc_color(arc_co2_, lv_color_hex(0x36B9F6), LV_PART_INDICATOR | LV_STATE_DEFAULT );
+    lv_obj_set_style_arc_color(arc_co2_, lv_color_hex(air_quality_colors_[AIRSHIFT_AIR_QUALITY_UNKNOWN]), LV_PART_INDICATOR | LV_STATE_DEFAULT );
     lv_obj_set_style_arc_opa(arc_co2_, 255, LV_PART_INDICATOR| LV_STATE_DEFAULT);
     lv_obj_set_style_arc_width(arc_co2_, 8, LV_PART_INDICATOR| LV_STATE_DEFAULT);
 
@@ -86,7 +484,7 @@ esp_err_t airshift_ui_display_main()
     lv_label_set_text(label_co2_value_,"n/a");
     lv_obj_set_style_text_color(label_co2_value_, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT );
     lv_obj_set_style_text_opa(label_co2_value_, 255, LV_PART_MAIN| LV_STATE_DEFAULT);
-    lv_obj_set_style_text_font(label_co2_value_, &lv_font_montserrat_28, LV_PART_MAIN| LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(label_co2_value_, &airshift_font_value_28, LV_PART_MAIN| LV_STATE_DEFAULT);
 
     label_co2_name = lv_label_create(arc_co2_);
     lv_obj_set_width( label_co2_name, LV_SIZE_CONTENT);
@@ -127,44 +525,9 @@ esp_err_t airshift_ui_display_main()
     lv_label_set_text(label_air,"Air Sensor");
     lv_obj_set_style_text_color(label_air, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT );
     lv_obj_set_style_text_opa(label_air, 255, LV_PART_MAIN| LV_STATE_DEFAULT);
-
-    return ESP_OK;
 }
 
-void airshift_ui_set_co2( uint16_t value )
+static void monitor_callback( lv_disp_drv_t *disp_drv, uint32_t time, uint32_t px )
 {
-    char    label_text[10]  = { 0 };
-    float   percentage      = ( ( (float)value / (float)2500 ) * (float)100 ); // 2500 (unhealthy) == 100%
-
-    ESP_LOGI( TAG, "airshift_ui_set_co2" );
-
-    snprintf( label_text, sizeof( label_text ), "%hu", value );
-
-    lv_label_set_text( label_co2_value_, label_text );
-
-    lv_arc_set_value( arc_co2_, (int)percentage ); 
-}
-
-void airshift_ui_set_temperature( float value )
-{
-    char label_text[15] = { 0 };
-
-    ESP_LOGI( TAG, "airshift_ui_set_temperature" );
-
-    snprintf( label_text, sizeof( label_text ), "T: %.0f C", value );
-
-    lv_label_set_text( label_temp_, label_text );
+    invalidated_ += px;
 }
-
-void airshift_ui_set_particulate_matter( uint16_t value )
-{
-    char label_text[15] = { 0 };
-
-    ESP_LOGI( TAG, "airshift_ui_set_particulate_matter" );
-
-    snprintf( label_text, sizeof( label_text ), "PM: %hu", value );
-
-    lv_label_set_text( label_pm_, label_text );
-}
-
-// Private functions
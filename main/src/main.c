@@ -1,10 +1,14 @@
 #include "airshift_header_common.h"
 
 #include <esp_timer.h>
+#include <esp_console.h>
+#include <stdlib.h>
+#include <stdatomic.h>
 
 // Components ...
 #include "airshift_event.h"
 #include "airshift_nvs.h"
+#include "airshift_config.h"
 #include "airshift_common.h"
 #include "airshift_i2c.h"
 #include "airshift_matter.h"
@@ -12,28 +16,111 @@
 #include "airshift_pms7003.h"
 #include "airshift_senseair.h"
 #include "airshift_sht30.h"
+#include "airshift_acquisition.h"
+#include "airshift_timeseries.h"
+#include "airshift_air_quality.h"
+#include "airshift_history.h"
+#include "airshift_telemetry.h"
+#include "airshift_outbox.h"
 #include "airshift_led.h"
 #include "airshift_ui.h"
 #include "airshift_mqtt.h"
+#include "airshift_metrics.h"
+#include "airshift_trace.h"
+#include "airshift_power.h"
+#include "airshift_boot.h"
 
 // Component handlers ...
 
+#define PERIOD_US( field )	( (int64_t)airshift_config()->field * 1000 * 1000 )
+#define DIAG_MESSAGE_SIZE	1024
+
+// Boot stages, every one after the stages it depends on ...
+typedef enum
+{
+	STAGE_EVENT,
+	STAGE_METRICS,
+	STAGE_TRACE,
+	STAGE_POWER,
+	STAGE_NVS,
+	STAGE_CONFIG,
+	STAGE_I2C,
+	STAGE_LED,
+	STAGE_DISPLAY,
+	STAGE_UI,
+	STAGE_PMS7003,
+	STAGE_SENSEAIR,
+	STAGE_SHT30,
+	STAGE_ACQUISITION,
+	STAGE_TIMESERIES,
+	STAGE_AIR_QUALITY,
+	STAGE_HISTORY,
+	STAGE_CONSOLE,
+	STAGE_SENSING,
+	STAGE_MATTER,		// deferred, everything from here on waits for first light
+	STAGE_MQTT,
+	STAGE_TELEMETRY,
+	STAGE_OUTBOX,
+	STAGE_COUNT
+} stage_t;
+
+#define DEPENDS( stage )	AIRSHIFT_BOOT_DEPENDS( stage )
+
 static const char* TAG = "airshift_main";
 
 // Forward declarations
-static esp_err_t	init();
+static esp_err_t	init_event();
+static esp_err_t	release_event();
+static esp_err_t	init_acquisition();
+static esp_err_t	init_mqtt();
+static esp_err_t	init_telemetry();
+static esp_err_t	start_sensing();
+static esp_err_t	start_console();
 static void			release();
 static void			airshift_event_handler( void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data );
 static void			start_restart_timer( uint64_t timeout_us );
 static void			restart_timer_callback( void* arguments );
 static void			sensor_polling_task( void* arguments );
-static void			mqtt_publish( int co2, float temp, int pm2, float rh );
-static void			update_leds( int co2 );
+static void			mqtt_publish( const airshift_sample_set_t *sample_set );
+static void			log_mqtt_stats();
+static void			publish_diagnostics();
+static void			update_matter( const airshift_sample_set_t *sample_set, airshift_air_quality_t quality );
+static void			update_leds( airshift_air_quality_t quality );
 static void			blink_leds_task( void* arguments );
 
+// the sensors, display and leds come up first, the network once the device shows readings. Sensors, power and the history
+// log are soft dependencies, sensing runs with whatever of them came up ...
+static const airshift_boot_stage_t stages_[STAGE_COUNT] =
+{
+	[STAGE_EVENT]		= { .name = "event",		.init = init_event,					.release = release_event },
+	[STAGE_METRICS]		= { .name = "metrics",		.init = airshift_metrics_init,		.release = airshift_metrics_release },
+	[STAGE_TRACE]		= { .name = "trace",		.init = airshift_trace_init,		.release = airshift_trace_release },
+	[STAGE_POWER]		= { .name = "power",		.init = airshift_power_init,		.release = airshift_power_release,			.depends = DEPENDS( STAGE_EVENT ) },
+	[STAGE_NVS]			= { .name = "nvs",			.init = airshift_nvs_init,			.release = airshift_nvs_release,			.depends = DEPENDS( STAGE_TRACE ) },
+	[STAGE_CONFIG]		= { .name = "config",		.init = airshift_config_init,		.release = airshift_config_release,			.depends = DEPENDS( STAGE_NVS ) },
+	[STAGE_I2C]			= { .name = "i2c",			.init = airshift_i2c_init,			.release = airshift_i2c_release,			.depends = DEPENDS( STAGE_METRICS ) | DEPENDS( STAGE_TRACE ) },
+	[STAGE_LED]			= { .name = "led",			.init = airshift_led_init,			.release = airshift_led_release },
+	[STAGE_DISPLAY]		= { .name = "display",		.init = airshift_display_init,		.release = airshift_display_release,		.depends = DEPENDS( STAGE_METRICS ) },
+	[STAGE_UI]			= { .name = "ui",			.init = airshift_ui_init,			.release = airshift_ui_release,				.depends = DEPENDS( STAGE_DISPLAY ) },
+	[STAGE_PMS7003]		= { .name = "pms7003",		.init = airshift_pms7003_init,		.release = airshift_pms7003_release,		.depends = DEPENDS( STAGE_METRICS ) | DEPENDS( STAGE_TRACE ),		.after = DEPENDS( STAGE_POWER ) },
+	[STAGE_SENSEAIR]	= { .name = "senseair",		.init = airshift_senseair_init,		.release = airshift_senseair_release,		.depends = DEPENDS( STAGE_METRICS ) },
+	[STAGE_SHT30]		= { .name = "sht30",		.init = airshift_sht30_init,		.release = airshift_sht30_release,			.depends = DEPENDS( STAGE_I2C ) },
+	[STAGE_ACQUISITION]	= { .name = "acquisition",	.init = init_acquisition,			.release = airshift_acquisition_release,									.after = DEPENDS( STAGE_PMS7003 ) | DEPENDS( STAGE_SENSEAIR ) | DEPENDS( STAGE_SHT30 ) },
+	[STAGE_TIMESERIES]	= { .name = "timeseries",	.init = airshift_timeseries_init,	.release = airshift_timeseries_release },
+	[STAGE_AIR_QUALITY]	= { .name = "air_quality",	.init = airshift_air_quality_init,	.release = airshift_air_quality_release },
+	[STAGE_HISTORY]		= { .name = "history",		.init = airshift_history_init,		.release = airshift_history_release },
+	[STAGE_CONSOLE]		= { .name = "console",		.init = start_console,													.depends = DEPENDS( STAGE_METRICS ) | DEPENDS( STAGE_POWER ) | DEPENDS( STAGE_CONFIG ) },
+	[STAGE_SENSING]		= { .name = "sensing",		.init = start_sensing,													.depends = DEPENDS( STAGE_ACQUISITION ) | DEPENDS( STAGE_TIMESERIES ) | DEPENDS( STAGE_AIR_QUALITY ) | DEPENDS( STAGE_CONFIG ),	.after = DEPENDS( STAGE_HISTORY ) },
+	[STAGE_MATTER]		= { .name = "matter",		.init = airshift_matter_init,		.release = airshift_matter_release,			.depends = DEPENDS( STAGE_EVENT ) | DEPENDS( STAGE_NVS ),	.deferred = true },
+	[STAGE_MQTT]		= { .name = "mqtt",			.init = init_mqtt,					.release = airshift_mqtt_release,			.depends = DEPENDS( STAGE_EVENT ) | DEPENDS( STAGE_POWER ),	.deferred = true },
+	[STAGE_TELEMETRY]	= { .name = "telemetry",	.init = init_telemetry,				.release = airshift_telemetry_release,		.depends = DEPENDS( STAGE_MQTT ) | DEPENDS( STAGE_CONFIG ),	.deferred = true },
+	[STAGE_OUTBOX]		= { .name = "outbox",		.init = airshift_outbox_init,		.release = airshift_outbox_release,			.depends = DEPENDS( STAGE_NVS ) | DEPENDS( STAGE_HISTORY ) | DEPENDS( STAGE_TELEMETRY ),	.deferred = true },
+};
+
 static const esp_timer_create_args_t	restart_timer_args_ = { .callback = &restart_timer_callback, .name = "restart-timer" };
 static esp_timer_handle_t				restart_timer_		= NULL;
 static bool								blink_leds_			= false;
+static atomic_bool						network_up_			= false;
 
 // Public functions
 void app_main( void )
@@ -50,91 +137,123 @@ void app_main( void )
 	ESP_LOGI( TAG, "esp_wakeup_status: %llu", wakeup_status );
 	ESP_LOGI( TAG, "utc_time: %lld", utc_time.tv_sec );
 
-	init(); // TODO: Need to handle init failures somehow, flashing lights, etc... depending on the failure...
-
-	// Log some debug / startup information ...
-	ESP_LOGI( TAG, "AirShift firmware running ..." );
-
-	// Main event loop ...
-	while( true )
+	// independent components come up side by side, a failed one only takes down what depends on it, the rest keeps running ...
+	if( airshift_boot_run( stages_, STAGE_COUNT ) != ESP_OK )
+	{
+		ESP_LOGE( TAG, "AirShift firmware running degraded, 'boot' on the console lists what did not come up ..." );
+	}
+	else
 	{
-		lv_task_handler();
-		
-		vTaskDelay( 1000 / portTICK_PERIOD_MS );
+		// Log some debug / startup information ...
+		ESP_LOGI( TAG, "AirShift firmware running ..." );
 	}
+
+	// nothing left for the main task, lvgl has its own task that sleeps until its next deadline or a published change ...
 }
 
 // Private functions
-static esp_err_t init()
+static esp_err_t init_event()
 {
 	esp_err_t ret = ESP_FAIL;
 
-	ESP_LOGI( TAG, "init" );
+	ESP_LOGI( TAG, "init_event" );
 
 	ESP_GOTO_ON_ERROR( airshift_event_init(), error, TAG, "airshift_event_init failed" );
-	
+
 	ESP_GOTO_ON_ERROR( esp_event_handler_instance_register( AIRSHIFT_EVENT_GENERAL, ESP_EVENT_ANY_ID, airshift_event_handler, NULL, NULL ), error, TAG, "esp_event_handler_instance_register failed" );
 	ESP_GOTO_ON_ERROR( esp_event_handler_instance_register( AIRSHIFT_EVENT_MATTER, ESP_EVENT_ANY_ID, airshift_event_handler, NULL, NULL ), error, TAG, "esp_event_handler_instance_register failed" );
 
-	ESP_GOTO_ON_ERROR( airshift_nvs_init(), error, TAG, "airshift_nvs_init failed" );
+	return ESP_OK;
 
-	ESP_GOTO_ON_ERROR( airshift_i2c_init(), error, TAG, "airshift_i2c_init failed" );
+error:
+
+	ESP_LOGE( TAG, "init_event failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+	return ret;
+}
 
-	ESP_GOTO_ON_ERROR( airshift_led_init(), error, TAG, "airshift_led_init failed" );
+static esp_err_t release_event()
+{
+	ESP_LOGI( TAG, "release_event" );
 
-	ESP_GOTO_ON_ERROR( airshift_display_init(), error, TAG, "airshift_display_init failed" );
+	ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_handler_unregister( AIRSHIFT_EVENT_GENERAL, ESP_EVENT_ANY_ID, &airshift_event_handler ) );
 
-	ESP_GOTO_ON_ERROR( airshift_ui_init(), error, TAG, "airshift_ui_init failed" );
+	return airshift_event_release();
+}
 
-	ESP_GOTO_ON_ERROR( airshift_pms7003_init(), error, TAG, "airshift_pms7003_init failed" );
+static esp_err_t init_acquisition()
+{
+	uint32_t sensors = 0;
 
-	ESP_GOTO_ON_ERROR( airshift_senseair_init(), error, TAG, "airshift_senseair_init failed" );
+	// every sensor that came up is read, the ones that did not stay invalid in valid_mask ...
+	sensors |= airshift_boot_is_ready( STAGE_PMS7003 ) ? AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_PMS7003 ) : 0;
+	sensors |= airshift_boot_is_ready( STAGE_SENSEAIR ) ? AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR ) : 0;
+	sensors |= airshift_boot_is_ready( STAGE_SHT30 ) ? AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 ) : 0;
 
-	ESP_GOTO_ON_ERROR( airshift_sht30_init(), error, TAG, "airshift_sht30_init failed" );
+	return airshift_acquisition_init( sensors );
+}
 
-	ESP_GOTO_ON_ERROR( airshift_matter_init(), error, TAG, "airshift_matter_init failed" );
+static esp_err_t init_mqtt()
+{
+	esp_err_t ret = ESP_FAIL;
 
 	ESP_GOTO_ON_ERROR( airshift_mqtt_init(), error, TAG, "airshift_mqtt_init failed" );
-	
+
+	// matter comes up alongside, an address handed out before the client existed is not waited for again ...
+	if( atomic_load( &network_up_ ) == true )
+	{
+		airshift_mqtt_start();
+	}
+
 	return ESP_OK;
 
 error:
 
-    ESP_LOGE( TAG, "device_init failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
-
-	// Any part of device initialization has failed, let's cleanup, so we can try again ...
-	release();
+	ESP_LOGE( TAG, "init_mqtt failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
 
 	return ret;
 }
 
-static void release()
+static esp_err_t init_telemetry()
 {
-	ESP_LOGI( TAG, "release" );
+	esp_err_t ret = ESP_FAIL;
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_mqtt_release() );
+	ESP_GOTO_ON_ERROR( airshift_telemetry_init(), error, TAG, "airshift_telemetry_init failed" );
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_matter_release() );
+	airshift_telemetry_set_mode( (airshift_telemetry_mode_t)airshift_config()->telemetry_mode );
+
+	airshift_telemetry_set_format( (airshift_telemetry_format_t)airshift_config()->telemetry_format );
+
+	return ESP_OK;
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_sht30_release() );
-	
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_senseair_release() );
+error:
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_pms7003_release() );
+	ESP_LOGE( TAG, "init_telemetry failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_ui_release() );
+	return ret;
+}
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_display_release() );
+static esp_err_t start_sensing()
+{
+	ESP_LOGI( TAG, "start_sensing" );
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_led_release() );
+	// display main user interface, without a display the values simply go nowhere ...
+	airshift_ui_display_main();
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_i2c_release() );
+	// ... readings no longer wait for the network, matter and mqtt pick them up once they are there ...
+	if( xTaskCreate( sensor_polling_task, "sensor_polling_task", 8192, NULL, 5, NULL ) != pdPASS )
+	{
+		return ESP_ERR_NO_MEM;
+	}
 
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_nvs_release() );
-	
-	ESP_ERROR_CHECK_WITHOUT_ABORT( esp_event_handler_unregister( AIRSHIFT_EVENT_GENERAL, ESP_EVENT_ANY_ID, &airshift_event_handler ) );
-	
-	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_event_release() );
+	return ESP_OK;
+}
+
+static void release()
+{
+	ESP_LOGI( TAG, "release" );
+
+	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_boot_release() );
 
 	if( ( restart_timer_ != NULL ) && ( esp_timer_is_active( restart_timer_ ) == true ) )
 	{
@@ -143,6 +262,51 @@ static void release()
 	}
 }
 
+static esp_err_t start_console()
+{
+	esp_err_t					ret			= ESP_FAIL;
+	esp_console_repl_t			*repl		= NULL;
+	esp_console_repl_config_t	repl_config	= ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+
+	ESP_LOGI( TAG, "start_console" );
+
+	repl_config.prompt = "airshift>";
+
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+	esp_console_dev_usb_serial_jtag_config_t device_config = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+
+	ESP_GOTO_ON_ERROR( esp_console_new_repl_usb_serial_jtag( &device_config, &repl_config, &repl ), error, TAG, "esp_console_new_repl_usb_serial_jtag failed" );
+#else
+	esp_console_dev_uart_config_t device_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+
+	ESP_GOTO_ON_ERROR( esp_console_new_repl_uart( &device_config, &repl_config, &repl ), error, TAG, "esp_console_new_repl_uart failed" );
+#endif
+
+	ESP_GOTO_ON_ERROR( esp_console_register_help_command(), error, TAG, "esp_console_register_help_command failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_metrics_register_console(), error, TAG, "airshift_metrics_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_power_register_console(), error, TAG, "airshift_power_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_matter_register_console(), error, TAG, "airshift_matter_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_config_register_console(), error, TAG, "airshift_config_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_boot_register_console(), error, TAG, "airshift_boot_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( airshift_timeseries_register_console(), error, TAG, "airshift_timeseries_register_console failed" );
+
+	ESP_GOTO_ON_ERROR( esp_console_start_repl( repl ), error, TAG, "esp_console_start_repl failed" );
+
+	return ESP_OK;
+
+error:
+
+	ESP_LOGE( TAG, "start_console failed: %s ( 0x%x )", esp_err_to_name( ret ), ret );
+
+	return ret;
+}
+
 static void airshift_event_handler( void* handler_args, esp_event_base_t base, int32_t event_id, void* event_data )
 {
 	ESP_LOGI( TAG, "%s: airshift_event_handler -> event id: %ld", base, event_id );
@@ -151,8 +315,13 @@ static void airshift_event_handler( void* handler_args, esp_event_base_t base, i
 	{
 		case AIRSHIFT_EVENT_MATTER_COMMISSIONING_WINDOW_OPENED:
 		{
-			// need to show qrcode for provisioning ...
-			ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_ui_display_qrcode() );
+			char payload[AIRSHIFT_MATTER_QRCODE_PAYLOAD_SIZE] = { 0 };
+
+			// need to show qrcode for provisioning, every device has its own onboarding payload ...
+			if( airshift_matter_get_qrcode_payload( payload, sizeof( payload ) ) == ESP_OK )
+			{
+				ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_ui_display_qrcode( payload ) );
+			}
 
 			break;
 		}
@@ -172,8 +341,12 @@ static void airshift_event_handler( void* handler_args, esp_event_base_t base, i
 		}
 		case AIRSHIFT_EVENT_MATTER_IP_EVENT_STA_GOT_IP:
 		{
-			// create task to poll sensors ...
-			xTaskCreate( sensor_polling_task, "sensor_polling_task", 8192, NULL, 5, NULL );
+			// sensors are already being read, back from the qrcode to the readings and on to the broker ...
+			atomic_store( &network_up_, true );
+
+			airshift_ui_display_main();
+
+			airshift_mqtt_start();
 
 			break;
 		}
@@ -206,129 +379,326 @@ static void restart_timer_callback( void* arguments )
 
 static void sensor_polling_task( void* arguments )
 {
-	pms7003_data_t	pms7003_data	= { 0 };
-	uint32_t		co2_value		= 0;
-	sht30_data_t	sht30_data		= { 0 };
+	airshift_sample_set_t		sample_set		= { 0 };
+	airshift_sample_t			sample			= { 0 };
+	airshift_history_record_t	record			= { 0 };
+	airshift_air_quality_result_t	air_quality	= { 0 };
+	int64_t						last_publish	= 0;
+	int64_t						last_history	= 0;
+	int64_t						last_diag		= 0;
+	int64_t						started			= 0;
+	bool						recorded		= false;
+	bool						publish_due		= false;
+	bool						delivered		= false;
 
 	ESP_LOGI( TAG, "sensor_polling_task" );
 
-	// display main user interface ....
-	airshift_ui_display_main();
-
-	// start mqtt ...
-	airshift_mqtt_start();
-
 	// upon startup, give all sensors 30 seconds to warm up? Just a random number here, may need to be tweaked ...
 	vTaskDelay( 30000 / portTICK_PERIOD_MS );
 
+	// sensors are now read concurrently, each on its own cadence, by the acquisition engine ...
+	ESP_ERROR_CHECK_WITHOUT_ABORT( airshift_acquisition_start() );
+
 	while( true )
 	{
-		// read sensor data ...
-		airshift_pms7003_get( &pms7003_data );
+		if( airshift_acquisition_wait( &sample_set, portMAX_DELAY ) != ESP_OK )
+		{
+			continue;
+		}
+
+		airshift_boot_mark_first_reading();
+
+		// every sensor of this cycle has been read, the next trigger is most of a cycle away, settings waiting for the flash go out now ...
+		airshift_nvs_commit_if_due();
+
+		// keep every sample set in the time-series store, it downsamples into the slower tiers itself ...
+		airshift_acquisition_to_sample( &sample_set, &sample );
+
+		airshift_timeseries_push( &sample );
+
+		// ... one air quality for the leds, the ui and matter alike, from rolling windows over every sample set ...
+		airshift_air_quality_update( &sample, &air_quality );
+
+		// ... matter controllers follow every sample set, the attributes go out as one batch on the chip thread ...
+		if( airshift_boot_is_ready( STAGE_MATTER ) )
+		{
+			update_matter( &sample_set, air_quality.quality );
+		}
+
+		// only publish coherent sample sets, where every sensor being read was triggered at the same instant ...
+		publish_due = ( sample_set.updated_mask == airshift_acquisition_get_sensors() ) && ( ( sample_set.timestamp - last_publish ) >= PERIOD_US( publish_period_s ) );
+
+		// ... and a record in flash every few seconds, so readings survive network and power outages, published sets always get one ...
+		if( publish_due || ( ( sample_set.timestamp - last_history ) >= PERIOD_US( history_period_s ) ) )
+		{
+			last_history	= sample_set.timestamp;
+			started			= esp_timer_get_time();
+			recorded		= airshift_boot_is_ready( STAGE_HISTORY ) && ( airshift_history_append( &sample, &record ) == ESP_OK );
 
-		airshift_senseair_get( &co2_value );
+			airshift_metrics_record( AIRSHIFT_METRICS_STAGE_HISTORY_APPEND, esp_timer_get_time() - started );
+		}
+
+		// ... stage latencies and error counters once a minute, for fleet diagnostics ...
+		if( ( sample_set.timestamp - last_diag ) >= PERIOD_US( diag_period_s ) )
+		{
+			last_diag = sample_set.timestamp;
 
-		airshift_sht30_get( &sht30_data );
+			publish_diagnostics();
+		}
+
+		if( !publish_due )
+		{
+			continue;
+		}
+
+		last_publish = sample_set.timestamp;
+
+		// ... without the log the record is still published live, there is just nothing to backfill from ...
+		if( !recorded )
+		{
+			airshift_history_to_record( &sample, &record );
+		}
+
+		AIRSHIFT_TRACEI( TAG, "sample set: cycle: %lu, latency: %lld us, jitter: %lld us, valid: 0x%lx", sample_set.cycle, sample_set.latency, sample_set.jitter, sample_set.valid_mask );
 
 		// ... update ui with sensor data ...
-		airshift_ui_set_co2( (uint16_t)co2_value );
+		started = esp_timer_get_time();
+
+		airshift_ui_set_co2( (uint16_t)sample_set.senseair.co2 );
 
-		airshift_ui_set_temperature( sht30_data.temperature );
+		airshift_ui_set_temperature( sample_set.sht30.temperature );
 
-		airshift_ui_set_particulate_matter( pms7003_data.pm_sp_ug_2_5 );
+		airshift_ui_set_particulate_matter( sample_set.pms7003.pm_sp_ug_2_5 );
+
+		airshift_ui_set_air_quality( air_quality.quality );
+
+		airshift_metrics_record( AIRSHIFT_METRICS_STAGE_UI_UPDATE, esp_timer_get_time() - started );
 
 		// ... update leds ...
-		update_leds( co2_value );
+		started = esp_timer_get_time();
+
+		if( airshift_boot_is_ready( STAGE_LED ) )
+		{
+			update_leds( air_quality.quality );
+		}
+
+		airshift_metrics_record( AIRSHIFT_METRICS_STAGE_LED_UPDATE, esp_timer_get_time() - started );
 
-		// ... send sensor data via mqtt ...
-		mqtt_publish( co2_value, sht30_data.temperature, pms7003_data.pm_sp_ug_2_5, sht30_data.humidity );
+		// ... send sensor data via mqtt, one message per sample set and / or the legacy per channel topics ...
+		delivered = false;
+
+		if( airshift_mqtt_is_connected() && airshift_boot_is_ready( STAGE_TELEMETRY ) )
+		{
+			if( airshift_telemetry_get_mode() & AIRSHIFT_TELEMETRY_MODE_BATCHED )
+			{
+				delivered = ( airshift_telemetry_publish( &record ) == ESP_OK );
+			}
+
+			if( airshift_telemetry_get_mode() & AIRSHIFT_TELEMETRY_MODE_LEGACY )
+			{
+				mqtt_publish( &sample_set );
 
-		vTaskDelay( 10000 / portTICK_PERIOD_MS ); // sleep 10 seconds before next reading ...
+				delivered |= !( airshift_telemetry_get_mode() & AIRSHIFT_TELEMETRY_MODE_BATCHED );
+			}
+		}
+
+		// ... otherwise it is backfilled from the history log once the broker is reachable again ...
+		if( recorded && !delivered && airshift_boot_is_ready( STAGE_OUTBOX ) )
+		{
+			airshift_outbox_push( &record );
+		}
+
+		log_mqtt_stats();
 	}
 
 	vTaskDelete( NULL );
 }
 
-static void mqtt_publish( int co2, float temp, int pm2, float rh )
+static void mqtt_publish( const airshift_sample_set_t *sample_set )
 {
 	char		topic[64]	= { 0 };
     char		message[32]	= { 0 };
 	const char	*client_id	= airshift_mqtt_get_client_id();
+	uint32_t	fresh		= sample_set->valid_mask & ~sample_set->held_mask;
+	uint32_t	pms7003		= fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_PMS7003 );
+	uint32_t	senseair	= fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR );
+	uint32_t	sht30		= fresh & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 );
 
-	ESP_LOGI( TAG, "mqtt_publish" );
+	AIRSHIFT_TRACEI( TAG, "mqtt_publish" );
+
+	// a sensor that missed this cycle, or sleeps between windows, still holds its last good reading, it is not published again as if it were new ...
 
 	/* CO2 */
-	sprintf( topic, "co2/%s", client_id );
-	sprintf( message, "%d", co2 );
+	if( senseair )
+	{
+		sprintf( topic, "co2/%s", client_id );
+		sprintf( message, "%d", sample_set->senseair.co2 );
 
-	airshift_mqtt_publish( topic, message, strlen( message ) );
+		airshift_mqtt_publish( topic, message, strlen( message ) );
+	}
 
 	/* Temperature */
-	sprintf( topic, "temp/%s", client_id );
-	sprintf( message, "%.01f", temp );
-	
-	airshift_mqtt_publish( topic, message, strlen( message ) );
+	if( sht30 )
+	{
+		sprintf( topic, "temp/%s", client_id );
+		sprintf( message, "%.01f", sample_set->sht30.temperature );
+
+		airshift_mqtt_publish( topic, message, strlen( message ) );
+	}
 
 	/* Humidity */
-	sprintf( topic, "rh/%s", client_id );
-	sprintf( message, "%.0f", rh );
-	
-	airshift_mqtt_publish( topic, message, strlen( message ) );
+	if( sht30 )
+	{
+		sprintf( topic, "rh/%s", client_id );
+		sprintf( message, "%.0f", sample_set->sht30.humidity );
+
+		airshift_mqtt_publish( topic, message, strlen( message ) );
+	}
 
 	/* PM */
-	sprintf( topic, "pm2.5/%s", client_id );
-	sprintf( message, "%d", pm2 );
-	
-	airshift_mqtt_publish( topic, message, strlen( message ) );
+	if( pms7003 )
+	{
+		sprintf( topic, "pm2.5/%s", client_id );
+		sprintf( message, "%d", sample_set->pms7003.pm_sp_ug_2_5 );
+
+		airshift_mqtt_publish( topic, message, strlen( message ) );
+	}
 }
 
-static void update_leds( int co2 )
+static void log_mqtt_stats()
 {
-	airshift_led_color_t airshift_led_color = AIRSHIFT_LED_COLOR_BLACK;
+	airshift_mqtt_stats_t	stats	= { 0 };
+	int64_t					elapsed	= 0;
 
-	ESP_LOGI( TAG, "update_leds" );
+	airshift_mqtt_get_stats( &stats );
 
-	// 400 ppm: average outdoor air level.
-	// 400–1,000 ppm: typical level found in occupied spaces with good air exchange.
-	// 1,000–2,000 ppm: level associated with complaints of drowsiness and poor air.
-	// 2,000–5,000 ppm: level associated with headaches, sleepiness, and stagnant, stale, stuffy air. Poor concentration, loss of attention, increased heart rate and slight nausea may also be present.
-	// 5,000 ppm: this indicates unusual air conditions where high levels of other gases could also be present. Toxicity or oxygen deprivation could occur. This is the permissible exposure limit for daily workplace exposures.
-	// 40,000 ppm: this level is immediately harmful due to oxygen deprivation.
+	elapsed = esp_timer_get_time() - stats.since;
 
-	for( short i = AIRSHIFT_LED_POSITION_ONE; i <= AIRSHIFT_LED_POSITION_FOUR; i++ )
+	if( elapsed <= 0 )
 	{
-		if( co2 < 1000 )
+		return;
+	}
+
+	// per device broker load, messages and bytes on the wire per hour ...
+	AIRSHIFT_TRACEI( TAG, "mqtt: publishes: %lu, acks: %lu, failures: %lu, payload: %llu bytes, wire: %llu bytes, rate: %lld msg/h, %lld bytes/h",
+		stats.publishes, stats.acks, stats.publish_failures, stats.payload_bytes, stats.wire_bytes,
+		( (int64_t)stats.publishes * 3600LL * 1000 * 1000 ) / elapsed, ( (int64_t)stats.wire_bytes * 3600LL * 1000 * 1000 ) / elapsed );
+
+	// outbox sizing, queue depth against its limits, what had to go and how long the broker takes to ack ...
+	AIRSHIFT_TRACEI( TAG, "mqtt queue: depth: %lu ( max %lu ), bytes: %lu ( max %lu ), inflight: %lu, dropped oldest: %lu, dropped newest: %lu, coalesced: %lu, ack timeouts: %lu, ack latency: %lld us ( avg %lld, max %lld )",
+		stats.queue_depth, stats.queue_depth_max, stats.queue_bytes, stats.queue_bytes_max, stats.inflight, stats.dropped_oldest, stats.dropped_newest, stats.coalesced,
+		stats.ack_timeouts, stats.ack_latency_last, stats.ack_latency_avg, stats.ack_latency_max );
+}
+
+static void publish_diagnostics()
+{
+	char	topic[64]	= { 0 };
+	char	*message	= NULL;
+	size_t	length		= 0;
+
+	if( airshift_mqtt_is_connected() != true )
+	{
+		return;
+	}
+
+	message = malloc( DIAG_MESSAGE_SIZE );
+
+	if( message == NULL )
+	{
+		return;
+	}
+
+	if( airshift_metrics_to_json( message, DIAG_MESSAGE_SIZE, &length ) == ESP_OK )
+	{
+		sprintf( topic, "diag/%s", airshift_mqtt_get_client_id() );
+
+		airshift_mqtt_publish( topic, message, length );
+	}
+
+	free( message );
+}
+
+static void update_matter( const airshift_sample_set_t *sample_set, airshift_air_quality_t quality )
+{
+	airshift_matter_measurements_t	measurements	= { 0 };
+	uint32_t						pms7003			= sample_set->valid_mask & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_PMS7003 );
+	uint32_t						senseair		= sample_set->valid_mask & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SENSEAIR );
+	uint32_t						sht30			= sample_set->valid_mask & AIRSHIFT_ACQUISITION_SENSOR_BIT( AIRSHIFT_ACQUISITION_SENSOR_SHT30 );
+
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_CO2]			= sample_set->senseair.co2;
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_PM_1_0]			= sample_set->pms7003.pm_sp_ug_1_0;
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_PM_2_5]			= sample_set->pms7003.pm_sp_ug_2_5;
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_PM_10_0]		= sample_set->pms7003.pm_sp_ug_10_0;
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_TEMPERATURE]	= sample_set->sht30.temperature;
+	measurements.values[AIRSHIFT_MATTER_MEASUREMENT_HUMIDITY]		= sample_set->sht30.humidity;
+
+	// a sensor without a valid reading shows up as null rather than its last value, a held one keeps it, unchanged it is not written again ...
+	measurements.valid_mask |= ( senseair != 0 ) ? AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_CO2 ) : 0;
+	measurements.valid_mask |= ( pms7003 != 0 ) ? ( AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_PM_1_0 ) | AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_PM_2_5 ) | AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_PM_10_0 ) ) : 0;
+	measurements.valid_mask |= ( sht30 != 0 ) ? ( AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_TEMPERATURE ) | AIRSHIFT_MATTER_MEASUREMENT_BIT( AIRSHIFT_MATTER_MEASUREMENT_HUMIDITY ) ) : 0;
+
+	measurements.air_quality = quality;
+
+	airshift_matter_update( &measurements );
+}
+
+static void update_leds( airshift_air_quality_t quality )
+{
+	airshift_led_color_t airshift_led_color = AIRSHIFT_LED_COLOR_BLACK;
+
+	AIRSHIFT_TRACEI( TAG, "update_leds" );
+
+	// the air quality fuses co2, particulate matter and humidity, see airshift_air_quality for the breakpoints ...
+	switch( quality )
+	{
+		case AIRSHIFT_AIR_QUALITY_GOOD:
+		case AIRSHIFT_AIR_QUALITY_FAIR:
 		{
 			// Excellent
-			airshift_led_color	= AIRSHIFT_LED_COLOR_GREEN;
-			blink_leds_			= false;
-        }
-		else if( co2 < 1500 )
+			airshift_led_color = AIRSHIFT_LED_COLOR_GREEN;
+			break;
+		}
+		case AIRSHIFT_AIR_QUALITY_MODERATE:
 		{
-            // Mediocre
-			airshift_led_color	= AIRSHIFT_LED_COLOR_YELLOW;
-			blink_leds_			= false;
-        }
-		else if( co2 < 2000 )
+			// Mediocre
+			airshift_led_color = AIRSHIFT_LED_COLOR_YELLOW;
+			break;
+		}
+		case AIRSHIFT_AIR_QUALITY_POOR:
 		{
-            // Unhealthy
-			airshift_led_color	= AIRSHIFT_LED_COLOR_ORANGE;
-			blink_leds_			= false;
-        }
-		else if( co2 < 2500 )
+			// Unhealthy
+			airshift_led_color = AIRSHIFT_LED_COLOR_ORANGE;
+			break;
+		}
+		case AIRSHIFT_AIR_QUALITY_VERY_POOR:
 		{
-            // Very unhealthy
-			airshift_led_color	= AIRSHIFT_LED_COLOR_RED;
-			blink_leds_			= false;
-        }
-		else
+			// Very unhealthy
+			airshift_led_color = AIRSHIFT_LED_COLOR_RED;
+			break;
+		}
+		case AIRSHIFT_AIR_QUALITY_EXTREMELY_POOR:
 		{
-            // Hazardous. Blink if co2 is too high
+			// Hazardous. Blink
 			airshift_led_color = AIRSHIFT_LED_COLOR_PURPLE;
-        }
+			break;
+		}
+		default:
+		{
+			// nothing measured yet ...
+			airshift_led_color = AIRSHIFT_LED_COLOR_BLACK;
+			break;
+		}
+	}
+
+	if( airshift_led_color != AIRSHIFT_LED_COLOR_PURPLE )
+	{
+		blink_leds_ = false;
+	}
 
+	for( short i = AIRSHIFT_LED_POSITION_ONE; i <= AIRSHIFT_LED_POSITION_FOUR; i++ )
+	{
 		airshift_led_set( i, airshift_led_color );
-    }
+	}
 
 	// start blink task, if not already running ...
 	if( airshift_led_color == AIRSHIFT_LED_COLOR_PURPLE )
@@ -373,6 +743,4 @@ static void blink_leds_task( void* arguments )
 	vTaskDelete( NULL );
 }
 
-// chip-tool payload generate-qrcode --discriminator 3840 --setup-pin-code 20202021 --vendor-id 0xFFF1 --product-id 0x8000 --version 0 --commissioning-mode 0 --rendezvous 2
-
 // modified to turn off CHIP logging: /Volumes/RaidData/BuildTools/espressif/esp-matter/connectedhomeip/connectedhomeip/config/esp32/components/chip/CMakeLists.txt
\ No newline at end of file